@@ -0,0 +1,139 @@
+#include "BenchFramework.h"
+#include <Archive.h>
+#include <Vector.h>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef CVector<float, 3> CBenchVector;
+
+static CArray<double> createDoubles( int count )
+{
+	CArray<double> result;
+	for( int i = 0; i < count; i++ ) {
+		result.Add( i * 0.25 );
+	}
+	return result;
+}
+
+static CArray<CBenchVector> createVectors( int count )
+{
+	CArray<CBenchVector> result;
+	for( int i = 0; i < count; i++ ) {
+		result.Add( CBenchVector( i * 1.0f, i * 2.0f, i * 3.0f ) );
+	}
+	return result;
+}
+
+// Element by element serialization of the scalar values, as the arrays were serialized before the bulk copy.
+static void writeValues( CArchiveWriter& archive, const CArray<double>& values )
+{
+	archive << values.Size();
+	for( double value : values ) {
+		archive << value;
+	}
+}
+
+static void readValues( CArchiveReader& archive, CArray<double>& values )
+{
+	int size;
+	archive >> size;
+	values.Empty();
+	values.IncreaseSize( size );
+	for( double& value : values ) {
+		archive >> value;
+	}
+}
+
+static void writeValues( CArchiveWriter& archive, const CArray<CBenchVector>& values )
+{
+	archive << values.Size();
+	for( const auto& value : values ) {
+		for( int i = 0; i < 3; i++ ) {
+			archive << value[i];
+		}
+	}
+}
+
+static void readValues( CArchiveReader& archive, CArray<CBenchVector>& values )
+{
+	int size;
+	archive >> size;
+	values.Empty();
+	values.IncreaseSize( size );
+	for( auto& value : values ) {
+		for( int i = 0; i < 3; i++ ) {
+			archive >> value[i];
+		}
+	}
+}
+
+// Best time of several loads of the data. The reader takes its own copy of the data, the copying is not measured.
+template <class LoadAction>
+static double measureLoading( const CArray<BYTE>& data, const LoadAction& load )
+{
+	double bestTime = 0;
+	for( int run = 0; run < 5; run++ ) {
+		CArchiveReader archive( copy( data ) );
+		const double runTime = MeasureSeconds( 1, [&]() { load( archive ); } );
+		bestTime = run == 0 ? runTime : min( bestTime, runTime );
+	}
+	return bestTime;
+}
+
+// Save and load throughput of the array with the element by element and with the bulk serialization.
+template <class Elem>
+static void benchmarkArray( const char* arrayName, const CArray<Elem>& source )
+{
+	const double byteCount = static_cast<double>( source.Size() ) * sizeof( Elem );
+	char caseName[64];
+	CArray<BYTE> elementData;
+	const double elementSaveTime = MeasureSeconds( 5, [&]() {
+		CArchiveWriter archive;
+		writeValues( archive, source );
+		elementData = archive.FlushToByteString();
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, save by element", arrayName );
+	ReportThroughput( caseName, elementSaveTime, byteCount );
+
+	CArray<BYTE> bulkData;
+	const double bulkSaveTime = MeasureSeconds( 5, [&]() {
+		CArchiveWriter archive;
+		archive << source;
+		bulkData = archive.FlushToByteString();
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, save in bulk", arrayName );
+	ReportThroughput( caseName, bulkSaveTime, byteCount );
+	snprintf( caseName, sizeof( caseName ), "%s, save speedup", arrayName );
+	Report( caseName, elementSaveTime / bulkSaveTime, "x" );
+
+	CArray<Elem> target;
+	const double elementLoadTime = measureLoading( elementData, [&]( CArchiveReader& archive ) { readValues( archive, target ); } );
+	snprintf( caseName, sizeof( caseName ), "%s, load by element", arrayName );
+	ReportThroughput( caseName, elementLoadTime, byteCount );
+
+	const double bulkLoadTime = measureLoading( bulkData, [&]( CArchiveReader& archive ) { archive >> target; } );
+	snprintf( caseName, sizeof( caseName ), "%s, load in bulk", arrayName );
+	ReportThroughput( caseName, bulkLoadTime, byteCount );
+	snprintf( caseName, sizeof( caseName ), "%s, load speedup", arrayName );
+	Report( caseName, elementLoadTime / bulkLoadTime, "x" );
+	KeepResult( target.Size() );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_BENCHMARK( ArchiveDoubleArray )
+{
+	benchmarkArray( "double", createDoubles( Scaled( 1 << 22 ) ) );
+}
+
+RELIB_BENCHMARK( ArchiveVectorArray )
+{
+	benchmarkArray( "float vector", createVectors( Scaled( 1 << 21 ) ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,122 @@
+#include "BenchFramework.h"
+#include <AsyncMessageLog.h>
+#include <MessageLogImpls.h>
+#include <TempFile.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Thread counts from one to the processor count, doubling on every step.
+static std::vector<int> getThreadCounts()
+{
+	const int maxThreadCount = max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	std::vector<int> result;
+	for( int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2 ) {
+		result.push_back( threadCount );
+	}
+	result.push_back( maxThreadCount );
+	return result;
+}
+
+// Time of logging the given number of messages on every thread. The time includes writing all the messages to the file.
+template <class Log>
+static double measureLogging( Log& log, int threadCount, int messageCount )
+{
+	return MeasureSeconds( 1, [&]() {
+		std::vector<std::thread> threads;
+		for( int threadPos = 0; threadPos < threadCount; threadPos++ ) {
+			threads.emplace_back( [&]() {
+				const CString message( "Request processed, status 200, 1532 bytes sent to the client" );
+				for( int i = 0; i < messageCount; i++ ) {
+					log.AddMessage( copy( message ), LMT_Message );
+				}
+			} );
+		}
+		for( auto& thread : threads ) {
+			thread.join();
+		}
+		log.Flush();
+	} );
+}
+
+static const char* const overflowPolicyNames[LOP_EnumCount] = { "block", "drop" };
+
+static void benchmarkAsyncLog( TLogOverflowPolicy policy )
+{
+	const int messageCount = Scaled( 1000000 );
+	for( int threadCount : getThreadCounts() ) {
+		const auto fileName = TempFile::New();
+		double time;
+		__int64 blockedCount;
+		__int64 droppedCount;
+		{
+			CAsyncMessageLog log( fileName, policy );
+			time = measureLogging( log, threadCount, messageCount );
+			blockedCount = log.GetBlockedMessageCount();
+			droppedCount = log.GetDroppedMessageCount();
+		}
+		TempFile::Delete( fileName );
+
+		char caseName[64];
+		snprintf( caseName, sizeof( caseName ), "%s, %d threads", overflowPolicyNames[policy], threadCount );
+		ReportTime( caseName, time, static_cast<double>( threadCount ) * messageCount );
+		snprintf( caseName, sizeof( caseName ), "%s, %d threads, blocked", overflowPolicyNames[policy], threadCount );
+		Report( caseName, 100.0 * blockedCount / threadCount / messageCount, "%" );
+		snprintf( caseName, sizeof( caseName ), "%s, %d threads, dropped", overflowPolicyNames[policy], threadCount );
+		Report( caseName, 100.0 * droppedCount / threadCount / messageCount, "%" );
+	}
+}
+
+// Synchronous file log interface for the measurement.
+class CSyncFileLog {
+public:
+	explicit CSyncFileLog( CStringPart fileName ) : log( fileName, INT_MAX ) {}
+
+	void AddMessage( CString text, TLogMessageType type )
+		{ log.AddMessage( move( text ), type ); }
+	void Flush() {}
+
+private:
+	CFileMessageLog log;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Threads that log without waiting for the writer as long as their buffers have space.
+RELIB_BENCHMARK( AsyncMessageLogBlock )
+{
+	benchmarkAsyncLog( LOP_Block );
+}
+
+// Threads that discard the messages that don't fit in their buffers.
+RELIB_BENCHMARK( AsyncMessageLogDrop )
+{
+	benchmarkAsyncLog( LOP_Drop );
+}
+
+// The synchronous file log opens the file for every message under a global lock. Fewer messages are logged.
+RELIB_BENCHMARK( SyncFileMessageLog )
+{
+	const int messageCount = Scaled( 10000 );
+	for( int threadCount : getThreadCounts() ) {
+		const auto fileName = TempFile::New();
+		double time;
+		{
+			CSyncFileLog log( fileName );
+			time = measureLogging( log, threadCount, messageCount );
+		}
+		TempFile::Delete( fileName );
+
+		char caseName[64];
+		snprintf( caseName, sizeof( caseName ), "%d threads", threadCount );
+		ReportTime( caseName, time, static_cast<double>( threadCount ) * messageCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,114 @@
+#include "BenchFramework.h"
+#include <exception>
+#include <stdio.h>
+#include <string.h>
+
+namespace RelibBench {
+
+//////////////////////////////////////////////////////////////////////////
+
+struct CBenchmarkInfo {
+	const char* Name;
+	TBenchmarkFunction Function;
+};
+
+static const int maxBenchmarkCount = 256;
+
+// The registry is filled during static initialization, so it must not depend on constructors of other globals.
+static CBenchmarkInfo& getBenchmark( int index )
+{
+	static CBenchmarkInfo benchmarks[maxBenchmarkCount];
+	return benchmarks[index];
+}
+
+static int& getBenchmarkCount()
+{
+	static int benchmarkCount = 0;
+	return benchmarkCount;
+}
+
+static bool isQuickRun = false;
+static const char* currentBenchmarkName = "";
+static volatile long long resultSink = 0;
+
+CBenchmarkRegistration::CBenchmarkRegistration( const char* name, TBenchmarkFunction function )
+{
+	int& benchmarkCount = getBenchmarkCount();
+	if( benchmarkCount == maxBenchmarkCount ) {
+		fprintf( stderr, "Too many benchmarks, %s is not registered.\n", name );
+		return;
+	}
+	getBenchmark( benchmarkCount ).Name = name;
+	getBenchmark( benchmarkCount ).Function = function;
+	benchmarkCount++;
+}
+
+int Scaled( int count )
+{
+	if( !isQuickRun ) {
+		return count;
+	}
+	const int result = count / QuickRunDivisor;
+	return result > 0 ? result : 1;
+}
+
+void Report( const char* caseName, double value, const char* unit )
+{
+	printf( "%-28s %-48s %12.3f %s\n", currentBenchmarkName, caseName, value, unit );
+	fflush( stdout );
+}
+
+void ReportTime( const char* caseName, double seconds, double itemCount )
+{
+	Report( caseName, seconds * 1e9 / itemCount, "ns/item" );
+}
+
+void ReportThroughput( const char* caseName, double seconds, double byteCount )
+{
+	Report( caseName, byteCount / seconds / ( 1024 * 1024 ), "MB/s" );
+}
+
+void KeepResult( long long value )
+{
+	resultSink = resultSink + value;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibBench.
+
+using namespace RelibBench;
+
+// Runs all the benchmarks or the benchmarks whose names contain the filter argument.
+// The -quick argument reduces the sizes, so the run only checks that the benchmarks work.
+int main( int argc, char** argv )
+{
+	const char* filter = "";
+	for( int i = 1; i < argc; i++ ) {
+		if( strcmp( argv[i], "-quick" ) == 0 ) {
+			isQuickRun = true;
+		} else {
+			filter = argv[i];
+		}
+	}
+
+	int failedCount = 0;
+	for( int i = 0; i < getBenchmarkCount(); i++ ) {
+		const CBenchmarkInfo& benchmark = getBenchmark( i );
+		if( strstr( benchmark.Name, filter ) == nullptr ) {
+			continue;
+		}
+		currentBenchmarkName = benchmark.Name;
+		try {
+			benchmark.Function();
+		} catch( const std::exception& e ) {
+			fprintf( stderr, "%s: unexpected exception: %s\n", benchmark.Name, e.what() );
+			failedCount++;
+		} catch( ... ) {
+			fprintf( stderr, "%s: unexpected exception.\n", benchmark.Name );
+			failedCount++;
+		}
+	}
+	return failedCount == 0 ? 0 : 1;
+}
+
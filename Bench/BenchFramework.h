@@ -0,0 +1,65 @@
+#pragma once
+#include <chrono>
+
+// Minimal benchmark registry for the library benchmarks.
+// Only the standard library is used, so the portable benchmarks build on every platform.
+
+namespace RelibBench {
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef void ( *TBenchmarkFunction )();
+
+// Registers a benchmark function during static initialization.
+class CBenchmarkRegistration {
+public:
+	CBenchmarkRegistration( const char* name, TBenchmarkFunction function );
+};
+
+// Element counts are divided by this value when the benchmarks are started with -quick.
+static const int QuickRunDivisor = 100;
+
+// Scale an element or iteration count for the current run. Quick runs only check that the benchmarks work.
+int Scaled( int count );
+
+// Print a measurement of the current benchmark.
+void Report( const char* caseName, double value, const char* unit );
+// Print the time per item in nanoseconds.
+void ReportTime( const char* caseName, double seconds, double itemCount );
+// Print the throughput in megabytes per second.
+void ReportThroughput( const char* caseName, double seconds, double byteCount );
+
+// Keep a value computed by the benchmark, so the computation is not removed by the optimizer.
+void KeepResult( long long value );
+
+// Best time of several runs of the action in seconds.
+template <class Action>
+double MeasureSeconds( int runCount, const Action& action );
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Action>
+double MeasureSeconds( int runCount, const Action& action )
+{
+	double bestTime = 0;
+	for( int i = 0; i < runCount; i++ ) {
+		const auto startTime = std::chrono::steady_clock::now();
+		action();
+		const std::chrono::duration<double> runTime = std::chrono::steady_clock::now() - startTime;
+		if( i == 0 || runTime.count() < bestTime ) {
+			bestTime = runTime.count();
+		}
+	}
+	return bestTime;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibBench.
+
+// Define a benchmark function that is run by the benchmark executable.
+#define RELIB_BENCHMARK( name ) \
+	static void name(); \
+	static RelibBench::CBenchmarkRegistration name##Registration( #name, name ); \
+	static void name()
+
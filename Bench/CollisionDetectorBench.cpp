@@ -0,0 +1,167 @@
+#include "BenchFramework.h"
+#include <AARect.h>
+#include <Interval.h>
+#include <Matrix.h>
+#include <Transformations.h>
+#include <InlineStackAllocator.h>
+#include <ConvexShapeCollisionDetector.h>
+#include <Arena.h>
+#include <random>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Shape combinations of the checked pairs.
+enum TBenchPairType {
+	BPT_CircleCircle,
+	BPT_RectRect,
+	BPT_RectCircle,
+	// Circles and rects with a quarter of angled rects that take the per-pair path.
+	BPT_Mixed,
+	BPT_EnumCount
+};
+
+static const char* const benchPairTypeNames[BPT_EnumCount] = { "circle-circle", "rect-rect", "rect-circle", "mixed" };
+
+// Shapes are placed in a small area, so about half of the pairs collide and the result can't be predicted.
+static const float benchAreaSize = 4.0f;
+
+template <class T>
+class CBenchPairs {
+public:
+	typedef CHitbox<T> THitbox;
+
+	CBenchPairs( TBenchPairType type, int pairCount );
+
+	CArrayView<CPair<const THitbox*>> Pairs() const
+		{ return pairs; }
+
+private:
+	CArena<> arena;
+	CArray<THitbox> hitboxes;
+	CArray<CPair<const THitbox*>> pairs;
+
+	THitbox createHitbox( THitboxShapeType shapeType, std::mt19937& random );
+	static THitboxShapeType getShapeType( TBenchPairType type, bool isLeft, std::mt19937& random );
+};
+
+template <class T>
+CBenchPairs<T>::CBenchPairs( TBenchPairType type, int pairCount )
+{
+	std::mt19937 random( 1 );
+	for( int i = 0; i < pairCount; i++ ) {
+		hitboxes.Add( createHitbox( getShapeType( type, true, random ), random ) );
+		hitboxes.Add( createHitbox( getShapeType( type, false, random ), random ) );
+	}
+	// Hitboxes don't move after the array is filled.
+	for( int i = 0; i < pairCount; i++ ) {
+		pairs.Add( &hitboxes[2 * i], &hitboxes[2 * i + 1] );
+	}
+}
+
+template <class T>
+THitboxShapeType CBenchPairs<T>::getShapeType( TBenchPairType type, bool isLeft, std::mt19937& random )
+{
+	switch( type ) {
+		case BPT_CircleCircle:
+			return HST_Circle;
+		case BPT_RectRect:
+			return HST_AARect;
+		case BPT_RectCircle:
+			return isLeft ? HST_AARect : HST_Circle;
+		case BPT_Mixed:
+		{
+			const int shapePos = random() % 8;
+			return shapePos < 3 ? HST_Circle : shapePos < 6 ? HST_AARect : HST_AngledRect;
+		}
+		default:
+			assert( false );
+			return HST_Null;
+	}
+}
+
+template <class T>
+CHitbox<T> CBenchPairs<T>::createHitbox( THitboxShapeType shapeType, std::mt19937& random )
+{
+	std::uniform_real_distribution<T> positionDistribution( 0, static_cast<T>( benchAreaSize ) );
+	std::uniform_real_distribution<T> sizeDistribution( static_cast<T>( 0.5 ), static_cast<T>( 1.5 ) );
+	const CVector2<T> position( positionDistribution( random ), positionDistribution( random ) );
+	const T width = sizeDistribution( random );
+	const T height = sizeDistribution( random );
+	const CAARect<T> rect( position, width, height );
+	switch( shapeType ) {
+		case HST_Circle:
+			return THitbox( CCircleShape<T>( position, width / 2 ), arena );
+		case HST_AARect:
+			return THitbox( CAARectShape<T>( rect ), arena );
+		case HST_AngledRect:
+			return THitbox( CAngledRectShape<T>( rect ), arena );
+		default:
+			assert( false );
+			return THitbox( CRawBuffer(), HST_Null );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T>
+static void detectByPair( const CConvexShapeCollisionDetector<T>& detector, CArrayView<CPair<const CHitbox<T>*>> pairs, CDynamicBitSet<>& result )
+{
+	result.ReserveBuffer( pairs.Size() );
+	result.FillWithZeroes();
+	for( int i = 0; i < pairs.Size(); i++ ) {
+		if( detector.DetectCollision( *pairs[i].First, *pairs[i].Second ) ) {
+			result.Set( i, true );
+		}
+	}
+}
+
+static bool areEqual( const CDynamicBitSet<>& left, const CDynamicBitSet<>& right, int size )
+{
+	for( int i = 0; i < size; i++ ) {
+		if( left.Has( i ) != right.Has( i ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Time per pair of the per-pair and the batched detection.
+template <class T>
+static void benchmarkDetection( const char* typeName )
+{
+	const int pairCount = Scaled( 1 << 16 );
+	const CConvexShapeCollisionDetector<T> detector;
+	for( int type = 0; type < BPT_EnumCount; type++ ) {
+		const CBenchPairs<T> benchPairs( static_cast<TBenchPairType>( type ), pairCount );
+		const auto pairs = benchPairs.Pairs();
+
+		CDynamicBitSet<> pairResult;
+		const double pairTime = MeasureSeconds( 5, [&]() { detectByPair( detector, pairs, pairResult ); } );
+		CDynamicBitSet<> batchResult;
+		const double batchTime = MeasureSeconds( 5, [&]() { detector.DetectCollisions( pairs, batchResult ); } );
+
+		char caseName[64];
+		snprintf( caseName, sizeof( caseName ), "%s %s, per pair", typeName, benchPairTypeNames[type] );
+		ReportTime( caseName, pairTime, pairCount );
+		snprintf( caseName, sizeof( caseName ), "%s %s, batch", typeName, benchPairTypeNames[type] );
+		ReportTime( caseName, batchTime, pairCount );
+		if( !areEqual( pairResult, batchResult, pairCount ) ) {
+			printf( "%s: batch result differs from the per pair result\n", caseName );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Float blocks have 4 lanes.
+RELIB_BENCHMARK( CollisionDetectFloat )
+{
+	benchmarkDetection<float>( "float" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
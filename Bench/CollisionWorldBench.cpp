@@ -0,0 +1,197 @@
+#include "BenchFramework.h"
+#include <AARect.h>
+#include <Interval.h>
+#include <Matrix.h>
+#include <Transformations.h>
+#include <CollisionWorld.h>
+#include <Arena.h>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef CVector2<float> TBenchVector;
+typedef CAARect<float> TBenchRect;
+typedef CHitbox<float> TBenchHitbox;
+
+// Circle or axis aligned square that moves with a constant speed and bounces off the area bounds.
+struct CMovingShape {
+	TBenchVector Position;
+	TBenchVector Velocity;
+	float Size;
+	bool IsCircle;
+};
+
+static const float shapeSpacing = 4.0f;
+static const float maxShapeSize = 1.5f;
+static const float maxShapeSpeed = 0.05f;
+
+// The area grows with the shape count, so every shape has about the same number of neighbours.
+static float getAreaSize( int shapeCount )
+{
+	return sqrtf( static_cast<float>( shapeCount ) ) * shapeSpacing;
+}
+
+static CArray<CMovingShape> createShapes( int count )
+{
+	std::mt19937 random( 1 );
+	std::uniform_real_distribution<float> positionDistribution( 0.0f, getAreaSize( count ) );
+	std::uniform_real_distribution<float> velocityDistribution( -maxShapeSpeed, maxShapeSpeed );
+	std::uniform_real_distribution<float> sizeDistribution( 0.5f, maxShapeSize );
+	CArray<CMovingShape> result;
+	for( int i = 0; i < count; i++ ) {
+		auto& shape = result.Add();
+		shape.Position = TBenchVector( positionDistribution( random ), positionDistribution( random ) );
+		shape.Velocity = TBenchVector( velocityDistribution( random ), velocityDistribution( random ) );
+		shape.Size = sizeDistribution( random );
+		shape.IsCircle = i % 2 == 0;
+	}
+	return result;
+}
+
+static void moveShapes( CArray<CMovingShape>& shapes )
+{
+	const float areaSize = getAreaSize( shapes.Size() );
+	for( auto& shape : shapes ) {
+		for( int axis = 0; axis < 2; axis++ ) {
+			shape.Position[axis] += shape.Velocity[axis];
+			if( shape.Position[axis] < 0 || shape.Position[axis] > areaSize ) {
+				shape.Velocity[axis] = -shape.Velocity[axis];
+			}
+		}
+	}
+}
+
+static TBenchHitbox createHitbox( const CMovingShape& shape, CArena<>& arena, TBenchRect& boundRect )
+{
+	const float halfSize = shape.Size / 2;
+	boundRect = TBenchRect( shape.Position - TBenchVector( halfSize, halfSize ), shape.Size, shape.Size );
+	if( shape.IsCircle ) {
+		return TBenchHitbox( CCircleShape<float>( shape.Position, halfSize ), arena );
+	} else {
+		return TBenchHitbox( CAARectShape<float>( boundRect ), arena );
+	}
+}
+
+// Hitboxes of the current frame. The data of the previous frame stays valid until the next frame, the world references it until the hitboxes are moved.
+class CFrameHitboxes {
+public:
+	void Create( const CArray<CMovingShape>& shapes );
+
+	const TBenchHitbox& Hitbox( int index ) const
+		{ return hitboxes[index]; }
+	const TBenchRect& BoundRect( int index ) const
+		{ return boundRects[index]; }
+
+private:
+	CArena<> arenas[2];
+	int frameIndex = 0;
+	CArray<TBenchHitbox> hitboxes;
+	CArray<TBenchRect> boundRects;
+};
+
+void CFrameHitboxes::Create( const CArray<CMovingShape>& shapes )
+{
+	frameIndex = 1 - frameIndex;
+	auto& arena = arenas[frameIndex];
+	arena.Reset();
+	hitboxes.Empty();
+	boundRects.Empty();
+	for( const auto& shape : shapes ) {
+		TBenchRect boundRect;
+		hitboxes.Add( createHitbox( shape, arena, boundRect ) );
+		boundRects.Add( boundRect );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int frameCount = 10;
+
+// Every frame moves all the shapes and finds all the colliding pairs. Time per shape per frame is reported.
+static void benchmarkWorld( TCollisionBroadphaseType broadphaseType, const char* broadphaseName, int shapeCount )
+{
+	auto shapes = createShapes( shapeCount );
+	CFrameHitboxes frameHitboxes;
+	frameHitboxes.Create( shapes );
+	CCollisionWorld<float> world( broadphaseType, 0.1f, 2 * maxShapeSize );
+	for( int i = 0; i < shapeCount; i++ ) {
+		world.AddHitbox( frameHitboxes.Hitbox( i ), frameHitboxes.BoundRect( i ) );
+	}
+
+	int pairCount = 0;
+	const double time = MeasureSeconds( 1, [&]() {
+		for( int frame = 0; frame < frameCount; frame++ ) {
+			moveShapes( shapes );
+			frameHitboxes.Create( shapes );
+			for( int i = 0; i < shapeCount; i++ ) {
+				world.MoveHitbox( i, frameHitboxes.Hitbox( i ), frameHitboxes.BoundRect( i ) );
+			}
+			pairCount = 0;
+			world.FindCollisions( [&]( int, int ) { pairCount++; } );
+		}
+	} );
+	KeepResult( pairCount );
+	char caseName[64];
+	snprintf( caseName, sizeof( caseName ), "%s, %d shapes", broadphaseName, shapeCount );
+	ReportTime( caseName, time, static_cast<double>( frameCount ) * shapeCount );
+}
+
+// The same frames with every pair checked, first by the bound rects and then by the detector.
+static void benchmarkAllPairs( int shapeCount )
+{
+	auto shapes = createShapes( shapeCount );
+	CFrameHitboxes frameHitboxes;
+	CConvexShapeCollisionDetector<float> detector;
+	int pairCount = 0;
+	const double time = MeasureSeconds( 1, [&]() {
+		for( int frame = 0; frame < frameCount; frame++ ) {
+			moveShapes( shapes );
+			frameHitboxes.Create( shapes );
+			pairCount = 0;
+			for( int i = 0; i < shapeCount; i++ ) {
+				for( int j = i + 1; j < shapeCount; j++ ) {
+					if( frameHitboxes.BoundRect( i ).Intersects( frameHitboxes.BoundRect( j ) )
+						&& detector.DetectCollision( frameHitboxes.Hitbox( i ), frameHitboxes.Hitbox( j ) ) )
+					{
+						pairCount++;
+					}
+				}
+			}
+		}
+	} );
+	KeepResult( pairCount );
+	char caseName[64];
+	snprintf( caseName, sizeof( caseName ), "all pairs, %d shapes", shapeCount );
+	ReportTime( caseName, time, static_cast<double>( frameCount ) * shapeCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Checking all pairs is quadratic, so it is only measured for the smaller counts.
+RELIB_BENCHMARK( CollisionAllPairs )
+{
+	benchmarkAllPairs( Scaled( 1000 ) );
+	benchmarkAllPairs( Scaled( 10000 ) );
+}
+
+RELIB_BENCHMARK( CollisionWorldTree )
+{
+	for( int shapeCount : { 1000, 10000, 100000 } ) {
+		benchmarkWorld( CBT_AABBTree, "tree", Scaled( shapeCount ) );
+	}
+}
+
+RELIB_BENCHMARK( CollisionWorldSpatialHash )
+{
+	for( int shapeCount : { 1000, 10000, 100000 } ) {
+		benchmarkWorld( CBT_SpatialHash, "spatial hash", Scaled( shapeCount ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
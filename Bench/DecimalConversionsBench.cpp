@@ -0,0 +1,152 @@
+#include "BenchFramework.h"
+#include <DecimalConversions.h>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Values with a few significant digits, like the numbers in configuration and JSON files.
+static std::vector<double> createShortValues( int count )
+{
+	std::mt19937_64 random( 1 );
+	std::vector<double> result;
+	for( int i = 0; i < count; i++ ) {
+		result.push_back( static_cast<double>( random() % 1000000 ) / 1000 );
+	}
+	return result;
+}
+
+// Values with all the 17 digits and any exponent.
+static std::vector<double> createRandomValues( int count )
+{
+	std::mt19937_64 random( 2 );
+	std::vector<double> result;
+	while( static_cast<int>( result.size() ) < count ) {
+		const unsigned long long bits = random() & ~( 1ULL << 63 );
+		double value;
+		memcpy( &value, &bits, sizeof( value ) );
+		if( std::isfinite( value ) ) {
+			result.push_back( value );
+		}
+	}
+	return result;
+}
+
+static std::vector<std::string> formatValues( const std::vector<double>& values )
+{
+	std::vector<std::string> result;
+	for( double value : values ) {
+		char buffer[Decimal::MaxShortestLength];
+		result.push_back( std::string( buffer, Decimal::FormatShortest( value, buffer ) ) );
+	}
+	return result;
+}
+
+static void benchmarkFormatting( const char* valuesName, const std::vector<double>& values )
+{
+	const int valueCount = static_cast<int>( values.size() );
+	char caseName[64];
+	const double shortestTime = MeasureSeconds( 3, [&]() {
+		char buffer[Decimal::MaxShortestLength];
+		for( double value : values ) {
+			KeepResult( Decimal::FormatShortest( value, buffer ) );
+		}
+	} );
+	snprintf( caseName, sizeof( caseName ), "FormatShortest, %s", valuesName );
+	ReportTime( caseName, shortestTime, valueCount );
+
+	const double printfTime = MeasureSeconds( 3, [&]() {
+		char buffer[32];
+		for( double value : values ) {
+			KeepResult( snprintf( buffer, sizeof( buffer ), "%.17g", value ) );
+		}
+	} );
+	snprintf( caseName, sizeof( caseName ), "snprintf %%.17g, %s", valuesName );
+	ReportTime( caseName, printfTime, valueCount );
+}
+
+static void benchmarkParsing( const char* valuesName, const std::vector<std::string>& strs )
+{
+	const int strCount = static_cast<int>( strs.size() );
+	char caseName[64];
+	const double parseTime = MeasureSeconds( 3, [&]() {
+		for( const auto& str : strs ) {
+			double value;
+			KeepResult( Decimal::Parse( str.c_str(), static_cast<int>( str.length() ), value ) );
+		}
+	} );
+	snprintf( caseName, sizeof( caseName ), "Parse, %s", valuesName );
+	ReportTime( caseName, parseTime, strCount );
+
+	const double strtodTime = MeasureSeconds( 3, [&]() {
+		for( const auto& str : strs ) {
+			KeepResult( static_cast<long long>( strtod( str.c_str(), nullptr ) ) );
+		}
+	} );
+	snprintf( caseName, sizeof( caseName ), "strtod, %s", valuesName );
+	ReportTime( caseName, strtodTime, strCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Shortest round trip formatting compared to the C library.
+RELIB_BENCHMARK( DecimalFormatShortest )
+{
+	const int valueCount = Scaled( 1 << 20 );
+	benchmarkFormatting( "short values", createShortValues( valueCount ) );
+	benchmarkFormatting( "random bits", createRandomValues( valueCount ) );
+}
+
+// Fixed notation with the default Str precision and with long fractions.
+RELIB_BENCHMARK( DecimalFormatFixed )
+{
+	const int valueCount = Scaled( 1 << 20 );
+	const auto values = createShortValues( valueCount );
+	for( int digitCount : { 3, 20 } ) {
+		char caseName[64];
+		const double fixedTime = MeasureSeconds( 3, [&]() {
+			char buffer[64];
+			for( double value : values ) {
+				KeepResult( Decimal::FormatFixed( value, digitCount, buffer ) );
+			}
+		} );
+		snprintf( caseName, sizeof( caseName ), "FormatFixed, %d digits", digitCount );
+		ReportTime( caseName, fixedTime, valueCount );
+
+		const double printfTime = MeasureSeconds( 3, [&]() {
+			char buffer[64];
+			for( double value : values ) {
+				KeepResult( snprintf( buffer, sizeof( buffer ), "%.*f", digitCount, value ) );
+			}
+		} );
+		snprintf( caseName, sizeof( caseName ), "snprintf %%.*f, %d digits", digitCount );
+		ReportTime( caseName, printfTime, valueCount );
+	}
+}
+
+// Parsing of the shortest representations and of long mantissas that need the exact rounding.
+RELIB_BENCHMARK( DecimalParse )
+{
+	const int valueCount = Scaled( 1 << 20 );
+	benchmarkParsing( "short values", formatValues( createShortValues( valueCount ) ) );
+	benchmarkParsing( "random bits", formatValues( createRandomValues( valueCount ) ) );
+
+	std::vector<std::string> longStrs;
+	for( const auto& value : createRandomValues( Scaled( 1 << 14 ) ) ) {
+		char buffer[1024];
+		snprintf( buffer, sizeof( buffer ), "%.100e", value );
+		longStrs.push_back( buffer );
+	}
+	benchmarkParsing( "100 digit mantissas", longStrs );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,181 @@
+#include "BenchFramework.h"
+#include <EntityComponentSystem.h>
+#include <EntityContainer.h>
+#include <SystemOwner.h>
+#include <ThreadPool.h>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Every system writes its own component, so the systems don't conflict with each other.
+static const int benchSystemCount = 8;
+static CComponent<float> benchComponents[benchSystemCount];
+static CComponentGroup benchGroup( benchComponents[0], benchComponents[1], benchComponents[2], benchComponents[3],
+	benchComponents[4], benchComponents[5], benchComponents[6], benchComponents[7] );
+
+struct CBenchContext : public ISystemContext {
+};
+
+// Work on a single component value. Large enough to hide the scheduling cost.
+static void updateValue( float& value )
+{
+	for( int i = 0; i < 8; i++ ) {
+		value = sqrtf( value + 1.0f );
+	}
+}
+
+// Modes of the component access declaration.
+enum TBenchAccess {
+	// The system writes its own component.
+	BA_Independent,
+	// The system doesn't declare anything and is exclusive.
+	BA_Exclusive
+};
+
+class CWholeGroupSystem : public CBaseUpdateSystem<CWholeGroupSystem> {
+public:
+	CWholeGroupSystem( int _componentIndex, TBenchAccess _access ) : componentIndex( _componentIndex ), access( _access ) {}
+
+	virtual void GetComponentAccess( CSystemAccess& result ) const override;
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return benchGroup; }
+
+	void UpdateEntities( CEntityGroupRange range, CBenchContext& context );
+
+private:
+	int componentIndex;
+	TBenchAccess access;
+};
+
+void CWholeGroupSystem::GetComponentAccess( CSystemAccess& result ) const
+{
+	if( access == BA_Independent ) {
+		result.Write( benchComponents[componentIndex] );
+	} else {
+		result.SetExclusive();
+	}
+}
+
+void CWholeGroupSystem::UpdateEntities( CEntityGroupRange range, CBenchContext& )
+{
+	const auto& component = benchComponents[componentIndex];
+	for( auto entities : range ) {
+		for( auto entity : entities ) {
+			updateValue( entity.GetValue( component ) );
+		}
+	}
+}
+
+class CChunkSystem : public CBaseChunkUpdateSystem<CChunkSystem> {
+public:
+	explicit CChunkSystem( int _componentIndex ) : componentIndex( _componentIndex ) {}
+
+	virtual void GetComponentAccess( CSystemAccess& result ) const override
+		{ result.Write( benchComponents[componentIndex] ); }
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return benchGroup; }
+
+	void UpdateEntities( CEntityRange range, CBenchContext& context );
+
+private:
+	int componentIndex;
+};
+
+void CChunkSystem::UpdateEntities( CEntityRange range, CBenchContext& )
+{
+	const auto& component = benchComponents[componentIndex];
+	for( auto entity : range ) {
+		updateValue( entity.GetValue( component ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Thread counts from one to the processor count, doubling on every step. Zero stands for no thread pool.
+static std::vector<int> getThreadCounts()
+{
+	const int maxThreadCount = max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	std::vector<int> result{ 0 };
+	for( int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2 ) {
+		result.push_back( threadCount );
+	}
+	result.push_back( maxThreadCount );
+	return result;
+}
+
+// Frame time of the systems created by createSystem for every thread count.
+template <class SystemCreator>
+static void benchmarkFrames( const char* systemsName, int entityCount, const SystemCreator& createSystem )
+{
+	const int frameCount = 10;
+	CEntityContainer container;
+	CEntityComponentSystem ecs( &container );
+	for( int i = 0; i < entityCount; i++ ) {
+		ecs.CreateEntity( benchGroup );
+	}
+	std::vector<CSystemOwner<IUpdateSystem>> systems;
+	for( int i = 0; i < benchSystemCount; i++ ) {
+		systems.push_back( ecs.AddSystem( createSystem( i ) ) );
+	}
+
+	for( int threadCount : getThreadCounts() ) {
+		CPtrOwner<CThreadPool> pool;
+		if( threadCount > 0 ) {
+			pool = CreateOwner<CThreadPool>( threadCount );
+		}
+		ecs.SetThreadPool( pool.Ptr() );
+		const double time = MeasureSeconds( 3, [&]() {
+			for( int frame = 0; frame < frameCount; frame++ ) {
+				CBenchContext context;
+				ecs.RunUpdateSystems( context );
+			}
+		} );
+		ecs.SetThreadPool( nullptr );
+
+		char caseName[64];
+		if( threadCount == 0 ) {
+			snprintf( caseName, sizeof( caseName ), "%s, no pool", systemsName );
+		} else {
+			snprintf( caseName, sizeof( caseName ), "%s, %d threads", systemsName, threadCount );
+		}
+		ReportTime( caseName, time, static_cast<double>( frameCount ) * entityCount * benchSystemCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Systems with disjoint component access run concurrently on the pool.
+RELIB_BENCHMARK( EcsIndependentSystems )
+{
+	const int entityCount = Scaled( 1 << 17 );
+	benchmarkFrames( "independent systems", entityCount, []( int index ) {
+		return CPtrOwner<IUpdateSystem>( CreateOwner<CWholeGroupSystem>( index, BA_Independent ) );
+	} );
+}
+
+// Systems without declared access run one by one, the pool only adds the scheduling cost.
+RELIB_BENCHMARK( EcsExclusiveSystems )
+{
+	const int entityCount = Scaled( 1 << 17 );
+	benchmarkFrames( "exclusive systems", entityCount, []( int index ) {
+		return CPtrOwner<IUpdateSystem>( CreateOwner<CWholeGroupSystem>( index, BA_Exclusive ) );
+	} );
+}
+
+// Entity chunks of every system are updated concurrently.
+RELIB_BENCHMARK( EcsChunkedSystems )
+{
+	const int entityCount = Scaled( 1 << 17 );
+	benchmarkFrames( "chunked systems", entityCount, []( int index ) {
+		return CPtrOwner<IUpdateSystem>( CreateOwner<CChunkSystem>( index ) );
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
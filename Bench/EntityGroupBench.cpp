@@ -0,0 +1,119 @@
+#include "BenchFramework.h"
+#include <EntityComponentSystem.h>
+#include <EntityContainer.h>
+#include <EntityRange.h>
+#include <EntityGroupRange.h>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+struct CBenchVector {
+	float X;
+	float Y;
+	float Z;
+};
+
+// Data that is not touched by the movement, it only takes space in the contiguous rows.
+struct CBenchPayload {
+	int Data[16];
+};
+
+static CComponent<CBenchVector> positionComponent;
+static CComponent<CBenchVector> velocityComponent;
+static CComponent<CBenchPayload> payloadComponent;
+static CComponentGroup movingGroup( positionComponent, velocityComponent, payloadComponent );
+
+static const TEntityStorageMode storageModes[] = { ESM_Contiguous, ESM_Chunked };
+static const char* const storageModeNames[] = { "contiguous", "chunked" };
+
+static void createEntities( CEntityComponentSystem& ecs, int count )
+{
+	for( int i = 0; i < count; i++ ) {
+		auto entity = ecs.CreateEntity( movingGroup );
+		entity.GetValue( velocityComponent ) = CBenchVector{ 1.0f, 2.0f, 3.0f };
+	}
+}
+
+static void moveEntities( CEntityComponentSystem& ecs )
+{
+	for( auto range : ecs.Entities( movingGroup ) ) {
+		for( auto entity : range ) {
+			auto& position = entity.GetValue( positionComponent );
+			const auto& velocity = entity.GetValue( velocityComponent );
+			position.X += velocity.X;
+			position.Y += velocity.Y;
+			position.Z += velocity.Z;
+		}
+	}
+}
+
+// The same movement over the raw component arrays of the chunks.
+static void moveChunks( CEntityGroup& group )
+{
+	for( int chunk = 0; chunk < group.ChunkCount(); chunk++ ) {
+		auto positions = group.GetChunkValues( positionComponent, chunk );
+		const auto velocities = group.GetChunkValues( velocityComponent, chunk );
+		const int count = min( group.ChunkCapacity(), group.Size() - chunk * group.ChunkCapacity() );
+		for( int i = 0; i < count; i++ ) {
+			positions[i].X += velocities[i].X;
+			positions[i].Y += velocities[i].Y;
+			positions[i].Z += velocities[i].Z;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Entity creation, iteration and destruction in both storage modes.
+RELIB_BENCHMARK( EntityGroupStorageModes )
+{
+	const int entityCount = Scaled( 1 << 18 );
+	for( int modePos = 0; modePos < 2; modePos++ ) {
+		const auto modeName = storageModeNames[modePos];
+		char caseName[64];
+		const double spawnTime = MeasureSeconds( 3, [&]() {
+			CEntityContainer container( storageModes[modePos] );
+			CEntityComponentSystem ecs( &container );
+			createEntities( ecs, entityCount );
+		} );
+		snprintf( caseName, sizeof( caseName ), "%s, spawn", modeName );
+		ReportTime( caseName, spawnTime, entityCount );
+
+		CEntityContainer container( storageModes[modePos] );
+		CEntityComponentSystem ecs( &container );
+		createEntities( ecs, entityCount );
+		const double iterationTime = MeasureSeconds( 5, [&]() { moveEntities( ecs ); } );
+		snprintf( caseName, sizeof( caseName ), "%s, iterate with GetValue", modeName );
+		ReportTime( caseName, iterationTime, entityCount );
+		if( storageModes[modePos] == ESM_Chunked ) {
+			auto& group = container.GetEntityGroup( 0 );
+			const double chunkTime = MeasureSeconds( 5, [&]() { moveChunks( group ); } );
+			snprintf( caseName, sizeof( caseName ), "%s, iterate chunk arrays", modeName );
+			ReportTime( caseName, chunkTime, entityCount );
+		}
+
+		// Every run destroys half of the entities of its own container from pseudorandom positions.
+		double despawnTime = 0;
+		for( int run = 0; run < 3; run++ ) {
+			CEntityContainer despawnContainer( storageModes[modePos] );
+			CEntityComponentSystem despawnEcs( &despawnContainer );
+			createEntities( despawnEcs, entityCount );
+			auto& group = despawnContainer.GetEntityGroup( 0 );
+			const double runTime = MeasureSeconds( 1, [&]() {
+				for( int i = 0; i < entityCount / 2; i++ ) {
+					const int entityPos = static_cast<int>( ( i * 7919LL ) % group.Size() );
+					despawnEcs.DestroyEntity( *CEntityRange( group, entityPos, entityPos + 1 ).begin() );
+				}
+			} );
+			despawnTime = run == 0 ? runTime : min( despawnTime, runTime );
+		}
+		snprintf( caseName, sizeof( caseName ), "%s, despawn", modeName );
+		ReportTime( caseName, despawnTime, entityCount / 2 );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,111 @@
+#include "BenchFramework.h"
+#include <FlatHashTable.h>
+#include <HashTable.h>
+#include <random>
+#include <stdio.h>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Distinct random keys. The second half is never inserted and is used for the missing lookups.
+static std::vector<int> createKeys( int count )
+{
+	std::mt19937 random( 1 );
+	std::vector<int> result;
+	CFlatHashTable<int> usedKeys;
+	usedKeys.ReserveBuffer( 2 * count );
+	while( static_cast<int>( result.size() ) < 2 * count ) {
+		const int key = static_cast<int>( random() );
+		if( usedKeys.Set( key ) ) {
+			result.push_back( key );
+		}
+	}
+	return result;
+}
+
+// Every operation of the table on the first half of the keys.
+template <class Table>
+static void benchmarkTable( const char* tableName, const std::vector<int>& keys )
+{
+	const int count = static_cast<int>( keys.size() / 2 );
+	char caseName[64];
+	const double insertTime = MeasureSeconds( 3, [&]() {
+		Table table;
+		for( int i = 0; i < count; i++ ) {
+			table.Set( keys[i] );
+		}
+		KeepResult( table.Size() );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, %d keys, insert", tableName, count );
+	ReportTime( caseName, insertTime, count );
+
+	Table table;
+	for( int i = 0; i < count; i++ ) {
+		table.Set( keys[i] );
+	}
+	const double hitTime = MeasureSeconds( 3, [&]() {
+		long long found = 0;
+		for( int i = 0; i < count; i++ ) {
+			found += table.HasValue( keys[i] ) ? 1 : 0;
+		}
+		KeepResult( found );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, %d keys, hit lookup", tableName, count );
+	ReportTime( caseName, hitTime, count );
+
+	const double missTime = MeasureSeconds( 3, [&]() {
+		long long found = 0;
+		for( int i = count; i < 2 * count; i++ ) {
+			found += table.HasValue( keys[i] ) ? 1 : 0;
+		}
+		KeepResult( found );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, %d keys, miss lookup", tableName, count );
+	ReportTime( caseName, missTime, count );
+
+	const double iterationTime = MeasureSeconds( 3, [&]() {
+		long long sum = 0;
+		for( int key : table ) {
+			sum += key;
+		}
+		KeepResult( sum );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, %d keys, iteration", tableName, count );
+	ReportTime( caseName, iterationTime, count );
+
+	// Every run deletes from its own copy of the table.
+	double deleteTime = 0;
+	for( int run = 0; run < 3; run++ ) {
+		Table copy;
+		for( int i = 0; i < count; i++ ) {
+			copy.Set( keys[i] );
+		}
+		const double runTime = MeasureSeconds( 1, [&]() {
+			for( int i = 0; i < count; i++ ) {
+				copy.Delete( keys[i] );
+			}
+			KeepResult( copy.Size() );
+		} );
+		deleteTime = run == 0 ? runTime : min( deleteTime, runTime );
+	}
+	snprintf( caseName, sizeof( caseName ), "%s, %d keys, delete", tableName, count );
+	ReportTime( caseName, deleteTime, count );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Open addressing table compared to the chained table with random int keys.
+RELIB_BENCHMARK( FlatHashTableRandomKeys )
+{
+	for( int count : { 1000, 100000, 1000000 } ) {
+		const auto keys = createKeys( max( Scaled( count ), 1 ) );
+		benchmarkTable<CFlatHashTable<int>>( "CFlatHashTable", keys );
+		benchmarkTable<CHashTable<int>>( "CHashTable", keys );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
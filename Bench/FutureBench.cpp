@@ -0,0 +1,77 @@
+#include "BenchFramework.h"
+#include <Future.h>
+#include <Promise.h>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int continuationCount = 500;
+
+// Continuations of a single future, as with one download that has many consumers.
+// Time per continuation includes attaching it and running it from CreateValue.
+RELIB_BENCHMARK( FutureFanOut )
+{
+	const int futureCount = Scaled( 1000 );
+	long long sum = 0;
+	const double time = MeasureSeconds( 5, [&]() {
+		for( int i = 0; i < futureCount; i++ ) {
+			CPromise<int> promise;
+			auto future = promise.GetFuture();
+			for( int j = 0; j < continuationCount; j++ ) {
+				future.Then( [&sum]( int& value ) { sum += value; } );
+			}
+			promise.CreateValue( 1 );
+		}
+	} );
+	KeepResult( sum );
+	ReportTime( "500 continuations", time, static_cast<double>( futureCount ) * continuationCount );
+}
+
+// Four futures joined by ExecuteAfterAll. Time per join.
+RELIB_BENCHMARK( FutureFanIn )
+{
+	const int joinCount = Scaled( 100000 );
+	long long sum = 0;
+	const double time = MeasureSeconds( 5, [&]() {
+		for( int i = 0; i < joinCount; i++ ) {
+			CPromise<int> promises[4];
+			auto joined = ExecuteAfterAll( []( int first, int second, int third, int fourth ) { return first + second + third + fourth; },
+				promises[0].GetFuture(), promises[1].GetFuture(), promises[2].GetFuture(), promises[3].GetFuture() );
+			for( int j = 0; j < 4; j++ ) {
+				promises[j].CreateValue( j );
+			}
+			sum += joined.GetValue();
+		}
+	} );
+	KeepResult( sum );
+	ReportTime( "join of 4 futures", time, joinCount );
+}
+
+// A chain of continuations where every link takes the previous result. Time per link.
+RELIB_BENCHMARK( FutureChain )
+{
+	const int chainCount = Scaled( 1000 );
+	bool isValid = true;
+	const double time = MeasureSeconds( 5, [&]() {
+		for( int i = 0; i < chainCount; i++ ) {
+			CPromise<int> promise;
+			auto future = promise.GetFuture();
+			for( int j = 0; j < continuationCount; j++ ) {
+				future = future.Then( []( int& value ) { return value + 1; } );
+			}
+			promise.CreateValue( 0 );
+			isValid &= future.GetValue() == continuationCount;
+		}
+	} );
+	KeepResult( isValid );
+	if( !isValid ) {
+		printf( "FutureChain: wrong chain result\n" );
+	}
+	ReportTime( "chain of 500 links", time, static_cast<double>( chainCount ) * continuationCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,164 @@
+#include "BenchFramework.h"
+#include <JsonDocument.h>
+#include <JsonValues.h>
+#include <random>
+#include <stdio.h>
+#include <string>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+static void appendFormat( std::string& result, const char* format, long long value )
+{
+	char buffer[64];
+	result.append( buffer, snprintf( buffer, sizeof( buffer ), format, value ) );
+}
+
+static void appendDouble( std::string& result, double value )
+{
+	char buffer[64];
+	result.append( buffer, snprintf( buffer, sizeof( buffer ), "%.15g", value ) );
+}
+
+// Social network statuses: nested objects with many strings, escapes, identifiers and literals.
+static std::string createTwitterText( int byteCount )
+{
+	std::mt19937 random( 1 );
+	std::string result = "{\"statuses\":[";
+	for( int i = 0; static_cast<int>( result.size() ) < byteCount; i++ ) {
+		if( i > 0 ) {
+			result += ',';
+		}
+		result += "{\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\",\"id\":";
+		appendFormat( result, "%lld", 505874924095815681LL + i );
+		result += ",\"text\":\"@aym0566x \\n\\u540d\\u524d:\\u524d\\u7530\\u3042\\u3086\\u307f status text number ";
+		appendFormat( result, "%lld", i );
+		result += " with a link http:\\/\\/t.co\\/abcdef\",\"source\":\"<a href=\\\"http:\\/\\/twitter.com\\/download\\/iphone\\\" rel=\\\"nofollow\\\">Twitter for iPhone<\\/a>\",";
+		result += "\"truncated\":false,\"in_reply_to_status_id\":null,\"user\":{\"id\":";
+		appendFormat( result, "%lld", random() % 3000000000LL );
+		result += ",\"name\":\"user name\",\"screen_name\":\"screen_name\",\"location\":\"\",\"followers_count\":";
+		appendFormat( result, "%lld", random() % 100000 );
+		result += ",\"verified\":false,\"lang\":\"ja\"},\"entities\":{\"hashtags\":[],\"urls\":[],\"user_mentions\":[{\"screen_name\":\"aym0566x\",\"indices\":[0,9]}]},";
+		result += "\"retweet_count\":";
+		appendFormat( result, "%lld", random() % 1000 );
+		result += ",\"favorited\":false,\"lang\":\"ja\"}";
+	}
+	result += "]}";
+	return result;
+}
+
+// Geographic borders: long arrays of coordinate pairs with full precision numbers.
+static std::string createCanadaText( int byteCount )
+{
+	std::mt19937 random( 2 );
+	std::uniform_real_distribution<double> longitudeDistribution( -141.0, -52.0 );
+	std::uniform_real_distribution<double> latitudeDistribution( 41.0, 83.0 );
+	std::string result = "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\",\"properties\":{\"name\":\"Canada\"},";
+	result += "\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+	for( int ring = 0; static_cast<int>( result.size() ) < byteCount; ring++ ) {
+		if( ring > 0 ) {
+			result += ',';
+		}
+		result += '[';
+		for( int point = 0; point < 1000; point++ ) {
+			if( point > 0 ) {
+				result += ',';
+			}
+			result += '[';
+			appendDouble( result, longitudeDistribution( random ) );
+			result += ',';
+			appendDouble( result, latitudeDistribution( random ) );
+			result += ']';
+		}
+		result += ']';
+	}
+	result += "]}}]}";
+	return result;
+}
+
+// Event catalog: objects keyed by identifiers with small integers, short strings and integer arrays.
+static std::string createCitmText( int byteCount )
+{
+	std::mt19937 random( 3 );
+	std::string result = "{\"events\":{";
+	for( int i = 0; static_cast<int>( result.size() ) < byteCount; i++ ) {
+		if( i > 0 ) {
+			result += ',';
+		}
+		result += '"';
+		appendFormat( result, "%lld", 138586341 + i );
+		result += "\":{\"description\":null,\"id\":";
+		appendFormat( result, "%lld", 138586341 + i );
+		result += ",\"logo\":null,\"name\":\"30th Anniversary Tour\",\"subTopicIds\":[";
+		appendFormat( result, "%lld", 337184269 + random() % 100 );
+		result += ',';
+		appendFormat( result, "%lld", 337184283 + random() % 100 );
+		result += "],\"subjectCode\":null,\"subtitle\":null,\"topicIds\":[324846099,107888604],\"prices\":[";
+		for( int price = 0; price < 4; price++ ) {
+			if( price > 0 ) {
+				result += ',';
+			}
+			result += "{\"amount\":";
+			appendFormat( result, "%lld", 9000 + random() % 90000 );
+			result += ",\"audienceSubCategoryId\":337100890,\"seatCategoryId\":";
+			appendFormat( result, "%lld", 338937271 + price );
+			result += '}';
+		}
+		result += "]}";
+	}
+	result += "}}";
+	return result;
+}
+
+// Parsing throughput of the whole text and of the creation in the on-demand mode.
+// The last case accesses the first value of the root container, as a query for a single field does.
+static void benchmarkParsing( const char* corpusName, const std::string& text, CStringPart rootKey )
+{
+	const CStringPart textPart( text.c_str(), static_cast<int>( text.size() ) );
+	const double byteCount = static_cast<double>( text.size() );
+	char caseName[64];
+	CJsonDocument doc;
+	const double fullTime = MeasureSeconds( 5, [&]() {
+		doc.CreateFromString( textPart, JPM_Full );
+		KeepResult( doc.GetRoot().FindObjectValue( rootKey ).IsNull() );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, full", corpusName );
+	Report( caseName, byteCount / fullTime / 1e9, "GB/s" );
+
+	const double onDemandTime = MeasureSeconds( 5, [&]() {
+		doc.CreateFromString( textPart, JPM_OnDemand );
+		KeepResult( doc.TryGetRoot() != nullptr );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, on demand", corpusName );
+	Report( caseName, byteCount / onDemandTime / 1e9, "GB/s" );
+
+	const double firstValueTime = MeasureSeconds( 5, [&]() {
+		doc.CreateFromString( textPart, JPM_OnDemand );
+		const auto& container = doc.GetRoot().FindObjectValue( rootKey );
+		KeepResult( container.IsArray() ? ( *container.GetAsArray().begin() )->GetType() : ( *container.GetObjectKeyValues().begin() ).Value->GetType() );
+	} );
+	snprintf( caseName, sizeof( caseName ), "%s, on demand, first value", corpusName );
+	Report( caseName, byteCount / firstValueTime / 1e9, "GB/s" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_BENCHMARK( JsonParseTwitter )
+{
+	benchmarkParsing( "twitter", createTwitterText( Scaled( 1 << 25 ) ), "statuses" );
+}
+
+RELIB_BENCHMARK( JsonParseCanada )
+{
+	benchmarkParsing( "canada", createCanadaText( Scaled( 1 << 25 ) ), "features" );
+}
+
+RELIB_BENCHMARK( JsonParseCitm )
+{
+	benchmarkParsing( "citm", createCitmText( Scaled( 1 << 25 ) ), "events" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
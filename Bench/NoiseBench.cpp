@@ -0,0 +1,184 @@
+#include "BenchFramework.h"
+#include <NoiseGenerator.h>
+#include <ThreadPool.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+static const unsigned __int64 benchSeed = 1;
+
+// Thread counts from one to the processor count, doubling on every step. Zero stands for no thread pool.
+static std::vector<int> getThreadCounts()
+{
+	const int maxThreadCount = max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	std::vector<int> result{ 0 };
+	for( int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2 ) {
+		result.push_back( threadCount );
+	}
+	result.push_back( maxThreadCount );
+	return result;
+}
+
+// Millions of grid points per second.
+static void reportSpeed( const char* typeName, const char* operationName, double seconds, int pointCount )
+{
+	char caseName[64];
+	snprintf( caseName, sizeof( caseName ), "%s %s", typeName, operationName );
+	Report( caseName, pointCount / seconds / 1e6, "Msamples/s" );
+}
+
+template <class ValueType>
+static void checkEqual( const char* typeName, const char* operationName, const CArray<ValueType>& pointResult, const CArray<ValueType>& gridResult )
+{
+	for( int i = 0; i < pointResult.Size(); i++ ) {
+		if( pointResult[i] != gridResult[i] ) {
+			printf( "%s %s: grid result differs from the point result\n", typeName, operationName );
+			return;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// A 2D grid point by point with Noise and with FillNoise.
+template <class ValueType>
+static void benchmarkNoise2( const char* typeName )
+{
+	const CGradientNoise<ValueType> noise( benchSeed );
+	const CVector2<ValueType> origin( ValueType( 0.5 ), ValueType( 0.25 ) );
+	const CVector2<ValueType> step( ValueType( 0.037 ), ValueType( 0.041 ) );
+	const CVector2<int> gridSize( Scaled( 1024 ), Scaled( 1024 ) );
+	const int pointCount = gridSize.X() * gridSize.Y();
+
+	CArray<ValueType> pointResult;
+	pointResult.IncreaseSizeNoInitialize( pointCount );
+	const double pointTime = MeasureSeconds( 3, [&]() {
+		for( int y = 0; y < gridSize.Y(); y++ ) {
+			for( int x = 0; x < gridSize.X(); x++ ) {
+				const CVector2<ValueType> pos( origin.X() + x * step.X(), origin.Y() + y * step.Y() );
+				pointResult[y * gridSize.X() + x] = noise.Noise( pos );
+			}
+		}
+	} );
+	reportSpeed( typeName, "2D Noise by point", pointTime, pointCount );
+
+	CArray<ValueType> gridResult;
+	gridResult.IncreaseSizeNoInitialize( pointCount );
+	const double gridTime = MeasureSeconds( 3, [&]() { noise.FillNoise( origin, step, gridSize, gridResult ); } );
+	reportSpeed( typeName, "2D FillNoise", gridTime, pointCount );
+	checkEqual( typeName, "2D FillNoise", pointResult, gridResult );
+}
+
+// A 3D grid point by point with Noise and with FillNoise.
+template <class ValueType>
+static void benchmarkNoise3( const char* typeName )
+{
+	const CGradientNoise<ValueType> noise( benchSeed );
+	const CVector3<ValueType> origin( ValueType( 0.5 ), ValueType( 0.25 ), ValueType( -3.5 ) );
+	const CVector3<ValueType> step( ValueType( 0.037 ), ValueType( 0.041 ), ValueType( 0.043 ) );
+	const CVector3<int> gridSize( Scaled( 128 ), Scaled( 128 ), Scaled( 128 ) );
+	const int pointCount = gridSize.X() * gridSize.Y() * gridSize.Z();
+
+	CArray<ValueType> pointResult;
+	pointResult.IncreaseSizeNoInitialize( pointCount );
+	const double pointTime = MeasureSeconds( 3, [&]() {
+		for( int z = 0; z < gridSize.Z(); z++ ) {
+			for( int y = 0; y < gridSize.Y(); y++ ) {
+				for( int x = 0; x < gridSize.X(); x++ ) {
+					const CVector3<ValueType> pos( origin.X() + x * step.X(), origin.Y() + y * step.Y(), origin.Z() + z * step.Z() );
+					pointResult[( z * gridSize.Y() + y ) * gridSize.X() + x] = noise.Noise( pos );
+				}
+			}
+		}
+	} );
+	reportSpeed( typeName, "3D Noise by point", pointTime, pointCount );
+
+	CArray<ValueType> gridResult;
+	gridResult.IncreaseSizeNoInitialize( pointCount );
+	const double gridTime = MeasureSeconds( 3, [&]() { noise.FillNoise( origin, step, gridSize, gridResult ); } );
+	reportSpeed( typeName, "3D FillNoise", gridTime, pointCount );
+	checkEqual( typeName, "3D FillNoise", pointResult, gridResult );
+}
+
+// A 2D grid of four fBm octaves point by point and with FillFractalNoise.
+template <class ValueType>
+static void benchmarkFractalNoise2( const char* typeName )
+{
+	const CGradientNoise<ValueType> noise( benchSeed );
+	const CVector2<ValueType> origin( ValueType( 0.5 ), ValueType( 0.25 ) );
+	const CVector2<ValueType> step( ValueType( 0.037 ), ValueType( 0.041 ) );
+	const CVector2<int> gridSize( Scaled( 512 ), Scaled( 512 ) );
+	const int pointCount = gridSize.X() * gridSize.Y();
+	const CFractalNoiseParams<ValueType> params;
+
+	CArray<ValueType> pointResult;
+	pointResult.IncreaseSizeNoInitialize( pointCount );
+	const double pointTime = MeasureSeconds( 3, [&]() {
+		for( int y = 0; y < gridSize.Y(); y++ ) {
+			for( int x = 0; x < gridSize.X(); x++ ) {
+				const CVector2<ValueType> pos( origin.X() + x * step.X(), origin.Y() + y * step.Y() );
+				pointResult[y * gridSize.X() + x] = noise.FractalNoise( pos, params );
+			}
+		}
+	} );
+	reportSpeed( typeName, "2D fBm by point", pointTime, pointCount );
+
+	CArray<ValueType> gridResult;
+	gridResult.IncreaseSizeNoInitialize( pointCount );
+	const double gridTime = MeasureSeconds( 3, [&]() { noise.FillFractalNoise( origin, step, gridSize, params, gridResult ); } );
+	reportSpeed( typeName, "2D FillFractalNoise", gridTime, pointCount );
+	checkEqual( typeName, "2D FillFractalNoise", pointResult, gridResult );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Float grids use four lanes. Double grids use two lanes only for the fractal noise.
+RELIB_BENCHMARK( NoiseGridFloat )
+{
+	benchmarkNoise2<float>( "float" );
+	benchmarkNoise3<float>( "float" );
+	benchmarkFractalNoise2<float>( "float" );
+}
+
+RELIB_BENCHMARK( NoiseGridDouble )
+{
+	benchmarkNoise2<double>( "double" );
+	benchmarkNoise3<double>( "double" );
+	benchmarkFractalNoise2<double>( "double" );
+}
+
+// A float heightmap split between the pool workers.
+RELIB_BENCHMARK( NoiseGridByThreadCount )
+{
+	const CGradientNoise<float> noise( benchSeed );
+	const CVector2<int> gridSize( Scaled( 4096 ), Scaled( 1024 ) );
+	const int pointCount = gridSize.X() * gridSize.Y();
+	CArray<float> result;
+	result.IncreaseSizeNoInitialize( pointCount );
+	for( int threadCount : getThreadCounts() ) {
+		const CVector2<float> origin( 0.5f, 0.25f );
+		const CVector2<float> step( 0.037f, 0.041f );
+		double time;
+		if( threadCount == 0 ) {
+			time = MeasureSeconds( 3, [&]() { noise.FillNoise( origin, step, gridSize, result ); } );
+		} else {
+			CThreadPool pool( threadCount );
+			time = MeasureSeconds( 3, [&]() { noise.FillNoise( origin, step, gridSize, result, pool ); } );
+		}
+		char operationName[64];
+		if( threadCount == 0 ) {
+			snprintf( operationName, sizeof( operationName ), "2D FillNoise, no pool" );
+		} else {
+			snprintf( operationName, sizeof( operationName ), "2D FillNoise, %d threads", threadCount );
+		}
+		reportSpeed( "float", operationName, time, pointCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,181 @@
+#include "BenchFramework.h"
+#include <Sort.h>
+#include <ParallelSort.h>
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Input orders that are common in practice or bad for a naive quick sort.
+enum TSortInput {
+	SI_Random,
+	SI_Sorted,
+	SI_Reversed,
+	SI_FewUnique,
+	SI_OrganPipe,
+	SI_Count
+};
+
+static const char* const sortInputNames[SI_Count] = { "random", "sorted", "reversed", "few unique", "organ pipe" };
+
+static std::vector<int> createInts( TSortInput input, int count )
+{
+	std::mt19937 random( 1 );
+	std::vector<int> result( count );
+	for( int i = 0; i < count; i++ ) {
+		switch( input ) {
+			case SI_Random:
+				result[i] = static_cast<int>( random() );
+				break;
+			case SI_Sorted:
+				result[i] = i;
+				break;
+			case SI_Reversed:
+				result[i] = count - i;
+				break;
+			case SI_FewUnique:
+				result[i] = static_cast<int>( random() % 16 );
+				break;
+			case SI_OrganPipe:
+				result[i] = i < count / 2 ? i : count - i;
+				break;
+			default:
+				assert( false );
+		}
+	}
+	return result;
+}
+
+// Element with a key and a payload, larger than the branchless partitioning limit.
+struct CSortRecord {
+	double Key;
+	int Payload[6];
+};
+
+static bool operator<( const CSortRecord& left, const CSortRecord& right )
+{
+	return left.Key < right.Key;
+}
+
+// Best time of sorting a fresh copy of the source.
+template <class Type, class SortAction>
+static double measureSort( const std::vector<Type>& source, const SortAction& sortAction )
+{
+	std::vector<Type> arr;
+	double bestTime = 0;
+	for( int run = 0; run < 3; run++ ) {
+		arr = source;
+		const double runTime = MeasureSeconds( 1, [&]() { sortAction( arr ); } );
+		bestTime = run == 0 ? runTime : min( bestTime, runTime );
+	}
+	assert( std::is_sorted( arr.begin(), arr.end(), []( const Type& left, const Type& right ) { return left < right; } ) );
+	return bestTime;
+}
+
+template <class Type>
+static void benchmarkComparisonSorts( const char* inputName, const std::vector<Type>& source, bool hasQSort = true )
+{
+	const int count = static_cast<int>( source.size() );
+	const auto less = []( const Type& left, const Type& right ) { return left < right; };
+	char caseName[64];
+	if( hasQSort ) {
+		const double qsortTime = measureSort( source, [&]( std::vector<Type>& arr ) { Sort::QSort( arr.data(), count, less ); } );
+		snprintf( caseName, sizeof( caseName ), "QSort, %s", inputName );
+		ReportTime( caseName, qsortTime, count );
+	}
+	const double introTime = measureSort( source, [&]( std::vector<Type>& arr ) { Sort::IntroSort( arr.data(), count, less ); } );
+	snprintf( caseName, sizeof( caseName ), "IntroSort, %s", inputName );
+	ReportTime( caseName, introTime, count );
+	const double stdTime = measureSort( source, [&]( std::vector<Type>& arr ) { std::sort( arr.begin(), arr.end(), less ); } );
+	snprintf( caseName, sizeof( caseName ), "std::sort, %s", inputName );
+	ReportTime( caseName, stdTime, count );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// The previous quick sort, the introsort and the standard library sort on integers in different orders.
+RELIB_BENCHMARK( SortIntInputs )
+{
+	const int count = Scaled( 1 << 22 );
+	for( int input = 0; input < SI_Count; input++ ) {
+		// QSort is quadratic on the organ pipe input, it is measured on a smaller array by SortQuadraticInput.
+		benchmarkComparisonSorts( sortInputNames[input], createInts( static_cast<TSortInput>( input ), count ), input != SI_OrganPipe );
+	}
+}
+
+// The organ pipe input takes quadratic time with the previous quick sort.
+RELIB_BENCHMARK( SortQuadraticInput )
+{
+	for( int count : { 1 << 14, 1 << 16 } ) {
+		char inputName[64];
+		snprintf( inputName, sizeof( inputName ), "organ pipe, %d elements", Scaled( count ) );
+		benchmarkComparisonSorts( inputName, createInts( SI_OrganPipe, Scaled( count ) ) );
+	}
+}
+
+// Elements that are too large for the branchless partitioning.
+RELIB_BENCHMARK( SortRecords )
+{
+	const int count = Scaled( 1 << 20 );
+	std::mt19937 random( 2 );
+	std::uniform_real_distribution<double> keyDistribution( -1e6, 1e6 );
+	std::vector<CSortRecord> records( count );
+	for( auto& record : records ) {
+		record.Key = keyDistribution( random );
+	}
+	benchmarkComparisonSorts( "random 32 byte records", records );
+}
+
+// Radix sort compared to the introsort on arithmetic keys.
+RELIB_BENCHMARK( SortRadix )
+{
+	const int count = Scaled( 1 << 22 );
+	const auto ints = createInts( SI_Random, count );
+	const auto less = []( int left, int right ) { return left < right; };
+	const double introTime = measureSort( ints, [&]( std::vector<int>& arr ) { Sort::IntroSort( arr.data(), count, less ); } );
+	ReportTime( "IntroSort, random int", introTime, count );
+	const double radixTime = measureSort( ints, [&]( std::vector<int>& arr ) { Sort::RadixSort( CArrayBuffer<int>( arr.data(), count ) ); } );
+	ReportTime( "RadixSort, random int", radixTime, count );
+
+	std::mt19937 random( 3 );
+	std::uniform_real_distribution<double> distribution( -1e6, 1e6 );
+	std::vector<double> doubles( count );
+	for( auto& value : doubles ) {
+		value = distribution( random );
+	}
+	const auto doubleLess = []( double left, double right ) { return left < right; };
+	const double introDoubleTime = measureSort( doubles, [&]( std::vector<double>& arr ) { Sort::IntroSort( arr.data(), count, doubleLess ); } );
+	ReportTime( "IntroSort, random double", introDoubleTime, count );
+	const double radixDoubleTime = measureSort( doubles, [&]( std::vector<double>& arr ) { Sort::RadixSort( CArrayBuffer<double>( arr.data(), count ) ); } );
+	ReportTime( "RadixSort, random double", radixDoubleTime, count );
+}
+
+// Parallel sort scaling from one thread to all the processors.
+RELIB_BENCHMARK( SortParallel )
+{
+	const int count = Scaled( 1 << 23 );
+	const auto ints = createInts( SI_Random, count );
+	const auto less = []( int left, int right ) { return left < right; };
+	const double introTime = measureSort( ints, [&]( std::vector<int>& arr ) { Sort::IntroSort( arr.data(), count, less ); } );
+	ReportTime( "IntroSort", introTime, count );
+
+	const int maxThreadCount = max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	for( int threadCount = 1; ; threadCount = min( threadCount * 2, maxThreadCount ) ) {
+		char caseName[64];
+		const double time = measureSort( ints, [&]( std::vector<int>& arr ) { Sort::ParallelSort( CArrayBuffer<int>( arr.data(), count ), less, threadCount ); } );
+		snprintf( caseName, sizeof( caseName ), "ParallelSort, %d threads", threadCount );
+		ReportTime( caseName, time, count );
+		if( threadCount == maxThreadCount ) {
+			break;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,293 @@
+#include "BenchFramework.h"
+#include <StringAllocator.h>
+#include <GeneralBlockAllocator.h>
+#include <ObjectPool.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// String allocator used before the thread heaps, kept here as the baseline.
+// Every thread has a block allocator for each of the three block sizes up to 128 bytes, larger strings go to the process heap.
+// A block goes to the allocator of the thread that frees it.
+class CBlockStringAllocator {
+public:
+	CBlockStringAllocator();
+
+	CRawBuffer AllocateSized( int size );
+	void Free( CRawBuffer buffer );
+
+private:
+	static const int smallBlockSize = 32;
+	static const int mediumBlockSize = 64;
+	static const int largeBlockSize = 128;
+
+	template <int blockSize>
+	using TStringBlockAllocator = CGeneralBlockAllocator<blockSize, alignof( wchar_t ), CProcessHeap, CDynamicByteResizeStrategy<16 * blockSize>>;
+	template <int blockSize>
+	using TStringAllocatorPool = RelibInternal::CObjectPool<TStringBlockAllocator<blockSize>, 4, CProcessHeap, CProcessHeap>;
+
+	// Block allocators of a thread. Returned to the pools when the thread ends.
+	class CThreadAllocators;
+
+	std::mutex poolLock;
+	TStringAllocatorPool<smallBlockSize> smallBlockAllocators;
+	TStringAllocatorPool<mediumBlockSize> mediumBlockAllocators;
+	TStringAllocatorPool<largeBlockSize> largeBlockAllocators;
+	CHeapAllocator heapManager;
+
+	CThreadAllocators& getThreadAllocators();
+};
+
+class CBlockStringAllocator::CThreadAllocators {
+public:
+	explicit CThreadAllocators( CBlockStringAllocator& _owner );
+	~CThreadAllocators();
+
+	TStringBlockAllocator<smallBlockSize>& Small()
+		{ return small->Value(); }
+	TStringBlockAllocator<mediumBlockSize>& Medium()
+		{ return medium->Value(); }
+	TStringBlockAllocator<largeBlockSize>& Large()
+		{ return large->Value(); }
+
+private:
+	CBlockStringAllocator& owner;
+	std::unique_ptr<typename TStringAllocatorPool<smallBlockSize>::TPoolRef> small;
+	std::unique_ptr<typename TStringAllocatorPool<mediumBlockSize>::TPoolRef> medium;
+	std::unique_ptr<typename TStringAllocatorPool<largeBlockSize>::TPoolRef> large;
+};
+
+CBlockStringAllocator::CThreadAllocators::CThreadAllocators( CBlockStringAllocator& _owner ) :
+	owner( _owner )
+{
+	std::lock_guard<std::mutex> lock( owner.poolLock );
+	small.reset( new typename TStringAllocatorPool<smallBlockSize>::TPoolRef( owner.smallBlockAllocators.GetOrCreate() ) );
+	medium.reset( new typename TStringAllocatorPool<mediumBlockSize>::TPoolRef( owner.mediumBlockAllocators.GetOrCreate() ) );
+	large.reset( new typename TStringAllocatorPool<largeBlockSize>::TPoolRef( owner.largeBlockAllocators.GetOrCreate() ) );
+}
+
+CBlockStringAllocator::CThreadAllocators::~CThreadAllocators()
+{
+	std::lock_guard<std::mutex> lock( owner.poolLock );
+	small.reset();
+	medium.reset();
+	large.reset();
+}
+
+CBlockStringAllocator::CBlockStringAllocator()
+{
+	heapManager.Create( 0 );
+	heapManager.SetLowFragmentation( true );
+}
+
+CBlockStringAllocator::CThreadAllocators& CBlockStringAllocator::getThreadAllocators()
+{
+	thread_local CThreadAllocators allocators( *this );
+	return allocators;
+}
+
+CRawBuffer CBlockStringAllocator::AllocateSized( int size )
+{
+	if( size <= smallBlockSize ) {
+		return getThreadAllocators().Small().AllocateSized( smallBlockSize );
+	} else if( size <= mediumBlockSize ) {
+		return getThreadAllocators().Medium().AllocateSized( mediumBlockSize );
+	} else if( size <= largeBlockSize ) {
+		return getThreadAllocators().Large().AllocateSized( largeBlockSize );
+	}
+	return heapManager.AllocateSized( size );
+}
+
+void CBlockStringAllocator::Free( CRawBuffer buffer )
+{
+	const int size = buffer.Size();
+	if( size <= smallBlockSize ) {
+		getThreadAllocators().Small().Free( buffer.Ptr() );
+	} else if( size <= mediumBlockSize ) {
+		getThreadAllocators().Medium().Free( buffer.Ptr() );
+	} else if( size <= largeBlockSize ) {
+		getThreadAllocators().Large().Free( buffer.Ptr() );
+	} else {
+		heapManager.Free( buffer.Ptr() );
+	}
+}
+
+// Only one instance may exist, the thread allocators belong to it.
+static CBlockStringAllocator& getBlockStringAllocator()
+{
+	static CBlockStringAllocator allocator;
+	return allocator;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// String sizes of a benchmark case. Small strings fit the block sizes of both allocators.
+struct CStringSizes {
+	const char* Name;
+	int MaxSize;
+};
+
+static const CStringSizes stringSizeCases[] = { { "up to 128 bytes", 128 }, { "up to 1 KB", 1024 } };
+
+static int getMaxThreadCount()
+{
+	const int hardwareCount = static_cast<int>( std::thread::hardware_concurrency() );
+	return hardwareCount > 0 ? hardwareCount : 1;
+}
+
+// A string of random size that is written by its user.
+template <class Allocator>
+static CRawBuffer createString( Allocator& allocator, std::minstd_rand& random, int maxSize )
+{
+	const int size = 8 + static_cast<int>( random() % maxSize );
+	const auto result = allocator.AllocateSized( size );
+	memset( result.Ptr(), 'a', size );
+	return result;
+}
+
+// Every thread keeps a window of live strings and replaces a random one on every step.
+template <class Allocator>
+static double measureSameThreadChurn( Allocator& allocator, int threadCount, int maxSize, int stepCount )
+{
+	return MeasureSeconds( 3, [&]() {
+		std::vector<std::thread> threads;
+		for( int i = 0; i < threadCount; i++ ) {
+			threads.emplace_back( [&, i]() {
+				std::minstd_rand random( i + 1 );
+				std::vector<CRawBuffer> window;
+				for( int j = 0; j < 1024; j++ ) {
+					window.push_back( createString( allocator, random, maxSize ) );
+				}
+				for( int j = 0; j < stepCount; j++ ) {
+					auto& str = window[random() % window.size()];
+					allocator.Free( str );
+					str = createString( allocator, random, maxSize );
+				}
+				for( auto& str : window ) {
+					allocator.Free( str );
+				}
+			} );
+		}
+		for( auto& thread : threads ) {
+			thread.join();
+		}
+	} );
+}
+
+// Producers pass batches of strings to consumers that free them.
+template <class Allocator>
+static double measureProducerConsumer( Allocator& allocator, int pairCount, int maxSize, int stringCount )
+{
+	const int batchSize = 256;
+	const int batchCount = stringCount / batchSize / pairCount;
+	return MeasureSeconds( 3, [&]() {
+		std::mutex queueLock;
+		std::condition_variable queueChanged;
+		std::deque<std::vector<CRawBuffer>> queue;
+		int activeProducerCount = pairCount;
+
+		std::vector<std::thread> threads;
+		for( int i = 0; i < pairCount; i++ ) {
+			threads.emplace_back( [&, i]() {
+				std::minstd_rand random( i + 1 );
+				for( int j = 0; j < batchCount; j++ ) {
+					std::vector<CRawBuffer> batch;
+					batch.reserve( batchSize );
+					for( int k = 0; k < batchSize; k++ ) {
+						batch.push_back( createString( allocator, random, maxSize ) );
+					}
+					std::unique_lock<std::mutex> lock( queueLock );
+					// Limit the strings in flight, like a pipeline with a bounded queue.
+					queueChanged.wait( lock, [&]() { return queue.size() < 64; } );
+					queue.push_back( std::move( batch ) );
+					queueChanged.notify_all();
+				}
+				std::lock_guard<std::mutex> lock( queueLock );
+				activeProducerCount--;
+				queueChanged.notify_all();
+			} );
+			threads.emplace_back( [&]() {
+				for( ;; ) {
+					std::vector<CRawBuffer> batch;
+					{
+						std::unique_lock<std::mutex> lock( queueLock );
+						queueChanged.wait( lock, [&]() { return !queue.empty() || activeProducerCount == 0; } );
+						if( queue.empty() ) {
+							return;
+						}
+						batch = std::move( queue.front() );
+						queue.pop_front();
+						queueChanged.notify_all();
+					}
+					for( auto& str : batch ) {
+						KeepResult( static_cast<char*>( str.Ptr() )[0] );
+						allocator.Free( str );
+					}
+				}
+			} );
+		}
+		for( auto& thread : threads ) {
+			thread.join();
+		}
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Allocations and frees on the same thread.
+RELIB_BENCHMARK( StringAllocatorSameThreadChurn )
+{
+	const int stepCount = Scaled( 1 << 22 );
+	for( const auto& sizes : stringSizeCases ) {
+		for( int threadCount = 1; ; threadCount = min( threadCount * 2, getMaxThreadCount() ) ) {
+			char caseName[64];
+			const double heapTime = measureSameThreadChurn( GetStringAllocator(), threadCount, sizes.MaxSize, stepCount );
+			snprintf( caseName, sizeof( caseName ), "thread heaps, %s, %d threads", sizes.Name, threadCount );
+			ReportTime( caseName, heapTime, static_cast<double>( stepCount ) * threadCount );
+			const double blockTime = measureSameThreadChurn( getBlockStringAllocator(), threadCount, sizes.MaxSize, stepCount );
+			snprintf( caseName, sizeof( caseName ), "block allocators, %s, %d threads", sizes.Name, threadCount );
+			ReportTime( caseName, blockTime, static_cast<double>( stepCount ) * threadCount );
+			if( threadCount == getMaxThreadCount() ) {
+				break;
+			}
+		}
+	}
+}
+
+// Strings allocated by producer threads and freed by consumer threads.
+RELIB_BENCHMARK( StringAllocatorProducerConsumer )
+{
+	const int stringCount = Scaled( 1 << 22 );
+	for( const auto& sizes : stringSizeCases ) {
+		for( int pairCount : { 1, 2 } ) {
+			char caseName[64];
+			const auto statisticsBefore = GetStringAllocator().GetStatistics();
+			const double heapTime = measureProducerConsumer( GetStringAllocator(), pairCount, sizes.MaxSize, stringCount );
+			const auto statisticsAfter = GetStringAllocator().GetStatistics();
+			snprintf( caseName, sizeof( caseName ), "thread heaps, %s, %d pairs", sizes.Name, pairCount );
+			ReportTime( caseName, heapTime, stringCount );
+			const auto freeCount = statisticsAfter.FreeCount - statisticsBefore.FreeCount;
+			const auto remoteFreeCount = statisticsAfter.RemoteFreeCount - statisticsBefore.RemoteFreeCount;
+			snprintf( caseName, sizeof( caseName ), "thread heaps, %s, %d pairs, remote frees", sizes.Name, pairCount );
+			Report( caseName, freeCount > 0 ? 100.0 * remoteFreeCount / freeCount : 0.0, "%" );
+
+			const double blockTime = measureProducerConsumer( getBlockStringAllocator(), pairCount, sizes.MaxSize, stringCount );
+			snprintf( caseName, sizeof( caseName ), "block allocators, %s, %d pairs", sizes.Name, pairCount );
+			ReportTime( caseName, blockTime, stringCount );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,166 @@
+#include "BenchFramework.h"
+#include <BaseString.h>
+#include <random>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Search functions used before the SSE2 kernels, kept here as the baseline.
+
+static int baselineFind( CStringPart text, char symbol )
+{
+	for( int i = 0; i < text.Length(); i++ ) {
+		if( text[i] == symbol ) {
+			return i;
+		}
+	}
+	return NotFound;
+}
+
+// Start of the strstr search. The value is read on every call, so the search is not moved out of the measured loop.
+static volatile int searchStart = 0;
+
+// The text must be null-terminated.
+static int baselineFind( const CString& text, const CString& substring )
+{
+	const char* result = ::strstr( text.Ptr() + searchStart, substring.Ptr() );
+	return result != nullptr ? static_cast<int>( result - text.Ptr() ) : NotFound;
+}
+
+static int baselineFindNoCase( CStringPart text, CStringPart substring )
+{
+	int textPos = 0;
+	int substringPos = 0;
+	int resultPos = NotFound;
+	while( substringPos < substring.Length() ) {
+		if( textPos >= text.Length() ) {
+			return NotFound;
+		}
+		if( ::tolower( static_cast<unsigned char>( text[textPos] ) ) == ::tolower( static_cast<unsigned char>( substring[substringPos] ) ) ) {
+			if( resultPos == NotFound ) {
+				resultPos = textPos;
+			}
+			substringPos++;
+			textPos++;
+		} else {
+			substringPos = 0;
+			if( resultPos != NotFound ) {
+				textPos = resultPos + 1;
+				resultPos = NotFound;
+			} else {
+				textPos++;
+			}
+		}
+	}
+	return resultPos;
+}
+
+static int baselineFindOneOf( CStringPart text, CStringPart symbols )
+{
+	for( int i = 0; i < text.Length(); i++ ) {
+		if( baselineFind( symbols, text[i] ) != NotFound ) {
+			return i;
+		}
+	}
+	return NotFound;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Lowercase words separated by spaces. The searched patterns are only at the end of the text.
+static CString createSearchText( int length )
+{
+	std::mt19937 random( 1 );
+	CString result;
+	while( result.Length() < length ) {
+		const int wordLength = 2 + random() % 8;
+		for( int i = 0; i < wordLength; i++ ) {
+			result += static_cast<char>( 'a' + random() % 20 );
+		}
+		result += ' ';
+	}
+	result += "Needle;";
+	return result;
+}
+
+// Time per text symbol of the repeated search.
+template <class SearchAction>
+static void measureSearch( const char* caseName, const CString& text, int expectedPos, const SearchAction& search )
+{
+	const int repeatCount = 10;
+	bool isFound = true;
+	const double time = MeasureSeconds( 3, [&]() {
+		for( int i = 0; i < repeatCount; i++ ) {
+			isFound &= search() == expectedPos;
+		}
+	} );
+	KeepResult( isFound );
+	if( !isFound ) {
+		printf( "%s: wrong search result\n", caseName );
+	}
+	ReportTime( caseName, time, static_cast<double>( repeatCount ) * text.Length() );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_BENCHMARK( StringFindSymbol )
+{
+	const auto text = createSearchText( Scaled( 1 << 20 ) );
+	const int expectedPos = text.Length() - 7;
+	measureSearch( "baseline", text, expectedPos, [&]() { return baselineFind( text, 'N' ); } );
+	measureSearch( "Find", text, expectedPos, [&]() { return text.Find( 'N' ); } );
+}
+
+RELIB_BENCHMARK( StringFindSubstring )
+{
+	const auto text = createSearchText( Scaled( 1 << 20 ) );
+	const int expectedPos = text.Length() - 7;
+	const CString substring( "Needle" );
+	measureSearch( "baseline strstr", text, expectedPos, [&]() { return baselineFind( text, substring ); } );
+	measureSearch( "Find", text, expectedPos, [&]() { return text.Find( substring ); } );
+}
+
+RELIB_BENCHMARK( StringFindNoCase )
+{
+	const auto text = createSearchText( Scaled( 1 << 20 ) );
+	const int expectedPos = text.Length() - 7;
+	measureSearch( "baseline", text, expectedPos, [&]() { return baselineFindNoCase( text, "NEEDLE" ); } );
+	measureSearch( "FindNoCase", text, expectedPos, [&]() { return text.FindNoCase( "NEEDLE" ); } );
+}
+
+RELIB_BENCHMARK( StringFindOneOf )
+{
+	const auto text = createSearchText( Scaled( 1 << 20 ) );
+	const int expectedPos = text.Length() - 7;
+	const CString symbols( "NXYZ;,.!?" );
+	measureSearch( "baseline", text, expectedPos, [&]() { return baselineFindOneOf( text, symbols ); } );
+	measureSearch( "FindOneOf", text, expectedPos, [&]() { return text.FindOneOf( symbols ); } );
+}
+
+// Strings up to 23 symbols are stored inside the object, longer strings are allocated.
+RELIB_BENCHMARK( StringCreateShortAndLong )
+{
+	const int stringCount = Scaled( 1000000 );
+	const char* const sources[] = { "entity name", "a string that is too long to be stored inline" };
+	const char* const caseNames[] = { "create 11 symbols", "create 45 symbols" };
+	for( int sourcePos = 0; sourcePos < 2; sourcePos++ ) {
+		const CStringPart source( sources[sourcePos] );
+		const double time = MeasureSeconds( 3, [&]() {
+			int totalLength = 0;
+			for( int i = 0; i < stringCount; i++ ) {
+				CString str( source );
+				totalLength += str.Length();
+			}
+			KeepResult( totalLength );
+		} );
+		ReportTime( caseNames[sourcePos], time, stringCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
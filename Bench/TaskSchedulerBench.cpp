@@ -0,0 +1,111 @@
+#include "BenchFramework.h"
+#include <TaskScheduler.h>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+
+using namespace Relib::RelibInternal;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Work of a single index. Large enough to hide the scheduling cost with a moderate grain size.
+static double computeItem( int index )
+{
+	double value = index;
+	for( int i = 0; i < 64; i++ ) {
+		value = sqrt( value + i ) * 1.5;
+	}
+	return value;
+}
+
+static int getMaxThreadCount()
+{
+	const int hardwareCount = static_cast<int>( std::thread::hardware_concurrency() );
+	return hardwareCount > 0 ? hardwareCount : 1;
+}
+
+// Worker counts from one to the processor count, doubling on every step.
+template <class Action>
+static void forEachWorkerCount( const Action& action )
+{
+	const int maxThreadCount = getMaxThreadCount();
+	for( int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2 ) {
+		action( threadCount );
+	}
+	action( maxThreadCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Scaling of ParallelFor from one worker to all the processors. Speedup is relative to a plain loop.
+RELIB_BENCHMARK( TaskSchedulerParallelForScaling )
+{
+	const int itemCount = Scaled( 1 << 22 );
+	const int grainSize = 1024;
+	const double serialTime = MeasureSeconds( 3, [&]() {
+		double sum = 0;
+		for( int i = 0; i < itemCount; i++ ) {
+			sum += computeItem( i );
+		}
+		KeepResult( static_cast<long long>( sum ) );
+	} );
+	ReportTime( "serial loop", serialTime, itemCount );
+
+	forEachWorkerCount( [&]( int threadCount ) {
+		CTaskScheduler scheduler( threadCount, nullptr );
+		std::atomic<long long> sum( 0 );
+		const double time = MeasureSeconds( 3, [&]() {
+			scheduler.ParallelFor( 0, itemCount / grainSize, 1, [&]( int chunk ) {
+				double chunkSum = 0;
+				for( int i = chunk * grainSize; i < ( chunk + 1 ) * grainSize; i++ ) {
+					chunkSum += computeItem( i );
+				}
+				sum += static_cast<long long>( chunkSum );
+			} );
+		} );
+		KeepResult( sum.load() );
+		char caseName[64];
+		snprintf( caseName, sizeof( caseName ), "ParallelFor, %d workers", threadCount );
+		ReportTime( caseName, time, itemCount );
+		snprintf( caseName, sizeof( caseName ), "ParallelFor, %d workers, speedup", threadCount );
+		Report( caseName, serialTime / time, "x" );
+	} );
+}
+
+// Cost of scheduling tiny tasks from outside the pool and from the workers.
+RELIB_BENCHMARK( TaskSchedulerTaskThroughput )
+{
+	const int taskCount = Scaled( 1 << 20 );
+	forEachWorkerCount( [&]( int threadCount ) {
+		CTaskScheduler scheduler( threadCount, nullptr );
+		const double externalTime = MeasureSeconds( 3, [&]() {
+			std::atomic<int> doneCount( 0 );
+			for( int i = 0; i < taskCount; i++ ) {
+				scheduler.Execute( [&doneCount]() { doneCount++; } );
+			}
+			scheduler.WaitFor( doneCount, taskCount );
+		} );
+		const int spawnerCount = 256;
+		const int tasksPerSpawner = taskCount / spawnerCount > 0 ? taskCount / spawnerCount : 1;
+		const double internalTime = MeasureSeconds( 3, [&]() {
+			std::atomic<int> doneCount( 0 );
+			for( int i = 0; i < spawnerCount; i++ ) {
+				scheduler.Execute( [&]() {
+					for( int j = 0; j < tasksPerSpawner; j++ ) {
+						scheduler.Execute( [&doneCount]() { doneCount++; } );
+					}
+				} );
+			}
+			scheduler.WaitFor( doneCount, spawnerCount * tasksPerSpawner );
+		} );
+		char caseName[64];
+		snprintf( caseName, sizeof( caseName ), "external tasks, %d workers", threadCount );
+		ReportTime( caseName, externalTime, taskCount );
+		snprintf( caseName, sizeof( caseName ), "worker spawned tasks, %d workers", threadCount );
+		ReportTime( caseName, internalTime, spawnerCount * tasksPerSpawner );
+	} );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
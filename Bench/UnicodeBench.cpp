@@ -0,0 +1,108 @@
+#include "BenchFramework.h"
+#include <UnicodeUtils.h>
+#include <Array.h>
+#include <random>
+#include <stdio.h>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Code point ranges of the generated texts. Symbols of the text are mixed with ASCII spaces and punctuation in the given share.
+struct CBenchCorpus {
+	const char* Name;
+	unsigned FirstCode;
+	unsigned LastCode;
+	// Percent of the symbols that come from the range, the rest are ASCII.
+	int RangePercent;
+};
+
+static const CBenchCorpus benchCorpora[] = {
+	{ "ascii", 'a', 'z', 100 },
+	{ "latin", 0xC0, 0xFF, 15 },
+	{ "cjk", 0x4E00, 0x9FFF, 90 },
+	{ "emoji", 0x1F600, 0x1F64F, 50 }
+};
+
+static CArray<char> createUtf8Text( const CBenchCorpus& corpus, int byteCount )
+{
+	std::mt19937 random( 1 );
+	std::uniform_int_distribution<unsigned> rangeDistribution( corpus.FirstCode, corpus.LastCode );
+	std::uniform_int_distribution<unsigned> asciiDistribution( 'a', 'z' );
+	CArray<char> result;
+	char symbol[4];
+	while( result.Size() < byteCount ) {
+		const int percent = random() % 100;
+		const unsigned code = percent % 10 == 9 ? ' ' : percent < corpus.RangePercent ? rangeDistribution( random ) : asciiDistribution( random );
+		const int symbolLength = Unicode::TryConvertUtf32ToUtf8( code, symbol );
+		for( int i = 0; i < symbolLength; i++ ) {
+			result.Add( symbol[i] );
+		}
+	}
+	return result;
+}
+
+// Conversion one code point at a time through the UTF-32 value, as the text was decoded before the block transcoder.
+static int convertByCodePoint( const char* str, int length, wchar_t* result )
+{
+	int resultLength = 0;
+	for( int pos = 0; pos < length; ) {
+		unsigned code;
+		const int symbolLength = Unicode::TryConvertUtf8ToUtf32( str + pos, length - pos, code );
+		if( symbolLength == 0 ) {
+			return NotFound;
+		}
+		pos += symbolLength;
+		if( code < 0x10000 ) {
+			result[resultLength++] = static_cast<wchar_t>( code );
+		} else {
+			code -= 0x10000;
+			result[resultLength++] = static_cast<wchar_t>( 0xD800 + ( code >> 10 ) );
+			result[resultLength++] = static_cast<wchar_t>( 0xDC00 + ( code & 0x3FF ) );
+		}
+	}
+	return resultLength;
+}
+
+// Throughput in gigabytes of the UTF-8 text per second.
+static void reportSpeed( const char* corpusName, const char* operationName, double seconds, int byteCount )
+{
+	char caseName[64];
+	snprintf( caseName, sizeof( caseName ), "%s, %s", corpusName, operationName );
+	Report( caseName, byteCount / seconds / 1e9, "GB/s" );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_BENCHMARK( UnicodeTranscoding )
+{
+	for( const auto& corpus : benchCorpora ) {
+		const auto utf8 = createUtf8Text( corpus, Scaled( 1 << 24 ) );
+		const int byteCount = utf8.Size();
+		CArray<wchar_t> utf16;
+		utf16.IncreaseSizeNoInitialize( Unicode::GetMaxUtf16Length( byteCount ) );
+		int utf16Length = 0;
+
+		const double validateTime = MeasureSeconds( 5, [&]() { KeepResult( Unicode::IsValidUtf8( utf8.Ptr(), byteCount ) ); } );
+		reportSpeed( corpus.Name, "validate UTF-8", validateTime, byteCount );
+
+		const double codePointTime = MeasureSeconds( 5, [&]() { utf16Length = convertByCodePoint( utf8.Ptr(), byteCount, utf16.Ptr() ); } );
+		reportSpeed( corpus.Name, "UTF-8 to UTF-16 by code point", codePointTime, byteCount );
+
+		const double toUtf16Time = MeasureSeconds( 5, [&]() { utf16Length = Unicode::TryConvertUtf8ToUtf16( utf8.Ptr(), byteCount, utf16.Ptr() ); } );
+		reportSpeed( corpus.Name, "UTF-8 to UTF-16", toUtf16Time, byteCount );
+
+		CArray<char> utf8Result;
+		utf8Result.IncreaseSizeNoInitialize( Unicode::GetUtf8Length( utf16.Ptr(), utf16Length ) );
+		int utf8Length = 0;
+		const double toUtf8Time = MeasureSeconds( 5, [&]() { utf8Length = Unicode::TryConvertUtf16ToUtf8( utf16.Ptr(), utf16Length, utf8Result.Ptr() ); } );
+		reportSpeed( corpus.Name, "UTF-16 to UTF-8", toUtf8Time, byteCount );
+		if( utf8Length != byteCount ) {
+			printf( "%s: wrong conversion result\n", corpus.Name );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
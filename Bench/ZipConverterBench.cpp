@@ -0,0 +1,136 @@
+#include "BenchFramework.h"
+#include <ZipConverter.h>
+#include <ThreadPool.h>
+#include <random>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+using namespace RelibBench;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Text-like data from a small vocabulary, compressible by about a factor of five.
+static CArray<BYTE> createBenchData( int size )
+{
+	static const char* const words[] = { "entity ", "component ", "system ", "archive ", "value ", "0.25 ", "-17 ", "\"name\": ", "{ ", "} ", "\r\n" };
+	const int wordCount = sizeof( words ) / sizeof( words[0] );
+	std::mt19937 random( 1 );
+	CArray<BYTE> result;
+	while( result.Size() < size ) {
+		const char* word = words[random() % wordCount];
+		for( ; *word != 0 && result.Size() < size; word++ ) {
+			result.Add( static_cast<BYTE>( *word ) );
+		}
+		if( random() % 4 == 0 ) {
+			result.Add( static_cast<BYTE>( '0' + random() % 10 ) );
+		}
+	}
+	result.DeleteLast( result.Size() - size );
+	return result;
+}
+
+// Thread counts from one to the processor count, doubling on every step. Zero stands for no thread pool.
+static std::vector<int> getThreadCounts()
+{
+	const int maxThreadCount = max( static_cast<int>( std::thread::hardware_concurrency() ), 1 );
+	std::vector<int> result{ 0 };
+	for( int threadCount = 1; threadCount < maxThreadCount; threadCount *= 2 ) {
+		result.push_back( threadCount );
+	}
+	result.push_back( maxThreadCount );
+	return result;
+}
+
+static void getCaseName( const char* operationName, int threadCount, char ( &caseName )[64] )
+{
+	if( threadCount == 0 ) {
+		snprintf( caseName, sizeof( caseName ), "%s, no pool", operationName );
+	} else {
+		snprintf( caseName, sizeof( caseName ), "%s, %d threads", operationName, threadCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Single zlib stream compression. Without a pool the whole data is deflated as one stream.
+RELIB_BENCHMARK( ZipDataByThreadCount )
+{
+	const auto data = createBenchData( Scaled( 1 << 25 ) );
+	for( int threadCount : getThreadCounts() ) {
+		CPtrOwner<CThreadPool> pool;
+		if( threadCount > 0 ) {
+			pool = CreateOwner<CThreadPool>( threadCount );
+		}
+		CZipConverter converter( CZipConverter::DefaultCompressionLevel, pool.Ptr() );
+		CArray<BYTE> zipped;
+		const double zipTime = MeasureSeconds( 3, [&]() {
+			zipped.Empty();
+			converter.ZipData( data, zipped );
+		} );
+		char caseName[64];
+		getCaseName( "zip", threadCount, caseName );
+		ReportThroughput( caseName, zipTime, data.Size() );
+		getCaseName( "zip ratio", threadCount, caseName );
+		Report( caseName, static_cast<double>( data.Size() ) / zipped.Size(), "x" );
+
+		CArray<BYTE> unzipped;
+		const double unzipTime = MeasureSeconds( 3, [&]() {
+			unzipped.Empty();
+			converter.UnzipData( zipped, unzipped );
+		} );
+		getCaseName( "unzip", threadCount, caseName );
+		ReportThroughput( caseName, unzipTime, data.Size() );
+	}
+}
+
+// Block container compression and the parallel decompression of its blocks.
+RELIB_BENCHMARK( ZipBlocksByThreadCount )
+{
+	const auto data = createBenchData( Scaled( 1 << 25 ) );
+	for( int threadCount : getThreadCounts() ) {
+		CPtrOwner<CThreadPool> pool;
+		if( threadCount > 0 ) {
+			pool = CreateOwner<CThreadPool>( threadCount );
+		}
+		CZipConverter converter( CZipConverter::DefaultCompressionLevel, pool.Ptr() );
+		CArray<BYTE> container;
+		const double zipTime = MeasureSeconds( 3, [&]() {
+			container.Empty();
+			converter.ZipBlocks( data, container );
+		} );
+		char caseName[64];
+		getCaseName( "zip blocks", threadCount, caseName );
+		ReportThroughput( caseName, zipTime, data.Size() );
+
+		CArray<BYTE> unzipped;
+		const double unzipTime = MeasureSeconds( 3, [&]() {
+			unzipped.Empty();
+			converter.UnzipData( container, unzipped );
+		} );
+		getCaseName( "unzip blocks", threadCount, caseName );
+		ReportThroughput( caseName, unzipTime, data.Size() );
+	}
+}
+
+// Random access to a single block of the container.
+RELIB_BENCHMARK( ZipUnzipSingleBlock )
+{
+	const auto data = createBenchData( Scaled( 1 << 25 ) );
+	CZipConverter converter;
+	CArray<BYTE> container;
+	converter.ZipBlocks( data, container );
+	const int blockCount = CZipConverter::GetBlockCount( container );
+	CArray<BYTE> block;
+	const double time = MeasureSeconds( 3, [&]() {
+		for( int i = 0; i < blockCount; i++ ) {
+			block.Empty();
+			converter.UnzipBlock( container, ( i * 7 ) % blockCount, block );
+		}
+	} );
+	ReportTime( "unzip block", time, blockCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -113,7 +113,8 @@ namespace rapidxml
 	private:
 		CXmlDocument& owner;
 		// Current document strings. Includes all the document content and additional string for added nodes.
-		CArray<CUnicodeString> documentContent;
+		// Elements and attributes keep views of these strings, so the strings must never move. Short strings are stored inside the string object.
+		CPersistentStorage<CUnicodeString, 64> documentContent;
 		// Parsing flags.
 		int flags;
 		// Pointer to the start of the text that is being parsed. Used in exceptions.
@@ -52,8 +52,8 @@ CXmlElement* xml_document::CreateCopy( const CXmlElement& elem )
 CXmlElement* xml_document::parse( CUnicodeString str )
 {
 	documentContent.Empty();
-	const wchar_t* text = str.Ptr();
-	documentContent.Add( move( str ) );
+	// The view is taken from the stored string. A short text lives inside the string object and moves with it.
+	const wchar_t* text = AllocateString( move( str ) ).Ptr();
 	assert( text != nullptr );
 	textStart = text;
 
@@ -22,6 +22,10 @@ struct ClassMemberInfo<ReturnType ( ClassType::* )( Args... ) const> {
 	using ArgTypeAt = typename VarArgs::At<argNum, Args...>::Result;
 };
 
+// Non-const members, e.g. operators of mutable lambdas.
+template <class ClassType, class ReturnType, class... Args>
+struct ClassMemberInfo<ReturnType ( ClassType::* )( Args... )> : public ClassMemberInfo<ReturnType ( ClassType::* )( Args... ) const> {};
+
 // General information about an entity that defines operator().
 template <class F>
 struct FunctionInfo : public ClassMemberInfo<decltype( &Types::PureType<F>::Result::operator() )> {};
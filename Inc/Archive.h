@@ -18,10 +18,16 @@ extern const REAPI CError Err_SmallArchive;
 
 namespace RelibInternal {
 
+	class CArchiveSource;
+	class CArchiveTarget;
+
 	// Class for data serialization.
+	// Data is accessed through a window. In-memory archives use the whole buffer as the window.
+	// Streamed archives move the window over the source or the target, so the whole archive is never held in memory.
 	class REAPI CArchive {
 	public:
 		CArchive();
+		~CArchive();
 
 	protected:
 		// Read/Write methods for arbitrary data.
@@ -42,7 +48,25 @@ namespace RelibInternal {
 		void attachBuffer( CArray<BYTE> newBuffer );
 		CArray<BYTE> detachBuffer();
 
-		void skip( int byteCount );
+		// Streamed data.
+		void attachSource( CPtrOwner<CArchiveSource> newSource );
+		// The write chunk starts with the reserved size and grows up to the chunk size.
+		void attachTarget( CPtrOwner<CArchiveTarget> newTarget, int reserveSize, int chunkSize );
+		bool hasSource() const
+		{
+			return source != nullptr;
+		}
+		bool hasTarget() const
+		{
+			return target != nullptr;
+		}
+		// Decompress the rest of the source.
+		void startSourceInflation();
+		// Write the remaining data and close the target.
+		void closeTarget();
+
+		void skipReading( int byteCount );
+		void skipWriting( int byteCount );
 
 		// Serialization for small values.
 		// Integers from 0 to 254 are stored in 1 byte.
@@ -71,16 +95,29 @@ namespace RelibInternal {
 		int writeVersion( int currentVersion );
 
 	private:
-		// Buffer to be written to the file.
+		// Data of in-memory archives or the write chunk of streamed archives.
 		CArray<BYTE> buffer;
-		// Current buffer position.
+		// Current window of the reading. Points to the buffer or to the streamed source data.
+		const BYTE* readWindow;
+		int readWindowSize;
+		// Current window position. The writing window is the buffer.
 		int currentBufferPos;
+		// Maximum size of the write chunk of streamed archives.
+		int writeChunkSize;
+
+		CPtrOwner<CArchiveSource> source;
+		CPtrOwner<CArchiveTarget> target;
 
 		// Map that returns creationFunctionsBuffer's index for an object's name.
 		CMap<CUnicodeString, int> objectNamesDictionary;
 		// Buffer for quick access to object's creation functions. Filled only in reading mode.
 		CArray<const CBaseObjectCreationFunction*> creationFunctionsBuffer;
 
+		void readSlow( void* ptr, int size );
+		void writeSlow( const void* ptr, int size );
+		bool moveReadWindow();
+		void flushWriteChunk();
+
 		CPtrOwner<ISerializable> readUniqueObject();
 
 		void writeExternalName( CUnicodeView name );
@@ -92,26 +129,23 @@ namespace RelibInternal {
 	inline void CArchive::read( void* ptr, int size )
 	{
 		assert( size >= 0 );
-		check( size < buffer.Size(), Err_SmallArchive );
-		if( size > 0 ) {
-			::memcpy( ptr, buffer.Ptr() + currentBufferPos, size );
+		if( size <= readWindowSize - currentBufferPos ) {
+			::memcpy( ptr, readWindow + currentBufferPos, size );
 			currentBufferPos += size;
+		} else {
+			readSlow( ptr, size );
 		}
 	}
 
 	inline void CArchive::write( const void* ptr, int size )
 	{
 		assert( size >= 0 );
-		if( size + currentBufferPos >= buffer.Size() ) {
-			buffer.IncreaseSizeNoInitialize( size + currentBufferPos + 1 );
+		if( size <= buffer.Size() - currentBufferPos ) {
+			::memcpy( buffer.Ptr() + currentBufferPos, ptr, size );
+			currentBufferPos += size;
+		} else {
+			writeSlow( ptr, size );
 		}
-		::memcpy( buffer.Ptr() + currentBufferPos, ptr, size );
-		currentBufferPos += size;
-	}
-
-	inline bool CArchive::isEndOfReading() const
-	{
-		return currentBufferPos == buffer.Size();
 	}
 
 	template <class Type>
@@ -135,15 +169,18 @@ namespace RelibInternal {
 //////////////////////////////////////////////////////////////////////////
 
 // Class that reads and serializes data from a given file into the data structures.
+// File archives are read in windows: named files are mapped to memory a part at a time, file views are read in chunks.
+// Compressed archives are inflated incrementally.
 class REAPI CArchiveReader : public RelibInternal::CArchive {
 public:
 	explicit CArchiveReader( CStringPart fileName );
+	// File must stay open while the reader is used.
 	explicit CArchiveReader( CFileReadView _file );
 	explicit CArchiveReader( CArray<BYTE> _fileData );
 
 	void Skip( int byteCount )
 	{
-		skip( byteCount );
+		skipReading( byteCount );
 	}
 
 	bool IsEndOfArchive() const
@@ -291,12 +328,29 @@ inline CArchiveReader& operator>>( CArchiveReader& archive, CPtrOwner<ObjectType
 
 //////////////////////////////////////////////////////////////////////////
 
-// Class that writes the binarized data. It must be flushed to a valid source before it's destroyed.
+// Compression of a streamed archive.
+enum TArchiveCompression {
+	AC_None,
+	AC_Zlib,
+	AC_EnumCount
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Class that writes the binarized data.
+// In-memory writer must be flushed to a valid source before it's destroyed.
+// Streaming writer writes the data to the file in chunks of a fixed size and must be closed before it's destroyed.
 class REAPI CArchiveWriter : public RelibInternal::CArchive {
 public:
+	static const int DefaultChunkSize = 1024 * 1024;
+
+	// Create an in-memory writer.
 	explicit CArchiveWriter( int reserveSize = 0 );
+	// Create a streaming writer. File must stay open until the writer is closed.
+	explicit CArchiveWriter( CFileWriteView file, TArchiveCompression compression = AC_None, int chunkSize = DefaultChunkSize );
 	~CArchiveWriter();
 
+	// In-memory writer methods.
 	void FlushToFile( CStringPart fileName );
 	void FlushToFile( CFileWriteView file );
 #ifndef RELIB_NO_ZLIB
@@ -305,9 +359,13 @@ public:
 #endif
 	CArray<BYTE> FlushToByteString();
 
+	// Streaming writer methods.
+	// Write the remaining data and finish the compressed stream.
+	void Close();
+
 	void Skip( int byteCount )
 	{
-		skip( byteCount );
+		skipWriting( byteCount );
 	}
 
 	void WriteSmallValue( int value )
@@ -332,33 +390,35 @@ public:
 	template <class ObjectType>
 	friend CArchiveWriter& operator<<( CArchiveWriter& archive, const CPtrOwner<ObjectType>& object );
 
+protected:
+	// Create a streaming writer to a named file.
+	CArchiveWriter( CStringPart fileName, TArchiveCompression compression, int reserveSize, int chunkSize );
+
 private:
 	void writeArchiveFlag( BYTE flagValue, CArray<BYTE>& dest ) const;
 };
 
 //////////////////////////////////////////////////////////////////////////
 
-// Class that writes the binarized data to a given file. File write happens on destruction.
+// Class that writes the binarized data to a given file.
+// Data is written in chunks of the given size, the last chunk is written on destruction.
+// Chunk buffer starts with the reserved size, so small archives don't allocate the whole chunk.
 class REAPI CFileArchiveWriter : public CArchiveWriter {
 public:
-	explicit CFileArchiveWriter( CStringPart fileName, int reserveSize = 4096 );
+	explicit CFileArchiveWriter( CStringPart fileName, int reserveSize = 4096, int chunkSize = DefaultChunkSize );
 	~CFileArchiveWriter();
-
-private:
-	CString fileName;
 };
 
 //////////////////////////////////////////////////////////////////////////
 
 #ifndef RELIB_NO_ZLIB
-// Class that compresses and writes the binarized data to a given file. File write happens on destruction.
+// Class that compresses and writes the binarized data to a given file.
+// Data is compressed in chunks of the given size, the compressed stream is finished on destruction.
+// Chunk buffer starts with the reserved size, so small archives don't allocate the whole chunk.
 class REAPI CCompressedArchiveWriter : public CArchiveWriter {
 public:
-	explicit CCompressedArchiveWriter( CStringPart fileName, int reserveSize = 4096 );
+	explicit CCompressedArchiveWriter( CStringPart fileName, int reserveSize = 4096, int chunkSize = DefaultChunkSize );
 	~CCompressedArchiveWriter();
-
-private:
-	CString fileName;
 };
 #endif
 
@@ -483,6 +543,38 @@ inline CArchiveWriter& operator<<( CArchiveWriter& archive, const CPtrOwner<Obje
 	return archive;
 }
 
+//////////////////////////////////////////////////////////////////////////
+// Contiguous element serialization.
+// Values are stored in the native byte order, so the single copy of bitwise serializable elements produces the same data as the element by element serialization.
+
+template <class Elem>
+void WriteArrayData( CArchiveWriter& archive, const Elem* elems, int count )
+{
+	assert( count >= 0 );
+	if constexpr( Types::IsBitwiseSerializable<Elem>::Result ) {
+		assert( count <= INT_MAX / static_cast<int>( sizeof( Elem ) ) );
+		archive.Write( elems, count * sizeof( Elem ) );
+	} else {
+		for( int i = 0; i < count; i++ ) {
+			archive << elems[i];
+		}
+	}
+}
+
+template <class Elem>
+void ReadArrayData( CArchiveReader& archive, Elem* elems, int count )
+{
+	assert( count >= 0 );
+	if constexpr( Types::IsBitwiseSerializable<Elem>::Result ) {
+		check( count <= INT_MAX / static_cast<int>( sizeof( Elem ) ), Err_BadArchive );
+		archive.Read( elems, count * sizeof( Elem ) );
+	} else {
+		for( int i = 0; i < count; i++ ) {
+			archive >> elems[i];
+		}
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Array serialization.
 
@@ -490,9 +582,7 @@ template <class Elem, class Allocator /*= CRuntimeHeap*/, class GrowStrategy /*=
 CArchiveWriter& operator<<( CArchiveWriter& archive, const CArray<Elem, Allocator, GrowStrategy>& arr )
 {
 	archive << arr.Size();
-	for( const auto& elem : arr ) {
-		archive << elem;
-	}
+	WriteArrayData( archive, arr.Ptr(), arr.Size() );
 	return archive;
 }
 
@@ -503,10 +593,13 @@ CArchiveReader& operator>>( CArchiveReader& archive, CArray<Elem, Allocator, Gro
 	int size;
 	archive >> size;
 	check( size >= 0, Err_BadArchive );
-	arr.IncreaseSize( size );
-	for( int i = 0; i < size; i++ ) {
-		archive >> arr[i];
+	// Bitwise serializable elements are overwritten entirely.
+	if constexpr( Types::IsBitwiseSerializable<Elem>::Result && Types::IsPOD<Elem>::Result ) {
+		arr.IncreaseSizeNoInitialize( size );
+	} else {
+		arr.IncreaseSize( size );
 	}
+	ReadArrayData( archive, arr.Ptr(), size );
 	return archive;
 }
 
@@ -517,9 +610,7 @@ template <class Elem, class Allocator>
 CArchiveWriter& operator<<( CArchiveWriter& archive, const CStaticArray<Elem, Allocator>& arr )
 {
 	archive << arr.Size();
-	for( const auto& elem : arr ) {
-		archive << elem;
-	}
+	WriteArrayData( archive, arr.Ptr(), arr.Size() );
 	return archive;
 }
 
@@ -530,10 +621,12 @@ CArchiveReader& operator>>( CArchiveReader& archive, CStaticArray<Elem, Allocato
 	int size;
 	archive >> size;
 	check( size >= 0, Err_BadArchive );
-	arr.ResetSize( size );
-	for( int i = 0; i < size; i++ ) {
-		archive >> arr[i];
+	if constexpr( Types::IsBitwiseSerializable<Elem>::Result && Types::IsPOD<Elem>::Result ) {
+		arr.ResetSizeNoInitialize( size );
+	} else {
+		arr.ResetSize( size );
 	}
+	ReadArrayData( archive, arr.Ptr(), size );
 	return archive;
 }
 
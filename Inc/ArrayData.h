@@ -145,7 +145,7 @@ public:
 	bool IsSorted( const LessAction& less ) const
 		{ return data.IsSorted( less ); }
 
-	// Quick sorting algorithm. Uses a given comparison class to compare elements.
+	// Introspective sorting algorithm. Uses a given comparison class to compare elements.
 	template <class LessAction>
 	void QuickSort( const LessAction& less );
 
@@ -222,7 +222,7 @@ template <class T>
 template<class LessAction>
 void CArrayData<T>::QuickSort( const LessAction& less )
 {
-	Sort::QSort( data.getWritableBuffer(), Size(), less );
+	Sort::IntroSort( data.getWritableBuffer(), Size(), less );
 }
 
 template <class T>
@@ -0,0 +1,120 @@
+#pragma once
+#include <MessageLog.h>
+#include <Array.h>
+#include <PtrOwner.h>
+#include <Atomic.h>
+#include <CriticalSection.h>
+#include <ConditionVariable.h>
+#include <FileOwners.h>
+#include <Thread.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+	class CLogRingBuffer;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Action that is taken when the message buffer of a thread is full.
+enum TLogOverflowPolicy {
+	// Wait for the writer thread to free the buffer space.
+	LOP_Block,
+	// Discard the message.
+	LOP_Drop,
+	LOP_EnumCount
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Message log that writes messages on a background thread.
+// Every thread that adds messages gets its own ring buffer. Adding a message only copies its text to the buffer, no locks are taken and no system calls are made.
+// The writer thread collects messages from all the buffers, formats them in batches and writes them to the target that stays open.
+// Messages of a single thread are written in order. Messages of different threads are not ordered.
+// Files are written in UTF-16 like in CFileMessageLog, the standard output receives the original text.
+class REAPI CAsyncMessageLog : public IMessageLog {
+public:
+	static const int DefaultThreadBufferSize = 64 * 1024;
+	// Maximum time in milliseconds between a message addition and its writing.
+	static const int MaxWriteDelay = 50;
+
+	// Append messages to the given file. Messages are prefixed with the local time of their addition.
+	// Messages that fail to be written are counted as dropped, the log keeps working.
+	explicit CAsyncMessageLog( CStringPart fileName, TLogOverflowPolicy overflowPolicy = LOP_Block, int threadBufferSize = DefaultThreadBufferSize );
+	// Write messages to the standard output.
+	explicit CAsyncMessageLog( TLogOverflowPolicy overflowPolicy = LOP_Block, int threadBufferSize = DefaultThreadBufferSize );
+	// Write the original text of the messages to an open file, like to the standard output. The file must stay open while the log is used.
+	explicit CAsyncMessageLog( CFileWriteView file, TLogOverflowPolicy overflowPolicy = LOP_Block, int threadBufferSize = DefaultThreadBufferSize );
+	// Remaining messages are written before destruction.
+	~CAsyncMessageLog();
+
+	// Number of messages that were discarded because of the buffer overflow or the shutdown.
+	__int64 GetDroppedMessageCount() const
+		{ return droppedMessageCount.Load(); }
+	// Number of messages that had to wait for the buffer space.
+	__int64 GetBlockedMessageCount() const
+		{ return blockedMessageCount.Load(); }
+
+	// Wait until all the messages that were added by this thread before the call are written.
+	void Flush();
+	// Write the remaining messages and stop the writer thread.
+	// Messages added after the shutdown are dropped. Messages added concurrently with the shutdown may be lost.
+	void Shutdown();
+
+	virtual void AddMessage( CString text, TLogMessageType type ) override final;
+
+private:
+	// Identifier of the log that is used to find the buffer of the current thread.
+	int logId;
+	TLogOverflowPolicy overflowPolicy;
+	int threadBufferSize;
+	// Messages are prefixed with the time.
+	bool addTimestamps;
+	// Output is converted to UTF-16.
+	bool isUnicodeTarget;
+
+	CPtrOwner<CFileWriter> ownedFile;
+	CFileWriteView target;
+
+	// Section for the buffer list and the writer thread state.
+	CCriticalSection section;
+	// Buffers are shared with the threads that add messages. They are removed when the thread ends or the log is destroyed.
+	CArray<RelibInternal::CLogRingBuffer*> threadBuffers;
+	CConditionVariable writerWakeup;
+	CConditionVariable flushWakeup;
+	int flushRequestCount = 0;
+	int flushedCount = 0;
+	bool isWriterStopping = false;
+	CAtomic<bool> isShutDown{ false };
+
+	CAtomic<__int64> droppedMessageCount{ 0 };
+	CAtomic<__int64> blockedMessageCount{ 0 };
+
+	// Writer thread data.
+	CArray<RelibInternal::CLogRingBuffer*> writerBuffers;
+	// Buffers of the ended threads that were emptied during the last pass.
+	CArray<RelibInternal::CLogRingBuffer*> finishedBuffers;
+	CArray<char> writerOutput;
+	CArray<wchar_t> writerUnicodeOutput;
+	// Number of messages in the output.
+	int writerMessageCount = 0;
+	__int64 timestampSecond = -1;
+	CString timestampStr;
+	CThread writerThread;
+
+	void startWriter();
+	RelibInternal::CLogRingBuffer& getThreadBuffer();
+	RelibInternal::CLogRingBuffer& findThreadBuffer();
+	void wakeWriter();
+	int runWriter();
+	void writeMessages();
+	void removeFinishedBuffers();
+	void formatMessage( CStringPart text, __int64 time );
+	void updateTimestamp( __int64 time );
+	void appendOutput( CStringPart text );
+	void writeOutput();
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
@@ -20,7 +20,19 @@ public:
 		{ atomicValue.store( value ); }
 	// Exchange operation. Previous value is returned.
 	T Exchange( T value )
-		{ atomicValue.exchange( value ); }
+		{ return atomicValue.exchange( value ); }
+
+	// Operations with an explicit memory ordering.
+	T Load( std::memory_order order ) const
+		{ return atomicValue.load( order ); }
+	void Store( T value, std::memory_order order )
+		{ atomicValue.store( value, order ); }
+	T Exchange( T value, std::memory_order order )
+		{ return atomicValue.exchange( value, order ); }
+	T FetchAdd( T value, std::memory_order order = std::memory_order_seq_cst )
+		{ return atomicValue.fetch_add( value, order ); }
+	bool CompareExchangeStrong( T& expected, T desired, std::memory_order success, std::memory_order failure )
+		{ return atomicValue.compare_exchange_strong( expected, desired, success, failure ); }
 
 	// Atomic increment/decrement operations.
 	T PostIncrement()
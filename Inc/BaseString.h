@@ -29,9 +29,13 @@ struct COppositeChar<wchar_t> {
 // Base class for a string.
 // String owns the contained string data.
 // String is guaranteed to be null-terminated.
+// Short strings are stored inside the object without allocations. Moving a short string copies its symbols, so pointers to the string data don't survive the movement.
 template <class T>
 class CBaseString : public CStringData<T> {
 public:
+	// Maximum length of a string that is stored without allocations.
+	static const int InlineCapacity = 24 / sizeof( T ) - 1;
+
 	CBaseString() = default;
 
 	// Explicit copy operation.
@@ -158,14 +162,19 @@ public:
 	friend class CRawStringBuffer<T>;
 
 private:
+	// Size of the current buffer in bytes. Empty strings that have never been written to have no buffer.
 	int allocatedSize = 0;
-
-	CBaseString( CRawBuffer rawBuffer, const T* str, int strLength );
+	// Buffer for short strings.
+	T inlineBuffer[InlineCapacity + 1];
 
 	static int getRequiredSize( int strLength );
 	static void copyBuffer( const T* src, T* dest, int srcLength );
+	bool isInline() const
+		{ return Ptr() == inlineBuffer; }
+	CRawBuffer allocateBuffer( int bufferSize );
 	void createBuffer( const T* src, int srcLength, int bufferSize );
 	void freeBuffer();
+	void moveBuffer( CBaseString<T>& other );
 	void markBufferLength( int newLength );
 
 	// Copy construction is prohibited.
@@ -187,9 +196,9 @@ CBaseString<T>::CBaseString( const T* buffer ) :
 }
 
 template <class T>
-CBaseString<T>::CBaseString( const T* str, int strLength ) :
-	CBaseString( GetStringAllocator().AllocateSized( getRequiredSize( strLength ) ), str, strLength )
+CBaseString<T>::CBaseString( const T* str, int strLength )
 {
+	createBuffer( str, strLength, getRequiredSize( strLength ) );
 }
 
 template <class T>
@@ -198,14 +207,6 @@ int CBaseString<T>::getRequiredSize( int strLength )
 	return static_cast<int>( sizeof( T ) ) * ( strLength + 1 );
 }
 
-template <class T>
-CBaseString<T>::CBaseString( CRawBuffer rawBuffer, const T* str, int strLength ) :
-	CStringData<T>( static_cast<T*>( rawBuffer.Ptr() ), strLength ),
-	allocatedSize( rawBuffer.Size() )
-{
-	copyBuffer( str, this->getWritableBuffer(), strLength );
-}
-
 template <class T>
 void CBaseString<T>::copyBuffer( const T* src, T* dest, int srcLength )
 {
@@ -222,11 +223,20 @@ CBaseString<T>::~CBaseString()
 template <class T>
 void CBaseString<T>::freeBuffer()
 {
-	if( allocatedSize > 0 ) {
+	if( allocatedSize > 0 && !isInline() ) {
 		GetStringAllocator().Free( { this->getWritableBuffer(), allocatedSize } );
 	}
 }
 
+template <class T>
+CRawBuffer CBaseString<T>::allocateBuffer( int bufferSize )
+{
+	if( bufferSize <= static_cast<int>( sizeof( inlineBuffer ) ) ) {
+		return CRawBuffer( inlineBuffer, sizeof( inlineBuffer ) );
+	}
+	return GetStringAllocator().AllocateSized( bufferSize );
+}
+
 template <class T>
 CBaseString<T>::CBaseString( const CStringData<T>& other, const CExplicitCopyTag& ) :
 	CBaseString( other.begin(), other.Length() )
@@ -234,10 +244,22 @@ CBaseString<T>::CBaseString( const CStringData<T>& other, const CExplicitCopyTag
 }
 
 template <class T>
-CBaseString<T>::CBaseString( CBaseString<T>&& other ) :
-	CStringData<T>( other.Ptr(), other.Length() ),
-	allocatedSize( other.allocatedSize )
+CBaseString<T>::CBaseString( CBaseString<T>&& other )
 {
+	moveBuffer( other );
+}
+
+template <class T>
+void CBaseString<T>::moveBuffer( CBaseString<T>& other )
+{
+	if( other.isInline() ) {
+		const int length = other.Length();
+		copyBuffer( other.Ptr(), inlineBuffer, length );
+		CStringData<T>::operator=( { inlineBuffer, length } );
+	} else {
+		CStringData<T>::operator=( other );
+	}
+	allocatedSize = other.allocatedSize;
 	other.CStringData<T>::operator=( {} );
 	other.allocatedSize = 0;
 }
@@ -252,11 +274,7 @@ template <class T>
 CBaseString<T>& CBaseString<T>::operator=( CBaseString<T>&& other )
 {
 	freeBuffer();
-
-	CStringData<T>::operator=( other );
-	allocatedSize = other.allocatedSize;
-	other.CStringData<T>::operator=( {} );
-	other.allocatedSize = 0;
+	moveBuffer( other );
 	return *this;
 }
 
@@ -294,7 +312,8 @@ CBaseString<T>& CBaseString<T>::operator=( CBaseStringPart<T> part )
 template <class T>
 void CBaseString<T>::createBuffer( const T* src, int srcLength, int bufferSize )
 {
-	CRawBuffer newBuffer = GetStringAllocator().AllocateSized( bufferSize );
+	// A new buffer is created only when the current one is too small, so an inline buffer never overlaps the source.
+	CRawBuffer newBuffer = allocateBuffer( bufferSize );
 	T* bufferPtr = static_cast<T*>( newBuffer.Ptr() );
 	copyBuffer( src, bufferPtr, srcLength );
 	freeBuffer();
@@ -372,7 +391,7 @@ CBaseString<T>& CBaseString<T>::operator+=( CBaseStringPart<T> string )
 	const int newBufferSize = getRequiredSize( newLength );
 	if( allocatedSize < newBufferSize ) {
 		// Create a new buffer, copy the data into it and replace the old one.
-		CRawBuffer newBuffer = GetStringAllocator().AllocateSized( newBufferSize );
+		CRawBuffer newBuffer = allocateBuffer( newBufferSize );
 		T* bufferPtr = static_cast<T*>( newBuffer.Ptr() );
 		memcpy( bufferPtr, Ptr(), length * sizeof( T ) );
 		memcpy( bufferPtr + length, strBuffer, srcLength * sizeof( T ) );
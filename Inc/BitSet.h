@@ -344,7 +344,8 @@ namespace RelibInternal {
 	template <class BitSetStorage, class Elem>
 	CBaseBitSet<BitSetStorage, Elem>& CBaseBitSet<BitSetStorage, Elem>::operator|=( const CBaseBitSet<BitSetStorage, Elem>& set )
 	{
-		for( int i = 0; i < storage.StorageSize(); i++ ) {
+		// Dynamic storage grows to fit all the bits of the other set.
+		for( int i = 0; i < set.storage.StorageSize(); i++ ) {
 			storage[i] |= set.storage[i];
 		}
 		return *this;
@@ -757,12 +758,29 @@ template <class BitSetStorage, class Elem>
 CArchiveReader& operator>>( CArchiveReader& archive, RelibInternal::CBaseBitSet<BitSetStorage, Elem>& set )
 {
 	archive >> set.GetStorage();
+	return archive;
 }
 
 template <class BitSetStorage, class Elem>
 CArchiveWriter& operator<<( CArchiveWriter& archive, const RelibInternal::CBaseBitSet<BitSetStorage, Elem>& set )
 {
 	archive << set.GetStorage();
+	return archive;
+}
+
+// Stack storage words are serialized with a single copy.
+template <class ElemType, int bitSetSize>
+CArchiveReader& operator>>( CArchiveReader& archive, RelibInternal::CStackBitSetStorage<ElemType, bitSetSize>& set )
+{
+	archive >> set.GetStorage();
+	return archive;
+}
+
+template <class ElemType, int bitSetSize>
+CArchiveWriter& operator<<( CArchiveWriter& archive, const RelibInternal::CStackBitSetStorage<ElemType, bitSetSize>& set )
+{
+	archive << set.GetStorage();
+	return archive;
 }
 
 
@@ -0,0 +1,962 @@
+#pragma once
+#include <ConvexShapeCollisionDetector.h>
+#include <Array.h>
+#include <FlatMap.h>
+#include <InlineStackAllocator.h>
+#include <Pair.h>
+#include <Remath.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Spatial structure that is used by the collision world to find candidate pairs.
+enum TCollisionBroadphaseType {
+	// Dynamic bounding volume tree. Works with rects of any size.
+	CBT_AABBTree,
+	// Uniform grid with hashed cells. Works best when most of the rects are no larger than a cell.
+	CBT_SpatialHash,
+	CBT_EnumCount
+};
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Find the fraction of the segment start + delta * t, t in [0, 1], where it enters the rect.
+template <class Type>
+bool FindRayRectFraction( CVector2<Type> start, CVector2<Type> delta, const CAARect<Type>& rect, Type& fraction )
+{
+	Type minFraction = 0;
+	Type maxFraction = 1;
+	const Type lowerBounds[2] = { rect.Left(), rect.Bottom() };
+	const Type upperBounds[2] = { rect.Right(), rect.Top() };
+	for( int axis = 0; axis < 2; axis++ ) {
+		if( delta[axis] == 0 ) {
+			if( start[axis] < lowerBounds[axis] || start[axis] > upperBounds[axis] ) {
+				return false;
+			}
+			continue;
+		}
+		const Type invDelta = Type( 1 ) / delta[axis];
+		Type lowerFraction = ( lowerBounds[axis] - start[axis] ) * invDelta;
+		Type upperFraction = ( upperBounds[axis] - start[axis] ) * invDelta;
+		if( lowerFraction > upperFraction ) {
+			swap( lowerFraction, upperFraction );
+		}
+		minFraction = max( minFraction, lowerFraction );
+		maxFraction = min( maxFraction, upperFraction );
+		if( minFraction > maxFraction ) {
+			return false;
+		}
+	}
+	fraction = minFraction;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Dynamic bounding volume tree. Every leaf contains a rect with an associated proxy identifier.
+// Inner nodes contain the union of their children's rects. The tree is kept balanced with rotations.
+template <class Type>
+class CAABBTree {
+public:
+	typedef CAARect<Type> TAARect;
+	typedef CVector2<Type> TVector2;
+
+	// Add a new leaf and return its index.
+	int AddLeaf( const TAARect& rect, int proxyId );
+	void DeleteLeaf( int leafIndex );
+	void Empty();
+
+	// Call action( leftProxyId, rightProxyId ) once for every pair of intersecting leaves.
+	template <class Action>
+	void FindPairs( const Action& action ) const;
+	// Call action( proxyId ) for every leaf that intersects the rect.
+	template <class Action>
+	void FindIntersections( const TAARect& rect, const Action& action ) const;
+	// Call action( proxyId ) for every leaf that intersects the segment.
+	template <class Action>
+	void FindRayIntersections( TVector2 start, TVector2 end, const Action& action ) const;
+
+private:
+	struct CNode {
+		TAARect Rect;
+		// Next free node for nodes in the free list.
+		int Parent;
+		int Left;
+		int Right;
+		// Leaves have zero height, free nodes have NotFound.
+		int Height;
+		int ProxyId;
+	};
+
+	CArray<CNode> nodes;
+	int rootIndex = NotFound;
+	int freeIndex = NotFound;
+
+	bool isLeaf( int nodeIndex ) const
+		{ return nodes[nodeIndex].Height == 0; }
+	int allocateNode();
+	void freeNode( int nodeIndex );
+	void insertLeaf( int leafIndex );
+	void removeLeaf( int leafIndex );
+	void refitAncestors( int nodeIndex );
+	int balance( int nodeIndex );
+	void replaceChild( int parentIndex, int oldChild, int newChild );
+	template <class TestAction, class Action>
+	void findLeaves( const TestAction& testRect, const Action& action ) const;
+
+	static TAARect getUnion( const TAARect& left, const TAARect& right );
+	static Type getPerimeter( const TAARect& rect )
+		{ return rect.Width() + rect.Height(); }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Type>
+int CAABBTree<Type>::AddLeaf( const TAARect& rect, int proxyId )
+{
+	const int leafIndex = allocateNode();
+	CNode& leaf = nodes[leafIndex];
+	leaf.Rect = rect;
+	leaf.Left = NotFound;
+	leaf.Right = NotFound;
+	leaf.Height = 0;
+	leaf.ProxyId = proxyId;
+	insertLeaf( leafIndex );
+	return leafIndex;
+}
+
+template <class Type>
+void CAABBTree<Type>::DeleteLeaf( int leafIndex )
+{
+	assert( isLeaf( leafIndex ) );
+	removeLeaf( leafIndex );
+	freeNode( leafIndex );
+}
+
+template <class Type>
+void CAABBTree<Type>::Empty()
+{
+	nodes.Empty();
+	rootIndex = NotFound;
+	freeIndex = NotFound;
+}
+
+template <class Type>
+template <class Action>
+void CAABBTree<Type>::FindPairs( const Action& action ) const
+{
+	if( rootIndex == NotFound ) {
+		return;
+	}
+
+	// Traverse the tree against itself. A pair of equal nodes stands for the pairs inside the node's subtree.
+	CFlexibleArray<CPair<int, int>, 64> stack;
+	stack.Add( rootIndex, rootIndex );
+	while( !stack.IsEmpty() ) {
+		const auto nodePair = stack.Last();
+		stack.DeleteLast();
+		const CNode& left = nodes[nodePair.First];
+		if( nodePair.First == nodePair.Second ) {
+			if( left.Height > 0 ) {
+				stack.Add( left.Left, left.Left );
+				stack.Add( left.Right, left.Right );
+				stack.Add( left.Left, left.Right );
+			}
+			continue;
+		}
+
+		const CNode& right = nodes[nodePair.Second];
+		if( !left.Rect.Intersects( right.Rect ) ) {
+			continue;
+		}
+		if( left.Height == 0 && right.Height == 0 ) {
+			action( left.ProxyId, right.ProxyId );
+		} else if( right.Height == 0 || ( left.Height > 0 && getPerimeter( left.Rect ) > getPerimeter( right.Rect ) ) ) {
+			// Descend into the larger node.
+			stack.Add( left.Left, nodePair.Second );
+			stack.Add( left.Right, nodePair.Second );
+		} else {
+			stack.Add( nodePair.First, right.Left );
+			stack.Add( nodePair.First, right.Right );
+		}
+	}
+}
+
+template <class Type>
+template <class Action>
+void CAABBTree<Type>::FindIntersections( const TAARect& rect, const Action& action ) const
+{
+	findLeaves( [rect]( const TAARect& nodeRect ) { return nodeRect.Intersects( rect ); }, action );
+}
+
+template <class Type>
+template <class Action>
+void CAABBTree<Type>::FindRayIntersections( TVector2 start, TVector2 end, const Action& action ) const
+{
+	const TVector2 delta = end - start;
+	const auto segmentRect = getUnion( TAARect( start, start ), TAARect( end, end ) );
+	findLeaves( [start, delta, segmentRect]( const TAARect& nodeRect ) {
+		Type fraction;
+		return nodeRect.Intersects( segmentRect ) && FindRayRectFraction( start, delta, nodeRect, fraction );
+	}, action );
+}
+
+template <class Type>
+template <class TestAction, class Action>
+void CAABBTree<Type>::findLeaves( const TestAction& testRect, const Action& action ) const
+{
+	if( rootIndex == NotFound ) {
+		return;
+	}
+
+	CFlexibleArray<int, 64> stack;
+	stack.Add( rootIndex );
+	while( !stack.IsEmpty() ) {
+		const CNode& node = nodes[stack.Last()];
+		stack.DeleteLast();
+		if( !testRect( node.Rect ) ) {
+			continue;
+		}
+		if( node.Height == 0 ) {
+			action( node.ProxyId );
+		} else {
+			stack.Add( node.Left );
+			stack.Add( node.Right );
+		}
+	}
+}
+
+template <class Type>
+int CAABBTree<Type>::allocateNode()
+{
+	if( freeIndex == NotFound ) {
+		const int result = nodes.Size();
+		nodes.Add();
+		return result;
+	}
+
+	const int result = freeIndex;
+	freeIndex = nodes[result].Parent;
+	return result;
+}
+
+template <class Type>
+void CAABBTree<Type>::freeNode( int nodeIndex )
+{
+	nodes[nodeIndex].Parent = freeIndex;
+	nodes[nodeIndex].Height = NotFound;
+	freeIndex = nodeIndex;
+}
+
+template <class Type>
+void CAABBTree<Type>::insertLeaf( int leafIndex )
+{
+	if( rootIndex == NotFound ) {
+		rootIndex = leafIndex;
+		nodes[leafIndex].Parent = NotFound;
+		return;
+	}
+
+	// Descend to the sibling that minimizes the total perimeter of the inner nodes.
+	const TAARect leafRect = nodes[leafIndex].Rect;
+	int siblingIndex = rootIndex;
+	while( !isLeaf( siblingIndex ) ) {
+		const CNode& node = nodes[siblingIndex];
+		const Type perimeter = getPerimeter( node.Rect );
+		const Type combinedPerimeter = getPerimeter( getUnion( node.Rect, leafRect ) );
+		// Cost of creating a new parent for this node and the leaf.
+		const Type cost = 2 * combinedPerimeter;
+		// Minimum cost of pushing the leaf further down the tree.
+		const Type inheritanceCost = 2 * ( combinedPerimeter - perimeter );
+
+		const auto getDescentCost = [&]( int childIndex ) {
+			const CNode& child = nodes[childIndex];
+			const Type childPerimeter = getPerimeter( getUnion( child.Rect, leafRect ) );
+			return child.Height == 0 ? childPerimeter + inheritanceCost : childPerimeter - getPerimeter( child.Rect ) + inheritanceCost;
+		};
+		const Type leftCost = getDescentCost( node.Left );
+		const Type rightCost = getDescentCost( node.Right );
+		if( cost < leftCost && cost < rightCost ) {
+			break;
+		}
+		siblingIndex = leftCost < rightCost ? node.Left : node.Right;
+	}
+
+	const int oldParentIndex = nodes[siblingIndex].Parent;
+	const int newParentIndex = allocateNode();
+	CNode& newParent = nodes[newParentIndex];
+	newParent.Parent = oldParentIndex;
+	newParent.Rect = getUnion( leafRect, nodes[siblingIndex].Rect );
+	newParent.Left = siblingIndex;
+	newParent.Right = leafIndex;
+	newParent.Height = nodes[siblingIndex].Height + 1;
+	newParent.ProxyId = NotFound;
+	nodes[siblingIndex].Parent = newParentIndex;
+	nodes[leafIndex].Parent = newParentIndex;
+	if( oldParentIndex == NotFound ) {
+		rootIndex = newParentIndex;
+	} else {
+		replaceChild( oldParentIndex, siblingIndex, newParentIndex );
+	}
+
+	refitAncestors( nodes[leafIndex].Parent );
+}
+
+template <class Type>
+void CAABBTree<Type>::removeLeaf( int leafIndex )
+{
+	if( leafIndex == rootIndex ) {
+		rootIndex = NotFound;
+		return;
+	}
+
+	const int parentIndex = nodes[leafIndex].Parent;
+	const int grandParentIndex = nodes[parentIndex].Parent;
+	const int siblingIndex = nodes[parentIndex].Left == leafIndex ? nodes[parentIndex].Right : nodes[parentIndex].Left;
+	freeNode( parentIndex );
+	nodes[siblingIndex].Parent = grandParentIndex;
+	if( grandParentIndex == NotFound ) {
+		rootIndex = siblingIndex;
+	} else {
+		replaceChild( grandParentIndex, parentIndex, siblingIndex );
+		refitAncestors( grandParentIndex );
+	}
+}
+
+template <class Type>
+void CAABBTree<Type>::refitAncestors( int nodeIndex )
+{
+	while( nodeIndex != NotFound ) {
+		nodeIndex = balance( nodeIndex );
+		CNode& node = nodes[nodeIndex];
+		const CNode& left = nodes[node.Left];
+		const CNode& right = nodes[node.Right];
+		node.Height = 1 + max( left.Height, right.Height );
+		node.Rect = getUnion( left.Rect, right.Rect );
+		nodeIndex = node.Parent;
+	}
+}
+
+template <class Type>
+int CAABBTree<Type>::balance( int aIndex )
+{
+	// Rotate the higher child of A up if the heights of A's children differ by more than one.
+	// Return the index of the node that replaced A.
+	CNode& a = nodes[aIndex];
+	if( a.Height < 2 ) {
+		return aIndex;
+	}
+
+	const int bIndex = a.Left;
+	const int cIndex = a.Right;
+	CNode& b = nodes[bIndex];
+	CNode& c = nodes[cIndex];
+	const int heightDifference = c.Height - b.Height;
+
+	if( heightDifference > 1 ) {
+		// Rotate C up.
+		const int fIndex = c.Left;
+		const int gIndex = c.Right;
+		CNode& f = nodes[fIndex];
+		CNode& g = nodes[gIndex];
+		c.Left = aIndex;
+		c.Parent = a.Parent;
+		a.Parent = cIndex;
+		if( c.Parent == NotFound ) {
+			rootIndex = cIndex;
+		} else {
+			replaceChild( c.Parent, aIndex, cIndex );
+		}
+
+		// The higher grandchild stays with C.
+		const int lowIndex = f.Height > g.Height ? gIndex : fIndex;
+		const int highIndex = f.Height > g.Height ? fIndex : gIndex;
+		c.Right = highIndex;
+		a.Right = lowIndex;
+		nodes[lowIndex].Parent = aIndex;
+		a.Rect = getUnion( b.Rect, nodes[lowIndex].Rect );
+		c.Rect = getUnion( a.Rect, nodes[highIndex].Rect );
+		a.Height = 1 + max( b.Height, nodes[lowIndex].Height );
+		c.Height = 1 + max( a.Height, nodes[highIndex].Height );
+		return cIndex;
+	}
+
+	if( heightDifference < -1 ) {
+		// Rotate B up.
+		const int dIndex = b.Left;
+		const int eIndex = b.Right;
+		CNode& d = nodes[dIndex];
+		CNode& e = nodes[eIndex];
+		b.Left = aIndex;
+		b.Parent = a.Parent;
+		a.Parent = bIndex;
+		if( b.Parent == NotFound ) {
+			rootIndex = bIndex;
+		} else {
+			replaceChild( b.Parent, aIndex, bIndex );
+		}
+
+		const int lowIndex = d.Height > e.Height ? eIndex : dIndex;
+		const int highIndex = d.Height > e.Height ? dIndex : eIndex;
+		b.Right = highIndex;
+		a.Left = lowIndex;
+		nodes[lowIndex].Parent = aIndex;
+		a.Rect = getUnion( c.Rect, nodes[lowIndex].Rect );
+		b.Rect = getUnion( a.Rect, nodes[highIndex].Rect );
+		a.Height = 1 + max( c.Height, nodes[lowIndex].Height );
+		b.Height = 1 + max( a.Height, nodes[highIndex].Height );
+		return bIndex;
+	}
+
+	return aIndex;
+}
+
+template <class Type>
+void CAABBTree<Type>::replaceChild( int parentIndex, int oldChild, int newChild )
+{
+	CNode& parent = nodes[parentIndex];
+	if( parent.Left == oldChild ) {
+		parent.Left = newChild;
+	} else {
+		assert( parent.Right == oldChild );
+		parent.Right = newChild;
+	}
+}
+
+template <class Type>
+CAARect<Type> CAABBTree<Type>::getUnion( const TAARect& left, const TAARect& right )
+{
+	return TAARect( min( left.Left(), right.Left() ), max( left.Top(), right.Top() ), max( left.Right(), right.Right() ), min( left.Bottom(), right.Bottom() ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Uniform grid with the given cell size. Only the non-empty cells are stored in a hash table.
+// Every rect is added to all the cells that it touches.
+template <class Type>
+class CSpatialHashGrid {
+public:
+	typedef CAARect<Type> TAARect;
+	typedef CVector2<Type> TVector2;
+
+	explicit CSpatialHashGrid( Type _cellSize ) : cellSize( _cellSize ) {}
+
+	// Rects are identified by the proxy identifier. The rect that was used on addition must be passed on deletion.
+	void AddRect( const TAARect& rect, int proxyId );
+	void DeleteRect( const TAARect& rect, int proxyId );
+	void Empty()
+		{ cells.FreeBuffer(); }
+
+	// Call action( leftProxyId, rightProxyId ) once for every pair of intersecting rects.
+	template <class Action>
+	void FindPairs( const Action& action ) const;
+	// Call action( proxyId ) once for every rect that intersects the given one.
+	template <class Action>
+	void FindIntersections( const TAARect& rect, const Action& action ) const;
+	// Call action( proxyId ) for every rect in the cells that the segment passes. A rect may be reported multiple times.
+	template <class Action>
+	void FindRayCandidates( TVector2 start, TVector2 end, const Action& action ) const;
+
+private:
+	struct CEntry {
+		TAARect Rect;
+		int ProxyId;
+	};
+
+	Type cellSize;
+	CFlatMap<CVector2<int>, CArray<CEntry>> cells;
+
+	CVector2<int> getCell( TVector2 point ) const
+		{ return CVector2<int>( Floor( point.X() / cellSize ), Floor( point.Y() / cellSize ) ); }
+	CAARect<int> getCellRect( const TAARect& rect ) const;
+	// Two intersecting rects are present together in several cells. Only the cell with the bottom left corner of their intersection reports them.
+	CVector2<int> getPairCell( const TAARect& left, const TAARect& right ) const
+		{ return getCell( TVector2( max( left.Left(), right.Left() ), max( left.Bottom(), right.Bottom() ) ) ); }
+	template <class Action>
+	void findCellIntersections( CVector2<int> cell, const CArray<CEntry>& entries, const TAARect& rect, const Action& action ) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Type>
+void CSpatialHashGrid<Type>::AddRect( const TAARect& rect, int proxyId )
+{
+	const auto cellRect = getCellRect( rect );
+	for( int y = cellRect.Bottom(); y <= cellRect.Top(); y++ ) {
+		for( int x = cellRect.Left(); x <= cellRect.Right(); x++ ) {
+			cells.GetOrCreate( CVector2<int>( x, y ) ).Value().Add( CEntry{ rect, proxyId } );
+		}
+	}
+}
+
+template <class Type>
+void CSpatialHashGrid<Type>::DeleteRect( const TAARect& rect, int proxyId )
+{
+	const auto cellRect = getCellRect( rect );
+	for( int y = cellRect.Bottom(); y <= cellRect.Top(); y++ ) {
+		for( int x = cellRect.Left(); x <= cellRect.Right(); x++ ) {
+			const CVector2<int> cell( x, y );
+			auto& entries = cells[cell];
+			for( int i = 0; i < entries.Size(); i++ ) {
+				if( entries[i].ProxyId == proxyId ) {
+					entries[i] = entries.Last();
+					entries.DeleteLast();
+					break;
+				}
+			}
+			if( entries.IsEmpty() ) {
+				cells.Delete( cell );
+			}
+		}
+	}
+}
+
+template <class Type>
+template <class Action>
+void CSpatialHashGrid<Type>::FindPairs( const Action& action ) const
+{
+	for( const auto& cell : cells ) {
+		const auto& entries = cell.Value();
+		const int entryCount = entries.Size();
+		for( int i = 0; i < entryCount; i++ ) {
+			const CEntry& left = entries[i];
+			for( int j = i + 1; j < entryCount; j++ ) {
+				const CEntry& right = entries[j];
+				if( left.Rect.Intersects( right.Rect ) && getPairCell( left.Rect, right.Rect ) == cell.Key() ) {
+					action( left.ProxyId, right.ProxyId );
+				}
+			}
+		}
+	}
+}
+
+template <class Type>
+template <class Action>
+void CSpatialHashGrid<Type>::FindIntersections( const TAARect& rect, const Action& action ) const
+{
+	const auto cellRect = getCellRect( rect );
+	const __int64 cellCount = ( static_cast<__int64>( cellRect.Width() ) + 1 ) * ( static_cast<__int64>( cellRect.Height() ) + 1 );
+	if( cellCount > cells.Size() ) {
+		// Large regions are faster to check by going through all the stored cells.
+		for( const auto& cell : cells ) {
+			if( cellRect.Has( cell.Key() ) ) {
+				findCellIntersections( cell.Key(), cell.Value(), rect, action );
+			}
+		}
+		return;
+	}
+
+	for( int y = cellRect.Bottom(); y <= cellRect.Top(); y++ ) {
+		for( int x = cellRect.Left(); x <= cellRect.Right(); x++ ) {
+			const CVector2<int> cell( x, y );
+			const auto entries = cells.Get( cell );
+			if( entries != nullptr ) {
+				findCellIntersections( cell, *entries, rect, action );
+			}
+		}
+	}
+}
+
+template <class Type>
+template <class Action>
+void CSpatialHashGrid<Type>::findCellIntersections( CVector2<int> cell, const CArray<CEntry>& entries, const TAARect& rect, const Action& action ) const
+{
+	for( const CEntry& entry : entries ) {
+		if( entry.Rect.Intersects( rect ) && getPairCell( entry.Rect, rect ) == cell ) {
+			action( entry.ProxyId );
+		}
+	}
+}
+
+template <class Type>
+template <class Action>
+void CSpatialHashGrid<Type>::FindRayCandidates( TVector2 start, TVector2 end, const Action& action ) const
+{
+	// Walk through the grid cells along the segment.
+	const TVector2 delta = end - start;
+	CVector2<int> cell = getCell( start );
+	const CVector2<int> endCell = getCell( end );
+	CVector2<int> step;
+	TVector2 nextFraction;
+	TVector2 fractionStep;
+	for( int axis = 0; axis < 2; axis++ ) {
+		step[axis] = delta[axis] > 0 ? 1 : -1;
+		if( delta[axis] != 0 ) {
+			const Type nextBound = ( cell[axis] + ( delta[axis] > 0 ? 1 : 0 ) ) * cellSize;
+			nextFraction[axis] = ( nextBound - start[axis] ) / delta[axis];
+			fractionStep[axis] = cellSize / abs( delta[axis] );
+		}
+	}
+
+	for( ;; ) {
+		const auto entries = cells.Get( cell );
+		if( entries != nullptr ) {
+			for( const CEntry& entry : *entries ) {
+				action( entry.ProxyId );
+			}
+		}
+		if( cell == endCell ) {
+			break;
+		}
+		// Never step past the end cell on any axis. This guarantees termination regardless of the rounding errors.
+		const int axis = cell.X() == endCell.X() ? 1 : cell.Y() == endCell.Y() ? 0 : nextFraction.X() < nextFraction.Y() ? 0 : 1;
+		cell[axis] += step[axis];
+		nextFraction[axis] += fractionStep[axis];
+	}
+}
+
+template <class Type>
+CAARect<int> CSpatialHashGrid<Type>::getCellRect( const TAARect& rect ) const
+{
+	const auto bottomLeft = getCell( rect.BottomLeft() );
+	const auto topRight = getCell( rect.TopRight() );
+	return CAARect<int>( bottomLeft, topRight );
+}
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Collection of hitboxes that finds the colliding ones without checking every pair.
+// Hitboxes are added with their bound rects. A broadphase structure finds the pairs with intersecting bound rects,
+// the candidates are then checked with the convex shape detector.
+// Hitbox data is referenced, not copied. It must stay valid while the hitbox is in the world.
+// The world must not be modified from the query actions.
+template <class FloatingPointType>
+class CCollisionWorld {
+public:
+	typedef FloatingPointType Type;
+
+	typedef CHitbox<Type> THitbox;
+	typedef CVector2<Type> TVector2;
+	typedef CAARect<Type> TAARect;
+
+	// Bound rects are stored expanded by the boundMargin in the broadphase structure.
+	// Hitboxes that move within the expanded rect don't need a broadphase update.
+	// The cell size is only used by the spatial hash.
+	CCollisionWorld( TCollisionBroadphaseType broadphaseType, Type boundMargin, Type cellSize = 0 );
+
+	TCollisionBroadphaseType GetBroadphaseType() const
+		{ return broadphaseType; }
+	int HitboxCount() const
+		{ return proxies.Size() - freeProxyIds.Size(); }
+
+	const THitbox& GetHitbox( int hitboxId ) const
+		{ return getProxy( hitboxId ).Hitbox; }
+	TAARect GetBoundRect( int hitboxId ) const
+		{ return getProxy( hitboxId ).BoundRect; }
+
+	// Add a hitbox and return its identifier. Identifiers of deleted hitboxes are reused.
+	int AddHitbox( const THitbox& hitbox, const TAARect& boundRect );
+	// Change the hitbox and its bound rect.
+	void MoveHitbox( int hitboxId, const THitbox& hitbox, const TAARect& boundRect );
+	void DeleteHitbox( int hitboxId );
+	void Empty();
+
+	// Call action( leftId, rightId ) once for every pair of colliding hitboxes.
+	template <class Action>
+	void FindCollisions( const Action& action ) const;
+	// Call action( hitboxId ) for every hitbox in the world that collides with the given one.
+	template <class Action>
+	void FindCollisions( const THitbox& hitbox, const TAARect& boundRect, const Action& action ) const;
+	// Call action( hitboxId ) for every hitbox that intersects the rect.
+	template <class Action>
+	void FindRectCollisions( const TAARect& rect, const Action& action ) const;
+	// Call action( hitboxId ) for every hitbox that contains the point.
+	template <class Action>
+	void FindPointCollisions( TVector2 point, const Action& action ) const;
+	// Call action( hitboxId, fraction ) for every bound rect that the segment from start to end intersects.
+	// The fraction of the segment before the intersection is passed. Hits are reported in the order of increasing fraction.
+	// The detector has no segment shape, so hitboxes themselves are not checked.
+	template <class Action>
+	void FindRayIntersections( TVector2 start, TVector2 end, const Action& action ) const;
+
+private:
+	struct CProxy {
+		THitbox Hitbox;
+		TAARect BoundRect;
+		// Rect that is stored in the broadphase.
+		TAARect FatRect;
+		// Tree leaf for the tree broadphase.
+		int LeafIndex;
+		bool IsFree;
+	};
+
+	// Expanded rects are additionally stretched by the displacement times this value in the direction of the movement.
+	static const int displacementMultiplier = 2;
+
+	TCollisionBroadphaseType broadphaseType;
+	Type boundMargin;
+	CArray<CProxy> proxies;
+	CArray<int> freeProxyIds;
+	RelibInternal::CAABBTree<Type> tree;
+	RelibInternal::CSpatialHashGrid<Type> grid;
+	CConvexShapeCollisionDetector<Type> detector;
+
+	const CProxy& getProxy( int hitboxId ) const;
+	TAARect getFatRect( const TAARect& boundRect, TVector2 displacement ) const;
+	void addToBroadphase( int hitboxId );
+	void deleteFromBroadphase( int hitboxId );
+	template <class Action>
+	void findCandidates( const TAARect& rect, const Action& action ) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class FloatingPointType>
+CCollisionWorld<FloatingPointType>::CCollisionWorld( TCollisionBroadphaseType _broadphaseType, Type _boundMargin, Type cellSize ) :
+	broadphaseType( _broadphaseType ),
+	boundMargin( _boundMargin ),
+	grid( cellSize )
+{
+	assert( broadphaseType >= 0 && broadphaseType < CBT_EnumCount );
+	assert( boundMargin >= 0 );
+	assert( broadphaseType != CBT_SpatialHash || cellSize > 0 );
+}
+
+template <class FloatingPointType>
+int CCollisionWorld<FloatingPointType>::AddHitbox( const THitbox& hitbox, const TAARect& boundRect )
+{
+	assert( boundRect.Width() >= 0 && boundRect.Height() >= 0 );
+	const CProxy newProxy{ hitbox, boundRect, getFatRect( boundRect, TVector2() ), NotFound, false };
+	int hitboxId;
+	if( freeProxyIds.IsEmpty() ) {
+		hitboxId = proxies.Size();
+		proxies.Add( newProxy );
+	} else {
+		hitboxId = freeProxyIds.Last();
+		freeProxyIds.DeleteLast();
+		proxies[hitboxId] = newProxy;
+	}
+	addToBroadphase( hitboxId );
+	return hitboxId;
+}
+
+template <class FloatingPointType>
+void CCollisionWorld<FloatingPointType>::MoveHitbox( int hitboxId, const THitbox& hitbox, const TAARect& boundRect )
+{
+	assert( boundRect.Width() >= 0 && boundRect.Height() >= 0 );
+	assert( !getProxy( hitboxId ).IsFree );
+	CProxy& proxy = proxies[hitboxId];
+	proxy.Hitbox = hitbox;
+	const TVector2 displacement = boundRect.CenterPoint() - proxy.BoundRect.CenterPoint();
+	proxy.BoundRect = boundRect;
+	if( proxy.FatRect.Has( boundRect ) ) {
+		return;
+	}
+
+	deleteFromBroadphase( hitboxId );
+	proxy.FatRect = getFatRect( boundRect, displacement );
+	addToBroadphase( hitboxId );
+}
+
+template <class FloatingPointType>
+void CCollisionWorld<FloatingPointType>::DeleteHitbox( int hitboxId )
+{
+	assert( !getProxy( hitboxId ).IsFree );
+	deleteFromBroadphase( hitboxId );
+	proxies[hitboxId].IsFree = true;
+	freeProxyIds.Add( hitboxId );
+}
+
+template <class FloatingPointType>
+void CCollisionWorld<FloatingPointType>::Empty()
+{
+	proxies.Empty();
+	freeProxyIds.Empty();
+	tree.Empty();
+	grid.Empty();
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::FindCollisions( const Action& action ) const
+{
+	// Candidates are gathered first and checked by the detector in a single batch.
+	CArray<CPair<int>> candidateIds;
+	CArray<CPair<const THitbox*>> candidates;
+	const auto addCandidate = [&]( int leftId, int rightId ) {
+		const CProxy& left = proxies[leftId];
+		const CProxy& right = proxies[rightId];
+		if( left.BoundRect.Intersects( right.BoundRect ) ) {
+			candidateIds.Add( leftId, rightId );
+			candidates.Add( &left.Hitbox, &right.Hitbox );
+		}
+	};
+
+	staticAssert( CBT_EnumCount == 2 );
+	switch( broadphaseType ) {
+		case CBT_AABBTree:
+			tree.FindPairs( addCandidate );
+			break;
+		case CBT_SpatialHash:
+			grid.FindPairs( addCandidate );
+			break;
+		default:
+			assert( false );
+	}
+
+	CDynamicBitSet<> collisions;
+	detector.DetectCollisions( candidates, collisions );
+	for( int i = 0; i < candidateIds.Size(); i++ ) {
+		if( collisions.Has( i ) ) {
+			action( candidateIds[i].First, candidateIds[i].Second );
+		}
+	}
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::FindCollisions( const THitbox& hitbox, const TAARect& boundRect, const Action& action ) const
+{
+	findCandidates( boundRect, [&]( int hitboxId ) {
+		const CProxy& proxy = proxies[hitboxId];
+		if( proxy.BoundRect.Intersects( boundRect ) && detector.DetectCollision( hitbox, proxy.Hitbox ) ) {
+			action( hitboxId );
+		}
+	} );
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::FindRectCollisions( const TAARect& rect, const Action& action ) const
+{
+	TAARect rectData = rect;
+	const THitbox rectHitbox( CRawBuffer( &rectData, sizeof( rectData ) ), HST_AARect );
+	FindCollisions( rectHitbox, rect, action );
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::FindPointCollisions( TVector2 point, const Action& action ) const
+{
+	const THitbox pointHitbox( CRawBuffer( &point, sizeof( point ) ), HST_Point );
+	FindCollisions( pointHitbox, TAARect( point, point ), action );
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::FindRayIntersections( TVector2 start, TVector2 end, const Action& action ) const
+{
+	const TVector2 delta = end - start;
+	CFlexibleArray<CPair<Type, int>, 32> hits;
+	const auto addHit = [&]( int hitboxId ) {
+		Type fraction;
+		if( RelibInternal::FindRayRectFraction( start, delta, proxies[hitboxId].BoundRect, fraction ) ) {
+			hits.Add( fraction, hitboxId );
+		}
+	};
+
+	staticAssert( CBT_EnumCount == 2 );
+	switch( broadphaseType ) {
+		case CBT_AABBTree:
+			tree.FindRayIntersections( start, end, addHit );
+			break;
+		case CBT_SpatialHash: {
+			// Grid cells may report the same hitbox several times.
+			CFlexibleArray<int, 32> candidates;
+			grid.FindRayCandidates( start, end, [&candidates]( int hitboxId ) { candidates.Add( hitboxId ); } );
+			candidates.QuickSort( []( int left, int right ) { return left < right; } );
+			for( int i = 0; i < candidates.Size(); i++ ) {
+				if( i == 0 || candidates[i] != candidates[i - 1] ) {
+					addHit( candidates[i] );
+				}
+			}
+			break;
+		}
+		default:
+			assert( false );
+	}
+
+	hits.QuickSort( []( const CPair<Type, int>& left, const CPair<Type, int>& right ) { return left.First < right.First; } );
+	for( const auto& hit : hits ) {
+		action( hit.Second, hit.First );
+	}
+}
+
+template <class FloatingPointType>
+const typename CCollisionWorld<FloatingPointType>::CProxy& CCollisionWorld<FloatingPointType>::getProxy( int hitboxId ) const
+{
+	const CProxy& proxy = proxies[hitboxId];
+	assert( !proxy.IsFree );
+	return proxy;
+}
+
+template <class FloatingPointType>
+CAARect<FloatingPointType> CCollisionWorld<FloatingPointType>::getFatRect( const TAARect& boundRect, TVector2 displacement ) const
+{
+	TAARect result( boundRect.Left() - boundMargin, boundRect.Top() + boundMargin, boundRect.Right() + boundMargin, boundRect.Bottom() - boundMargin );
+	const Type offsetX = displacement.X() * displacementMultiplier;
+	const Type offsetY = displacement.Y() * displacementMultiplier;
+	if( offsetX < 0 ) {
+		result.Left() += offsetX;
+	} else {
+		result.Right() += offsetX;
+	}
+	if( offsetY < 0 ) {
+		result.Bottom() += offsetY;
+	} else {
+		result.Top() += offsetY;
+	}
+	return result;
+}
+
+template <class FloatingPointType>
+void CCollisionWorld<FloatingPointType>::addToBroadphase( int hitboxId )
+{
+	CProxy& proxy = proxies[hitboxId];
+	staticAssert( CBT_EnumCount == 2 );
+	switch( broadphaseType ) {
+		case CBT_AABBTree:
+			proxy.LeafIndex = tree.AddLeaf( proxy.FatRect, hitboxId );
+			break;
+		case CBT_SpatialHash:
+			grid.AddRect( proxy.FatRect, hitboxId );
+			break;
+		default:
+			assert( false );
+	}
+}
+
+template <class FloatingPointType>
+void CCollisionWorld<FloatingPointType>::deleteFromBroadphase( int hitboxId )
+{
+	CProxy& proxy = proxies[hitboxId];
+	staticAssert( CBT_EnumCount == 2 );
+	switch( broadphaseType ) {
+		case CBT_AABBTree:
+			tree.DeleteLeaf( proxy.LeafIndex );
+			proxy.LeafIndex = NotFound;
+			break;
+		case CBT_SpatialHash:
+			grid.DeleteRect( proxy.FatRect, hitboxId );
+			break;
+		default:
+			assert( false );
+	}
+}
+
+template <class FloatingPointType>
+template <class Action>
+void CCollisionWorld<FloatingPointType>::findCandidates( const TAARect& rect, const Action& action ) const
+{
+	staticAssert( CBT_EnumCount == 2 );
+	switch( broadphaseType ) {
+		case CBT_AABBTree:
+			tree.FindIntersections( rect, action );
+			break;
+		case CBT_SpatialHash:
+			grid.FindIntersections( rect, action );
+			break;
+		default:
+			assert( false );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
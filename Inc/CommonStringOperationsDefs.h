@@ -46,6 +46,29 @@ template <class T>
 struct CStrConversionFunctions;
 //////////////////////////////////////////////////////////////////////////
 
+// Set of symbols for the symbol set search.
+// Symbols with codes below 256 are looked up in a bit table, other symbols are searched in the original set.
+template <class T>
+class CSymbolLookupTable {
+public:
+	explicit CSymbolLookupTable( CStringData<T> symbols );
+
+	bool Has( T symbol ) const;
+
+private:
+	static const int tableSize = 256;
+	static const int bitsPerWord = 32;
+
+	DWORD lowSymbolBits[tableSize / bitsPerWord]{};
+	CStringData<T> highSymbols;
+	bool hasHighSymbols = false;
+
+	static unsigned getCode( T symbol )
+		{ return static_cast<typename std::make_unsigned<T>::type>( symbol ); }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 // Operations that can be uniformly described for all string types.
 template <class T>
 class CCommonStringOperations {
@@ -133,14 +133,45 @@ int CCommonStringOperations<T>::ReverseFind( CStringData<T> data, T symbol, int
 	return NotFound;
 }
 
+template <class T>
+CSymbolLookupTable<T>::CSymbolLookupTable( CStringData<T> symbols ) :
+	highSymbols( symbols )
+{
+	for( auto symbol : symbols ) {
+		const auto code = getCode( symbol );
+		if( code < tableSize ) {
+			lowSymbolBits[code / bitsPerWord] |= 1U << ( code % bitsPerWord );
+		} else {
+			hasHighSymbols = true;
+		}
+	}
+}
+
+template <class T>
+bool CSymbolLookupTable<T>::Has( T symbol ) const
+{
+	const auto code = getCode( symbol );
+	if( code < tableSize ) {
+		return ( lowSymbolBits[code / bitsPerWord] & ( 1U << ( code % bitsPerWord ) ) ) != 0;
+	}
+	return hasHighSymbols && CCommonStringOperations<T>::Find( highSymbols, symbol, 0 ) != NotFound;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 template <class T>
 int CCommonStringOperations<T>::FindOneOf( CStringData<T> data, CStringData<T> charSet, int from )
 {
+	if( charSet.Length() == 1 ) {
+		return CStringOperations<T>::Find( data, charSet.First(), from );
+	}
+
 	const int length = data.Length();
 	const auto dataPtr = data.begin();
 	assert( from >= 0 && from <= length );
+	const CSymbolLookupTable<T> symbolTable( charSet );
 	for( int i = from; i < length; i++ ) {
-		if( CCommonStringOperations<T>::Find( charSet, dataPtr[i], 0 ) != NotFound ) {
+		if( symbolTable.Has( dataPtr[i] ) ) {
 			return i;
 		}
 	}
@@ -152,8 +183,9 @@ int CCommonStringOperations<T>::ReverseFindOneOf( CStringData<T> data, CStringDa
 {
 	assert( from >= 0 && from <= data.Length() );
 	const auto dataPtr = data.begin();
+	const CSymbolLookupTable<T> symbolTable( charSet );
 	for( int i = from - 1; i >= 0; i-- ) {
-		if( CCommonStringOperations<T>::Find( charSet, dataPtr[i], 0 ) != NotFound ) {
+		if( symbolTable.Has( dataPtr[i] ) ) {
 			return i;
 		}
 	}
@@ -36,6 +36,9 @@ public:
 	TMoveAssignComponentData GetMoveAssignFunction() const
 		{ return moveAssignPtr; }
 
+	// Move a single component value to a constructed destination.
+	void MoveAssignValue( void* src, void* dest ) const;
+
 private:
 	TConstructComponentData constructPtr;
 	TDestroyComponentData destroyPtr;
@@ -58,6 +61,15 @@ inline int CBaseComponent::createUniqueId() const
 	return RelibInternal::CurrentComponentId.PostIncrement();
 }
 
+inline void CBaseComponent::MoveAssignValue( void* src, void* dest ) const
+{
+	if( moveAssignPtr == nullptr ) {
+		::memcpy( dest, src, size );
+	} else {
+		moveAssignPtr( src, dest );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 template <class T>
@@ -4,9 +4,78 @@
 #include <StackArray.h>
 #include <BitSet.h>
 #include <AngledRectShape.h>
+#include <Pair.h>
 
 namespace Relib {
 
+namespace RelibInternal {
+
+// Vector registers with several floating point values. Used by the batched collision detection.
+template <class Type>
+struct CCollisionLanes;
+
+template <>
+struct CCollisionLanes<float> {
+	typedef __m128 TRegister;
+	static const int Size = 4;
+
+	static TRegister Load( const float* values )
+		{ return _mm_loadu_ps( values ); }
+	static TRegister Add( TRegister left, TRegister right )
+		{ return _mm_add_ps( left, right ); }
+	static TRegister Sub( TRegister left, TRegister right )
+		{ return _mm_sub_ps( left, right ); }
+	static TRegister Mul( TRegister left, TRegister right )
+		{ return _mm_mul_ps( left, right ); }
+	static TRegister Less( TRegister left, TRegister right )
+		{ return _mm_cmplt_ps( left, right ); }
+	static TRegister LessOrEqual( TRegister left, TRegister right )
+		{ return _mm_cmple_ps( left, right ); }
+	static TRegister Greater( TRegister left, TRegister right )
+		{ return _mm_cmpgt_ps( left, right ); }
+	static TRegister GreaterOrEqual( TRegister left, TRegister right )
+		{ return _mm_cmpge_ps( left, right ); }
+	static TRegister Or( TRegister left, TRegister right )
+		{ return _mm_or_ps( left, right ); }
+	static TRegister Select( TRegister mask, TRegister ifTrue, TRegister ifFalse )
+		{ return _mm_or_ps( _mm_and_ps( mask, ifTrue ), _mm_andnot_ps( mask, ifFalse ) ); }
+	static int GetMask( TRegister mask )
+		{ return _mm_movemask_ps( mask ); }
+};
+
+template <>
+struct CCollisionLanes<double> {
+	typedef __m128d TRegister;
+	static const int Size = 2;
+
+	static TRegister Load( const double* values )
+		{ return _mm_loadu_pd( values ); }
+	static TRegister Add( TRegister left, TRegister right )
+		{ return _mm_add_pd( left, right ); }
+	static TRegister Sub( TRegister left, TRegister right )
+		{ return _mm_sub_pd( left, right ); }
+	static TRegister Mul( TRegister left, TRegister right )
+		{ return _mm_mul_pd( left, right ); }
+	static TRegister Less( TRegister left, TRegister right )
+		{ return _mm_cmplt_pd( left, right ); }
+	static TRegister LessOrEqual( TRegister left, TRegister right )
+		{ return _mm_cmple_pd( left, right ); }
+	static TRegister Greater( TRegister left, TRegister right )
+		{ return _mm_cmpgt_pd( left, right ); }
+	static TRegister GreaterOrEqual( TRegister left, TRegister right )
+		{ return _mm_cmpge_pd( left, right ); }
+	static TRegister Or( TRegister left, TRegister right )
+		{ return _mm_or_pd( left, right ); }
+	static TRegister Select( TRegister mask, TRegister ifTrue, TRegister ifFalse )
+		{ return _mm_or_pd( _mm_and_pd( mask, ifTrue ), _mm_andnot_pd( mask, ifFalse ) ); }
+	static int GetMask( TRegister mask )
+		{ return _mm_movemask_pd( mask ); }
+};
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
 // Detector for collisions between a pair of convex shapes.
 // Convex shapes are checked using the separating axis theorem.
 template<class FloatingPointType>
@@ -22,8 +91,33 @@ public:
 
 	// Check if two shapes intersect.
 	bool DetectCollision( const THitbox& left, const THitbox& right ) const;
+	// Check a batch of shape pairs. Bit i of the result is set if the shapes of the i-th pair intersect.
+	// Circles and axis aligned rects are checked several pairs at a time, other shapes are checked one by one.
+	void DetectCollisions( CArrayView<CPair<const THitbox*>> pairs, CDynamicBitSet<>& result ) const;
 
 private:
+	typedef RelibInternal::CCollisionLanes<Type> TLanes;
+	typedef typename TLanes::TRegister TRegister;
+	typedef CStackArray<Type, TLanes::Size> TLaneValues;
+
+	// Pairs of the same shape combination that are checked together. Shape data is stored by lanes.
+	struct CPairBlock {
+		CStackArray<int, TLanes::Size> PairIndices;
+		int Size = 0;
+	};
+	struct CCircleCircleBlock : public CPairBlock {
+		TLaneValues LeftX, LeftY, LeftRadius;
+		TLaneValues RightX, RightY, RightRadius;
+	};
+	struct CRectRectBlock : public CPairBlock {
+		TLaneValues LeftLeft, LeftTop, LeftRight, LeftBottom;
+		TLaneValues RightLeft, RightTop, RightRight, RightBottom;
+	};
+	struct CRectCircleBlock : public CPairBlock {
+		TLaneValues RectLeft, RectTop, RectRight, RectBottom;
+		TLaneValues CenterX, CenterY, Radius;
+	};
+
 	static const int externalBitsetOffset = sizeof( TAARect ) + sizeof( CVector2<int> ) + sizeof( TVector2 ) + sizeof( TVector2 ) + sizeof( float ) + sizeof( float );
 
 	// Partially specialized functions.
@@ -110,6 +204,15 @@ private:
 	CAARect<int> findFlaggedRect( int startX, int startY, int rowOffset, const CDynamicBitSet<>& bitset, CAARect<int> cellRect ) const;
 	int findFlaggedRectEndY( int startX, int endX, int startY, int rowOffset, const CDynamicBitSet<>& bitset, int limitY ) const;
 	TAARect findRealCellRect( CAARect<int> cellRect, TVector2 cellSize ) const;
+
+	// Batched checks. A block is checked when all of its lanes are filled.
+	void addCircleCirclePair( int pairIndex, const THitbox& left, const THitbox& right, CCircleCircleBlock& block, CDynamicBitSet<>& result ) const;
+	void addRectRectPair( int pairIndex, const THitbox& left, const THitbox& right, CRectRectBlock& block, CDynamicBitSet<>& result ) const;
+	void addRectCirclePair( int pairIndex, const THitbox& rect, const THitbox& circle, CRectCircleBlock& block, CDynamicBitSet<>& result ) const;
+	void detectCircleCircleCollisions( const CCircleCircleBlock& block, CDynamicBitSet<>& result ) const;
+	void detectRectRectCollisions( const CRectRectBlock& block, CDynamicBitSet<>& result ) const;
+	void detectRectCircleCollisions( const CRectCircleBlock& block, CDynamicBitSet<>& result ) const;
+	static void setCollisionBits( int collisionMask, const CPairBlock& block, CDynamicBitSet<>& result );
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -143,6 +246,46 @@ bool CConvexShapeCollisionDetector<FloatingPointType>::DetectCollision( const TH
 	}
 }
 
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::DetectCollisions( CArrayView<CPair<const THitbox*>> pairs, CDynamicBitSet<>& result ) const
+{
+	result.ReserveBuffer( pairs.Size() );
+	result.FillWithZeroes();
+
+	// Common shape combinations are gathered in blocks, the rest is checked right away.
+	CCircleCircleBlock circleCircleBlock{};
+	CRectRectBlock rectRectBlock{};
+	CRectCircleBlock rectCircleBlock{};
+	for( int i = 0; i < pairs.Size(); i++ ) {
+		const THitbox& left = *pairs[i].First;
+		const THitbox& right = *pairs[i].Second;
+		const THitboxShapeType leftType = left.GetType();
+		const THitboxShapeType rightType = right.GetType();
+		if( leftType == HST_Circle && rightType == HST_Circle ) {
+			addCircleCirclePair( i, left, right, circleCircleBlock, result );
+		} else if( leftType == HST_AARect && rightType == HST_AARect ) {
+			addRectRectPair( i, left, right, rectRectBlock, result );
+		} else if( leftType == HST_AARect && rightType == HST_Circle ) {
+			addRectCirclePair( i, left, right, rectCircleBlock, result );
+		} else if( leftType == HST_Circle && rightType == HST_AARect ) {
+			addRectCirclePair( i, right, left, rectCircleBlock, result );
+		} else if( DetectCollision( left, right ) ) {
+			result.Set( i, true );
+		}
+	}
+
+	// Check the partially filled blocks.
+	if( circleCircleBlock.Size > 0 ) {
+		detectCircleCircleCollisions( circleCircleBlock, result );
+	}
+	if( rectRectBlock.Size > 0 ) {
+		detectRectRectCollisions( rectRectBlock, result );
+	}
+	if( rectCircleBlock.Size > 0 ) {
+		detectRectCircleCollisions( rectCircleBlock, result );
+	}
+}
+
 template<class FloatingPointType>
 bool CConvexShapeCollisionDetector<FloatingPointType>::detectPointCollision( const THitbox& point, const THitbox& right ) const
 {
@@ -1413,4 +1556,142 @@ CAARect<FloatingPointType> CConvexShapeCollisionDetector<FloatingPointType>::fin
 
 //////////////////////////////////////////////////////////////////////////
 
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::addCircleCirclePair( int pairIndex, const THitbox& left, const THitbox& right, CCircleCircleBlock& block, CDynamicBitSet<>& result ) const
+{
+	const int lane = block.Size;
+	const TVector2 leftCenter = left.HitboxData().Get<TVector2>( 0 );
+	const TVector2 rightCenter = right.HitboxData().Get<TVector2>( 0 );
+	block.LeftX[lane] = leftCenter.X();
+	block.LeftY[lane] = leftCenter.Y();
+	block.LeftRadius[lane] = left.HitboxData().Get<Type>( sizeof( leftCenter ) );
+	block.RightX[lane] = rightCenter.X();
+	block.RightY[lane] = rightCenter.Y();
+	block.RightRadius[lane] = right.HitboxData().Get<Type>( sizeof( rightCenter ) );
+	block.PairIndices[lane] = pairIndex;
+	block.Size++;
+	if( block.Size == TLanes::Size ) {
+		detectCircleCircleCollisions( block, result );
+		block.Size = 0;
+	}
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::addRectRectPair( int pairIndex, const THitbox& left, const THitbox& right, CRectRectBlock& block, CDynamicBitSet<>& result ) const
+{
+	const int lane = block.Size;
+	const TAARect leftRect = left.HitboxData().As<TAARect>();
+	const TAARect rightRect = right.HitboxData().As<TAARect>();
+	block.LeftLeft[lane] = leftRect.Left();
+	block.LeftTop[lane] = leftRect.Top();
+	block.LeftRight[lane] = leftRect.Right();
+	block.LeftBottom[lane] = leftRect.Bottom();
+	block.RightLeft[lane] = rightRect.Left();
+	block.RightTop[lane] = rightRect.Top();
+	block.RightRight[lane] = rightRect.Right();
+	block.RightBottom[lane] = rightRect.Bottom();
+	block.PairIndices[lane] = pairIndex;
+	block.Size++;
+	if( block.Size == TLanes::Size ) {
+		detectRectRectCollisions( block, result );
+		block.Size = 0;
+	}
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::addRectCirclePair( int pairIndex, const THitbox& rect, const THitbox& circle, CRectCircleBlock& block, CDynamicBitSet<>& result ) const
+{
+	const int lane = block.Size;
+	const TAARect globalRect = rect.HitboxData().As<TAARect>();
+	const TVector2 center = circle.HitboxData().Get<TVector2>( 0 );
+	block.RectLeft[lane] = globalRect.Left();
+	block.RectTop[lane] = globalRect.Top();
+	block.RectRight[lane] = globalRect.Right();
+	block.RectBottom[lane] = globalRect.Bottom();
+	block.CenterX[lane] = center.X();
+	block.CenterY[lane] = center.Y();
+	block.Radius[lane] = circle.HitboxData().Get<Type>( sizeof( center ) );
+	block.PairIndices[lane] = pairIndex;
+	block.Size++;
+	if( block.Size == TLanes::Size ) {
+		detectRectCircleCollisions( block, result );
+		block.Size = 0;
+	}
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::detectCircleCircleCollisions( const CCircleCircleBlock& block, CDynamicBitSet<>& result ) const
+{
+	// The same operations as in detectCircleCircleCollision are performed for every lane, so the results match exactly.
+	const TRegister deltaX = TLanes::Sub( TLanes::Load( block.LeftX.Ptr() ), TLanes::Load( block.RightX.Ptr() ) );
+	const TRegister deltaY = TLanes::Sub( TLanes::Load( block.LeftY.Ptr() ), TLanes::Load( block.RightY.Ptr() ) );
+	const TRegister radius = TLanes::Add( TLanes::Load( block.LeftRadius.Ptr() ), TLanes::Load( block.RightRadius.Ptr() ) );
+	const TRegister squareDistance = TLanes::Add( TLanes::Mul( deltaX, deltaX ), TLanes::Mul( deltaY, deltaY ) );
+	const TRegister collisions = TLanes::LessOrEqual( squareDistance, TLanes::Mul( radius, radius ) );
+	setCollisionBits( TLanes::GetMask( collisions ), block, result );
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::detectRectRectCollisions( const CRectRectBlock& block, CDynamicBitSet<>& result ) const
+{
+	// Same check as in StrictIntersects.
+	const TRegister separatedX = TLanes::Or( TLanes::GreaterOrEqual( TLanes::Load( block.RightLeft.Ptr() ), TLanes::Load( block.LeftRight.Ptr() ) ),
+		TLanes::LessOrEqual( TLanes::Load( block.RightRight.Ptr() ), TLanes::Load( block.LeftLeft.Ptr() ) ) );
+	const TRegister separatedY = TLanes::Or( TLanes::LessOrEqual( TLanes::Load( block.RightTop.Ptr() ), TLanes::Load( block.LeftBottom.Ptr() ) ),
+		TLanes::GreaterOrEqual( TLanes::Load( block.RightBottom.Ptr() ), TLanes::Load( block.LeftTop.Ptr() ) ) );
+	setCollisionBits( ~TLanes::GetMask( TLanes::Or( separatedX, separatedY ) ), block, result );
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::detectRectCircleCollisions( const CRectCircleBlock& block, CDynamicBitSet<>& result ) const
+{
+	// All the branches of detectRectCircleCollision are computed and the right one is selected for every lane.
+	const TRegister left = TLanes::Load( block.RectLeft.Ptr() );
+	const TRegister top = TLanes::Load( block.RectTop.Ptr() );
+	const TRegister right = TLanes::Load( block.RectRight.Ptr() );
+	const TRegister bottom = TLanes::Load( block.RectBottom.Ptr() );
+	const TRegister x = TLanes::Load( block.CenterX.Ptr() );
+	const TRegister y = TLanes::Load( block.CenterY.Ptr() );
+	const TRegister radius = TLanes::Load( block.Radius.Ptr() );
+
+	const TRegister isLeft = TLanes::Less( x, left );
+	const TRegister isRight = TLanes::Greater( x, right );
+	const TRegister isAbove = TLanes::Greater( y, top );
+	const TRegister isBelow = TLanes::Less( y, bottom );
+
+	// Center is outside of the rect on both axes, the closest corner is checked.
+	const TRegister cornerX = TLanes::Sub( TLanes::Select( isLeft, left, right ), x );
+	const TRegister cornerY = TLanes::Sub( TLanes::Select( isAbove, top, bottom ), y );
+	const TRegister cornerSquareDistance = TLanes::Add( TLanes::Mul( cornerX, cornerX ), TLanes::Mul( cornerY, cornerY ) );
+	const TRegister cornerCollision = TLanes::LessOrEqual( cornerSquareDistance, TLanes::Mul( radius, radius ) );
+	// Center is outside of the rect on one axis.
+	const TRegister sideXCollision = TLanes::Select( isLeft, TLanes::GreaterOrEqual( TLanes::Add( x, radius ), left ),
+		TLanes::LessOrEqual( TLanes::Sub( x, radius ), right ) );
+	const TRegister sideYCollision = TLanes::Select( isAbove, TLanes::LessOrEqual( TLanes::Sub( y, radius ), top ),
+		TLanes::GreaterOrEqual( TLanes::Add( y, radius ), bottom ) );
+
+	const int outsideXMask = TLanes::GetMask( TLanes::Or( isLeft, isRight ) );
+	const int outsideYMask = TLanes::GetMask( TLanes::Or( isAbove, isBelow ) );
+	// Center inside the rect is a collision.
+	const int collisionMask = ( outsideXMask & outsideYMask & TLanes::GetMask( cornerCollision ) )
+		| ( outsideXMask & ~outsideYMask & TLanes::GetMask( sideXCollision ) )
+		| ( ~outsideXMask & outsideYMask & TLanes::GetMask( sideYCollision ) )
+		| ( ~outsideXMask & ~outsideYMask );
+	setCollisionBits( collisionMask, block, result );
+}
+
+template<class FloatingPointType>
+void CConvexShapeCollisionDetector<FloatingPointType>::setCollisionBits( int collisionMask, const CPairBlock& block, CDynamicBitSet<>& result )
+{
+	// Bits are set without branching, the collision mask is unpredictable.
+	const int bitsPerWord = CHAR_BIT * sizeof( DWORD );
+	auto& resultWords = result.GetStorage();
+	for( int lane = 0; lane < block.Size; lane++ ) {
+		const int pairIndex = block.PairIndices[lane];
+		resultWords[pairIndex / bitsPerWord] |= static_cast<DWORD>( ( collisionMask >> lane ) & 1 ) << ( pairIndex % bitsPerWord );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Relib.
\ No newline at end of file
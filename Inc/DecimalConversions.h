@@ -0,0 +1,51 @@
+#pragma once
+#include <Redefs.h>
+// Header for conversions between binary floating point numbers and their decimal representations.
+
+namespace Relib {
+
+namespace Decimal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// All the conversions are correctly rounded, ties are rounded to even.
+// Only the period is accepted as a decimal point, the current locale is ignored.
+
+// Digit count that selects the shortest round trip representation in string conversions.
+const int ShortestDigitCount = -1;
+// Buffer size that is enough for the shortest representation of any double.
+const int MaxShortestLength = 25;
+
+// Value of mantissa * 10^exponent rounded to the nearest double.
+double REAPI ComputeDouble( unsigned __int64 mantissa, int exponent );
+
+// Parse a number in the format [-]digits[.digits][(e|E)[+|-]digits]. Digits may be omitted on one side of the decimal point.
+// Any number of digits is accepted, numbers that are too large are converted to infinity.
+// Return the number of parsed symbols or 0 if the string doesn't start with a number.
+int REAPI Parse( const char* str, int length, double& result );
+int REAPI Parse( const wchar_t* str, int length, double& result );
+int REAPI Parse( const char* str, int length, float& result );
+int REAPI Parse( const wchar_t* str, int length, float& result );
+
+// Write the shortest representation of the value that is parsed back to the same value. The closest one is chosen from several shortest candidates.
+// Exponent notation is used for values below 1e-6 and starting from 1e21. Infinities and NaNs are written as "inf", "-inf" and "nan".
+// Result must have MaxShortestLength symbols allocated. Return the number of written symbols.
+int REAPI FormatShortest( double value, char* result );
+int REAPI FormatShortest( double value, wchar_t* result );
+// Float values get the shortest representation that is parsed back to the same float, 0.1f is written as "0.1".
+int REAPI FormatShortest( float value, char* result );
+int REAPI FormatShortest( float value, wchar_t* result );
+
+// Buffer size that is enough for the fixed notation of the value.
+int REAPI GetMaxFixedLength( double value, int digitCount );
+// Write the value in the fixed notation with the given number of digits after the decimal point.
+// Result must have GetMaxFixedLength( value, digitCount ) symbols allocated. Return the number of written symbols.
+int REAPI FormatFixed( double value, int digitCount, char* result );
+int REAPI FormatFixed( double value, int digitCount, wchar_t* result );
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Decimal.
+
+}	// namespace Relib.
+
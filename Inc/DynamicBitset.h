@@ -63,21 +63,25 @@ CDynamicBitSetStorage<ContainerType>::CDynamicBitSetStorage()
 }
 
 template <class ContainerType>
-CDynamicBitSetStorage<ContainerType>::CDynamicBitSetStorage( const CDynamicBitSetStorage<ContainerType>& other )
+CDynamicBitSetStorage<ContainerType>::CDynamicBitSetStorage( const CDynamicBitSetStorage<ContainerType>& other ) :
+	bitSize( other.bitSize )
 {
 	storage = copy( other.storage );
 }
 
 template <class ContainerType>
 CDynamicBitSetStorage<ContainerType>::CDynamicBitSetStorage( CDynamicBitSetStorage<ContainerType>&& other ) :
-	storage( move( other.storage ) )
+	storage( move( other.storage ) ),
+	bitSize( other.bitSize )
 {
+	other.bitSize = 0;
 }
 
 template <class ContainerType>
 CDynamicBitSetStorage<ContainerType>& CDynamicBitSetStorage<ContainerType>::operator=( CDynamicBitSetStorage<ContainerType> other )
 {
-	swap( *this, other );
+	swap( storage, other.storage );
+	swap( bitSize, other.bitSize );
 	return *this;
 }
 
@@ -69,8 +69,9 @@ public:
 	const T* TryGetValue( const CComponent<T>& component ) const
 		{ return const_cast<CEntity*>( this )->TryGetValue( component ); }
 
-	// Entity container needs access to the entity group information.
+	// Entity container and command buffer need access to the entity group information.
 	friend class CEntityContainer;
+	friend class CEntityCommandBuffer;
 
 private:
 	// Complete entity data.
@@ -0,0 +1,100 @@
+#pragma once
+#include <Redefs.h>
+#include <Array.h>
+#include <PtrOwner.h>
+#include <CriticalSection.h>
+#include <Component.h>
+#include <EntityRef.h>
+
+namespace Relib {
+
+class CComponentGroup;
+class CEntityContainer;
+class CEntityGroup;
+namespace RelibInternal {
+	class CEntityCommandStream;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Deferred structural changes of entities.
+// Commands may be recorded by several threads simultaneously. Every thread records into its own stream, component values are stored in the stream memory arena.
+// Playback applies all the commands on a single thread. Entity creations are applied first, then component additions and removals, then destructions.
+// Commands of the same kind from a single thread are applied in the recording order.
+// Entity groups are reserved once for all the entities that are moved into them, so a group is never reallocated more than once during playback.
+class REAPI CEntityCommandBuffer {
+public:
+	CEntityCommandBuffer();
+	~CEntityCommandBuffer();
+
+	// Check if no commands have been recorded. Must not be called concurrently with recording.
+	bool IsEmpty() const;
+
+	// Record creation of an entity with the components from the given group. The group must stay alive until the playback.
+	// Returned index identifies the created entity in SetComponent calls made by the same thread.
+	int CreateEntity( const CComponentGroup& componentGroup );
+	// Set the initial component value of an entity created by the current thread. The component must be a part of the entity group.
+	template <class T, class... Args>
+	void SetComponent( int createdEntity, const CComponent<T>& component, Args&&... valueArgs );
+
+	// Record addition of a component. The entity is moved to the corresponding group during the playback.
+	// If the entity already has the component, only its value is changed.
+	template <class T, class... Args>
+	void AddComponent( CEntityRef entity, const CComponent<T>& component, Args&&... valueArgs );
+	// Record removal of a component. Nothing happens if the entity doesn't have the component.
+	void RemoveComponent( CEntityRef entity, const CBaseComponent& component );
+
+	// Record destruction of an entity. References that have expired by the time of the playback are ignored.
+	void DestroyEntity( CEntityRef entity );
+
+	// Apply all the recorded commands to the container and empty the buffer.
+	// Must not be called concurrently with recording.
+	void Playback( CEntityContainer& container );
+	// Discard all the recorded commands.
+	void Empty();
+
+private:
+	// Identifier of the buffer that is used to find the stream of the current thread.
+	int bufferId;
+	// Streams of all the threads that have recorded commands.
+	CCriticalSection streamSection;
+	CArray<CPtrOwner<RelibInternal::CEntityCommandStream>> streams;
+
+	RelibInternal::CEntityCommandStream& getThreadStream();
+	RelibInternal::CEntityCommandStream& findThreadStream();
+	void* allocateValue( int size );
+	void addCreatedValue( int createdEntity, const CBaseComponent& component, void* value );
+	void addComponentValue( CEntityRef entity, const CBaseComponent& component, void* value );
+
+	void createEntities( CEntityContainer& container );
+	void changeComponents( CEntityContainer& container );
+	void destroyEntities( CEntityContainer& container );
+
+	// Copying is prohibited.
+	CEntityCommandBuffer( CEntityCommandBuffer& ) = delete;
+	void operator=( CEntityCommandBuffer& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T, class... Args>
+void CEntityCommandBuffer::SetComponent( int createdEntity, const CComponent<T>& component, Args&&... valueArgs )
+{
+	staticAssert( alignof( T ) <= AllocatorAlignment );
+	// The value is recorded only after it is constructed, so an exception leaves no command behind.
+	const auto value = ::new( allocateValue( sizeof( T ) ) ) T( forward<Args>( valueArgs )... );
+	addCreatedValue( createdEntity, component, value );
+}
+
+template <class T, class... Args>
+void CEntityCommandBuffer::AddComponent( CEntityRef entity, const CComponent<T>& component, Args&&... valueArgs )
+{
+	staticAssert( alignof( T ) <= AllocatorAlignment );
+	const auto value = ::new( allocateValue( sizeof( T ) ) ) T( forward<Args>( valueArgs )... );
+	addComponentValue( entity, component, value );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
@@ -15,14 +15,18 @@ class CEntityGroupConstRange;
 class CEntityContainer;
 class CEntityInitializer;
 class CComponentGroup;
+class CEntityQuery;
 template <class System>
 class CSystemOwner;
 class CEntityInitializationData;
+class CThreadPool;
 //////////////////////////////////////////////////////////////////////////
 
 // General controller of the entity-component-system data.
 // Provides routines for adding/removing entities and running systems.
 // Systems are separated into update systems and draw systems. Draw systems are guaranteed to never add, remove or modify entities.
+// If a thread pool is provided, systems with non-conflicting component access are executed concurrently.
+// The first exception thrown by a system or by any of its entity chunks is rethrown by RunUpdateSystems/RunDrawSystems once the running systems finish. Systems that have not started yet are skipped.
 class REAPI CEntityComponentSystem {
 public:
 	// Create an ECS. A valid entity container must be provided before any entity operations take place.
@@ -31,8 +35,14 @@ public:
 
 	CEntityContainer* GetEntityContainer()
 		{ return entities; }
-	void SetEntityContainer( CEntityContainer* newValue )
-			{ entities = newValue; }
+	// Queries of the systems are registered in the new container.
+	void SetEntityContainer( CEntityContainer* newValue );
+
+	// Thread pool for concurrent system execution. Systems are executed on the calling thread if the pool is null.
+	CThreadPool* GetThreadPool() const
+		{ return threadPool; }
+	void SetThreadPool( CThreadPool* newValue )
+		{ threadPool = newValue; }
 
 	// Delete all entities.
 	void ClearEntities();
@@ -55,6 +65,12 @@ public:
 	CEntityGroupRange Entities( const CComponentGroup& group );
 	CEntityGroupConstRange Entities( const CComponentGroup& group ) const;
 
+	// Register a persistent query in the entity container. Groups that match the registered queries are cached.
+	int RegisterQuery( const CEntityQuery& query );
+	// Get all the entities that match a registered query.
+	CEntityGroupRange QueryEntities( int queryIndex );
+	CEntityGroupConstRange QueryEntities( int queryIndex ) const;
+
 	void RunUpdateSystems( ISystemContext& context );
 	void RunDrawSystems( const ISystemContext& context ) const;
 
@@ -67,22 +83,43 @@ private:
 		CPtrOwner<IBaseSystem> System;
 		int Priority;
 		const CComponentGroup* TargetGroup;
+		// Container query for the target group.
+		int QueryIndex;
+		CSystemAccess Access;
+		int ChunkSize;
 	};
 	struct CDrawSystemInfo {
 		CPtrOwner<IBaseSystem> System;
 		int Priority;
 		const CComponentGroup* TargetGroup;
+		// Container query for the target group.
+		int QueryIndex;
+		CSystemAccess Access;
+		int ChunkSize;
+	};
+	// Execution order constraints of a system list.
+	struct CSystemSchedule {
+		// Positions of the systems that wait for the given system to finish.
+		CArray<CArray<int>> Dependents;
+		// Number of the systems that must finish before the given system starts.
+		CArray<int> DependencyCounts;
 	};
 
 	CArray<CUpdateSystemInfo> writeSystems;
 	CArray<CDrawSystemInfo> readSystems;
+	CSystemSchedule writeSchedule;
+	CSystemSchedule readSchedule;
 
 	// Container for entity data. Owned elsewhere.
 	CEntityContainer* entities = nullptr;
+	// Pool for concurrent system execution. Owned elsewhere.
+	CThreadPool* threadPool = nullptr;
 	
 	template <class System>
 	void removeSystem( const System* ptr );
 
+	int registerTargetQuery( const CComponentGroup* targetGroup );
+
 	void doAddSystem( IUpdateSystem* systemPtr, CPtrOwner<IUpdateSystem> newSystem );
 	void doAddSystem( IDrawSystem* systemPtr, CPtrOwner<IDrawSystem> newSystem );
 	void doAddSystem( IWriteSystem* systemPtr, CPtrOwner<IWriteSystem> newSystem );
@@ -99,6 +136,14 @@ private:
 	void runReadSystem( const CDrawSystemInfo& target, const ISystemContext& context ) const;
 	void runDrawSystem( const CDrawSystemInfo& target, const ISystemContext& context ) const;
 
+	void runScheduledUpdateSystem( CUpdateSystemInfo& target, ISystemContext& context );
+	void runScheduledDrawSystem( const CDrawSystemInfo& target, const ISystemContext& context ) const;
+
+	template <class SystemInfo>
+	static void updateSchedule( const CArray<SystemInfo>& systems, CSystemSchedule& schedule );
+	template <class RunAction>
+	static void runSchedule( CThreadPool& pool, const CSystemSchedule& schedule, const RunAction& runSystem );
+
 	// Copying and moving is prohibited.
 	CEntityComponentSystem( CEntityComponentSystem& ) = delete;
 	void operator=( CEntityComponentSystem& ) = delete;
@@ -4,21 +4,28 @@
 #include <DynamicBitSet.h>
 #include <PersistentStorage.h>
 #include <PtrOwner.h>
+#include <EntityGroup.h>
+#include <EntityQuery.h>
 
 namespace Relib {
 
 class CEntity;
 class CConstEntity;
 class CEntityInitializer;
+class CEntityCommandBuffer;
 struct CFullEntityData;
 //////////////////////////////////////////////////////////////////////////
 
 // Entity and entity group data storage.
 class REAPI CEntityContainer {
 public:
-	CEntityContainer();
+	// Storage mode is used for all the entity groups created by the container.
+	explicit CEntityContainer( TEntityStorageMode groupStorageMode = ESM_Contiguous );
 	~CEntityContainer();
 
+	TEntityStorageMode GetGroupStorageMode() const
+		{ return groupStorageMode; }
+
 	void Empty();
 
 	CArrayBuffer<CPtrOwner<CEntityGroup>> EntityGroups()
@@ -31,6 +38,13 @@ public:
 	// Find an entity group that has all the components from the given component group.
 	int MatchNextEntityGroup( int startIndex, const CComponentGroup& componentGroup ) const;
 
+	// Register a persistent query. Matching groups of the registered queries are cached and updated when new groups are created.
+	// Returns the query index. Equal queries share the same index.
+	int RegisterQuery( const CEntityQuery& query );
+	// Indices of the entity groups that match a registered query in the ascending order.
+	CArrayView<int> GetQueryGroups( int queryIndex ) const
+		{ return queries[queryIndex].Groups; }
+
 	// Create an entity with components from the given group.
 	CFullEntityData& CreateEntity( const CComponentGroup& componentGroup );
 
@@ -43,16 +57,28 @@ public:
 
 	void DestroyEntity( CEntity entity );
 
+	// Command buffer playback needs access to the group management.
+	friend class CEntityCommandBuffer;
+
 private:
 	CPersistentStorage<CFullEntityData, 512> entityList;
 	CArray<CFullEntityData*> freeDataList;
 	CArray<CPtrOwner<CEntityGroup>> entityGroups;
+	// Registered queries with the cached matching groups.
+	struct CQueryCache {
+		CEntityQuery Query;
+		CArray<int> Groups;
+	};
+	CArray<CQueryCache> queries;
+	TEntityStorageMode groupStorageMode;
 
 	void returnEmptyEntity( CFullEntityData& entityData );
 	bool doesRightContainLeft( const CDynamicBitSet<>& left, const CDynamicBitSet<>& right ) const;
 	bool isComponentSetEqual( const CDynamicBitSet<>& left, const CDynamicBitSet<>& right ) const;
 	CFullEntityData* createEntityData();
 	CEntityGroup& getOrCreateEntityGroup( const CComponentGroup& componentGroup );
+	void removeGroupEntity( CEntityGroup& group, int groupPos );
+	void moveEntityToGroup( CFullEntityData& fullData, CEntityGroup& newGroup );
 
 	// Copying is prohibited.
 	CEntityContainer( CEntityContainer& ) = delete;
@@ -4,6 +4,7 @@
 #include <StaticArray.h>
 #include <MemoryOwner.h>
 #include <ComponentGroup.h>
+#include <Atomic.h>
 
 namespace Relib {
 
@@ -13,10 +14,29 @@ class CEntityRange;
 class CEntityConstRange;
 //////////////////////////////////////////////////////////////////////////
 
+// Layout of the component data in an entity group.
+enum TEntityStorageMode {
+	// Every component is stored in its own array. The arrays are reallocated when the group grows.
+	ESM_Contiguous,
+	// Entities are stored in fixed size chunks that hold arrays of all the components. Existing chunks are never moved.
+	ESM_Chunked
+};
+
+// Size of a chunk in the chunked storage mode. Chunks are bigger if a single entity doesn't fit.
+static const int EntityChunkByteSize = 16 * 1024;
+// Alignment of the component arrays in a chunk.
+static const int EntityChunkAlignment = 64;
+
+//////////////////////////////////////////////////////////////////////////
+
 // Structure of arrays of entity data.
 class REAPI CEntityGroup {
 public:
-	explicit CEntityGroup( CComponentGroup componentGroup );
+	explicit CEntityGroup( CComponentGroup componentGroup, TEntityStorageMode storageMode = ESM_Contiguous );
+	~CEntityGroup();
+
+	TEntityStorageMode GetStorageMode() const
+		{ return storageMode; }
 
 	const CComponentGroup& GetComponentGroup() const
 		{ return componentGroup; }
@@ -31,11 +51,44 @@ public:
 	CFullEntityData* GetEntityData( int entityIndex ) const
 		{ return entityDataPtrs[entityIndex]; }
 
+	// Chunk information for the chunked storage mode.
+	// Number of entities in a full chunk. Always a power of two.
+	int ChunkCapacity() const
+		{ return chunkCapacity; }
+	// Number of chunks that contain entities.
+	int ChunkCount() const
+		{ return ( Size() + chunkCapacity - 1 ) >> chunkCapacityLog; }
+	CEntityRange ChunkEntities( int chunkIndex );
+	CEntityConstRange ChunkEntities( int chunkIndex ) const;
+	// Get the array of component values in the chunk. The array length is the number of entities in the chunk.
+	template <class T>
+	T* GetChunkValues( const CComponent<T>& component, int chunkIndex );
+	template <class T>
+	const T* GetChunkValues( const CComponent<T>& component, int chunkIndex ) const
+		{ return const_cast<CEntityGroup*>( this )->GetChunkValues( component, chunkIndex ); }
+
+	// Change tracking for the chunked storage mode.
+	// Every change of a chunk sets the chunk version to a new value of the group change counter.
+	// A system can remember the group version and skip the chunks that have a smaller version on the next run.
+	// Adding, moving and deleting entities marks the chunks automatically. Changes of component values must be marked explicitly.
+	int GetChangeVersion() const
+		{ return changeVersion.Load(); }
+	int GetChunkVersion( int chunkIndex ) const
+		{ return chunks[chunkIndex].Version; }
+	void MarkChunkChanged( int chunkIndex )
+		{ chunks[chunkIndex].Version = changeVersion.PreIncrement(); }
+
 	template <class T>
 	T& GetValue( const CComponent<T>& component, int entityIndex );
 	template <class T>
 	T* TryGetValue( const CComponent<T>& component, int entityIndex );
 
+	bool HasComponent( const CBaseComponent& component ) const;
+	// Get the untyped component value. The group must have the specified component.
+	void* GetRawValue( const CBaseComponent& component, int entityIndex );
+
+	// Allocate the storage for the given total number of entities. Adding entities within the reserved size doesn't reallocate the component data.
+	void ReserveBuffer( int entityCount );
 	int AddEntity( CFullEntityData* newData );
 	int InitializeEntity( CFullEntityData* newData, RelibInternal::CFilledEntityData&& filledData );
 
@@ -48,6 +101,8 @@ private:
 	struct CComponentData {
 		CMemoryOwner<> Data;
 		int ElemSize = 0;
+		// Offset of the component array in a chunk.
+		int ChunkOffset = 0;
 	};
 	struct CDestructibleComponentData : CComponentData {
 		CBaseComponent::TConstructComponentData ConstructPtr;
@@ -72,32 +127,83 @@ private:
 	// List of entity full data information.
 	CArray<CFullEntityData*> entityDataPtrs;
 
-	void growEntityDataSize();
+	// Chunked storage data.
+	struct CEntityChunk {
+		CMemoryOwner<> Buffer;
+		// Aligned start of the component arrays.
+		BYTE* Data;
+		// Group change version at the moment of the last change.
+		int Version;
+	};
+	TEntityStorageMode storageMode;
+	CArray<CEntityChunk> chunks;
+	int chunkCapacity = 1;
+	int chunkCapacityLog = 0;
+	int chunkByteSize = 0;
+	CAtomic<int> changeVersion{ 0 };
+
+	BYTE* getEntityData( CComponentData& data, int entityIndex );
+	void initChunkLayout();
+	void addChunk();
+	void deleteLastChunk();
+	void markEntityChanged( int entityIndex );
+	void growEntityDataSize( int newMinSize );
 	void moveEntityData( int srcIndex, int destIndex );
+	void destroyEntityData( int entityIndex );
+
+	// Copying is prohibited.
+	CEntityGroup( CEntityGroup& ) = delete;
+	void operator=( CEntityGroup& ) = delete;
 };
 
 //////////////////////////////////////////////////////////////////////////
 
+inline BYTE* CEntityGroup::getEntityData( CComponentData& data, int entityIndex )
+{
+	if( storageMode == ESM_Contiguous ) {
+		return static_cast<BYTE*>( data.Data.Ptr() ) + entityIndex * data.ElemSize;
+	}
+	const auto chunkData = chunks[entityIndex >> chunkCapacityLog].Data;
+	return chunkData + data.ChunkOffset + ( entityIndex & ( chunkCapacity - 1 ) ) * data.ElemSize;
+}
+
+inline bool CEntityGroup::HasComponent( const CBaseComponent& component ) const
+{
+	const auto id = component.GetComponentId() - componentIdOffset;
+	return id >= 0 && id < entityDataIndex.Size() && entityDataIndex[id] != nullptr;
+}
+
+inline void* CEntityGroup::GetRawValue( const CBaseComponent& component, int entityIndex )
+{
+	assert( HasComponent( component ) );
+	return getEntityData( *entityDataIndex[component.GetComponentId() - componentIdOffset], entityIndex );
+}
+
 template <class T>
 T& CEntityGroup::GetValue( const CComponent<T>& component, int entityIndex )
 {
 	const auto id = component.GetComponentId() - componentIdOffset;
 	assert( entityDataIndex[id]->ElemSize == sizeof( T ) );
-	const auto data = reinterpret_cast<BYTE*>( entityDataIndex[id]->Data.Ptr() );
-	const auto resultData = data + entityIndex * sizeof( T );
-	return *reinterpret_cast<T*>( resultData );
+	return *reinterpret_cast<T*>( getEntityData( *entityDataIndex[id], entityIndex ) );
 }
 
 template <class T>
 T* CEntityGroup::TryGetValue( const CComponent<T>& component, int entityIndex )
 {
 	const auto id = component.GetComponentId() - componentIdOffset;
-	if( id < 0 || id >= entityDataIndex.Size() || entityDataIndex[id]->ElemSize != sizeof( T ) ) {
+	if( id < 0 || id >= entityDataIndex.Size() || entityDataIndex[id] == nullptr || entityDataIndex[id]->ElemSize != sizeof( T ) ) {
 		return nullptr;
 	}
-	const auto data = reinterpret_cast<BYTE*>( entityDataIndex[id]->Data.Ptr() );
-	const auto resultData = data + entityIndex * sizeof( T );
-	return reinterpret_cast<T*>( resultData );
+	return reinterpret_cast<T*>( getEntityData( *entityDataIndex[id], entityIndex ) );
+}
+
+template <class T>
+T* CEntityGroup::GetChunkValues( const CComponent<T>& component, int chunkIndex )
+{
+	assert( storageMode == ESM_Chunked );
+	const auto id = component.GetComponentId() - componentIdOffset;
+	assert( entityDataIndex[id]->ElemSize == sizeof( T ) );
+	return reinterpret_cast<T*>( chunks[chunkIndex].Data + entityDataIndex[id]->ChunkOffset );
 }
 
 //////////////////////////////////////////////////////////////////////////
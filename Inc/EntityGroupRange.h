@@ -7,42 +7,55 @@ namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
-// Mechanism for iteration of entities matching a given set of components.
+// Mechanism for iteration of entities matching a given set of components or a registered query.
+// Position is the group index for the component set iteration and the position in the cached group list for the query iteration.
 class CBaseEntityGroupRange {
 public:
 	CBaseEntityGroupRange( const CEntityContainer& _container, const CComponentGroup& _components ) :
-		container( _container ), components( _components ), groupPos( NotFound ) {}
-	CBaseEntityGroupRange( const CEntityContainer& _container, const CComponentGroup& _components, int _groupPos ) :
-		container( _container ), components( _components ), groupPos( _groupPos ) {}
+		container( _container ), components( &_components ), queryIndex( NotFound ), pos( NotFound ) {}
+	CBaseEntityGroupRange( const CEntityContainer& _container, const CComponentGroup& _components, int _pos ) :
+		container( _container ), components( &_components ), queryIndex( NotFound ), pos( _pos ) {}
+	// Iteration over the cached groups of a registered query.
+	CBaseEntityGroupRange( const CEntityContainer& _container, int _queryIndex ) :
+		container( _container ), components( nullptr ), queryIndex( _queryIndex ), pos( NotFound ) {}
+	CBaseEntityGroupRange( const CBaseEntityGroupRange& other, int _pos ) :
+		container( other.container ), components( other.components ), queryIndex( other.queryIndex ), pos( _pos ) {}
 	
 	bool operator!=( CBaseEntityGroupRange other ) const
-		{ return groupPos != other.groupPos; }
+		{ return pos != other.pos; }
 
 protected:
 	CEntityConstRange getCurrentEntities() const
-		{ return container.GetEntityGroup( groupPos ).Entities(); }
+		{ return container.GetEntityGroup( getGroupPos() ).Entities(); }
 	CEntityRange getCurrentEntities()
-		{ return const_cast<CEntityContainer&>( container ).GetEntityGroup( groupPos ).Entities(); }
+		{ return const_cast<CEntityContainer&>( container ).GetEntityGroup( getGroupPos() ).Entities(); }
 	void setNextEntityGroup()
-		{ groupPos = getNextEntityGroup( groupPos + 1 ); }
-	int getNextEntityGroup( int startPos ) const
-		{ return container.MatchNextEntityGroup( startPos, components ); }
+		{ pos = getNextEntityGroup( pos + 1 ); }
+	int getNextEntityGroup( int startPos ) const;
 
 	const CEntityContainer& getContainer() const
 		{ return container; }
 	CEntityContainer& getContainer()
 		{ return const_cast<CEntityContainer&>( container ); }
-	const CComponentGroup& getComponents() const
-		{ return components; }
 	int getGroupPos() const
-		{ return groupPos; }
+		{ return components != nullptr ? pos : container.GetQueryGroups( queryIndex )[pos]; }
 
 private:
 	const CEntityContainer& container;
-	const CComponentGroup& components;
-	int groupPos;
+	// Matched components. Null for the registered query iteration.
+	const CComponentGroup* components;
+	int queryIndex;
+	int pos;
 };
 
+inline int CBaseEntityGroupRange::getNextEntityGroup( int startPos ) const
+{
+	if( components != nullptr ) {
+		return container.MatchNextEntityGroup( startPos, *components );
+	}
+	return startPos < container.GetQueryGroups( queryIndex ).Size() ? startPos : NotFound;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 class CEntityGroupConstRange : public CBaseEntityGroupRange {
@@ -55,9 +68,9 @@ public:
 		{ return getCurrentEntities(); }
 	
 	CEntityGroupConstRange begin() const
-		{ return CEntityGroupConstRange( getContainer(), getComponents(), getNextEntityGroup( 0 ) ); }
+		{ return CEntityGroupConstRange( *this, getNextEntityGroup( 0 ) ); }
 	CEntityGroupConstRange end() const
-		{ return CEntityGroupConstRange( getContainer(), getComponents(), NotFound ); }
+		{ return CEntityGroupConstRange( *this, NotFound ); }
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -66,6 +79,8 @@ class CEntityGroupRange : public CBaseEntityGroupRange {
 public:
 	CEntityGroupRange( CEntityContainer& _container, const CComponentGroup& _components ) : CBaseEntityGroupRange( _container, _components ) {}
 	CEntityGroupRange( CEntityContainer& _container, const CComponentGroup& _components, int _groupPos ) : CBaseEntityGroupRange( _container, _components, _groupPos ) {}
+	CEntityGroupRange( CEntityContainer& _container, int _queryIndex ) : CBaseEntityGroupRange( _container, _queryIndex ) {}
+	CEntityGroupRange( const CEntityGroupRange& other, int _groupPos ) : CBaseEntityGroupRange( other, _groupPos ) {}
 
 	void operator++()
 		{ setNextEntityGroup(); }
@@ -73,9 +88,9 @@ public:
 		{ return getCurrentEntities(); }
 	
 	CEntityGroupRange begin()
-		{ return CEntityGroupRange( getContainer(), getComponents(), getNextEntityGroup( 0 ) ); }
+		{ return CEntityGroupRange( *this, getNextEntityGroup( 0 ) ); }
 	CEntityGroupRange end()
-		{ return CEntityGroupRange( getContainer(), getComponents(), NotFound ); }
+		{ return CEntityGroupRange( *this, NotFound ); }
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,113 @@
+#pragma once
+#include <Redefs.h>
+#include <Component.h>
+#include <ComponentGroup.h>
+#include <DynamicBitset.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Filter of entity groups by their components.
+// Component sets are compared a whole bit set word at a time. Groups that have fewer components than required are rejected before the comparison.
+class CEntityQuery {
+public:
+	CEntityQuery() = default;
+	explicit CEntityQuery( const CComponentGroup& withComponents )
+		{ With( withComponents ); }
+
+	// Matching groups must have all the given components.
+	CEntityQuery& With( const CBaseComponent& component );
+	CEntityQuery& With( const CComponentGroup& components );
+	// Matching groups must have none of the given components.
+	CEntityQuery& Without( const CBaseComponent& component );
+	CEntityQuery& Without( const CComponentGroup& components );
+	// Matching groups must have at least one of the given components.
+	CEntityQuery& AnyOf( const CBaseComponent& component );
+	CEntityQuery& AnyOf( const CComponentGroup& components );
+
+	// Check if the group with the given components matches the query.
+	bool Matches( const CComponentGroup& components ) const;
+
+	bool operator==( const CEntityQuery& other ) const;
+	bool operator!=( const CEntityQuery& other ) const
+		{ return !( *this == other ); }
+
+private:
+	CDynamicBitSet<> withSet;
+	CDynamicBitSet<> withoutSet;
+	CDynamicBitSet<> anyOfSet;
+	// Number of components in the with set.
+	int withCount = 0;
+	bool hasAnyOf = false;
+
+	static bool isSetEqual( const CDynamicBitSet<>& left, const CDynamicBitSet<>& right );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+inline CEntityQuery& CEntityQuery::With( const CBaseComponent& component )
+{
+	withSet |= component.GetComponentId();
+	withCount = withSet.ElementsCount();
+	return *this;
+}
+
+inline CEntityQuery& CEntityQuery::With( const CComponentGroup& components )
+{
+	withSet |= components.GetComponentSet();
+	withCount = withSet.ElementsCount();
+	return *this;
+}
+
+inline CEntityQuery& CEntityQuery::Without( const CBaseComponent& component )
+{
+	withoutSet |= component.GetComponentId();
+	return *this;
+}
+
+inline CEntityQuery& CEntityQuery::Without( const CComponentGroup& components )
+{
+	withoutSet |= components.GetComponentSet();
+	return *this;
+}
+
+inline CEntityQuery& CEntityQuery::AnyOf( const CBaseComponent& component )
+{
+	anyOfSet |= component.GetComponentId();
+	hasAnyOf = true;
+	return *this;
+}
+
+inline CEntityQuery& CEntityQuery::AnyOf( const CComponentGroup& components )
+{
+	anyOfSet |= components.GetComponentSet();
+	hasAnyOf = !anyOfSet.IsFilledWithZeroes();
+	return *this;
+}
+
+inline bool CEntityQuery::Matches( const CComponentGroup& components ) const
+{
+	if( components.GetComponents().Size() < withCount ) {
+		return false;
+	}
+	const auto& componentSet = components.GetComponentSet();
+	return componentSet.HasAll( withSet ) && !componentSet.Intersects( withoutSet ) && ( !hasAnyOf || componentSet.Intersects( anyOfSet ) );
+}
+
+inline bool CEntityQuery::operator==( const CEntityQuery& other ) const
+{
+	return withCount == other.withCount && hasAnyOf == other.hasAnyOf
+		&& isSetEqual( withSet, other.withSet ) && isSetEqual( withoutSet, other.withoutSet ) && isSetEqual( anyOfSet, other.anyOfSet );
+}
+
+inline bool CEntityQuery::isSetEqual( const CDynamicBitSet<>& left, const CDynamicBitSet<>& right )
+{
+	// Sets of different sizes may still be equal, so containment is checked both ways.
+	return left.HasAll( right ) && right.HasAll( left );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
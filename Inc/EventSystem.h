@@ -3,6 +3,8 @@
 #include <ArrayBuffer.h>
 #include <EventUtils.h>
 #include <ActionOwner.h>
+#include <Atomic.h>
+#include <PtrOwner.h>
 
 namespace Relib {
 
@@ -16,6 +18,7 @@ public:
 
 	virtual int GetClassId() const = 0;
 	virtual void DispatchListenerActions( CArrayView<const IExternalObject*> actions ) const = 0;
+	virtual void DispatchBatchListenerActions( CArrayView<const IExternalObject*> actions ) const = 0;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -37,6 +40,7 @@ public:
 	virtual int GetClassId() const override final
 		{ return GetEventClassId(); }
 	virtual void DispatchListenerActions( CArrayView<const IExternalObject *> actions ) const override final;
+	virtual void DispatchBatchListenerActions( CArrayView<const IExternalObject*> actions ) const override final;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -51,17 +55,297 @@ void CEvent<EventClass>::DispatchListenerActions( CArrayView<const IExternalObje
 	}
 }
 
+template<class EventClass>
+void CEvent<EventClass>::DispatchBatchListenerActions( CArrayView<const IExternalObject*> actions ) const
+{
+	const auto& realEvent = static_cast<const EventClass&>( *this );
+	for( auto actionPtr : actions ) {
+		const auto eventAction = static_cast<const IAction<void( const CArrayView<EventClass>& )>*>( actionPtr );
+		eventAction->Invoke( CArrayView<EventClass>( realEvent ) );
+	}
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 namespace RelibInternal {
 
+// List of listener actions with constant time removal.
+// Listeners are identified by slots that stay valid when other listeners are removed. The order of listeners is not preserved.
+class CEventListenerList {
+public:
+	bool IsEmpty() const
+		{ return actions.Size() == deletedSlots.Size(); }
+
+	// Invoke the action for every listener. The action can add and delete listeners.
+	// Deleted listeners are not invoked anymore, added listeners are invoked in the same pass.
+	template <class Action>
+	void ForEach( const Action& action );
+
+	// Add the action and return its slot.
+	int Add( const IExternalObject* action );
+	// Delete the action in the given slot. The last action takes its place.
+	// During ForEach the action is only cleared, the list is compacted when the iteration is finished.
+	void Delete( int slot );
+
+private:
+	CArray<const IExternalObject*> actions;
+	// Slot of every action.
+	CArray<int> actionSlots;
+	// Position of the action for every slot.
+	CArray<int> slotPositions;
+	CArray<int> freeSlots;
+	// Slots deleted during the iteration.
+	CArray<int> deletedSlots;
+	// Number of the running ForEach calls, nested calls come from the invoked actions.
+	int iterationDepth = 0;
+
+	void endIteration();
+	void deleteSlot( int slot );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Action>
+void CEventListenerList::ForEach( const Action& action )
+{
+	// The depth is restored if the action throws.
+	class CIterationGuard {
+	public:
+		explicit CIterationGuard( CEventListenerList& _list ) : list( _list ) { list.iterationDepth++; }
+		~CIterationGuard() { list.endIteration(); }
+
+	private:
+		CEventListenerList& list;
+	};
+
+	const CIterationGuard guard( *this );
+	for( int i = 0; i < actions.Size(); i++ ) {
+		const auto listener = actions[i];
+		if( listener != nullptr ) {
+			action( listener );
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline int CEventListenerList::Add( const IExternalObject* action )
+{
+	int slot;
+	if( freeSlots.IsEmpty() ) {
+		slot = slotPositions.Size();
+		slotPositions.Add( actions.Size() );
+	} else {
+		slot = freeSlots.Last();
+		freeSlots.DeleteLast();
+		slotPositions[slot] = actions.Size();
+	}
+	actions.Add( action );
+	actionSlots.Add( slot );
+	return slot;
+}
+
+inline void CEventListenerList::Delete( int slot )
+{
+	if( iterationDepth == 0 ) {
+		deleteSlot( slot );
+		return;
+	}
+	// Positions of the other listeners must not change while they are iterated.
+	const int pos = slotPositions[slot];
+	assert( pos != NotFound && actions[pos] != nullptr );
+	actions[pos] = nullptr;
+	deletedSlots.Add( slot );
+}
+
+inline void CEventListenerList::endIteration()
+{
+	iterationDepth--;
+	if( iterationDepth > 0 ) {
+		return;
+	}
+	for( int slot : deletedSlots ) {
+		deleteSlot( slot );
+	}
+	deletedSlots.Empty();
+}
+
+inline void CEventListenerList::deleteSlot( int slot )
+{
+	const int pos = slotPositions[slot];
+	assert( pos != NotFound && actionSlots[pos] == slot );
+	const int lastPos = actions.Size() - 1;
+	const int lastSlot = actionSlots[lastPos];
+	actions[pos] = actions[lastPos];
+	actionSlots[pos] = lastSlot;
+	slotPositions[lastSlot] = pos;
+	actions.DeleteLast();
+	actionSlots.DeleteLast();
+	slotPositions[slot] = NotFound;
+	freeSlots.Add( slot );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Listeners of a single event class.
+struct CEventListeners {
+	// Actions that take a single event.
+	CEventListenerList Actions;
+	// Actions that take an array view of events.
+	CEventListenerList BatchActions;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Queue of posted events of a single class.
+class IEventQueue {
+public:
+	virtual ~IEventQueue() {}
+
+	// Dispatch all the events that have been posted so far.
+	virtual void Dispatch( CEventListeners& listeners ) = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Bounded ring buffer of events. Any number of threads can push events, a single thread dispatches them.
+// Every cell has a sequence number that tells whether the cell is free for the given push position or contains the event for it.
+// Events are stored separately from the sequence numbers, so that the dispatched events form contiguous arrays.
+template <class Event>
+class CEventQueue : public IEventQueue {
+public:
+	explicit CEventQueue( int capacity );
+	~CEventQueue();
+
+	// Push the event. Return false if the queue is full. This operation is thread-safe.
+	bool Push( Event&& e );
+
+	virtual void Dispatch( CEventListeners& listeners ) override final;
+
+private:
+	Event* events;
+	CAtomic<unsigned>* sequences;
+	unsigned mask;
+	CAtomic<unsigned> pushPos{ 0 };
+	// Position of the first event that has not been dispatched. Only the dispatching thread accesses it.
+	unsigned dispatchPos = 0;
+
+	void dispatchRange( CEventListeners& listeners, unsigned begin, unsigned end ) const;
+
+	// Copying is prohibited.
+	CEventQueue( CEventQueue& ) = delete;
+	void operator=( CEventQueue& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Event>
+CEventQueue<Event>::CEventQueue( int capacity )
+{
+	assert( capacity > 0 );
+	int bufferSize = 1;
+	while( bufferSize < capacity ) {
+		bufferSize *= 2;
+	}
+	mask = bufferSize - 1;
+	events = static_cast<Event*>( RELIB_STATIC_ALLOCATE( CRuntimeHeap, bufferSize * sizeof( Event ) ) );
+	sequences = static_cast<CAtomic<unsigned>*>( RELIB_STATIC_ALLOCATE( CRuntimeHeap, bufferSize * sizeof( CAtomic<unsigned> ) ) );
+	for( int i = 0; i < bufferSize; i++ ) {
+		::new( sequences + i ) CAtomic<unsigned>( i );
+	}
+}
+
+template <class Event>
+CEventQueue<Event>::~CEventQueue()
+{
+	// Delete the events that have never been dispatched.
+	for( unsigned pos = dispatchPos; sequences[pos & mask].Load() == pos + 1; pos++ ) {
+		events[pos & mask].~Event();
+	}
+	CRuntimeHeap::Free( events );
+	CRuntimeHeap::Free( sequences );
+}
+
+template <class Event>
+bool CEventQueue<Event>::Push( Event&& e )
+{
+	unsigned pos = pushPos.Load( std::memory_order_relaxed );
+	for( ;; ) {
+		const unsigned sequence = sequences[pos & mask].Load( std::memory_order_acquire );
+		const int difference = static_cast<int>( sequence - pos );
+		if( difference == 0 ) {
+			if( pushPos.CompareExchangeStrong( pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed ) ) {
+				break;
+			}
+		} else if( difference < 0 ) {
+			// The cell still contains an event from the previous round.
+			return false;
+		} else {
+			pos = pushPos.Load( std::memory_order_relaxed );
+		}
+	}
+	::new( events + ( pos & mask ) ) Event( move( e ) );
+	sequences[pos & mask].Store( pos + 1, std::memory_order_release );
+	return true;
+}
+
+template <class Event>
+void CEventQueue<Event>::Dispatch( CEventListeners& listeners )
+{
+	const unsigned begin = dispatchPos;
+	unsigned end = begin;
+	while( end - begin <= mask && sequences[end & mask].Load( std::memory_order_acquire ) == end + 1 ) {
+		end++;
+	}
+	if( end == begin ) {
+		return;
+	}
+
+	// Events are contiguous up to the end of the buffer.
+	const unsigned wrapPos = begin + ( mask + 1 - ( begin & mask ) );
+	if( end <= wrapPos ) {
+		dispatchRange( listeners, begin, end );
+	} else {
+		dispatchRange( listeners, begin, wrapPos );
+		dispatchRange( listeners, wrapPos, end );
+	}
+
+	// Free the cells for the next round.
+	for( unsigned pos = begin; pos != end; pos++ ) {
+		events[pos & mask].~Event();
+		sequences[pos & mask].Store( pos + mask + 1, std::memory_order_release );
+	}
+	dispatchPos = end;
+}
+
+template <class Event>
+void CEventQueue<Event>::dispatchRange( CEventListeners& listeners, unsigned begin, unsigned end ) const
+{
+	// Listeners can be added and removed by the invoked actions, the listener lists handle it.
+	const CArrayView<Event> eventView( events + ( begin & mask ), static_cast<int>( end - begin ) );
+	listeners.BatchActions.ForEach( [&]( const IExternalObject* listener ) {
+		const auto eventAction = static_cast<const IAction<void( const CArrayView<Event>& )>*>( listener );
+		eventAction->Invoke( eventView );
+	} );
+	for( const auto& e : eventView ) {
+		listeners.Actions.ForEach( [&]( const IExternalObject* listener ) {
+			const auto eventAction = static_cast<const IAction<void( const Event& )>*>( listener );
+			eventAction->Invoke( e );
+		} );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 // An event target owner. Unregisters an event target from the event system on destruction.
 template <class ActionType>
 class CBaseEventTarget {
 public:
 	CBaseEventTarget() = default;
-	CBaseEventTarget( CEventSystem& events, ActionType targetAction, int classId ) : eventSystem( &events ), actionObject( move( targetAction ) ), eventClassId( classId ) {}
-	CBaseEventTarget( CBaseEventTarget&& other ) : eventSystem( other.eventSystem ), actionObject( move( other.actionObject ) ), eventClassId( other.eventClassId ) 
+	CBaseEventTarget( CEventSystem& events, ActionType targetAction, int classId, int _listenerId ) : 
+		eventSystem( &events ), actionObject( move( targetAction ) ), eventClassId( classId ), listenerId( _listenerId ) {}
+	CBaseEventTarget( CBaseEventTarget&& other ) : 
+		eventSystem( other.eventSystem ), actionObject( move( other.actionObject ) ), eventClassId( other.eventClassId ), listenerId( other.listenerId ) 
 		{ other.eventClassId = NotFound; }
 	CBaseEventTarget& operator=( CBaseEventTarget other );
 	~CBaseEventTarget();
@@ -73,6 +357,8 @@ private:
 	CEventSystem* eventSystem = nullptr;
 	ActionType actionObject{};
 	int eventClassId = NotFound;
+	// Listener identifier within the class, given by the event system.
+	int listenerId = NotFound;
 
 	// Copying is prohibited.
 	CBaseEventTarget( CBaseEventTarget& ) = delete;
@@ -84,7 +370,7 @@ template <class ActionType>
 CBaseEventTarget<ActionType>::~CBaseEventTarget()
 {
 	if( eventClassId != NotFound ) {
-		eventSystem->removeListener( eventClassId, actionObject );
+		eventSystem->removeListener( eventClassId, listenerId );
 	}
 }
 
@@ -94,6 +380,7 @@ CBaseEventTarget<ActionType>& CBaseEventTarget<ActionType>::operator=( CBaseEven
 	swap( eventSystem, other.eventSystem );
 	swap( actionObject, other.actionObject );
 	swap( eventClassId, other.eventClassId );
+	swap( listenerId, other.listenerId );
 	return *this;
 }
 
@@ -106,7 +393,8 @@ typedef RelibInternal::CBaseEventTarget<const IExternalObject*> CExternalEventTa
 
 // An event system. Registers listeners and sends notifications.
 // All events are separated into classes. Listeners can register for an event of a particular class.
-// This class does not have internal multithreading support.
+// Events can be dispatched immediately with Notify or queued with Post and dispatched in batches later.
+// Posting is thread-safe, other methods do not have internal multithreading support.
 class REAPI CEventSystem {
 public:
 	CEventSystem() = default; 
@@ -119,6 +407,9 @@ public:
 	
 	template <class ActionType>
 	void AddEventTarget( ActionType&& eventAction, CEventTarget& target );
+	// Add an action that takes CArrayView<Event>. Posted events are passed to the action in batches.
+	template <class ActionType>
+	void AddBatchEventTarget( ActionType&& eventAction, CEventTarget& target );
 	void AddExternalEventTarget( int eventClassId, const IExternalObject* eventAction, CExternalEventTarget& target );
 
 	// Notify all the listeners.
@@ -127,16 +418,37 @@ public:
 	// Notify all the listeners using the generic event.
 	void NotifyDynamic( const IEvent& e );
 
+	// Create a queue for posted events of the given type. Capacity is rounded up to a power of two.
+	template <class Event>
+	void CreateEventQueue( int capacity );
+	// Copy the event to the queue without notifying the listeners. The queue must be created beforehand.
+	// Return false if the queue is full. This operation is lock-free and can be called from any thread.
+	template <class Event>
+	bool Post( Event e );
+	// Notify the listeners of the posted events of the given type.
+	// Batch listeners receive the events as array views, other listeners receive them one by one.
+	// Queues of different event types can be dispatched concurrently, e.g. on a thread pool, if the listeners are not changed at the same time.
+	template <class Event>
+	void DispatchPostedEvents();
+	// Notify the listeners of all the posted events.
+	void DispatchPostedEvents();
+
 	// Event target needs access to remove the action target from the list of listeners.
 	template <class ActionType>
 	friend class RelibInternal::CBaseEventTarget;
 
 private:
 	// All the listeners divided by class.
-	CArray<CArray<const IExternalObject*>> listeners;
+	CArray<RelibInternal::CEventListeners> listeners;
+	// Queues of posted events divided by class. Null for classes without a queue.
+	CArray<CPtrOwner<RelibInternal::IEventQueue>> eventQueues;
 
-	void removeListener( int classId, const IExternalObject* listenerObject );
-	void removeListener( int classId, const CTypelessActionOwner& listenerObject );
+	void addEventTarget( int classId, CTypelessActionOwner action, CEventTarget& target, bool isBatchAction );
+	RelibInternal::CEventListeners& getOrCreateListeners( int classId );
+	void removeListener( int classId, int listenerId );
+	// Listener identifier combines the slot in the listener list with the batch action flag.
+	static int createListenerId( int slot, bool isBatchAction )
+		{ return slot * 2 + ( isBatchAction ? 1 : 0 ); }
 
 	// Copying is prohibited.
 	CEventSystem( CEventSystem& ) = delete;
@@ -155,7 +467,7 @@ template <class EventClass>
 bool CEventSystem::HasListeners() const
 {
 	const auto classId = GetEventClassId<EventClass>();
-	return classId < listeners.Size() && !listeners[classId].IsEmpty();
+	return classId < listeners.Size() && ( !listeners[classId].Actions.IsEmpty() || !listeners[classId].BatchActions.IsEmpty() );
 }
 
 template <class ActionType>
@@ -166,18 +478,22 @@ void CEventSystem::AddEventTarget( ActionType&& eventAction, CEventTarget& targe
 	using TEventArgRef = typename Types::FunctionInfo<ActionType>::template ArgTypeAt<0>;
 	using TEventArg = typename Types::PureType<TEventArgRef>::Result;
 	typedef typename TEventArg::TEventClass TArgEventClass;
-	const int classId = GetEventClassId<TArgEventClass>();
 	CActionOwner<void( const TEventArg& )> actionOwner( forward<ActionType>( eventAction ) );
-	CTypelessActionOwner typelessAction( move( actionOwner ) );
-
-	assert( classId >= 0 );
-
-	if( classId >= listeners.Size() ) {
-		listeners.IncreaseSize( classId + 1 );
-	}
-	listeners[classId].Add( typelessAction.GetActionObject() );
+	addEventTarget( GetEventClassId<TArgEventClass>(), CTypelessActionOwner( move( actionOwner ) ), target, false );
+}
 
-	target = CEventTarget( *this, move( typelessAction ), classId );
+template <class ActionType>
+void CEventSystem::AddBatchEventTarget( ActionType&& eventAction, CEventTarget& target )
+{
+	staticAssert( ( Types::IsSame<typename Types::FunctionInfo<ActionType>::ReturnType, void>::Result ) );
+	staticAssert( Types::FunctionInfo<ActionType>::ArgCount == 1 );
+	using TEventViewArgRef = typename Types::FunctionInfo<ActionType>::template ArgTypeAt<0>;
+	using TEventViewArg = typename Types::PureType<TEventViewArgRef>::Result;
+	typedef typename TEventViewArg::TElemType TEventArg;
+	staticAssert( ( Types::IsSame<TEventViewArg, CArrayView<TEventArg>>::Result ) );
+	typedef typename TEventArg::TEventClass TArgEventClass;
+	CActionOwner<void( const CArrayView<TEventArg>& )> actionOwner( forward<ActionType>( eventAction ) );
+	addEventTarget( GetEventClassId<TArgEventClass>(), CTypelessActionOwner( move( actionOwner ) ), target, true );
 }
 
 template <class Event>
@@ -189,12 +505,15 @@ void CEventSystem::Notify( const Event& e )
 	if( classId >= listeners.Size() ) {
 		return;
 	}
-	auto& listenerList = listeners[classId];
-	for( int i = 0; i < listenerList.Size(); i++ ) {
-		auto listener = listenerList[i];
+	auto& classListeners = listeners[classId];
+	classListeners.Actions.ForEach( [&]( const IExternalObject* listener ) {
 		const auto eventAction = static_cast<const IAction<void( const Event& )>*>( listener );
 		eventAction->Invoke( e );
-	}
+	} );
+	classListeners.BatchActions.ForEach( [&]( const IExternalObject* listener ) {
+		const auto eventAction = static_cast<const IAction<void( const CArrayView<Event>& )>*>( listener );
+		eventAction->Invoke( CArrayView<Event>( e ) );
+	} );
 }
 
 inline void CEventSystem::NotifyDynamic( const IEvent& e )
@@ -203,7 +522,42 @@ inline void CEventSystem::NotifyDynamic( const IEvent& e )
 	if( classId >= listeners.Size() ) {
 		return;
 	}
-	e.DispatchListenerActions( listeners[classId] );
+	// Listeners are passed one by one, so the actions can add and remove listeners.
+	auto& classListeners = listeners[classId];
+	classListeners.Actions.ForEach( [&]( const IExternalObject* listener ) { e.DispatchListenerActions( CArrayView<const IExternalObject*>( listener ) ); } );
+	classListeners.BatchActions.ForEach( [&]( const IExternalObject* listener ) { e.DispatchBatchListenerActions( CArrayView<const IExternalObject*>( listener ) ); } );
+}
+
+template <class Event>
+void CEventSystem::CreateEventQueue( int capacity )
+{
+	typedef typename Event::TEventClass TBaseEventClass;
+	staticAssert( ( Types::IsDerivedFrom<Event, CEvent<TBaseEventClass>>::Result ) );
+	const int classId = Event::GetEventClassId();
+	if( classId >= eventQueues.Size() ) {
+		eventQueues.IncreaseSize( classId + 1 );
+	}
+	assert( eventQueues[classId] == nullptr );
+	eventQueues[classId] = CreateOwner<RelibInternal::CEventQueue<Event>>( capacity );
+	getOrCreateListeners( classId );
+}
+
+template <class Event>
+bool CEventSystem::Post( Event e )
+{
+	const int classId = Event::GetEventClassId();
+	assert( classId < eventQueues.Size() && eventQueues[classId] != nullptr );
+	const auto queue = static_cast<RelibInternal::CEventQueue<Event>*>( eventQueues[classId].Ptr() );
+	assert( dynamic_cast<RelibInternal::CEventQueue<Event>*>( eventQueues[classId].Ptr() ) == queue );
+	return queue->Push( move( e ) );
+}
+
+template <class Event>
+void CEventSystem::DispatchPostedEvents()
+{
+	const int classId = Event::GetEventClassId();
+	assert( classId < eventQueues.Size() && eventQueues[classId] != nullptr );
+	eventQueues[classId]->Dispatch( listeners[classId] );
 }
 
 //////////////////////////////////////////////////////////////////////////
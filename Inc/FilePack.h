@@ -0,0 +1,112 @@
+#pragma once
+#include <Redefs.h>
+#include <Array.h>
+#include <ArrayBuffer.h>
+#include <BaseString.h>
+#include <FileMapping.h>
+
+namespace Relib {
+
+class CFileCollection;
+class CFileWriter;
+class CThreadPool;
+
+namespace RelibInternal {
+	struct CFilePackEntry;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Storage options of a packed file.
+enum TFilePackFileFlags {
+	FPF_Compressed = 1,	// file data is compressed with zlib, incompressible data is stored as is
+	FPF_Checksum = 2	// CRC-32 of the file data is stored
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Read-only pack of files that is mapped to memory.
+// The pack header points to a directory with file entries sorted by name, a hash table for the name lookup and the names.
+// Only the directory is mapped when the pack is opened, file data is mapped on request.
+class REAPI CFilePack {
+public:
+	static constexpr int GetMagicNumber()
+		{ return 1223218894; }
+	static const int Version = 2;
+
+	explicit CFilePack( CStringPart fileName );
+
+	int GetFileCount() const
+		{ return fileCount; }
+	// Files are sorted by name.
+	CStringPart GetFileName( int filePos ) const;
+	// Size of the original file data.
+	int GetFileSize( int filePos ) const;
+	DWORD GetFileFlags( int filePos ) const;
+
+	// Find the file with the given relative path. Returns NotFound if there is no such file.
+	int FindFile( CStringPart fileName ) const;
+
+	// Map the data of an uncompressed file.
+	CMappingReadView GetFileData( int filePos ) const;
+	// Append the data of any file to the result. Compressed data is inflated, checksums are verified.
+	void ReadFileData( int filePos, CArray<BYTE>& result ) const;
+	// Check if the file data matches its checksum. Files without checksums are always valid.
+	bool CheckFile( int filePos ) const;
+
+	// Copying is prohibited.
+	CFilePack( const CFilePack& ) = delete;
+	void operator=( const CFilePack& ) = delete;
+
+private:
+	mutable CFileMapping mapping;
+	CMappingReadView directoryView;
+	int fileCount = 0;
+	int hashTableSize = 0;
+	const RelibInternal::CFilePackEntry* entries = nullptr;
+	const int* hashTable = nullptr;
+	const char* names = nullptr;
+
+	void readDirectory();
+	void checkEntry( const RelibInternal::CFilePackEntry& entry, __int64 directoryOffset, int namesSize ) const;
+	const RelibInternal::CFilePackEntry& getEntry( int filePos ) const;
+	CMappingReadView mapStoredData( const RelibInternal::CFilePackEntry& entry ) const;
+	void readStoredData( const RelibInternal::CFilePackEntry& entry, CArray<BYTE>& result ) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Mechanism for writing file packs.
+// Added files are read, compressed and checksummed on the thread pool workers in batches, the results are written in order.
+class REAPI CFilePackBuilder {
+public:
+	// Add a file with the given data. Data must stay valid until the pack is written.
+	void AddFile( CStringPart fileName, CArrayView<BYTE> data, DWORD flags = 0 );
+	// Add all the files of the folder with the paths relative to the folder. Files are read when the pack is written.
+	void AddFolder( CStringPart folderName, DWORD flags = 0 );
+	// Add all the files of the collection. Collection must stay alive until the pack is written.
+	void AddCollection( const CFileCollection& collection, DWORD flags = 0 );
+
+	// Write the pack. Without a thread pool the files are processed on the calling thread.
+	// The first error of reading or compressing a file is rethrown and the incomplete pack is deleted.
+	void WritePack( CStringPart fileName, CThreadPool* threadPool = nullptr );
+
+private:
+	struct CSourceFile {
+		CString Name;
+		// Full path of the file that is read on writing. Empty for the files with the given data.
+		CString SourcePath;
+		CArrayView<BYTE> Data;
+		int DataSize = 0;
+		DWORD Flags = 0;
+	};
+
+	CArray<CSourceFile> sourceFiles;
+
+	void writePackFile( CFileWriter& file, const CArray<int>& fileOrder, CThreadPool* threadPool ) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
@@ -0,0 +1,467 @@
+#pragma once
+#include <HashUtils.h>
+#include <ExplicitCopy.h>
+#include <Array.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+// Control byte values of the flat hash index.
+// Full slots store 7 bits of the element hash, special values have the sign bit set.
+static const signed char flatControlEmpty = -128;
+static const signed char flatControlDeleted = -2;
+// Number of control bytes that are probed with a single SSE instruction.
+static const int flatGroupSize = 16;
+
+//////////////////////////////////////////////////////////////////////////
+
+// A group of consecutive control bytes that is checked simultaneously.
+class CFlatHashGroup {
+public:
+	explicit CFlatHashGroup( const signed char* controlPtr ) : control( _mm_loadu_si128( reinterpret_cast<const __m128i*>( controlPtr ) ) ) {}
+
+	// Get a bit mask of all the slots with the given hash tail.
+	unsigned Match( signed char hashTail ) const
+		{ return _mm_movemask_epi8( _mm_cmpeq_epi8( control, _mm_set1_epi8( hashTail ) ) ); }
+	unsigned MatchEmpty() const
+		{ return Match( flatControlEmpty ); }
+	// Empty and deleted slots are the only ones with a sign bit set.
+	unsigned MatchEmptyOrDeleted() const
+		{ return _mm_movemask_epi8( control ); }
+	unsigned MatchFull() const
+		{ return ~MatchEmptyOrDeleted() & 0xFFFF; }
+
+	// Bit mask position utilities. Mask must not be empty.
+	static int TrailingZeroCount( unsigned mask );
+	static int LeadingZeroCount( unsigned mask );
+
+private:
+	__m128i control;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+inline int CFlatHashGroup::TrailingZeroCount( unsigned mask )
+{
+	assert( mask != 0 );
+	DWORD result;
+	_BitScanForward( &result, mask );
+	return result;
+}
+
+inline int CFlatHashGroup::LeadingZeroCount( unsigned mask )
+{
+	assert( mask != 0 && mask <= 0xFFFF );
+	DWORD result;
+	_BitScanReverse( &result, mask );
+	return flatGroupSize - 1 - result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Uninitialized storage for a single flat hash table element.
+template <class T>
+struct CFlatHashSlot {
+	alignas( T ) BYTE Data[sizeof( T )];
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Classes for accessing flat hash index values consequentially.
+template <class T, class Strategy, class Allocator>
+class CFlatHashIndexConstIterator {
+public:
+	CFlatHashIndexConstIterator( const CFlatHashIndex<T, Strategy, Allocator>& _hashIndex, int _slot ) : hashIndex( _hashIndex ), slot( _slot ) {}
+
+	const T& operator*() const
+		{ return hashIndex.GetValue( slot ); }
+	// An increment operator.
+	// Range-based for loops don't require the ++operator to return a value.
+	void operator++()
+		{ slot = hashIndex.NextFullSlot( slot + 1 ); }
+
+	bool operator!=( const CFlatHashIndexConstIterator<T, Strategy, Allocator>& other ) const
+		{ return slot != other.slot; }
+
+protected:
+	const CFlatHashIndex<T, Strategy, Allocator>& hashIndex;
+	int slot;
+};
+
+template <class T, class Strategy, class Allocator>
+class CFlatHashIndexIterator : public CFlatHashIndexConstIterator<T, Strategy, Allocator> {
+public:
+	using CFlatHashIndexConstIterator<T, Strategy, Allocator>::CFlatHashIndexConstIterator;
+
+	T& operator*()
+		{ return const_cast<T&>( this->hashIndex.GetValue( this->slot ) ); }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Open addressing hash index with SwissTable-style control bytes.
+// Elements are stored directly in a power of 2 sized slot array, every slot has a corresponding control byte
+// that is either empty, deleted or contains 7 bits of the element's hash.
+// Lookup probes groups of control bytes with SSE2 instructions and compares only the elements with matching hash bits.
+// HashStrategy::HashKey is used to hash values of ContainedType.
+// Unlike CHashIndex, elements are relocated when the index grows.
+template <class ContainedType, class HashStrategy, class Allocator>
+class CFlatHashIndex {
+public:
+	CFlatHashIndex() = default;
+	// Custom dynamic allocator.
+	explicit CFlatHashIndex( Allocator& allocator );
+	CFlatHashIndex( CFlatHashIndex&& other );
+	template <class OtherAllocator>
+	CFlatHashIndex( const CFlatHashIndex<ContainedType, HashStrategy, OtherAllocator>& other, const CExplicitCopyTag& );
+
+	CFlatHashIndex& operator=( CFlatHashIndex&& other );
+
+	~CFlatHashIndex();
+
+	int IndexSize() const
+		{ return slots.Size(); }
+	int Size() const
+		{ return elementCount; }
+	bool IsEmpty() const
+		{ return elementCount == 0; }
+	// Rehash the index so that the given number of elements can be added without further rehashing.
+	void ReserveBuffer( int size );
+
+	// Delete everything.
+	void Empty();
+	// Delete everything and free buffer.
+	void FreeBuffer();
+
+	// Find a slot with an element that is equal to key. Return NotFound if no such element exists.
+	template <class Key>
+	int Find( int hash, const Key& key ) const;
+	// Find the next slot with an element starting from startSlot. Return IndexSize() if there is none.
+	int NextFullSlot( int startSlot ) const;
+
+	ContainedType& GetValue( int slot );
+	const ContainedType& GetValue( int slot ) const
+		{ return const_cast<CFlatHashIndex<ContainedType, HashStrategy, Allocator>*>( this )->GetValue( slot ); }
+
+	// Element insertion. Element with an equal key is assumed to be absent.
+	// References to other elements are invalidated if the index is rehashed.
+	template <class... Args>
+	ContainedType& Insert( int hash, Args&&... containedTypeArgs );
+	// Deletion. Slot is assumed to have an element.
+	void DeleteSlot( int slot );
+
+	// Copying between allocators requires access to the internals.
+	template <class OtherContainedType, class OtherStrategy, class OtherAllocator>
+	friend class CFlatHashIndex;
+
+private:
+	typedef CFlatHashSlot<ContainedType> TSlot;
+	// Control bytes. The first flatGroupSize bytes are cloned after the end of the table so that any group can be loaded without wrapping.
+	CArray<signed char, Allocator> control;
+	// Element storage.
+	CArray<TSlot, Allocator> slots;
+	// Total number of elements in the table.
+	int elementCount = 0;
+	// Number of elements that can be added before the index needs rehashing. Deleted slots are not reusable until the rehash.
+	int growthLeft = 0;
+
+	int mask() const
+		{ return slots.Size() - 1; }
+	ContainedType* getSlotPtr( int slot )
+		{ return reinterpret_cast<ContainedType*>( slots[slot].Data ); }
+
+	static unsigned mixHash( int hash );
+	static signed char getHashTail( unsigned mixedHash )
+		{ return static_cast<signed char>( mixedHash & 0x7F ); }
+	static int getMaxLoad( int indexSize );
+	static int getRequiredIndexSize( int elementCount );
+
+	int findFreeSlot( unsigned mixedHash ) const;
+	void setControl( int slot, signed char value );
+	void rehash( int newIndexSize );
+	void destroyElements();
+
+	// Copying is prohibited.
+	CFlatHashIndex( CFlatHashIndex& ) = delete;
+	void operator=( CFlatHashIndex& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class ContainedType, class HashStrategy, class Allocator>
+CFlatHashIndex<ContainedType, HashStrategy, Allocator>::CFlatHashIndex( Allocator& allocator ) :
+	control( allocator ),
+	slots( allocator )
+{
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+CFlatHashIndex<ContainedType, HashStrategy, Allocator>::CFlatHashIndex( CFlatHashIndex&& other ) :
+	control( move( other.control ) ),
+	slots( move( other.slots ) ),
+	elementCount( other.elementCount ),
+	growthLeft( other.growthLeft )
+{
+	other.elementCount = 0;
+	other.growthLeft = 0;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+template <class OtherAllocator>
+CFlatHashIndex<ContainedType, HashStrategy, Allocator>::CFlatHashIndex( const CFlatHashIndex<ContainedType, HashStrategy, OtherAllocator>& other, const CExplicitCopyTag& ) :
+	elementCount( other.elementCount ),
+	growthLeft( other.growthLeft )
+{
+	// Hash strategy is the same, elements can be copied to the same positions.
+	const int indexSize = other.IndexSize();
+	control.IncreaseSizeNoInitialize( other.control.Size() );
+	::memcpy( control.Ptr(), other.control.Ptr(), other.control.Size() );
+	slots.IncreaseSizeNoInitialize( indexSize );
+	for( int slot = other.NextFullSlot( 0 ); slot < indexSize; slot = other.NextFullSlot( slot + 1 ) ) {
+		::new( getSlotPtr( slot ) ) ContainedType( copy( other.GetValue( slot ) ) );
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+CFlatHashIndex<ContainedType, HashStrategy, Allocator>::~CFlatHashIndex()
+{
+	FreeBuffer();
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+unsigned CFlatHashIndex<ContainedType, HashStrategy, Allocator>::mixHash( int hash )
+{
+	// Hash strategies for integers and pointers return the key itself.
+	// Multiplication by a golden ratio constant spreads the key bits over both the probe position and the hash tail.
+	const unsigned __int64 product = static_cast<unsigned __int64>( static_cast<unsigned>( hash ) ) * 0x9E3779B97F4A7C15ULL;
+	return static_cast<unsigned>( product ^ ( product >> 32 ) );
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+int CFlatHashIndex<ContainedType, HashStrategy, Allocator>::getMaxLoad( int indexSize )
+{
+	// The index uses a compile-time defined maximum load factor of 87.5%.
+	return indexSize - indexSize / 8;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+int CFlatHashIndex<ContainedType, HashStrategy, Allocator>::getRequiredIndexSize( int elementCount )
+{
+	const int minIndexSize = elementCount + ( elementCount + 6 ) / 7;
+	return max( GetPow2HashTableSize( minIndexSize ), flatGroupSize );
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::ReserveBuffer( int size )
+{
+	if( size > elementCount + growthLeft ) {
+		rehash( getRequiredIndexSize( size ) );
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::Empty()
+{
+	if( elementCount != 0 ) {
+		destroyElements();
+		elementCount = 0;
+	}
+	// Deleted slots stay marked even in an empty index, so the control bytes are always reset.
+	if( IndexSize() > 0 ) {
+		::memset( control.Ptr(), flatControlEmpty, control.Size() );
+	}
+	growthLeft = getMaxLoad( IndexSize() );
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::FreeBuffer()
+{
+	if( elementCount != 0 ) {
+		destroyElements();
+		elementCount = 0;
+	}
+	control.FreeBuffer();
+	slots.FreeBuffer();
+	growthLeft = 0;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::destroyElements()
+{
+	const int indexSize = IndexSize();
+	for( int slot = NextFullSlot( 0 ); slot < indexSize; slot = NextFullSlot( slot + 1 ) ) {
+		ContainedType& elem = *getSlotPtr( slot );
+		elem;
+		elem.~ContainedType();
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+template <class Key>
+int CFlatHashIndex<ContainedType, HashStrategy, Allocator>::Find( int hash, const Key& key ) const
+{
+	if( elementCount == 0 ) {
+		return NotFound;
+	}
+
+	const unsigned mixedHash = mixHash( hash );
+	const signed char hashTail = getHashTail( mixedHash );
+	const int indexMask = mask();
+	int groupPos = ( mixedHash >> 7 ) & indexMask;
+	// Groups are probed with triangular steps, this visits every group in a power of 2 sized table.
+	for( int step = flatGroupSize; ; step += flatGroupSize ) {
+		const CFlatHashGroup group( control.Ptr() + groupPos );
+		for( unsigned matchMask = group.Match( hashTail ); matchMask != 0; matchMask &= matchMask - 1 ) {
+			const int slot = ( groupPos + CFlatHashGroup::TrailingZeroCount( matchMask ) ) & indexMask;
+			if( HashStrategy::IsEqual( key, GetValue( slot ) ) ) {
+				return slot;
+			}
+		}
+		// Insertion never skips an empty slot, so the probe sequence ends here.
+		if( group.MatchEmpty() != 0 ) {
+			return NotFound;
+		}
+		groupPos = ( groupPos + step ) & indexMask;
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+int CFlatHashIndex<ContainedType, HashStrategy, Allocator>::findFreeSlot( unsigned mixedHash ) const
+{
+	const int indexMask = mask();
+	int groupPos = ( mixedHash >> 7 ) & indexMask;
+	for( int step = flatGroupSize; ; step += flatGroupSize ) {
+		const unsigned freeMask = CFlatHashGroup( control.Ptr() + groupPos ).MatchEmptyOrDeleted();
+		if( freeMask != 0 ) {
+			return ( groupPos + CFlatHashGroup::TrailingZeroCount( freeMask ) ) & indexMask;
+		}
+		groupPos = ( groupPos + step ) & indexMask;
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+int CFlatHashIndex<ContainedType, HashStrategy, Allocator>::NextFullSlot( int startSlot ) const
+{
+	const int indexSize = IndexSize();
+	for( int groupPos = startSlot; groupPos < indexSize; groupPos += flatGroupSize ) {
+		const unsigned fullMask = CFlatHashGroup( control.Ptr() + groupPos ).MatchFull();
+		if( fullMask != 0 ) {
+			// Bits past the table end correspond to the cloned bytes and must not be reported.
+			return min( groupPos + CFlatHashGroup::TrailingZeroCount( fullMask ), indexSize );
+		}
+	}
+	return indexSize;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+ContainedType& CFlatHashIndex<ContainedType, HashStrategy, Allocator>::GetValue( int slot )
+{
+	assert( control[slot] >= 0 );
+	return *getSlotPtr( slot );
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::setControl( int slot, signed char value )
+{
+	control[slot] = value;
+	if( slot < flatGroupSize ) {
+		control[IndexSize() + slot] = value;
+	}
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+template <class... Args>
+ContainedType& CFlatHashIndex<ContainedType, HashStrategy, Allocator>::Insert( int hash, Args&&... containedTypeArgs )
+{
+	if( IndexSize() == 0 ) {
+		rehash( getRequiredIndexSize( 1 ) );
+	}
+
+	const unsigned mixedHash = mixHash( hash );
+	int slot = findFreeSlot( mixedHash );
+	if( growthLeft == 0 && control[slot] != flatControlDeleted ) {
+		// Rehashing drops all the deleted slots. The index only grows if the table is actually loaded.
+		const int indexSize = IndexSize();
+		const int newIndexSize = elementCount * 16 <= indexSize * 7 ? indexSize : indexSize * 2;
+		rehash( newIndexSize );
+		slot = findFreeSlot( mixedHash );
+	}
+
+	ContainedType* result = ::new( getSlotPtr( slot ) ) ContainedType( forward<Args>( containedTypeArgs )... );
+	if( control[slot] == flatControlEmpty ) {
+		growthLeft--;
+	}
+	setControl( slot, getHashTail( mixedHash ) );
+	elementCount++;
+	return *result;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::DeleteSlot( int slot )
+{
+	ContainedType& elem = GetValue( slot );
+	elem;
+	elem.~ContainedType();
+	elementCount--;
+
+	// If every group that contains the slot also contains an empty slot, no probe sequence has ever passed this slot.
+	// In this case the slot can be made empty again instead of leaving a deleted marker.
+	const int indexMask = mask();
+	const unsigned emptyBefore = CFlatHashGroup( control.Ptr() + ( ( slot - flatGroupSize ) & indexMask ) ).MatchEmpty();
+	const unsigned emptyAfter = CFlatHashGroup( control.Ptr() + slot ).MatchEmpty();
+	const bool wasNeverFull = emptyBefore != 0 && emptyAfter != 0
+		&& CFlatHashGroup::TrailingZeroCount( emptyAfter ) + CFlatHashGroup::LeadingZeroCount( emptyBefore ) < flatGroupSize;
+	if( wasNeverFull ) {
+		setControl( slot, flatControlEmpty );
+		growthLeft++;
+	} else {
+		setControl( slot, flatControlDeleted );
+	}
+}
+
+// Move all the elements to a new index of the given size.
+template <class ContainedType, class HashStrategy, class Allocator>
+void CFlatHashIndex<ContainedType, HashStrategy, Allocator>::rehash( int newIndexSize )
+{
+	assert( newIndexSize >= flatGroupSize && getMaxLoad( newIndexSize ) > elementCount );
+	// Moved arrays keep their allocator, so new buffers are allocated in the same place.
+	CArray<signed char, Allocator> oldControl( move( control ) );
+	CArray<TSlot, Allocator> oldSlots( move( slots ) );
+	control.IncreaseSizeNoInitialize( newIndexSize + flatGroupSize );
+	::memset( control.Ptr(), flatControlEmpty, control.Size() );
+	slots.IncreaseSizeNoInitialize( newIndexSize );
+
+	const int oldIndexSize = oldSlots.Size();
+	for( int slot = 0; slot < oldIndexSize; slot++ ) {
+		if( oldControl[slot] < 0 ) {
+			continue;
+		}
+		ContainedType& oldElem = *reinterpret_cast<ContainedType*>( oldSlots[slot].Data );
+		const unsigned mixedHash = mixHash( HashStrategy::HashKey( oldElem ) );
+		const int newSlot = findFreeSlot( mixedHash );
+		::new( getSlotPtr( newSlot ) ) ContainedType( move( oldElem ) );
+		oldElem.~ContainedType();
+		setControl( newSlot, getHashTail( mixedHash ) );
+	}
+	growthLeft = getMaxLoad( newIndexSize ) - elementCount;
+}
+
+template <class ContainedType, class HashStrategy, class Allocator>
+CFlatHashIndex<ContainedType, HashStrategy, Allocator>& CFlatHashIndex<ContainedType, HashStrategy, Allocator>::operator=( CFlatHashIndex<ContainedType, HashStrategy, Allocator>&& other )
+{
+	FreeBuffer();
+	control = move( other.control );
+	slots = move( other.slots );
+	elementCount = other.elementCount;
+	growthLeft = other.growthLeft;
+	other.elementCount = 0;
+	other.growthLeft = 0;
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
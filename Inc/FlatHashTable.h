@@ -0,0 +1,220 @@
+#pragma once
+
+#include <Redefs.h>
+#include <FlatHashIndex.h>
+#include <HashUtils.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// The open addressing hash table template.
+// Uses HashStrategy::HashKey to hash values.
+// Uses HashStrategy::IsEqual to compare values.
+// The interface matches CHashTable, the difference is in the storage: elements are kept in a single flat buffer and probed with SIMD.
+// This makes lookups of small keys much faster, but references to elements are invalidated on insertion.
+template<class Elem, class HashStrategy = CDefaultHash<Elem>, class Allocator = CRuntimeHeap>
+class CFlatHashTable {
+public:
+	typedef Elem ElemType;
+
+	CFlatHashTable() = default;
+	// Custom dynamic allocator.
+	explicit CFlatHashTable( Allocator& allocator );
+	// Explicit copy constructor.
+	template <class Container>
+	CFlatHashTable( const Container& other, const CExplicitCopyTag& );
+	template <class OtherAllocator>
+	CFlatHashTable( const CFlatHashTable<Elem, HashStrategy, OtherAllocator>& other, const CExplicitCopyTag& );
+	// Move constructor.
+	CFlatHashTable( CFlatHashTable&& other );
+
+	~CFlatHashTable();
+
+	int IndexSize() const
+		{ return hashIndex.IndexSize(); }
+	int Size() const
+		{ return hashIndex.Size(); }
+	void ReserveBuffer( int size );
+	bool IsEmpty() const
+		{ return hashIndex.IsEmpty(); }
+
+	// Getting, checking and setting values.
+	// Set a new value. If an equal value is already set, do nothing and return false.
+	template <class Key>
+	bool Set( Key&& elem );
+	// Get an existing value or create it using key as the constructor argument.
+	template <class Key>
+	const Elem& GetOrCreateValue( Key&& key );
+	// Get an existing value or create it using the specified creation function.
+	template <class Key, class Creator>
+	const Elem& GetOrCreateValue( Key&& key, const Creator& createFunc );
+	// Get a hash table element that IsEqual to key. Return nullptr if no element is found.
+	template <class Key>
+	const Elem* Get( const Key& key ) const;
+
+	// Redaction.
+	template <class Key>
+	void Delete( const Key& elem );
+	// Delete all.
+	void Empty();
+	// Delete all and free buffer.
+	void FreeBuffer();
+
+	// Moving objects from another hash table.
+	// Destination is emptied before all operations.
+	const CFlatHashTable& operator=( CFlatHashTable&& other );
+
+	template <class Key>
+	bool HasValue( const Key& elem ) const
+		{ return Get( elem ) != nullptr; }
+
+	// Range-based for loops support.
+	auto begin() const
+		{ return RelibInternal::CFlatHashIndexConstIterator<Elem, HashStrategy, Allocator>( hashIndex, hashIndex.NextFullSlot( 0 ) ); }
+	auto end() const
+		{ return RelibInternal::CFlatHashIndexConstIterator<Elem, HashStrategy, Allocator>( hashIndex, hashIndex.IndexSize() ); }
+
+	// Copying between allocators requires access to the index.
+	template <class OtherElem, class OtherStrategy, class OtherAllocator>
+	friend class CFlatHashTable;
+
+private:
+	// Base index of the table.
+	RelibInternal::CFlatHashIndex<Elem, HashStrategy, Allocator> hashIndex;
+
+	// Copying is prohibited.
+	CFlatHashTable( const CFlatHashTable& ) = delete;
+	void operator=( const CFlatHashTable& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Elem, class HashStrategy, class Allocator>
+CFlatHashTable<Elem, HashStrategy, Allocator>::CFlatHashTable( Allocator& allocator ) :
+	hashIndex( allocator )
+{
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Container>
+CFlatHashTable<Elem, HashStrategy, Allocator>::CFlatHashTable( const Container& other, const CExplicitCopyTag& )
+{
+	ReserveBuffer( other.Size() );
+	for( const auto& elem : other ) {
+		Set( elem );
+	}
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class OtherAllocator>
+CFlatHashTable<Elem, HashStrategy, Allocator>::CFlatHashTable( const CFlatHashTable<Elem, HashStrategy, OtherAllocator>& other, const CExplicitCopyTag& ) :
+	hashIndex( copy( other.hashIndex ) )
+{
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+CFlatHashTable<Elem, HashStrategy, Allocator>::CFlatHashTable( CFlatHashTable&& other ) :
+	hashIndex( move( other.hashIndex ) )
+{
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+CFlatHashTable<Elem, HashStrategy, Allocator>::~CFlatHashTable()
+{
+	FreeBuffer();
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+void CFlatHashTable<Elem, HashStrategy, Allocator>::ReserveBuffer( int size )
+{
+	hashIndex.ReserveBuffer( size );
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Key>
+bool CFlatHashTable<Elem, HashStrategy, Allocator>::Set( Key&& elem )
+{
+	const int hash = HashStrategy::HashKey( elem );
+	if( hashIndex.Find( hash, elem ) != NotFound ) {
+		return false;
+	}
+
+	hashIndex.Insert( hash, forward<Key>( elem ) );
+	return true;
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Key>
+const Elem& CFlatHashTable<Elem, HashStrategy, Allocator>::GetOrCreateValue( Key&& key )
+{
+	const int hash = HashStrategy::HashKey( key );
+	const int slot = hashIndex.Find( hash, key );
+	if( slot != NotFound ) {
+		return hashIndex.GetValue( slot );
+	}
+
+	return hashIndex.Insert( hash, forward<Key>( key ) );
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Key, class Creator>
+const Elem& CFlatHashTable<Elem, HashStrategy, Allocator>::GetOrCreateValue( Key&& key, const Creator& createFunc )
+{
+	const int hash = HashStrategy::HashKey( key );
+	const int slot = hashIndex.Find( hash, key );
+	if( slot != NotFound ) {
+		return hashIndex.GetValue( slot );
+	}
+
+	return hashIndex.Insert( hash, createFunc( forward<Key>( key ) ) );
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Key>
+const Elem* CFlatHashTable<Elem, HashStrategy, Allocator>::Get( const Key& key ) const
+{
+	if( hashIndex.IsEmpty() ) {
+		return nullptr;
+	}
+
+	const int slot = hashIndex.Find( HashStrategy::HashKey( key ), key );
+	return slot == NotFound ? nullptr : &hashIndex.GetValue( slot );
+}
+
+template <class Elem, class HashStrategy, class Allocator>
+template <class Key>
+void CFlatHashTable<Elem, HashStrategy, Allocator>::Delete( const Key& key )
+{
+	if( hashIndex.IsEmpty() ) {
+		return;
+	}
+
+	const int slot = hashIndex.Find( HashStrategy::HashKey( key ), key );
+	if( slot != NotFound ) {
+		hashIndex.DeleteSlot( slot );
+	}
+}
+
+template<class Elem, class HashStrategy, class Allocator>
+void CFlatHashTable<Elem, HashStrategy, Allocator>::Empty()
+{
+	hashIndex.Empty();
+}
+
+template<class Elem, class HashStrategy, class Allocator>
+void CFlatHashTable<Elem, HashStrategy, Allocator>::FreeBuffer()
+{
+	hashIndex.FreeBuffer();
+}
+
+template<class Elem, class HashStrategy, class Allocator>
+const CFlatHashTable<Elem, HashStrategy, Allocator>& CFlatHashTable<Elem, HashStrategy, Allocator>::operator=( CFlatHashTable<Elem, HashStrategy, Allocator>&& other )
+{
+	hashIndex = move( other.hashIndex );
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
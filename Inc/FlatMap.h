@@ -0,0 +1,249 @@
+#pragma once
+
+#include <Redefs.h>
+#include <FlatHashIndex.h>
+#include <MapUtils.h>
+#include <TemplateUtils.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// The open addressing map template.
+// Uses HashStrategy::HashKey to hash values.
+// Uses HashStrategy::IsEqual to compare values.
+// The class mirrors CMap on top of a flat hash index. Keys are unique, so there is no Add and AllValues.
+// References to the map data are invalidated on insertion.
+template<class KeyType, class ValueType, class HashStrategy = CDefaultHash<KeyType>, class Allocator = CRuntimeHeap>
+class CFlatMap {
+public:
+	typedef KeyType KeyElemType;
+	typedef ValueType ValueElemType;
+	typedef RelibInternal::CMapHashStrategy<KeyType, ValueType, HashStrategy> TMapHashStrategy;
+
+	CFlatMap() = default;
+	// Custom dynamic allocator.
+	explicit CFlatMap( Allocator& allocator );
+	// Explicit copy constructor.
+	template <class Container>
+	CFlatMap( const Container& other, const CExplicitCopyTag& );
+	template <class OtherAllocator>
+	CFlatMap( const CFlatMap<KeyType, ValueType, HashStrategy, OtherAllocator>& other, const CExplicitCopyTag& );
+	CFlatMap( CFlatMap&& other );
+	~CFlatMap();
+
+	int IndexSize() const
+		{ return hashIndex.IndexSize(); }
+	int Size() const
+		{ return hashIndex.Size(); }
+	bool IsEmpty() const
+		{ return Size() == 0; }
+	void ReserveBuffer( int size );
+
+	// Sets the value for the given key. The previous value associated with this key is destroyed.
+	// Returns a reference to a newly created value.
+	template <class Key, class... Args>
+	CMapData<KeyType, ValueType>& Set( Key&& key, Args&&... valueArgs );
+
+	// Get the value. If it's not present, null is returned.
+	template <class Key>
+	ValueType* Get( const Key& key );
+	template <class Key>
+	const ValueType* Get( const Key& key ) const;
+	// Get the value. It must be present in the map.
+	template <class Key>
+	ValueType& operator[]( const Key& key );
+	template <class Key>
+	const ValueType& operator[]( const Key& key ) const;
+
+	// Get the value for the given key, or create one with given arguments.
+	template <class Key, class... Args>
+	CMapData<KeyType, ValueType>& GetOrCreate( Key&& key, Args&&... valueArgs );
+
+	// Check if a key-value pair with a given key is present in this map.
+	template <class Key>
+	bool Has( const Key& key ) const;
+
+	// Redaction.
+	template <class Key>
+	void Delete( const Key& key );
+	// Delete all.
+	void Empty();
+	// Delete all and free buffer.
+	void FreeBuffer();
+
+	// Iteration.
+	auto begin()
+		{ return RelibInternal::CFlatHashIndexIterator<CMapData<KeyType, ValueType>, TMapHashStrategy, Allocator>( hashIndex, hashIndex.NextFullSlot( 0 ) ); }
+	auto begin() const
+		{ return RelibInternal::CFlatHashIndexConstIterator<CMapData<KeyType, ValueType>, TMapHashStrategy, Allocator>( hashIndex, hashIndex.NextFullSlot( 0 ) ); }
+	auto end()
+		{ return RelibInternal::CFlatHashIndexIterator<CMapData<KeyType, ValueType>, TMapHashStrategy, Allocator>( hashIndex, hashIndex.IndexSize() ); }
+	auto end() const
+		{ return RelibInternal::CFlatHashIndexConstIterator<CMapData<KeyType, ValueType>, TMapHashStrategy, Allocator>( hashIndex, hashIndex.IndexSize() ); }
+
+	// Moving objects to another map.
+	// Destination is emptied before all operations.
+	const CFlatMap& operator=( CFlatMap&& other );
+
+	// Copying between allocators requires access to the index.
+	template <class OtherKey, class OtherValue, class OtherStrategy, class OtherAllocator>
+	friend class CFlatMap;
+
+private:
+	RelibInternal::CFlatHashIndex<CMapData<KeyType, ValueType>, TMapHashStrategy, Allocator> hashIndex;
+
+	template <class Key>
+	int findSlot( const Key& key ) const;
+
+	// Copying is prohibited.
+	CFlatMap( CFlatMap& ) = delete;
+	void operator=( CFlatMap& ) = delete;
+};
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::CFlatMap( Allocator& allocator ) :
+	hashIndex( allocator )
+{
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Container>
+CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::CFlatMap( const Container& src, const CExplicitCopyTag& )
+{
+	ReserveBuffer( src.Size() );
+	for( const auto& elem : src ) {
+		Set( elem.Key(), copy( elem.Value() ) );
+	}
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class OtherAllocator>
+CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::CFlatMap( const CFlatMap<KeyType, ValueType, HashStrategy, OtherAllocator>& src, const CExplicitCopyTag& ) :
+	hashIndex( copy( src.hashIndex ) )
+{
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::CFlatMap( CFlatMap<KeyType, ValueType, HashStrategy, Allocator>&& other ) :
+	hashIndex( move( other.hashIndex ) )
+{
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::~CFlatMap()
+{
+	FreeBuffer();
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+void CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::ReserveBuffer( int size )
+{
+	hashIndex.ReserveBuffer( size );
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+int CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::findSlot( const Key& key ) const
+{
+	if( hashIndex.IsEmpty() ) {
+		return NotFound;
+	}
+	return hashIndex.Find( HashStrategy::HashKey( key ), key );
+}
+
+template <class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key, class... Args>
+CMapData<KeyType,ValueType>& CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Set( Key&& key, Args&&... valueArgs )
+{
+	const int hash = HashStrategy::HashKey( key );
+	const int slot = hashIndex.Find( hash, key );
+	if( slot != NotFound ) {
+		hashIndex.DeleteSlot( slot );
+	}
+	return hashIndex.Insert( hash, forward<Key>( key ), forward<Args>( valueArgs )... );
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+ValueType* CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Get( const Key& key )
+{
+	const int slot = findSlot( key );
+	return slot == NotFound ? nullptr : &hashIndex.GetValue( slot ).Value();
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+const ValueType* CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Get( const Key& key ) const
+{
+	return const_cast<CFlatMap<KeyType, ValueType, HashStrategy, Allocator>*>( this )->Get( key );
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+ValueType& CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::operator[]( const Key& key )
+{
+	const int slot = findSlot( key );
+	assert( slot != NotFound );
+	return hashIndex.GetValue( slot ).Value();
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+const ValueType& CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::operator[]( const Key& key ) const
+{
+	return const_cast<CFlatMap<KeyType, ValueType, HashStrategy, Allocator>*>( this )->operator[]( key );
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key, class... Args>
+CMapData<KeyType, ValueType>& CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::GetOrCreate( Key&& key, Args&&... valueArgs )
+{
+	const int hash = HashStrategy::HashKey( key );
+	const int slot = hashIndex.Find( hash, key );
+	if( slot != NotFound ) {
+		return hashIndex.GetValue( slot );
+	}
+
+	return hashIndex.Insert( hash, forward<Key>( key ), forward<Args>( valueArgs )... );
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+bool CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Has( const Key& key ) const
+{
+	return findSlot( key ) != NotFound;
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+template <class Key>
+void CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Delete( const Key& key )
+{
+	const int slot = findSlot( key );
+	if( slot != NotFound ) {
+		hashIndex.DeleteSlot( slot );
+	}
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+void CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::Empty()
+{
+	hashIndex.Empty();
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+void CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::FreeBuffer()
+{
+	hashIndex.FreeBuffer();
+}
+
+template<class KeyType, class ValueType, class HashStrategy, class Allocator>
+const CFlatMap<KeyType, ValueType, HashStrategy, Allocator>& CFlatMap<KeyType, ValueType, HashStrategy, Allocator>::operator=( CFlatMap<KeyType, ValueType, HashStrategy, Allocator>&& other )
+{
+	hashIndex = move( other.hashIndex );
+	return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
@@ -6,6 +6,12 @@ namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
+// Result of the asynchronous actions that return void.
+struct CEmptyTaskResult {
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 // Class representing a value that is currently being created somewhere else.
 template <class T> 
 class CFuture {
@@ -24,6 +30,7 @@ public:
 		{ sharedState = nullptr; }
 
 	// Wait for the value to be created and retrieve it.
+	// If the future is abandoned, the abandonment reason is rethrown. CAbandonedFutureException is thrown if there's no reason.
 	T& GetValue();
 	const T& GetValue() const;
 
@@ -40,6 +47,16 @@ public:
 	// Given action takes the created value as its argument and its return value is wrapped in a future and returned from this method.
 	template <class Func>
 	auto Then( Func&& action );
+	// Create a continuation that will be scheduled on the executor when the promise is fulfilled.
+	// Executor must provide an Execute method that takes an action without arguments, CThreadPool is an example.
+	// Returns a future for the action result. Actions that return void produce CEmptyTaskResult.
+	// The returned future is abandoned if this future is abandoned or the action throws.
+	template <class Executor, class Func>
+	auto Then( Executor& executor, Func&& action );
+	// Attach an action that takes the value and an action that takes the abandonment reason as std::exception_ptr.
+	// Exactly one of the actions is run, the reason may be null.
+	template <class Func, class AbandonFunc>
+	void ThenOrAbandoned( Func&& action, AbandonFunc&& abandonAction );
 
 	// A promise needs access to shared state for comparison.
 	friend class CPromise<T>;
@@ -102,6 +119,34 @@ inline auto CFuture<T>::Then( Func&& action )
 	return sharedState->AttachContinuation( forward<Func>( action ) );
 }
 
+template<class T>
+template<class Executor, class Func>
+inline auto CFuture<T>::Then( Executor& executor, Func&& action )
+{
+	staticAssert( Types::FunctionInfo<Func>::ArgCount == 1 );
+	typedef typename Types::FunctionInfo<Func>::ReturnType TReturnType;
+	typedef typename Types::Conditional<Types::IsSame<TReturnType, void>::Result, CEmptyTaskResult, TReturnType>::Result TResultType;
+	auto resultState = CreateShared<RelibInternal::CFutureSharedState<TResultType>, CProcessHeap>();
+	// The continuation is run once, so the action is moved to the scheduled task.
+	auto continuation = [&executor, state = sharedState, resultState, userAction = forward<Func>( action )]( T& ) mutable {
+		executor.Execute( [state, resultState, userAction = move( userAction )]() mutable {
+			resultState->CreateValueFromAction( userAction, state->WaitForValue() );
+		} );
+	};
+	auto abandonAction = [resultState]( const std::exception_ptr& reason ) {
+		resultState->Abandon( reason );
+	};
+	sharedState->AttachContinuation( move( continuation ), move( abandonAction ) );
+	return CFuture<TResultType>( move( resultState ) );
+}
+
+template<class T>
+template<class Func, class AbandonFunc>
+inline void CFuture<T>::ThenOrAbandoned( Func&& action, AbandonFunc&& abandonAction )
+{
+	sharedState->AttachContinuation( forward<Func>( action ), forward<AbandonFunc>( abandonAction ) );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 namespace RelibInternal {
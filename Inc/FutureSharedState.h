@@ -1,29 +1,46 @@
 #pragma once
 #include <Redefs.h>
-#include <ReadWriteLock.h>
+#include <Atomic.h>
 #include <Optional.h>
 #include <Reassert.h>
 #include <Remath.h>
 #include <Action.h>
 #include <Ptr.h>
 #include <StaticAllocators.h>
+#include <Errors.h>
+#include <exception>
+
+// WaitOnAddress and WakeByAddressAll are exported by the synchronization library.
+#pragma comment( lib, "Synchronization.lib" )
 
 namespace Relib {
 
 template <class T>
 class CFuture;
 
+// Exception thrown when waiting for a future that has been abandoned without a reason, e.g. its promise has been destroyed.
+class CAbandonedFutureException : public CException {
+public:
+	// CException.
+	virtual CString GetMessageText() const override final
+		{ return CString( "The future has been abandoned." ); }
+};
+
 namespace RelibInternal {
 
 //////////////////////////////////////////////////////////////////////////
 
+// State of a future that is shared between the promise and its futures.
+// The state is driven by a single atomic word that is either a special value or a pointer to the last attached continuation.
 template <class T>
 class CFutureSharedState {
 public:
-	CFutureSharedState();
+	CFutureSharedState() = default;
+	~CFutureSharedState();
 
 	// Mark the future as the one that will never be completed.
-	void Abandon();
+	// Waiters rethrow the reason or throw CAbandonedFutureException if the reason is null.
+	void Abandon( std::exception_ptr reason = nullptr );
 
 	T& WaitForValue();
 	const T& WaitForValue() const;
@@ -33,88 +50,182 @@ public:
 
 	template <class... Args>
 	void CreateValue( Args&&... createArgs );
+	// Create the value from the action result. Actions that return void create a default value.
+	// Exceptions thrown by the action abandon the state with the exception as a reason.
+	template <class Action, class... Args>
+	void CreateValueFromAction( Action& action, Args&&... args );
 
 	template <class Func>
 	auto AttachContinuation( Func&& action );
+	// Attach a value continuation and an action that takes the abandonment reason.
+	template <class Func, class AbandonFunc>
+	void AttachContinuation( Func&& action, AbandonFunc&& abandonAction );
 
 private:
-	CReadWriteSection valueSection;
-	COptional<CWriteLock> sectionLock;
+	// Continuation that waits for the value in an intrusive list.
+	class CContinuationNode {
+	public:
+		CContinuationNode* Next = nullptr;
+
+		virtual ~CContinuationNode() = default;
+		virtual void Invoke( T& value ) = 0;
+		virtual void Abandon( const std::exception_ptr& reason ) = 0;
+	};
+
+	template <class InvokeAction, class AbandonAction>
+	class CContinuation : public CContinuationNode {
+	public:
+		template <class InvokeArg, class AbandonArg>
+		CContinuation( InvokeArg&& _invokeAction, AbandonArg&& _abandonAction ) : 
+			invokeAction( forward<InvokeArg>( _invokeAction ) ), abandonAction( forward<AbandonArg>( _abandonAction ) ) {}
+
+		void Invoke( T& value ) override final
+			{ invokeAction( value ); }
+		void Abandon( const std::exception_ptr& reason ) override final
+			{ abandonAction( reason ); }
+
+	private:
+		InvokeAction invokeAction;
+		AbandonAction abandonAction;
+	};
+
+	// Special state values. Any other value is a pointer to the head of the continuation list.
+	static const UINT_PTR emptyState = 0;
+	static const UINT_PTR valueState = 1;
+	static const UINT_PTR abandonedState = 2;
+
+	CAtomic<UINT_PTR> state{ emptyState };
 	COptional<T> value;
-	CReadWriteSection continuationSection;
-	CActionOwner<void( T& )> continuationAction;
-	CActionOwner<void()> abandonAction;
-	bool isAbandoned = false;
+	// Written before the state becomes abandoned.
+	std::exception_ptr abandonReason;
 
-	template <class Func>
-	auto attachContinuation( Func&& action, Types::FalseType voidReturnMark );
-	template <class Func>
-	void attachContinuation( Func&& action, Types::TrueType voidReturnMark );
+	// The state word is used as a wait address.
+	staticAssert( sizeof( CAtomic<UINT_PTR> ) == sizeof( UINT_PTR ) );
+
+	void waitForValue() const;
+	template <class InvokeAction, class AbandonAction>
+	void attachNode( InvokeAction&& invokeAction, AbandonAction&& abandonAction );
+	static CContinuationNode* getNodeList( UINT_PTR stateValue );
+	static CContinuationNode* reverseNodeList( CContinuationNode* head );
+	static void destroyNode( CContinuationNode* node );
 };
 
 //////////////////////////////////////////////////////////////////////////
 
 template<class T>
-inline CFutureSharedState<T>::CFutureSharedState() :
-	sectionLock( valueSection )
+inline CFutureSharedState<T>::~CFutureSharedState()
 {
+	// Continuations of a future that has never been completed or abandoned are deleted without being run.
+	auto node = getNodeList( state.Load( std::memory_order_acquire ) );
+	while( node != nullptr ) {
+		const auto next = node->Next;
+		destroyNode( node );
+		node = next;
+	}
 }
 
 template<class T>
-inline void CFutureSharedState<T>::Abandon()
+inline void CFutureSharedState<T>::Abandon( std::exception_ptr reason )
 {
-	CWriteLock lock( continuationSection );
-	continuationAction = CActionOwner<void( T& )>();
-	if( !abandonAction.IsNull() ) {
-		abandonAction();
-		abandonAction = CActionOwner<void()>();
+	abandonReason = move( reason );
+	const auto prevState = state.Exchange( abandonedState, std::memory_order_acq_rel );
+	assert( prevState != valueState && prevState != abandonedState );
+	::WakeByAddressAll( &state );
+
+	auto node = reverseNodeList( getNodeList( prevState ) );
+	while( node != nullptr ) {
+		const auto next = node->Next;
+		node->Abandon( abandonReason );
+		destroyNode( node );
+		node = next;
 	}
-	isAbandoned = true;
 }
 
 template<class T>
 inline T& CFutureSharedState<T>::WaitForValue()
 {
-	CReadLock lock( valueSection );
-	assert( value.IsValid() );
+	waitForValue();
 	return *value;
 }
 
 template<class T>
 inline const T& CFutureSharedState<T>::WaitForValue() const
 {
-	CReadLock lock( valueSection );
-	assert( value.IsValid() );
+	waitForValue();
 	return *value;
 }
 
+template<class T>
+inline void CFutureSharedState<T>::waitForValue() const
+{
+	auto currentState = state.Load( std::memory_order_acquire );
+	while( currentState != valueState ) {
+		if( currentState == abandonedState ) {
+			if( abandonReason != nullptr ) {
+				std::rethrow_exception( abandonReason );
+			}
+			throw CAbandonedFutureException();
+		}
+		::WaitOnAddress( const_cast<CAtomic<UINT_PTR>*>( &state ), &currentState, sizeof( currentState ), INFINITE );
+		currentState = state.Load( std::memory_order_acquire );
+	}
+	assert( value.IsValid() );
+}
+
 template<class T>
 inline T* CFutureSharedState<T>::TryGetValue()
 {
-	auto lock = valueSection.TryLockRead();
-	return lock.IsValid() ? &( *value ) : nullptr;
+	return state.Load( std::memory_order_acquire ) == valueState ? &( *value ) : nullptr;
 }
 
 template<class T>
 inline const T* CFutureSharedState<T>::TryGetValue() const
 {
-	auto lock = valueSection.TryLockRead();
-	return lock.IsValid() ? &( *value ) : nullptr;
+	return state.Load( std::memory_order_acquire ) == valueState ? &( *value ) : nullptr;
 }
 
 template<class T>
 template<class... Args>
 inline void CFutureSharedState<T>::CreateValue( Args&&... createArgs )
 {
-	CWriteLock lock( continuationSection );
-	assert( !isAbandoned && !value.IsValid() );
+	assert( !value.IsValid() );
 	value.CreateValue( forward<Args>( createArgs )... );
-	sectionLock.DeleteValue();
-	
-	if( !continuationAction.IsNull() ) {
-		continuationAction( *value );
-		continuationAction = CActionOwner<void( T& )>{};
-		abandonAction = CActionOwner<void()>();
+	const auto prevState = state.Exchange( valueState, std::memory_order_acq_rel );
+	assert( prevState != valueState && prevState != abandonedState );
+	::WakeByAddressAll( &state );
+
+	// Continuations are pushed to the head of the list, reverse it to run them in the attachment order.
+	auto node = reverseNodeList( getNodeList( prevState ) );
+	while( node != nullptr ) {
+		const auto next = node->Next;
+		node->Invoke( *value );
+		destroyNode( node );
+		node = next;
+	}
+}
+
+template<class T>
+template<class Action, class... Args>
+inline void CFutureSharedState<T>::CreateValueFromAction( Action& action, Args&&... args )
+{
+	// Only the action is guarded, exceptions from the continuations of this state are propagated to the caller.
+	if constexpr( Types::IsSame<decltype( action( forward<Args>( args )... ) ), void>::Result ) {
+		try {
+			action( forward<Args>( args )... );
+		} catch( ... ) {
+			Abandon( std::current_exception() );
+			return;
+		}
+		CreateValue();
+	} else {
+		COptional<T> result;
+		try {
+			result.CreateValue( action( forward<Args>( args )... ) );
+		} catch( ... ) {
+			Abandon( std::current_exception() );
+			return;
+		}
+		CreateValue( move( *result ) );
 	}
 }
 
@@ -122,58 +233,81 @@ template<class T>
 template<class Func>
 inline auto CFutureSharedState<T>::AttachContinuation( Func&& action )
 {
-	CWriteLock lock( continuationSection );
 	typedef typename Types::FunctionInfo<Func>::ReturnType TReturnType;
-	return attachContinuation( forward<Func>( action ), Types::IsSame<TReturnType, void>() );
+	if constexpr( Types::IsSame<TReturnType, void>::Result ) {
+		attachNode( forward<Func>( action ), []( const std::exception_ptr& ) {} );
+	} else {
+		auto continuationState = CreateShared<CFutureSharedState<TReturnType>, CProcessHeap>();
+		auto invokeAction = [state = continuationState, userAction = forward<Func>( action )]( T& arg ) mutable {
+			state->CreateValueFromAction( userAction, arg );
+		};
+		// Abandonment is propagated to the continuation state.
+		auto abandonAction = [state = continuationState]( const std::exception_ptr& reason ) {
+			state->Abandon( reason );
+		};
+		attachNode( move( invokeAction ), move( abandonAction ) );
+		return CFuture<TReturnType>( move( continuationState ) );
+	}
 }
 
 template<class T>
-template<class Func>
-inline auto CFutureSharedState<T>::attachContinuation( Func&& action, Types::FalseType /*voidReturnMark*/ )
+template<class Func, class AbandonFunc>
+inline void CFutureSharedState<T>::AttachContinuation( Func&& action, AbandonFunc&& abandonAction )
 {
-	typedef typename Types::FunctionInfo<Func>::ReturnType TReturnType;
-	auto continuationState = CreateShared<CFutureSharedState<TReturnType>, CProcessHeap>();
-	auto newAction = [prevAction = move( continuationAction ), state = continuationState, userAction = forward<Func>( action )]( T& arg ) {
-		if( !prevAction.IsNull() ) {
-			prevAction( arg );
+	attachNode( forward<Func>( action ), forward<AbandonFunc>( abandonAction ) );
+}
+
+template<class T>
+template<class InvokeAction, class AbandonAction>
+inline void CFutureSharedState<T>::attachNode( InvokeAction&& invokeAction, AbandonAction&& abandonAction )
+{
+	typedef CContinuation<typename Types::PureType<InvokeAction>::Result, typename Types::PureType<AbandonAction>::Result> TContinuation;
+	void* nodeMemory = RELIB_STATIC_ALLOCATE( CProcessHeap, sizeof( TContinuation ) );
+	CContinuationNode* node = ::new( nodeMemory ) TContinuation( forward<InvokeAction>( invokeAction ), forward<AbandonAction>( abandonAction ) );
+
+	auto currentState = state.Load( std::memory_order_acquire );
+	for( ;; ) {
+		if( currentState == valueState ) {
+			// Executed if the value is already created.
+			node->Invoke( *value );
+			destroyNode( node );
+			return;
+		} else if( currentState == abandonedState ) {
+			node->Abandon( abandonReason );
+			destroyNode( node );
+			return;
 		}
-		state->CreateValue( userAction( arg ) );
-	};
-	continuationAction = move( newAction );
-	// Attach an action that recursively abandons continuations.
-	auto newAbandonAction = [prevAction = move( abandonAction ), state = continuationState]() {
-		if( !prevAction.IsNull() ) {
-			prevAction();
+		node->Next = getNodeList( currentState );
+		if( state.CompareExchangeStrong( currentState, reinterpret_cast<UINT_PTR>( node ), std::memory_order_release, std::memory_order_acquire ) ) {
+			return;
 		}
-		state->Abandon();
-	};
-	abandonAction = move( newAbandonAction );
-	if( value.IsValid() ) {
-		// Executed if the value is already created.
-		continuationAction( *value );
-		continuationAction = CActionOwner<void( T& )>{};
-		abandonAction = CActionOwner<void()>();
 	}
-	return CFuture<TReturnType>( move( continuationState ) );
 }
 
 template<class T>
-template<class Func>
-inline void CFutureSharedState<T>::attachContinuation( Func&& action, Types::TrueType /*voidReturnMark*/ )
+inline typename CFutureSharedState<T>::CContinuationNode* CFutureSharedState<T>::getNodeList( UINT_PTR stateValue )
 {
-	auto newAction = [prevAction = move( continuationAction ), userAction = forward<Func>( action )]( T& arg ) {
-		if( !prevAction.IsNull() ) {
-			prevAction( arg );
-		}
-		userAction( arg );
-	};
-	continuationAction = move( newAction );
-	if( value.IsValid() ) {
-		// Executed if the value is already created.
-		continuationAction( *value );
-		continuationAction = CActionOwner<void( T& )>{};
-		abandonAction = CActionOwner<void()>();
+	return stateValue == valueState || stateValue == abandonedState ? nullptr : reinterpret_cast<CContinuationNode*>( stateValue );
+}
+
+template<class T>
+inline typename CFutureSharedState<T>::CContinuationNode* CFutureSharedState<T>::reverseNodeList( CContinuationNode* head )
+{
+	CContinuationNode* result = nullptr;
+	while( head != nullptr ) {
+		const auto next = head->Next;
+		head->Next = result;
+		result = head;
+		head = next;
 	}
+	return result;
+}
+
+template<class T>
+inline void CFutureSharedState<T>::destroyNode( CContinuationNode* node )
+{
+	node->~CContinuationNode();
+	CProcessHeap::Free( node );
 }
 
 //////////////////////////////////////////////////////////////////////////
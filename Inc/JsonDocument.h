@@ -7,6 +7,8 @@
 #include <StrConversions.h>
 #include <BaseString.h>
 #include <Errors.h>
+#include <JsonValues.h>
+#include <JsonStructuralIndex.h>
 
 namespace Relib {
 
@@ -22,6 +24,17 @@ struct CJsonListNode;
 struct CJsonKeyValue;
 //////////////////////////////////////////////////////////////////////////
 
+// JSON text parsing mode.
+enum TJsonParseMode {
+	// The whole text is parsed at once.
+	JPM_Full,
+	// Arrays and objects are parsed when their values are accessed for the first time.
+	// Bracket balance is checked during the creation, other syntax errors inside a container are reported on its first access.
+	JPM_OnDemand
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 class CJsonParseException : public CException {
 public:
 	explicit CJsonParseException( int _lineNumber, int _linePos ) : lineNumber( _lineNumber ), linePos( _linePos ) {}
@@ -37,7 +50,9 @@ private:
 //////////////////////////////////////////////////////////////////////////
 
 // Parsed JSON information.
-class REAPI CJsonDocument {
+// Parsing is done in two stages: positions of the structural characters are found with SIMD block classification, then the value tree is built from them.
+// Documents with values that haven't been parsed on demand yet must not be moved or accessed from several threads simultaneously.
+class REAPI CJsonDocument : public IJsonLazySource {
 public:
 	CJsonDocument() = default;
 
@@ -45,9 +60,9 @@ public:
 	bool IsEmpty() const
 		{ return root == nullptr; }
 
-	void CreateFromFile( CStringPart fileName );
-	void CreateFromFile( CFileReader& fileReader );
-	void CreateFromString( CStringPart str );
+	void CreateFromFile( CStringPart fileName, TJsonParseMode mode = JPM_Full );
+	void CreateFromFile( CFileReader& fileReader, TJsonParseMode mode = JPM_Full );
+	void CreateFromString( CStringPart str, TJsonParseMode mode = JPM_Full );
 
 	CString GetDocumentString() const;
 	CString GetFormattedString() const;
@@ -76,19 +91,24 @@ public:
 	CJsonObject& CreateObject();
 	void AddObjectValue( CJsonObject& obj, CStringPart key, CJsonValue& val );
 
+	// IJsonLazySource.
+	virtual void ExpandArray( CJsonDynamicArray& arr, int sourcePos ) override final;
+	virtual void ExpandObject( CJsonObject& obj, int sourcePos ) override final;
+
 private:
 	CArena<> jsonData;
 	CJsonValue* root = nullptr;
+	// Parsed text and its structural characters. Kept after the creation only for the on-demand parsing.
+	CStringView jsonText;
+	RelibInternal::CJsonStructuralIndex structuralIndex;
+	TJsonParseMode parseMode = JPM_Full;
 
-	struct CJsonPosition {
-		int Pos = 0;
-		int LineNumber = 1;
-		int LineStartPos = 0;
-	};
+	// Objects with at least this number of keys get a key index.
+	static const int keyIndexThreshold = 16;
 
-	void parseJson( CStringView jsonStr );
+	void parseJson( CStringView jsonStr, TJsonParseMode mode );
 
-	CStringView allocateStringView( CStringPart source );
+	CStringView allocateJsonText( CStringPart source );
 	CStringPart allocateStringPart( CStringPart source );
 	CRawBuffer allocateStringBuffer( CStringPart source, int length );
 	template <class T>
@@ -103,19 +123,20 @@ private:
 	CJsonDynamicArray& allocateJsonDynamicArray( CJsonListNode<CJsonValue*>* head, CJsonListNode<CJsonValue*>* tail, int size );
 	CJsonObject& allocateJsonObject( CJsonListNode<CJsonKeyValue>* head, CJsonListNode<CJsonKeyValue>* tail, int size );
 
-	void throwParseException( CJsonPosition parsePos ) const;
-	CJsonPosition getNextPos( CJsonPosition parsePos ) const;
-	CJsonPosition skipWhitespace( CStringView str, CJsonPosition startPos ) const;
-	CStringPart parseString( CStringView str, CJsonPosition& parsePos );
-	double parseNumber( CStringView str, CJsonPosition& parsePos ) const;
-	CJsonObject& parseObject( CStringView str, CJsonPosition& parsePos );
-	CJsonValue& parseArray( CStringView str, CJsonPosition& parsePos );
-	CJsonValue& parseValueList( CStringView str, CJsonPosition& parsePos, char terminator, CJsonValue& firstValue );
-	CJsonValue& parseValue( CStringView str, CJsonPosition& parsePos );
-	CJsonValue& parseElement( CStringView str, CJsonPosition& parsePos );
-
-	CStringPart replaceEscapeSequences( CStringView str, int firstEscapePos, CJsonPosition& parsePos );
-	char getEscapeCharacter( char escapeCode ) const;
+	void throwParseException( int textPos ) const;
+	void throwStructuralException( int index ) const;
+	char getStructuralChar( int index ) const;
+	CJsonValue& parseValue( int& index );
+	void parseArrayValues( CJsonDynamicArray& arr, int& index );
+	void parseObjectValues( CJsonObject& obj, int& index );
+	CStringPart parseString( int textPos );
+	double parseNumber( int textPos ) const;
+	void parseLiteral( int textPos, CStringView literal ) const;
+	void checkScalarEnd( int textPos ) const;
+
+	void buildKeyIndex( CJsonObject& obj );
+	void updateKeyIndex( CJsonObject& obj );
+	static void insertKeySlot( CJsonKeySlot* slots, int slotCount, CJsonListNode<CJsonKeyValue>& node );
 
 	void writeToString( const CJsonValue& value, int indentValue, CString& result ) const;
 	void writeToString( const CJsonNull& value, CString& result ) const;
@@ -0,0 +1,108 @@
+#pragma once
+#include <Redefs.h>
+#include <Array.h>
+#include <BaseStringPart.h>
+#include <FileViews.h>
+#include <JsonDocument.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Event of the streaming JSON reader.
+enum TJsonReadEvent {
+	JRE_StartObject,
+	JRE_EndObject,
+	JRE_StartArray,
+	JRE_EndArray,
+	// Object key. Key text is returned by GetString.
+	JRE_Key,
+	JRE_String,
+	JRE_Number,
+	JRE_Bool,
+	JRE_Null,
+	JRE_EnumCount
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Pull parser of a JSON stream.
+// The stream is read through a fixed buffer, so memory use doesn't depend on the stream size. The buffer only grows to fit a single string or number that is longer than the buffer.
+// Top level values may follow each other, which allows reading newline-delimited JSON.
+// Syntax errors are reported with CJsonParseException.
+class REAPI CJsonReader {
+public:
+	static const int DefaultBufferSize = 64 * 1024;
+
+	// File must stay open while the reader is used.
+	explicit CJsonReader( CFileReadView file, int bufferSize = DefaultBufferSize );
+
+	// Read the next event. Return false if the stream has ended after a complete top level value.
+	bool Read();
+
+	TJsonReadEvent GetEvent() const
+		{ return event; }
+	// Key or string of the last event. The string is valid until the next Read call.
+	CStringPart GetString() const
+		{ assert( event == JRE_Key || event == JRE_String ); return stringValue; }
+	double GetNumber() const
+		{ assert( event == JRE_Number ); return numberValue; }
+	bool GetBool() const
+		{ assert( event == JRE_Bool ); return boolValue; }
+	// Number of containers that are open after the last event.
+	int GetDepth() const
+		{ return containers.Size(); }
+
+	// Skip the contents of the container that has just been started. The last read event becomes the container end.
+	void SkipContainer();
+
+private:
+	// Parsing state.
+	enum TReaderState {
+		RS_Value,
+		RS_FirstValue,
+		RS_FirstKey,
+		RS_Colon,
+		RS_Separator
+	};
+
+	CFileReadView file;
+	// Text buffer. Unread data is moved to its start when more data is needed.
+	CArray<char> buffer;
+	int bufferPos = 0;
+	int bufferEnd = 0;
+	bool isFileEnd = false;
+	// Stream position of the buffer start.
+	__int64 bufferOffset = 0;
+	// Current line information for the error messages.
+	int lineNumber = 1;
+	__int64 lineStartOffset = 0;
+
+	TReaderState state = RS_Value;
+	// Open containers. Objects are marked with true.
+	CArray<bool> containers;
+
+	TJsonReadEvent event = JRE_Null;
+	CStringPart stringValue;
+	double numberValue = 0;
+	bool boolValue = false;
+
+	bool fillBuffer( int count );
+	int getBufferCapacity() const;
+	bool skipWhitespace();
+	bool readKey();
+	bool readValue();
+	bool endContainer();
+	void finishValue();
+	void readString();
+	void readNumber();
+	void readLiteral( CStringView literal );
+	void checkScalarEnd();
+	bool isNumberChar( char ch ) const;
+	void throwParseException( int pos ) const;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
@@ -0,0 +1,38 @@
+#pragma once
+#include <Redefs.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Parsing of JSON strings and numbers. Shared by the JSON document and the streaming reader.
+// Parsed text must be followed by at least JsonTextPadding bytes of accessible memory.
+class REAPI CJsonScalarParser {
+public:
+	// Find the first quote or backslash starting from the given position. The string must be terminated.
+	static int FindQuoteOrEscape( const char* str, int startPos );
+	// Find the first quote or backslash in the given range. Return endPos if there is none.
+	static int FindQuoteOrEscape( const char* str, int startPos, int endPos );
+
+	// Replace the escape sequences of a string in place. The string must be terminated by an unescaped quote.
+	// On success endPos is set to the end of the replaced string. On failure it is set to the invalid character position.
+	static bool ReplaceEscapeSequences( char* str, int firstEscapePos, int& endPos );
+
+	// Parse a number. The number must be followed by a non-numeric character.
+	// On success pos is moved past the number. On failure it is set to the invalid character position.
+	static bool ParseNumber( const char* str, int& pos, double& result );
+
+private:
+	static bool replaceUnicodeEscape( char* str, int& srcPos, int& destPos );
+	static bool parseHexCode( const char* str, int& pos, unsigned& result );
+	static char getEscapeCharacter( char escapeCode );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
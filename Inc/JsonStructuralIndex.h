@@ -0,0 +1,49 @@
+#pragma once
+#include <Redefs.h>
+#include <Array.h>
+#include <BaseStringView.h>
+
+namespace Relib {
+
+// Number of zero bytes that must follow the parsed JSON text.
+// Text is scanned by whole blocks, so the last block may read past the end of the text.
+static const int JsonTextPadding = 64;
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Positions of the structural characters in a JSON text.
+// Structural characters are the brackets, colons and commas outside of strings, opening quotes of strings and first characters of other scalar values.
+// The text is classified 64 bytes at a time with SSE2 comparisons, string boundaries are found with a prefix xor of the unescaped quote mask.
+class REAPI CJsonStructuralIndex {
+public:
+	// Find the structural characters in the text. The text must be followed by JsonTextPadding zero bytes.
+	// If matchBrackets is set, closing bracket indices are calculated for every opening bracket.
+	// Return the text position of the first error or NotFound if the text is well-formed on the structural level.
+	int Build( CStringView text, bool matchBrackets );
+	void Empty();
+
+	int Size() const
+		{ return positions.Size(); }
+	// Text position of a structural character.
+	int operator[]( int index ) const
+		{ return positions[index]; }
+
+	// Index of the structural character that closes the given bracket. Brackets must have been matched during the build.
+	int GetClosingIndex( int openingIndex ) const
+		{ return closingIndices[openingIndex]; }
+
+private:
+	CArray<int> positions;
+	CArray<int> closingIndices;
+
+	int matchBrackets( CStringView text );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
@@ -6,10 +6,13 @@
 #include <StrConversions.h>
 #include <ArrayBuffer.h>
 #include <Errors.h>
+#include <HashUtils.h>
 
 namespace Relib {
 
 class CJsonValue;
+class CJsonDynamicArray;
+class CJsonObject;
 //////////////////////////////////////////////////////////////////////////
 
 // Possible JSON value type.
@@ -74,6 +77,24 @@ private:
 
 //////////////////////////////////////////////////////////////////////////
 
+// Slot of the object key index. Empty slots have a null node.
+struct CJsonKeySlot {
+	int Hash;
+	CJsonListNode<CJsonKeyValue>* Node;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Source of the container values that are parsed on demand.
+class IJsonLazySource {
+public:
+	// Parse the values of a container. The container is marked as parsed before the call.
+	virtual void ExpandArray( CJsonDynamicArray& arr, int sourcePos ) = 0;
+	virtual void ExpandObject( CJsonObject& obj, int sourcePos ) = 0;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 // Exception thrown on value type mismatch or missing values.
 class REAPI CJsonValueException : public CException {
 public:
@@ -191,10 +212,10 @@ public:
 		CJsonValue( JVT_Array ), listHead( head ), listTail( tail ), listSize( size ) {}
 
 	int Size() const
-		{ return listSize; }
+		{ expandLazyValues(); return listSize; }
 
 	CJsonList<CJsonValue*> GetValues() const
-		{ return CJsonList<CJsonValue*>( listHead, listSize ); }
+		{ expandLazyValues(); return CJsonList<CJsonValue*>( listHead, listSize ); }
 
 	// Json document needs access to the underlying implementation in order to change values.
 	friend class CJsonDocument;
@@ -203,9 +224,17 @@ private:
 	CJsonListNode<CJsonValue*>* listHead;
 	CJsonListNode<CJsonValue*>* listTail;
 	int listSize;
-
+	// Source of the values that haven't been parsed yet.
+	mutable IJsonLazySource* lazySource = nullptr;
+	int lazySourcePos = 0;
+
+	void expandLazyValues() const;
+	void setLazySource( IJsonLazySource& source, int sourcePos )
+		{ lazySource = &source; lazySourcePos = sourcePos; }
+	void setList( CJsonListNode<CJsonValue*>* head, CJsonListNode<CJsonValue*>* tail, int size )
+		{ listHead = head; listTail = tail; listSize = size; }
 	CJsonListNode<CJsonValue*>* getTail()
-		{ return listTail; }
+		{ expandLazyValues(); return listTail; }
 	void setTail( CJsonListNode<CJsonValue*>* newValue )
 		{ listTail = newValue; listSize++; }
 	void setFirstNode( CJsonListNode<CJsonValue*>* newValue )
@@ -220,12 +249,13 @@ public:
 		CJsonValue( JVT_Object ), listHead( head ), listTail( tail ), listSize( size ) {}
 
 	int Size() const
-		{ return listSize; }
+		{ expandLazyValues(); return listSize; }
 
 	CJsonList<CJsonKeyValue> GetKeyValueList() const
-		{ return CJsonList<CJsonKeyValue>( listHead, listSize ); }
+		{ expandLazyValues(); return CJsonList<CJsonKeyValue>( listHead, listSize ); }
 
 	// Return the value under the specified key or nullptr if no value exists.
+	// Objects with many keys are looked up by a hash index, smaller objects are searched linearly. The first of the duplicate keys is found.
 	CJsonValue* TryFindValue( CStringPart keyName ) const;
 	CJsonValue& FindValue( CStringPart keyName ) const;
 
@@ -236,9 +266,21 @@ private:
 	CJsonListNode<CJsonKeyValue>* listHead;
 	CJsonListNode<CJsonKeyValue>* listTail;
 	int listSize;
-
+	// Source of the values that haven't been parsed yet.
+	mutable IJsonLazySource* lazySource = nullptr;
+	int lazySourcePos = 0;
+	// Open addressing index of the keys. The slot array has a power of two size and is allocated in the document arena.
+	CJsonKeySlot* keySlots = nullptr;
+	int keySlotCount = 0;
+
+	void expandLazyValues() const;
+	CJsonValue* findIndexedValue( CStringPart keyName ) const;
+	void setLazySource( IJsonLazySource& source, int sourcePos )
+		{ lazySource = &source; lazySourcePos = sourcePos; }
+	void setList( CJsonListNode<CJsonKeyValue>* head, CJsonListNode<CJsonKeyValue>* tail, int size )
+		{ listHead = head; listTail = tail; listSize = size; }
 	CJsonListNode<CJsonKeyValue>* getTail()
-		{ return listTail; }
+		{ expandLazyValues(); return listTail; }
 	void setTail( CJsonListNode<CJsonKeyValue>* newValue )
 		{ listTail = newValue; listSize++; }
 	void setFirstNode( CJsonListNode<CJsonKeyValue>* newValue )
@@ -247,8 +289,32 @@ private:
 
 //////////////////////////////////////////////////////////////////////////
 
+inline void CJsonDynamicArray::expandLazyValues() const
+{
+	if( lazySource != nullptr ) {
+		const auto source = lazySource;
+		lazySource = nullptr;
+		source->ExpandArray( const_cast<CJsonDynamicArray&>( *this ), lazySourcePos );
+	}
+}
+
+inline void CJsonObject::expandLazyValues() const
+{
+	if( lazySource != nullptr ) {
+		const auto source = lazySource;
+		lazySource = nullptr;
+		source->ExpandObject( const_cast<CJsonObject&>( *this ), lazySourcePos );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 inline CJsonValue* CJsonObject::TryFindValue( CStringPart keyName ) const
 {
+	expandLazyValues();
+	if( keySlots != nullptr ) {
+		return findIndexedValue( keyName );
+	}
 	for( auto keyVal : GetKeyValueList() ) {
 		if( keyVal.Key == keyName ) {
 			return keyVal.Value;
@@ -259,12 +325,26 @@ inline CJsonValue* CJsonObject::TryFindValue( CStringPart keyName ) const
 
 inline CJsonValue& CJsonObject::FindValue( CStringPart keyName ) const
 {
-	for( auto keyVal : GetKeyValueList() ) {
-		if( keyVal.Key == keyName ) {
-			return *keyVal.Value;
+	const auto result = TryFindValue( keyName );
+	if( result == nullptr ) {
+		throw CJsonValueException( keyName );
+	}
+	return *result;
+}
+
+inline CJsonValue* CJsonObject::findIndexedValue( CStringPart keyName ) const
+{
+	const auto hash = CDefaultHash<CStringPart>::HashKey( keyName );
+	const auto slotMask = keySlotCount - 1;
+	for( int slotPos = hash & slotMask;; slotPos = ( slotPos + 1 ) & slotMask ) {
+		const auto& slot = keySlots[slotPos];
+		if( slot.Node == nullptr ) {
+			return nullptr;
+		}
+		if( slot.Hash == hash && slot.Node->Value.Key == keyName ) {
+			return slot.Node->Value.Value;
 		}
 	}
-	throw CJsonValueException( keyName );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,68 @@
+#pragma once
+#include <Redefs.h>
+#include <Array.h>
+#include <BaseStringPart.h>
+#include <FileViews.h>
+#include <JsonValues.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Streaming JSON writer.
+// Text is collected in a fixed buffer that is written to the file when it's full, so memory use doesn't depend on the output size.
+// Commas are inserted automatically. Top level values are separated by new lines, which allows writing newline-delimited JSON.
+class REAPI CJsonWriter {
+public:
+	static const int DefaultBufferSize = 64 * 1024;
+
+	// File must stay open while the writer is used.
+	explicit CJsonWriter( CFileWriteView file, int bufferSize = DefaultBufferSize );
+	// The buffered text is flushed. Write errors are logged.
+	~CJsonWriter();
+
+	void StartObject();
+	void EndObject();
+	void StartArray();
+	void EndArray();
+
+	// Object key. Must be followed by a value.
+	void WriteKey( CStringPart key );
+	void WriteString( CStringPart str );
+	void WriteNumber( int value );
+	// Infinities and NaNs are written as null.
+	void WriteNumber( double value );
+	void WriteBool( bool value );
+	void WriteNull();
+	// Write a document value with all its contents.
+	void WriteValue( const CJsonValue& value );
+
+	// Write the buffered text to the file.
+	void Flush();
+
+	// Copying is prohibited.
+	CJsonWriter( const CJsonWriter& ) = delete;
+	void operator=( const CJsonWriter& ) = delete;
+
+private:
+	CFileWriteView file;
+	CArray<char> buffer;
+	// Open containers. Objects are marked with true.
+	CArray<bool> containers;
+	// A value has been written to the current container.
+	bool needsSeparator = false;
+	bool isAfterKey = false;
+
+	void startValue();
+	void startContainer( bool isObject, char bracket );
+	void endContainer( bool isObject, char bracket );
+	void writeObject( const CJsonObject& obj );
+	void writeArray( const CJsonDynamicArray& arr );
+	void writeEscapedString( CStringPart str );
+	void writeText( CStringPart text );
+	void writeChar( char ch );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
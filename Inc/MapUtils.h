@@ -24,6 +24,9 @@ public:
 	// Index entries get to construct map data.
 	template <class ContainedType>
 	friend struct RelibInternal::CIndexEntry;
+	// Flat hash indices construct map data directly in their slots.
+	template <class ContainedType, class HashStrategy, class Allocator>
+	friend class RelibInternal::CFlatHashIndex;
 
 private:
 	KeyType key;
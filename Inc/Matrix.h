@@ -403,6 +403,12 @@ template<class Type, int dimX, int dimY, TMatrixOrder matOrder>
 struct IsMatrix< CMatrix<Type, dimX, dimY, matOrder> > : public TrueType {
 };
 
+// Column major matrices are serialized in their memory order.
+template<class Type, int dimX, int dimY>
+struct IsBitwiseSerializable< CMatrix<Type, dimX, dimY, MO_ColumnMajor> > :
+	public BoolType<IsBitwiseSerializable<Type>::Result && sizeof( CMatrix<Type, dimX, dimY, MO_ColumnMajor> ) == dimX * dimY * sizeof( Type )> {
+};
+
 }	// namespace Types.
 
 }	// namespace Relib.
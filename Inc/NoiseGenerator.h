@@ -1,11 +1,118 @@
 #pragma once
 #include <RandomGenerator.h>
 #include <Vector.h>
+#include <ArrayBuffer.h>
+#include <ThreadPool.h>
 
 namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
+// Ways of combining noise octaves.
+enum TFractalNoiseType {
+	// Sum of the octave values.
+	FNT_FBm,
+	// Sum of the squared ( 1 - |value| ) of the octaves. Creates sharp ridges where the noise crosses zero.
+	FNT_Ridged
+};
+
+// Parameters of the multi-octave noise.
+// Each octave multiplies the frequency by Lacunarity and the amplitude by Gain. The first octave has the amplitude of 1.
+template <class ValueType>
+struct CFractalNoiseParams {
+	TFractalNoiseType Type = FNT_FBm;
+	int OctaveCount = 4;
+	ValueType Frequency = 1;
+	ValueType Lacunarity = 2;
+	ValueType Gain = ValueType( 0.5 );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+// Vector registers with several floating point values. Used by the noise grid filling.
+template <class Type>
+struct CNoiseLanes;
+
+template <>
+struct CNoiseLanes<float> {
+	typedef __m128 TRegister;
+	static const int Size = 4;
+
+	static TRegister Set( float value )
+		{ return _mm_set1_ps( value ); }
+	// Values of first, first + 1, ..., first + Size - 1.
+	static TRegister Indices( int first )
+		{ return _mm_cvtepi32_ps( _mm_add_epi32( _mm_set1_epi32( first ), _mm_setr_epi32( 0, 1, 2, 3 ) ) ); }
+	static void Store( TRegister value, float* result )
+		{ _mm_storeu_ps( result, value ); }
+	static TRegister Add( TRegister left, TRegister right )
+		{ return _mm_add_ps( left, right ); }
+	static TRegister Sub( TRegister left, TRegister right )
+		{ return _mm_sub_ps( left, right ); }
+	static TRegister Mul( TRegister left, TRegister right )
+		{ return _mm_mul_ps( left, right ); }
+	static TRegister Abs( TRegister value )
+		{ return _mm_andnot_ps( _mm_set1_ps( -0.0f ), value ); }
+	// Change the sign of the values with the set mask.
+	static TRegister Negate( TRegister value, TRegister mask )
+		{ return _mm_xor_ps( value, _mm_and_ps( mask, _mm_set1_ps( -0.0f ) ) ); }
+	static TRegister Select( TRegister mask, TRegister ifTrue, TRegister ifFalse )
+		{ return _mm_or_ps( _mm_and_ps( mask, ifTrue ), _mm_andnot_ps( mask, ifFalse ) ); }
+	// Integer lanes are stored in the first Size 32-bit elements.
+	// Negative values are truncated and decremented, same as in the scalar noise function.
+	static __m128i Floor( TRegister value )
+		{ return _mm_add_epi32( _mm_cvttps_epi32( value ), _mm_castps_si128( _mm_cmplt_ps( value, _mm_setzero_ps() ) ) ); }
+	static TRegister ToValue( __m128i value )
+		{ return _mm_cvtepi32_ps( value ); }
+	// Convert a mask of integer lanes to a mask of value lanes.
+	static TRegister ExpandMask( __m128i mask )
+		{ return _mm_castsi128_ps( mask ); }
+};
+
+template <>
+struct CNoiseLanes<double> {
+	typedef __m128d TRegister;
+	static const int Size = 2;
+
+	static TRegister Set( double value )
+		{ return _mm_set1_pd( value ); }
+	static TRegister Indices( int first )
+		{ return _mm_cvtepi32_pd( _mm_add_epi32( _mm_set1_epi32( first ), _mm_setr_epi32( 0, 1, 0, 0 ) ) ); }
+	static void Store( TRegister value, double* result )
+		{ _mm_storeu_pd( result, value ); }
+	static TRegister Add( TRegister left, TRegister right )
+		{ return _mm_add_pd( left, right ); }
+	static TRegister Sub( TRegister left, TRegister right )
+		{ return _mm_sub_pd( left, right ); }
+	static TRegister Mul( TRegister left, TRegister right )
+		{ return _mm_mul_pd( left, right ); }
+	static TRegister Abs( TRegister value )
+		{ return _mm_andnot_pd( _mm_set1_pd( -0.0 ), value ); }
+	static TRegister Negate( TRegister value, TRegister mask )
+		{ return _mm_xor_pd( value, _mm_and_pd( mask, _mm_set1_pd( -0.0 ) ) ); }
+	static TRegister Select( TRegister mask, TRegister ifTrue, TRegister ifFalse )
+		{ return _mm_or_pd( _mm_and_pd( mask, ifTrue ), _mm_andnot_pd( mask, ifFalse ) ); }
+	static __m128i Floor( TRegister value );
+	static TRegister ToValue( __m128i value )
+		{ return _mm_cvtepi32_pd( value ); }
+	static TRegister ExpandMask( __m128i mask )
+		{ return _mm_castsi128_pd( _mm_shuffle_epi32( mask, _MM_SHUFFLE( 1, 1, 0, 0 ) ) ); }
+};
+
+inline __m128i CNoiseLanes<double>::Floor( TRegister value )
+{
+	const __m128i truncated = _mm_cvttpd_epi32( value );
+	// Comparison produces 64-bit masks, their low halves are moved to the first two elements.
+	const __m128i negativeMask = _mm_shuffle_epi32( _mm_castpd_si128( _mm_cmplt_pd( value, _mm_setzero_pd() ) ), _MM_SHUFFLE( 3, 3, 2, 0 ) );
+	return _mm_add_epi32( truncated, negativeMask );
+}
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
 // Mechanism for creating smooth arrays with random values.
 template <class ValueType>
 class CGradientNoise {
@@ -20,16 +127,89 @@ public:
 	ValueType Noise( CVector2<ValueType> pos ) const;
 	// A three dimensional gradient noise function.
 	ValueType Noise( CVector3<ValueType> pos ) const;
-	
+
+	// Multi-octave noise functions.
+	ValueType FractalNoise( CVector2<ValueType> pos, const CFractalNoiseParams<ValueType>& params ) const;
+	ValueType FractalNoise( CVector3<ValueType> pos, const CFractalNoiseParams<ValueType>& params ) const;
+
+	// Grid filling functions. Several points are processed at a time, results are equal to the results of the point functions.
+	// Point with indices ( x, y, z ) is origin + ( x * step.X(), y * step.Y(), z * step.Z() ), its value is written to result[( z * gridSize.Y() + y ) * gridSize.X() + x].
+	// Result size must be equal to the point count of the grid.
+	// Thread pool overloads split the grid rows between the pool workers and the calling thread.
+	void FillNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, CArrayBuffer<ValueType> result ) const
+		{ fillNoise( origin, step, gridSize, result, nullptr ); }
+	void FillNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, CArrayBuffer<ValueType> result, CThreadPool& threadPool ) const
+		{ fillNoise( origin, step, gridSize, result, &threadPool ); }
+	void FillNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result ) const
+		{ fillNoise( origin, step, gridSize, result, nullptr ); }
+	void FillNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result, CThreadPool& threadPool ) const
+		{ fillNoise( origin, step, gridSize, result, &threadPool ); }
+	void FillFractalNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+			CArrayBuffer<ValueType> result ) const
+		{ fillFractalNoise( origin, step, gridSize, params, result, nullptr ); }
+	void FillFractalNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+			CArrayBuffer<ValueType> result, CThreadPool& threadPool ) const
+		{ fillFractalNoise( origin, step, gridSize, params, result, &threadPool ); }
+	void FillFractalNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+			CArrayBuffer<ValueType> result ) const
+		{ fillFractalNoise( origin, step, gridSize, params, result, nullptr ); }
+	void FillFractalNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+			CArrayBuffer<ValueType> result, CThreadPool& threadPool ) const
+		{ fillFractalNoise( origin, step, gridSize, params, result, &threadPool ); }
+
 private:
+	typedef RelibInternal::CNoiseLanes<ValueType> TLanes;
+	typedef typename TLanes::TRegister TRegister;
+
 	// Grid with random values.
+	// The last entry is only read for the negative coordinates that are multiples of the table size.
 	static const int tableSize = 256;
-	BYTE permTable[tableSize + 1];
+	static const int maxTableValue = tableSize - 1;
+	BYTE permTable[tableSize + 2];
+
+	// Approximate number of grid points in a single thread pool task.
+	static const int parallelChunkPointCount = 16 * 1024;
+	// Single octave noise is filled by lanes only with four of them. Two double lanes are slower than the point by point noise
+	// because the table lookups are still done for every lane. Fractal noise with its several octaves is faster by lanes in both cases.
+	static const bool useNoiseLanes = TLanes::Size >= 4;
 
 	void populateGrid( unsigned __int64 seed );
 
+	static int floorCoordinate( ValueType value );
+	static int gridIndex( int flooredValue );
+	// Hashes of the cell corners in the order of TL, TR, BL, BR.
+	void findCornerHashes( int xFloored, int yFloored, BYTE* hashes ) const;
+	// Hashes of the cell corners in the order of CTL, CTR, CBL, CBR, FTL, FTR, FBL, FBR.
+	void findCornerHashes( int xFloored, int yFloored, int zFloored, BYTE* hashes ) const;
+
 	static ValueType fade( ValueType value );
 	static ValueType gradValue( BYTE seed, ValueType x, ValueType y, ValueType z );
+	static ValueType addOctave( TFractalNoiseType type, ValueType sum, ValueType amplitude, ValueType value );
+
+	TRegister noiseLanes( TRegister x, TRegister y ) const;
+	TRegister noiseLanes( TRegister x, TRegister y, TRegister z ) const;
+	static TRegister fadeLanes( TRegister value );
+	static TRegister lerpLanes( TRegister left, TRegister right, TRegister t );
+	static TRegister gradLanes( __m128i seeds, TRegister x, TRegister y, TRegister z );
+	static TRegister addOctaveLanes( TFractalNoiseType type, TRegister sum, ValueType amplitude, TRegister value );
+
+	void fillNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const;
+	void fillNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const;
+	void fillFractalNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+		CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const;
+	void fillFractalNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, const CFractalNoiseParams<ValueType>& params,
+		CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const;
+	template <class LanesAction, class PointAction>
+	static void fillGrid( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result, CThreadPool* threadPool,
+		bool useLanes, const LanesAction& lanesAction, const PointAction& pointAction );
+	template <class LanesAction, class PointAction>
+	static void fillRow( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, int row, ValueType* result,
+		bool useLanes, const LanesAction& lanesAction, const PointAction& pointAction );
+
+	template <class NoiseAction>
+	static ValueType fractalNoise( const CFractalNoiseParams<ValueType>& params, const NoiseAction& noiseAction );
+	template <class NoiseAction>
+	static TRegister fractalNoiseLanes( const CFractalNoiseParams<ValueType>& params, const NoiseAction& noiseAction );
 
 	// Copying is prohibited.
 	CGradientNoise( CGradientNoise& ) = delete;
@@ -54,7 +234,7 @@ template <class ValueType>
 void CGradientNoise<ValueType>::populateGrid( unsigned __int64 seed )
 {
 	CRandomGenerator rng( seed );
-	for( int i = 0; i < tableSize + 1; i++ ) {
+	for( int i = 0; i < tableSize + 2; i++ ) {
 		permTable[i] = numeric_cast<BYTE>( rng.RandomNumber( 0, tableSize - 1 ) );
 	}
 }
@@ -65,46 +245,29 @@ ValueType CGradientNoise<ValueType>::Noise( CVector2<ValueType> pos ) const
 	const ValueType x = pos.X();
 	const ValueType y = pos.Y();
 
-	const int maxTableValue = tableSize - 1;
-	const int xFloored = x >= 0 ? Floor( x ) : Floor( x ) - 1;
-	const int yFloored = y >= 0 ? Floor( y ) : Floor( y ) - 1;
-
-	// Grid values.
-	const int xGrid = x >= 0 ? xFloored & maxTableValue : tableSize - ( -xFloored & maxTableValue );
-	const int yGrid = y >= 0 ? yFloored & maxTableValue : tableSize - ( -yFloored & maxTableValue );
+	const int xFloored = floorCoordinate( x );
+	const int yFloored = floorCoordinate( y );
 
 	// Create a random value for every corner in the grid.
 	// T - top; B - bottom.
 	// L - left; R - right.
-
-	const BYTE valueL = permTable[xGrid];
-	const int valueTLIndex = valueL + yGrid;
-	const int valueBLIndex = valueTLIndex + 1;
-
-	const BYTE valueTL = permTable[valueTLIndex & maxTableValue];
-	const BYTE valueBL = permTable[valueBLIndex & maxTableValue];
-
-	const BYTE valueR = permTable[xGrid + 1];
-	const int valueTRIndex = valueR + yGrid;
-	const int valueBRIndex = valueTRIndex + 1;
-
-	const BYTE valueTR = permTable[valueTRIndex & maxTableValue];
-	const BYTE valueBR = permTable[valueBRIndex & maxTableValue];
+	BYTE hashes[4];
+	findCornerHashes( xFloored, yFloored, hashes );
 
 	// XYZ values relative to the grid.
 	const ValueType xRel = x - xFloored;
 	const ValueType yRel = y - yFloored;
 
 	// Weighted gradient values.
-	const ValueType gradValueTL = gradValue( valueTL, xRel, yRel, 0 );
-	const ValueType gradValueTR = gradValue( valueTR, xRel - 1, yRel, 0 );
-	const ValueType gradValueBL = gradValue( valueBL, xRel, yRel - 1, 0 );
-	const ValueType gradValueBR = gradValue( valueBR, xRel - 1, yRel - 1, 0 );
+	const ValueType gradValueTL = gradValue( hashes[0], xRel, yRel, 0 );
+	const ValueType gradValueTR = gradValue( hashes[1], xRel - 1, yRel, 0 );
+	const ValueType gradValueBL = gradValue( hashes[2], xRel, yRel - 1, 0 );
+	const ValueType gradValueBR = gradValue( hashes[3], xRel - 1, yRel - 1, 0 );
 
 	// Fade curves for XYZ.
 	const ValueType xFaded = fade( xRel );
 	const ValueType yFaded = fade( yRel );
-	
+
 	// Interpolated values.
 	const ValueType lerpT = Lerp( gradValueTL, gradValueTR, xFaded );
 	const ValueType lerpB = Lerp( gradValueBL, gradValueBR, xFaded );
@@ -120,54 +283,16 @@ ValueType CGradientNoise<ValueType>::Noise( CVector3<ValueType> pos ) const
 	const ValueType y = pos.Y();
 	const ValueType z = pos.Z();
 
-	const int maxTableValue = tableSize - 1;
-	const int xFloored = x >= 0 ? Floor( x ) : Floor( x ) - 1;
-	const int yFloored = y >= 0 ? Floor( y ) : Floor( y ) - 1;
-	const int zFloored = z >= 0 ? Floor( z ) : Floor( z ) - 1;
-
-	// Grid values.
-	const int xGrid = x >= 0 ? xFloored & maxTableValue : tableSize - ( -xFloored & maxTableValue );
-	const int yGrid = y >= 0 ? yFloored & maxTableValue : tableSize - ( -yFloored & maxTableValue );
-	const int zGrid = z >= 0 ? zFloored & maxTableValue : tableSize - ( -zFloored & maxTableValue );
+	const int xFloored = floorCoordinate( x );
+	const int yFloored = floorCoordinate( y );
+	const int zFloored = floorCoordinate( z );
 
 	// Create a random value for every corner in the grid.
 	// C - close; F - far.
 	// T - top; B - bottom.
 	// L - left; R - right.
-
-	const BYTE valueL = permTable[xGrid];
-	const int valueTLIndex = valueL + yGrid;
-	const int valueBLIndex = valueTLIndex + 1;
-
-	const BYTE valueTL = permTable[valueTLIndex & maxTableValue];
-	const BYTE valueBL = permTable[valueBLIndex & maxTableValue];
-
-	const int valueCTLIndex = valueTL + zGrid;
-	const int valueFTLIndex = valueCTLIndex + 1;
-	const int valueCBLIndex = valueBL + zGrid;
-	const int valueFBLIndex = valueCBLIndex + 1;
-
-	const BYTE valueR = permTable[xGrid + 1];
-	const int valueTRIndex = valueR + yGrid;
-	const int valueBRIndex = valueTRIndex + 1;
-
-	const BYTE valueTR = permTable[valueTRIndex & maxTableValue];
-	const BYTE valueBR = permTable[valueBRIndex & maxTableValue];
-
-	const int valueCTRIndex = valueTR + zGrid;
-	const int valueFTRIndex = valueCTRIndex + 1;
-	const int valueCBRIndex = valueBR + zGrid;
-	const int valueFBRIndex = valueCBRIndex + 1;
-
-	const BYTE valueCTL = permTable[valueCTLIndex & maxTableValue];
-	const BYTE valueCTR = permTable[valueCTRIndex & maxTableValue];
-	const BYTE valueCBL = permTable[valueCBLIndex & maxTableValue];
-	const BYTE valueCBR = permTable[valueCBRIndex & maxTableValue];
-
-	const BYTE valueFTL = permTable[valueFTLIndex & maxTableValue];
-	const BYTE valueFTR = permTable[valueFTRIndex & maxTableValue];
-	const BYTE valueFBL = permTable[valueFBLIndex & maxTableValue];
-	const BYTE valueFBR = permTable[valueFBRIndex & maxTableValue];
+	BYTE hashes[8];
+	findCornerHashes( xFloored, yFloored, zFloored, hashes );
 
 	// XYZ values relative to the grid.
 	const ValueType xRel = x - xFloored;
@@ -175,21 +300,21 @@ ValueType CGradientNoise<ValueType>::Noise( CVector3<ValueType> pos ) const
 	const ValueType zRel = z - zFloored;
 
 	// Weighted gradient values.
-	const ValueType gradValueCTL = gradValue( valueCTL, xRel, yRel, zRel );
-	const ValueType gradValueCTR = gradValue( valueCTR, xRel - 1, yRel, zRel );
-	const ValueType gradValueCBL = gradValue( valueCBL, xRel, yRel - 1, zRel );
-	const ValueType gradValueCBR = gradValue( valueCBR, xRel - 1, yRel - 1, zRel );
+	const ValueType gradValueCTL = gradValue( hashes[0], xRel, yRel, zRel );
+	const ValueType gradValueCTR = gradValue( hashes[1], xRel - 1, yRel, zRel );
+	const ValueType gradValueCBL = gradValue( hashes[2], xRel, yRel - 1, zRel );
+	const ValueType gradValueCBR = gradValue( hashes[3], xRel - 1, yRel - 1, zRel );
 
-	const ValueType gradValueFTL = gradValue( valueFTL, xRel, yRel, zRel - 1 );
-	const ValueType gradValueFTR = gradValue( valueFTR, xRel - 1, yRel, zRel - 1 );
-	const ValueType gradValueFBL = gradValue( valueFBL, xRel, yRel - 1, zRel - 1 );
-	const ValueType gradValueFBR = gradValue( valueFBR, xRel - 1, yRel - 1, zRel - 1 );
+	const ValueType gradValueFTL = gradValue( hashes[4], xRel, yRel, zRel - 1 );
+	const ValueType gradValueFTR = gradValue( hashes[5], xRel - 1, yRel, zRel - 1 );
+	const ValueType gradValueFBL = gradValue( hashes[6], xRel, yRel - 1, zRel - 1 );
+	const ValueType gradValueFBR = gradValue( hashes[7], xRel - 1, yRel - 1, zRel - 1 );
 
 	// Fade curves for XYZ.
 	const ValueType xFaded = fade( xRel );
 	const ValueType yFaded = fade( yRel );
 	const ValueType zFaded = fade( zRel );
-	
+
 	// Interpolated values.
 	const ValueType lerpCT = Lerp( gradValueCTL, gradValueCTR, xFaded );
 	const ValueType lerpCB = Lerp( gradValueCBL, gradValueCBR, xFaded );
@@ -203,6 +328,264 @@ ValueType CGradientNoise<ValueType>::Noise( CVector3<ValueType> pos ) const
 	return resultLerp;
 }
 
+template <class ValueType>
+ValueType CGradientNoise<ValueType>::FractalNoise( CVector2<ValueType> pos, const CFractalNoiseParams<ValueType>& params ) const
+{
+	return fractalNoise( params, [&]( ValueType frequency ) { return Noise( CVector2<ValueType>( pos.X() * frequency, pos.Y() * frequency ) ); } );
+}
+
+template <class ValueType>
+ValueType CGradientNoise<ValueType>::FractalNoise( CVector3<ValueType> pos, const CFractalNoiseParams<ValueType>& params ) const
+{
+	return fractalNoise( params, [&]( ValueType frequency ) {
+		return Noise( CVector3<ValueType>( pos.X() * frequency, pos.Y() * frequency, pos.Z() * frequency ) ); } );
+}
+
+
+template <class ValueType>
+void CGradientNoise<ValueType>::fillNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize, CArrayBuffer<ValueType> result,
+	CThreadPool* threadPool ) const
+{
+	const auto lanesAction = [this]( TRegister x, TRegister y, TRegister ) { return noiseLanes( x, y ); };
+	const auto pointAction = [this]( ValueType x, ValueType y, ValueType ) { return Noise( CVector2<ValueType>( x, y ) ); };
+	fillGrid( CVector3<ValueType>( origin, ValueType( 0 ) ), CVector3<ValueType>( step, ValueType( 0 ) ), CVector3<int>( gridSize, 1 ), result, threadPool,
+		useNoiseLanes, lanesAction, pointAction );
+}
+
+template <class ValueType>
+void CGradientNoise<ValueType>::fillNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result,
+	CThreadPool* threadPool ) const
+{
+	const auto lanesAction = [this]( TRegister x, TRegister y, TRegister z ) { return noiseLanes( x, y, z ); };
+	const auto pointAction = [this]( ValueType x, ValueType y, ValueType z ) { return Noise( CVector3<ValueType>( x, y, z ) ); };
+	fillGrid( origin, step, gridSize, result, threadPool, useNoiseLanes, lanesAction, pointAction );
+}
+
+template <class ValueType>
+void CGradientNoise<ValueType>::fillFractalNoise( CVector2<ValueType> origin, CVector2<ValueType> step, CVector2<int> gridSize,
+	const CFractalNoiseParams<ValueType>& params, CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const
+{
+	const auto lanesAction = [this, &params]( TRegister x, TRegister y, TRegister ) {
+		return fractalNoiseLanes( params, [&]( ValueType frequency ) {
+			const TRegister frequencyLanes = TLanes::Set( frequency );
+			return noiseLanes( TLanes::Mul( x, frequencyLanes ), TLanes::Mul( y, frequencyLanes ) );
+		} );
+	};
+	const auto pointAction = [this, &params]( ValueType x, ValueType y, ValueType ) { return FractalNoise( CVector2<ValueType>( x, y ), params ); };
+	fillGrid( CVector3<ValueType>( origin, ValueType( 0 ) ), CVector3<ValueType>( step, ValueType( 0 ) ), CVector3<int>( gridSize, 1 ), result, threadPool,
+		true, lanesAction, pointAction );
+}
+
+template <class ValueType>
+void CGradientNoise<ValueType>::fillFractalNoise( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize,
+	const CFractalNoiseParams<ValueType>& params, CArrayBuffer<ValueType> result, CThreadPool* threadPool ) const
+{
+	const auto lanesAction = [this, &params]( TRegister x, TRegister y, TRegister z ) {
+		return fractalNoiseLanes( params, [&]( ValueType frequency ) {
+			const TRegister frequencyLanes = TLanes::Set( frequency );
+			return noiseLanes( TLanes::Mul( x, frequencyLanes ), TLanes::Mul( y, frequencyLanes ), TLanes::Mul( z, frequencyLanes ) );
+		} );
+	};
+	const auto pointAction = [this, &params]( ValueType x, ValueType y, ValueType z ) { return FractalNoise( CVector3<ValueType>( x, y, z ), params ); };
+	fillGrid( origin, step, gridSize, result, threadPool, true, lanesAction, pointAction );
+}
+
+template <class ValueType>
+template <class LanesAction, class PointAction>
+void CGradientNoise<ValueType>::fillGrid( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, CArrayBuffer<ValueType> result,
+	CThreadPool* threadPool, bool useLanes, const LanesAction& lanesAction, const PointAction& pointAction )
+{
+	assert( gridSize.X() >= 0 && gridSize.Y() >= 0 && gridSize.Z() >= 0 );
+	assert( result.Size() == gridSize.X() * gridSize.Y() * gridSize.Z() );
+	const int rowCount = gridSize.Y() * gridSize.Z();
+	ValueType* resultPtr = result.Ptr();
+	const auto rowAction = [&]( int row ) {
+		fillRow( origin, step, gridSize, row, resultPtr + row * gridSize.X(), useLanes, lanesAction, pointAction );
+	};
+
+	if( threadPool == nullptr ) {
+		for( int row = 0; row < rowCount; row++ ) {
+			rowAction( row );
+		}
+	} else {
+		const int grainSize = max( 1, parallelChunkPointCount / max( 1, gridSize.X() ) );
+		threadPool->ParallelFor( 0, rowCount, grainSize, rowAction );
+	}
+}
+
+template <class ValueType>
+template <class LanesAction, class PointAction>
+void CGradientNoise<ValueType>::fillRow( CVector3<ValueType> origin, CVector3<ValueType> step, CVector3<int> gridSize, int row, ValueType* result,
+	bool useLanes, const LanesAction& lanesAction, const PointAction& pointAction )
+{
+	const int width = gridSize.X();
+	const int yIndex = row % gridSize.Y();
+	const int zIndex = row / gridSize.Y();
+	const ValueType y = origin.Y() + static_cast<ValueType>( yIndex ) * step.Y();
+	const ValueType z = origin.Z() + static_cast<ValueType>( zIndex ) * step.Z();
+
+	int xIndex = 0;
+	if( useLanes ) {
+		const TRegister xOrigin = TLanes::Set( origin.X() );
+		const TRegister xStep = TLanes::Set( step.X() );
+		const TRegister yLanes = TLanes::Set( y );
+		const TRegister zLanes = TLanes::Set( z );
+		for( ; xIndex + TLanes::Size <= width; xIndex += TLanes::Size ) {
+			const TRegister x = TLanes::Add( xOrigin, TLanes::Mul( TLanes::Indices( xIndex ), xStep ) );
+			TLanes::Store( lanesAction( x, yLanes, zLanes ), result + xIndex );
+		}
+	}
+	// The rest of the row is processed point by point.
+	for( ; xIndex < width; xIndex++ ) {
+		result[xIndex] = pointAction( origin.X() + static_cast<ValueType>( xIndex ) * step.X(), y, z );
+	}
+}
+
+template <class ValueType>
+int CGradientNoise<ValueType>::floorCoordinate( ValueType value )
+{
+	return value >= 0 ? Floor( value ) : Floor( value ) - 1;
+}
+
+template <class ValueType>
+int CGradientNoise<ValueType>::gridIndex( int flooredValue )
+{
+	// Floored value is negative only for negative coordinates.
+	return flooredValue >= 0 ? flooredValue & maxTableValue : tableSize - ( -flooredValue & maxTableValue );
+}
+
+template <class ValueType>
+void CGradientNoise<ValueType>::findCornerHashes( int xFloored, int yFloored, BYTE* hashes ) const
+{
+	const int xGrid = gridIndex( xFloored );
+	const int yGrid = gridIndex( yFloored );
+
+	const BYTE valueL = permTable[xGrid];
+	const int valueTLIndex = valueL + yGrid;
+	const int valueBLIndex = valueTLIndex + 1;
+
+	const BYTE valueR = permTable[xGrid + 1];
+	const int valueTRIndex = valueR + yGrid;
+	const int valueBRIndex = valueTRIndex + 1;
+
+	hashes[0] = permTable[valueTLIndex & maxTableValue];
+	hashes[1] = permTable[valueTRIndex & maxTableValue];
+	hashes[2] = permTable[valueBLIndex & maxTableValue];
+	hashes[3] = permTable[valueBRIndex & maxTableValue];
+}
+
+template <class ValueType>
+void CGradientNoise<ValueType>::findCornerHashes( int xFloored, int yFloored, int zFloored, BYTE* hashes ) const
+{
+	// Close and far corners are found from the hashes of the corresponding two dimensional corners.
+	BYTE planeHashes[4];
+	findCornerHashes( xFloored, yFloored, planeHashes );
+	const int zGrid = gridIndex( zFloored );
+	for( int i = 0; i < 4; i++ ) {
+		const int closeIndex = planeHashes[i] + zGrid;
+		const int farIndex = closeIndex + 1;
+		hashes[i] = permTable[closeIndex & maxTableValue];
+		hashes[i + 4] = permTable[farIndex & maxTableValue];
+	}
+}
+
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::noiseLanes( TRegister x, TRegister y ) const
+{
+	const __m128i xFloored = TLanes::Floor( x );
+	const __m128i yFloored = TLanes::Floor( y );
+
+	// SSE2 has no gather instructions, table lookups are done lane by lane.
+	int xValues[4];
+	int yValues[4];
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( xValues ), xFloored );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( yValues ), yFloored );
+	int cornerHashes[4][4] = {};
+	for( int lane = 0; lane < TLanes::Size; lane++ ) {
+		BYTE hashes[4];
+		findCornerHashes( xValues[lane], yValues[lane], hashes );
+		for( int corner = 0; corner < 4; corner++ ) {
+			cornerHashes[corner][lane] = hashes[corner];
+		}
+	}
+	const auto cornerSeeds = [&cornerHashes]( int corner ) { return _mm_loadu_si128( reinterpret_cast<const __m128i*>( cornerHashes[corner] ) ); };
+
+	// The operations are the same as in the scalar function to produce identical results.
+	const TRegister zero = TLanes::Set( 0 );
+	const TRegister one = TLanes::Set( 1 );
+	const TRegister xRel = TLanes::Sub( x, TLanes::ToValue( xFloored ) );
+	const TRegister yRel = TLanes::Sub( y, TLanes::ToValue( yFloored ) );
+	const TRegister xRelRight = TLanes::Sub( xRel, one );
+	const TRegister yRelBottom = TLanes::Sub( yRel, one );
+
+	const TRegister gradValueTL = gradLanes( cornerSeeds( 0 ), xRel, yRel, zero );
+	const TRegister gradValueTR = gradLanes( cornerSeeds( 1 ), xRelRight, yRel, zero );
+	const TRegister gradValueBL = gradLanes( cornerSeeds( 2 ), xRel, yRelBottom, zero );
+	const TRegister gradValueBR = gradLanes( cornerSeeds( 3 ), xRelRight, yRelBottom, zero );
+
+	const TRegister xFaded = fadeLanes( xRel );
+	const TRegister yFaded = fadeLanes( yRel );
+
+	const TRegister lerpT = lerpLanes( gradValueTL, gradValueTR, xFaded );
+	const TRegister lerpB = lerpLanes( gradValueBL, gradValueBR, xFaded );
+	return lerpLanes( lerpT, lerpB, yFaded );
+}
+
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::noiseLanes( TRegister x, TRegister y, TRegister z ) const
+{
+	const __m128i xFloored = TLanes::Floor( x );
+	const __m128i yFloored = TLanes::Floor( y );
+	const __m128i zFloored = TLanes::Floor( z );
+
+	int xValues[4];
+	int yValues[4];
+	int zValues[4];
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( xValues ), xFloored );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( yValues ), yFloored );
+	_mm_storeu_si128( reinterpret_cast<__m128i*>( zValues ), zFloored );
+	int cornerHashes[8][4] = {};
+	for( int lane = 0; lane < TLanes::Size; lane++ ) {
+		BYTE hashes[8];
+		findCornerHashes( xValues[lane], yValues[lane], zValues[lane], hashes );
+		for( int corner = 0; corner < 8; corner++ ) {
+			cornerHashes[corner][lane] = hashes[corner];
+		}
+	}
+	const auto cornerSeeds = [&cornerHashes]( int corner ) { return _mm_loadu_si128( reinterpret_cast<const __m128i*>( cornerHashes[corner] ) ); };
+
+	const TRegister one = TLanes::Set( 1 );
+	const TRegister xRel = TLanes::Sub( x, TLanes::ToValue( xFloored ) );
+	const TRegister yRel = TLanes::Sub( y, TLanes::ToValue( yFloored ) );
+	const TRegister zRel = TLanes::Sub( z, TLanes::ToValue( zFloored ) );
+	const TRegister xRelRight = TLanes::Sub( xRel, one );
+	const TRegister yRelBottom = TLanes::Sub( yRel, one );
+	const TRegister zRelFar = TLanes::Sub( zRel, one );
+
+	const TRegister gradValueCTL = gradLanes( cornerSeeds( 0 ), xRel, yRel, zRel );
+	const TRegister gradValueCTR = gradLanes( cornerSeeds( 1 ), xRelRight, yRel, zRel );
+	const TRegister gradValueCBL = gradLanes( cornerSeeds( 2 ), xRel, yRelBottom, zRel );
+	const TRegister gradValueCBR = gradLanes( cornerSeeds( 3 ), xRelRight, yRelBottom, zRel );
+
+	const TRegister gradValueFTL = gradLanes( cornerSeeds( 4 ), xRel, yRel, zRelFar );
+	const TRegister gradValueFTR = gradLanes( cornerSeeds( 5 ), xRelRight, yRel, zRelFar );
+	const TRegister gradValueFBL = gradLanes( cornerSeeds( 6 ), xRel, yRelBottom, zRelFar );
+	const TRegister gradValueFBR = gradLanes( cornerSeeds( 7 ), xRelRight, yRelBottom, zRelFar );
+
+	const TRegister xFaded = fadeLanes( xRel );
+	const TRegister yFaded = fadeLanes( yRel );
+	const TRegister zFaded = fadeLanes( zRel );
+
+	const TRegister lerpCT = lerpLanes( gradValueCTL, gradValueCTR, xFaded );
+	const TRegister lerpCB = lerpLanes( gradValueCBL, gradValueCBR, xFaded );
+	const TRegister lerpFT = lerpLanes( gradValueFTL, gradValueFTR, xFaded );
+	const TRegister lerpFB = lerpLanes( gradValueFBL, gradValueFBR, xFaded );
+
+	const TRegister lerpC = lerpLanes( lerpCT, lerpCB, yFaded );
+	const TRegister lerpF = lerpLanes( lerpFT, lerpFB, yFaded );
+	return lerpLanes( lerpC, lerpF, zFaded );
+}
+
 template <class ValueType>
 ValueType CGradientNoise<ValueType>::fade( ValueType value )
 {
@@ -213,6 +596,21 @@ ValueType CGradientNoise<ValueType>::fade( ValueType value )
 	return value * value * value * ( value * ( value * 6 - 15 ) + 10 );
 }
 
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::fadeLanes( TRegister value )
+{
+	const TRegister cube = TLanes::Mul( TLanes::Mul( value, value ), value );
+	const TRegister polynomial = TLanes::Add( TLanes::Mul( value, TLanes::Sub( TLanes::Mul( value, TLanes::Set( 6 ) ), TLanes::Set( 15 ) ) ), TLanes::Set( 10 ) );
+	return TLanes::Mul( cube, polynomial );
+}
+
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::lerpLanes( TRegister left, TRegister right, TRegister t )
+{
+	// Same as Lerp.
+	return TLanes::Add( left, TLanes::Mul( t, TLanes::Sub( right, left ) ) );
+}
+
 // Calculate a dot product with one of the gradient vectors described by seed.
 // Possible gradient vectors can equal one of the 12 possible values described in Perlin's paper.
 // Gradient function optimization is used: http://riven8192.blogspot.com/2010/08/calculate-perlinnoise-twice-as-fast.html
@@ -258,6 +656,90 @@ ValueType CGradientNoise<ValueType>::gradValue( BYTE seed, ValueType x, ValueTyp
     }
 }
 
+// Branchless version of gradValue.
+// Every case of the switch is a sum of two components, subtraction is the addition of the negated component.
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::gradLanes( __m128i seeds, TRegister x, TRegister y, TRegister z )
+{
+	const __m128i seedValues = _mm_and_si128( seeds, _mm_set1_epi32( 15 ) );
+	// The first component is x for the seeds below 8 and y for the rest.
+	const __m128i firstIsX = _mm_cmplt_epi32( seedValues, _mm_set1_epi32( 8 ) );
+	const TRegister first = TLanes::Select( TLanes::ExpandMask( firstIsX ), x, y );
+	// The second component is y for the seeds below 4, x for 12 and 14 and z for the rest.
+	const __m128i secondIsY = _mm_cmplt_epi32( seedValues, _mm_set1_epi32( 4 ) );
+	const __m128i secondIsX = _mm_or_si128( _mm_cmpeq_epi32( seedValues, _mm_set1_epi32( 12 ) ), _mm_cmpeq_epi32( seedValues, _mm_set1_epi32( 14 ) ) );
+	const TRegister second = TLanes::Select( TLanes::ExpandMask( secondIsY ), y, TLanes::Select( TLanes::ExpandMask( secondIsX ), x, z ) );
+	// The first bit negates the first component, the second bit negates the second one.
+	const __m128i negateFirst = _mm_cmpeq_epi32( _mm_and_si128( seedValues, _mm_set1_epi32( 1 ) ), _mm_set1_epi32( 1 ) );
+	const __m128i negateSecond = _mm_cmpeq_epi32( _mm_and_si128( seedValues, _mm_set1_epi32( 2 ) ), _mm_set1_epi32( 2 ) );
+	return TLanes::Add( TLanes::Negate( first, TLanes::ExpandMask( negateFirst ) ), TLanes::Negate( second, TLanes::ExpandMask( negateSecond ) ) );
+}
+
+template <class ValueType>
+ValueType CGradientNoise<ValueType>::addOctave( TFractalNoiseType type, ValueType sum, ValueType amplitude, ValueType value )
+{
+	switch( type ) {
+		case FNT_FBm:
+			return sum + amplitude * value;
+		case FNT_Ridged: {
+			const ValueType ridge = 1 - ( value < 0 ? -value : value );
+			return sum + amplitude * ( ridge * ridge );
+		}
+		default:
+			assert( false );
+			return sum;
+	}
+}
+
+template <class ValueType>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::addOctaveLanes( TFractalNoiseType type, TRegister sum, ValueType amplitude, TRegister value )
+{
+	const TRegister amplitudeLanes = TLanes::Set( amplitude );
+	switch( type ) {
+		case FNT_FBm:
+			return TLanes::Add( sum, TLanes::Mul( amplitudeLanes, value ) );
+		case FNT_Ridged: {
+			const TRegister ridge = TLanes::Sub( TLanes::Set( 1 ), TLanes::Abs( value ) );
+			return TLanes::Add( sum, TLanes::Mul( amplitudeLanes, TLanes::Mul( ridge, ridge ) ) );
+		}
+		default:
+			assert( false );
+			return sum;
+	}
+}
+
+template <class ValueType>
+template <class NoiseAction>
+ValueType CGradientNoise<ValueType>::fractalNoise( const CFractalNoiseParams<ValueType>& params, const NoiseAction& noiseAction )
+{
+	assert( params.OctaveCount > 0 );
+	ValueType sum = 0;
+	ValueType amplitude = 1;
+	ValueType frequency = params.Frequency;
+	for( int i = 0; i < params.OctaveCount; i++ ) {
+		sum = addOctave( params.Type, sum, amplitude, noiseAction( frequency ) );
+		frequency *= params.Lacunarity;
+		amplitude *= params.Gain;
+	}
+	return sum;
+}
+
+template <class ValueType>
+template <class NoiseAction>
+typename CGradientNoise<ValueType>::TRegister CGradientNoise<ValueType>::fractalNoiseLanes( const CFractalNoiseParams<ValueType>& params, const NoiseAction& noiseAction )
+{
+	assert( params.OctaveCount > 0 );
+	TRegister sum = TLanes::Set( 0 );
+	ValueType amplitude = 1;
+	ValueType frequency = params.Frequency;
+	for( int i = 0; i < params.OctaveCount; i++ ) {
+		sum = addOctaveLanes( params.Type, sum, amplitude, noiseAction( frequency ) );
+		frequency *= params.Lacunarity;
+		amplitude *= params.Gain;
+	}
+	return sum;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 }	// namespace Relib.
@@ -279,3 +761,4 @@ ValueType CGradientNoise<ValueType>::gradValue( BYTE seed, ValueType x, ValueTyp
 
 
 
+
@@ -0,0 +1,175 @@
+#pragma once
+#include <Redefs.h>
+#include <Sort.h>
+#include <Array.h>
+#include <ArrayBuffer.h>
+#include <Thread.h>
+#include <Reutils.h>
+
+namespace Relib {
+
+namespace Sort {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Arrays are not split into chunks smaller than this.
+static const int parallelSortMinChunkSize = 16 * 1024;
+
+// Execute the action for each task index. The last task is executed on the calling thread.
+template <class Action>
+void parallelSortRun( int taskCount, const Action& action )
+{
+	CArray<CThread> threads;
+	threads.ReserveBuffer( taskCount - 1 );
+	for( int i = 0; i < taskCount - 1; i++ ) {
+		threads.Add( [&action]( int taskIndex ) { action( taskIndex ); return 0; }, i );
+	}
+	action( taskCount - 1 );
+	for( auto& thread : threads ) {
+		thread.Wait();
+	}
+}
+
+// Find the number of elements taken from the left run in the first resultPos elements of the merged sequence.
+// This merge path split lets independent threads merge parts of the same pair of runs.
+template <class LessAction, class Type>
+int findMergeSplit( const Type* left, int leftSize, const Type* right, int rightSize, int resultPos, const LessAction& less )
+{
+	int low = max( 0, resultPos - rightSize );
+	int high = min( resultPos, leftSize );
+	while( low < high ) {
+		const int mid = ( low + high ) / 2;
+		const int rightPos = resultPos - mid - 1;
+		// Equal elements are taken from the left run first.
+		if( less( right[rightPos], left[mid] ) ) {
+			high = mid;
+		} else {
+			low = mid + 1;
+		}
+	}
+	return low;
+}
+
+// Stable merge of two sorted runs into dest.
+template <class LessAction, class Type>
+void mergeRuns( Type* left, int leftSize, Type* right, int rightSize, Type* dest, const LessAction& less )
+{
+	int leftPos = 0;
+	int rightPos = 0;
+	while( leftPos < leftSize && rightPos < rightSize ) {
+		if( less( right[rightPos], left[leftPos] ) ) {
+			*dest++ = move( right[rightPos++] );
+		} else {
+			*dest++ = move( left[leftPos++] );
+		}
+	}
+	while( leftPos < leftSize ) {
+		*dest++ = move( left[leftPos++] );
+	}
+	while( rightPos < rightSize ) {
+		*dest++ = move( right[rightPos++] );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Multithreaded sort with an arbitrary comparison function.
+// The array is split into chunks that are sorted with IntroSort simultaneously. Sorted chunks are merged pairwise,
+// every merge is split into pieces along the merge path so all threads are busy on each level.
+// Type must be default constructible, the merges use a temporary array of the same size.
+// Zero threadCount stands for the number of processors.
+template <class LessAction, class Type>
+void ParallelSort( CArrayBuffer<Type> arr, const LessAction& less, int threadCount = 0 )
+{
+	const int elemCount = arr.Size();
+	if( threadCount <= 0 ) {
+		threadCount = GetProcessorCount();
+	}
+	const int chunkCount = min( threadCount, elemCount / RelibInternal::parallelSortMinChunkSize );
+	if( chunkCount <= 1 ) {
+		IntroSort( arr.Ptr(), elemCount, less );
+		return;
+	}
+
+	// Run boundaries. Each run is sorted.
+	CArray<int> runBounds;
+	runBounds.IncreaseSizeNoInitialize( chunkCount + 1 );
+	for( int i = 0; i <= chunkCount; i++ ) {
+		runBounds[i] = static_cast<int>( static_cast<__int64>( elemCount ) * i / chunkCount );
+	}
+	Type* src = arr.Ptr();
+	RelibInternal::parallelSortRun( chunkCount, [src, &runBounds, &less]( int chunk ) {
+		IntroSort( src + runBounds[chunk], runBounds[chunk + 1] - runBounds[chunk], less );
+	} );
+
+	CArray<Type> tempArray;
+	tempArray.IncreaseSize( elemCount );
+	Type* dest = tempArray.Ptr();
+	CArray<int> newBounds;
+	while( runBounds.Size() > 2 ) {
+		const int runCount = runBounds.Size() - 1;
+		const int pairCount = runCount / 2;
+		const int piecesPerPair = max( 1, threadCount / pairCount );
+		// An odd run is moved as a whole by an additional task.
+		const int taskCount = pairCount * piecesPerPair + runCount % 2;
+		RelibInternal::parallelSortRun( taskCount, [=, &runBounds, &less]( int task ) {
+			const int pair = task / piecesPerPair;
+			if( pair == pairCount ) {
+				const int runStart = runBounds[runCount - 1];
+				const int runEnd = runBounds[runCount];
+				for( int i = runStart; i < runEnd; i++ ) {
+					dest[i] = move( src[i] );
+				}
+				return;
+			}
+
+			const int piece = task % piecesPerPair;
+			const int leftStart = runBounds[2 * pair];
+			const int rightStart = runBounds[2 * pair + 1];
+			const int leftSize = rightStart - leftStart;
+			const int rightSize = runBounds[2 * pair + 2] - rightStart;
+			const int totalSize = leftSize + rightSize;
+			const int pieceStart = static_cast<int>( static_cast<__int64>( totalSize ) * piece / piecesPerPair );
+			const int pieceEnd = static_cast<int>( static_cast<__int64>( totalSize ) * ( piece + 1 ) / piecesPerPair );
+			const int leftPieceStart = RelibInternal::findMergeSplit( src + leftStart, leftSize, src + rightStart, rightSize, pieceStart, less );
+			const int leftPieceEnd = RelibInternal::findMergeSplit( src + leftStart, leftSize, src + rightStart, rightSize, pieceEnd, less );
+			const int rightPieceStart = pieceStart - leftPieceStart;
+			const int rightPieceEnd = pieceEnd - leftPieceEnd;
+			RelibInternal::mergeRuns( src + leftStart + leftPieceStart, leftPieceEnd - leftPieceStart,
+				src + rightStart + rightPieceStart, rightPieceEnd - rightPieceStart, dest + leftStart + pieceStart, less );
+		} );
+
+		newBounds.Empty();
+		for( int i = 0; i < runCount; i += 2 ) {
+			newBounds.Add( runBounds[i] );
+		}
+		newBounds.Add( elemCount );
+		swap( runBounds, newBounds );
+		swap( src, dest );
+	}
+
+	if( src != arr.Ptr() ) {
+		Type* result = arr.Ptr();
+		const int copyTaskCount = chunkCount;
+		RelibInternal::parallelSortRun( copyTaskCount, [=]( int task ) {
+			const int copyStart = static_cast<int>( static_cast<__int64>( elemCount ) * task / copyTaskCount );
+			const int copyEnd = static_cast<int>( static_cast<__int64>( elemCount ) * ( task + 1 ) / copyTaskCount );
+			for( int i = copyStart; i < copyEnd; i++ ) {
+				result[i] = move( src[i] );
+			}
+		} );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Sort.
+
+}	// namespace Relib.
+
@@ -0,0 +1,13 @@
+#pragma once
+
+// Definitions that do not depend on the platform headers.
+// Headers that include only this file and the standard library build on any platform with a C++17 compiler.
+// Redefs.h includes this file, so the definitions are the same for the rest of the library.
+
+#if defined( _WIN32 ) && defined( REBUILD_DYNAMIC )
+#define REAPI __declspec( dllexport )
+#elif !defined( _WIN32 ) || defined( REBUILD ) || defined( USE_STATIC_RELIB )
+#define REAPI
+#else
+#define REAPI __declspec( dllimport )
+#endif
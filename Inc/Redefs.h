@@ -46,13 +46,7 @@
 
 #define RELIB_SUFFIX PLATFORM_SUFFIX
 
-#if defined( REBUILD_DYNAMIC )
-#define REAPI __declspec( dllexport )
-#elif defined( REBUILD ) || defined( USE_STATIC_RELIB )
-#define REAPI
-#else
-#define REAPI __declspec( dllimport )
-#endif
+#include <PortableDefs.h>
 
 #ifndef REBUILD
 #pragma comment( lib, "ReversedLibrary" RELIB_SUFFIX ".lib" )
@@ -109,6 +103,8 @@ namespace RelibInternal {
 	struct CIndexEntry;
 	template <class ContainedType, class HashStrategy, class Allocator>
 	class CHashIndex;
+	template <class ContainedType, class HashStrategy, class Allocator>
+	class CFlatHashIndex;
 	template <class T, int objectGroupSize, class GroupAllocator, class GeneralAllocator>
 	class CObjectPool;
 	struct CInlineEntityStorage;
@@ -12,12 +12,14 @@
 #include <Arena.h>
 #include <Array.h>
 #include <ArrayBuffer.h>
+#include <AsyncMessageLog.h>
 #include <Atomic.h>
 #include <BaseString.h>
 #include <BaseStringPart.h>
 #include <BaseStringView.h>
 #include <BitSet.h>
 #include <CircleShape.h>
+#include <CollisionWorld.h>
 #include <Color.h>
 #include <Comparators.h>
 #include <ComplexShape.h>
@@ -26,13 +28,16 @@
 #include <ConditionVariable.h>
 #include <ConvexShapeCollisionDetector.h>
 #include <DateTime.h>
+#include <DecimalConversions.h>
 #include <DynamicAllocators.h>
 #include <DynamicBitset.h>
 #include <Easing.h>
 #include <Entity.h>
+#include <EntityCommandBuffer.h>
 #include <EntityComponentSystem.h>
 #include <EntityGroupRange.h>
 #include <EntityInitializer.h>
+#include <EntityQuery.h>
 #include <EntityRange.h>
 #include <EntityRef.h>
 #include <EnumDictionary.h>
@@ -44,7 +49,10 @@
 #include <FileOwners.h>
 #include <FileCollection.h>
 #include <FileMapping.h>
+#include <FilePack.h>
 #include <FileSystem.h>
+#include <FlatHashTable.h>
+#include <FlatMap.h>
 #include <Future.h>
 #include <GeneralBlockAllocator.h>
 #include <GifFile.h>
@@ -59,7 +67,11 @@
 #include <Invoke.h>
 #include <JpgFile.h>
 #include <JsonDocument.h>
+#include <JsonReader.h>
+#include <JsonScalarParser.h>
+#include <JsonStructuralIndex.h>
 #include <JsonValues.h>
+#include <JsonWriter.h>
 #include <KernelEvent.h>
 #include <Link.h>
 #include <LockFreeStorage.h>
@@ -79,6 +91,7 @@
 #include <Optional.h>
 #include <PagedBitSet.h>
 #include <Pair.h>
+#include <ParallelSort.h>
 #include <PersistentStorage.h>
 #include <PngFile.h>
 #include <PointShape.h>
@@ -109,9 +122,12 @@
 #include <StaticAllocators.h>
 #include <StaticArray.h>
 #include <StrConversions.h>
+#include <SystemAccess.h>
 #include <SystemOwner.h>
 #include <Systems.h>
+#include <Task.h>
 #include <Thread.h>
+#include <ThreadPool.h>
 #include <Transformations.h>
 #include <UnicodeSet.h>
 #include <UnicodeUtils.h>
@@ -1,3 +1,7 @@
+#pragma once
+#include <Redefs.h>
+#include <StaticAllocators.h>
+#include <MemoryOwner.h>
 // Sorting algortithms.
 
 namespace Relib {
@@ -183,6 +187,563 @@ void QSort( Type* arr, int elemCount, const LessAction& less )
 
 //////////////////////////////////////////////////////////////////////////
 
+namespace RelibInternal {
+
+// Arrays with this or smaller size are sorted with insertion sort by IntroSort.
+static const int introSortInsertionCutoff = 24;
+// Arrays with a bigger size use the pseudomedian of nine as a pivot.
+static const int introSortNintherCutoff = 128;
+// Maximum number of element moves performed by a partial insertion sort before giving up.
+static const int introSortPartialInsertionLimit = 8;
+// Size of the offset blocks for the branchless partitioning. Offsets must fit in a BYTE.
+static const int introSortBlockSize = 64;
+// Partitions that leave less than 1/introSortBadPartitionRatio elements on one side are considered bad.
+static const int introSortBadPartitionRatio = 8;
+// Branchless partitioning is used for elements that are cheap to copy.
+static const int introSortBranchlessMaxElemSize = 2 * sizeof( void* );
+
+template <class Type>
+struct CIntroSortBranchless {
+	static const bool Result = Types::HasTrivialCopyConstructor<Type>::Result && sizeof( Type ) <= introSortBranchlessMaxElemSize;
+};
+
+// Sorts three elements in place.
+template <class LessAction, class Type>
+inline void sortThree( Type& first, Type& second, Type& third, const LessAction& less )
+{
+	if( less( second, first ) ) {
+		swap( first, second );
+	}
+	if( less( third, second ) ) {
+		swap( second, third );
+		if( less( second, first ) ) {
+			swap( first, second );
+		}
+	}
+}
+
+// Insertion sort that requires the element before arr to be not greater than any element of arr.
+template <class LessAction, class Type>
+void unguardedInsertionSort( Type* arr, int elemCount, const LessAction& less )
+{
+	for( int i = 1; i < elemCount; i++ ) {
+		if( less( arr[i], arr[i - 1] ) ) {
+			Type temp = move( arr[i] );
+			int pos = i;
+			do {
+				arr[pos] = move( arr[pos - 1] );
+				pos--;
+			} while( less( temp, arr[pos - 1] ) );
+			arr[pos] = move( temp );
+		}
+	}
+}
+
+// Regular insertion sort.
+template <class LessAction, class Type>
+void guardedInsertionSort( Type* arr, int elemCount, const LessAction& less )
+{
+	for( int i = 1; i < elemCount; i++ ) {
+		if( less( arr[i], arr[i - 1] ) ) {
+			Type temp = move( arr[i] );
+			int pos = i;
+			do {
+				arr[pos] = move( arr[pos - 1] );
+				pos--;
+			} while( pos > 0 && less( temp, arr[pos - 1] ) );
+			arr[pos] = move( temp );
+		}
+	}
+}
+
+// Insertion sort that gives up if the array is far from being sorted.
+// Returns true if the array has been sorted.
+template <class LessAction, class Type>
+bool partialInsertionSort( Type* arr, int elemCount, const LessAction& less )
+{
+	int moveCount = 0;
+	for( int i = 1; i < elemCount; i++ ) {
+		if( less( arr[i], arr[i - 1] ) ) {
+			Type temp = move( arr[i] );
+			int pos = i;
+			do {
+				arr[pos] = move( arr[pos - 1] );
+				pos--;
+			} while( pos > 0 && less( temp, arr[pos - 1] ) );
+			arr[pos] = move( temp );
+			moveCount += i - pos;
+		}
+		if( moveCount > introSortPartialInsertionLimit ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template <class LessAction, class Type>
+void siftDown( Type* arr, int elemCount, int pos, const LessAction& less )
+{
+	Type temp = move( arr[pos] );
+	for( ;; ) {
+		int child = 2 * pos + 1;
+		if( child >= elemCount ) {
+			break;
+		}
+		if( child + 1 < elemCount && less( arr[child], arr[child + 1] ) ) {
+			child++;
+		}
+		if( !less( temp, arr[child] ) ) {
+			break;
+		}
+		arr[pos] = move( arr[child] );
+		pos = child;
+	}
+	arr[pos] = move( temp );
+}
+
+// Heap sort. Used by IntroSort as a fallback for inputs that cause too many bad partitions.
+template <class LessAction, class Type>
+void heapSort( Type* arr, int elemCount, const LessAction& less )
+{
+	for( int i = elemCount / 2 - 1; i >= 0; i-- ) {
+		siftDown( arr, elemCount, i, less );
+	}
+	for( int i = elemCount - 1; i > 0; i-- ) {
+		swap( arr[0], arr[i] );
+		siftDown( arr, i, 0, less );
+	}
+}
+
+// Partition around the pivot at arr[0]. Elements equal to the pivot go to the right part.
+// Requires an element that is not less than the pivot to be present after the first element.
+// Returns the final pivot position. isAlreadyPartitioned is set if no elements had to be swapped.
+template <class LessAction, class Type>
+int partitionRight( Type* arr, int elemCount, const LessAction& less, bool& isAlreadyPartitioned )
+{
+	Type pivot = move( arr[0] );
+	int first = 0;
+	int last = elemCount;
+	// The median selection guarantees that the first scan stops.
+	while( less( arr[++first], pivot ) ) {
+	}
+	if( first == 1 ) {
+		while( first < last && !less( arr[--last], pivot ) ) {
+		}
+	} else {
+		while( !less( arr[--last], pivot ) ) {
+		}
+	}
+
+	isAlreadyPartitioned = first >= last;
+	while( first < last ) {
+		swap( arr[first], arr[last] );
+		while( less( arr[++first], pivot ) ) {
+		}
+		while( !less( arr[--last], pivot ) ) {
+		}
+	}
+
+	const int pivotPos = first - 1;
+	arr[0] = move( arr[pivotPos] );
+	arr[pivotPos] = move( pivot );
+	return pivotPos;
+}
+
+// Swaps the elements marked in the offset blocks.
+template <class Type>
+void swapOffsets( Type* left, Type* right, const BYTE* leftOffsets, const BYTE* rightOffsets, int count, bool useSwaps )
+{
+	if( useSwaps ) {
+		// Both sides have to be swapped pairwise to preserve the already partitioned pattern.
+		for( int i = 0; i < count; i++ ) {
+			swap( left[leftOffsets[i]], right[-static_cast<int>( rightOffsets[i] )] );
+		}
+	} else if( count > 0 ) {
+		// Cyclic permutation is cheaper than swaps.
+		Type* leftElem = left + leftOffsets[0];
+		Type* rightElem = right - rightOffsets[0];
+		Type temp = move( *leftElem );
+		*leftElem = move( *rightElem );
+		for( int i = 1; i < count; i++ ) {
+			leftElem = left + leftOffsets[i];
+			*rightElem = move( *leftElem );
+			rightElem = right - rightOffsets[i];
+			*leftElem = move( *rightElem );
+		}
+		*rightElem = move( temp );
+	}
+}
+
+// Branchless version of partitionRight.
+// Comparison results are stored into offset blocks instead of branching on them, then the misplaced elements are swapped in bulk.
+template <class LessAction, class Type>
+int partitionRightBranchless( Type* arr, int elemCount, const LessAction& less, bool& isAlreadyPartitioned )
+{
+	Type pivot = move( arr[0] );
+	Type* first = arr;
+	Type* last = arr + elemCount;
+	while( less( *++first, pivot ) ) {
+	}
+	if( first - 1 == arr ) {
+		while( first < last && !less( *--last, pivot ) ) {
+		}
+	} else {
+		while( !less( *--last, pivot ) ) {
+		}
+	}
+
+	isAlreadyPartitioned = first >= last;
+	if( !isAlreadyPartitioned ) {
+		swap( *first, *last );
+		first++;
+
+		alignas( 64 ) BYTE leftOffsets[introSortBlockSize];
+		alignas( 64 ) BYTE rightOffsets[introSortBlockSize];
+		// Offsets are counted from the block bases. Right offsets are counted backwards starting from 1.
+		Type* leftBase = first;
+		Type* rightBase = last;
+		int leftCount = 0;
+		int rightCount = 0;
+		int leftStart = 0;
+		int rightStart = 0;
+		while( first < last ) {
+			// Fill the empty blocks. When less than two blocks of elements are left, they are split between the sides.
+			const int unknownCount = static_cast<int>( last - first );
+			const int leftSplit = leftCount == 0 ? ( rightCount == 0 ? unknownCount / 2 : unknownCount ) : 0;
+			const int rightSplit = rightCount == 0 ? unknownCount - leftSplit : 0;
+
+			const int leftScanSize = min( leftSplit, introSortBlockSize );
+			for( int i = 0; i < leftScanSize; i++ ) {
+				leftOffsets[leftCount] = static_cast<BYTE>( i );
+				leftCount += !less( *first, pivot );
+				first++;
+			}
+			const int rightScanSize = min( rightSplit, introSortBlockSize );
+			for( int i = 1; i <= rightScanSize; i++ ) {
+				rightOffsets[rightCount] = static_cast<BYTE>( i );
+				rightCount += less( *--last, pivot );
+			}
+
+			const int swapCount = min( leftCount, rightCount );
+			swapOffsets( leftBase, rightBase, leftOffsets + leftStart, rightOffsets + rightStart, swapCount, leftCount == rightCount );
+			leftCount -= swapCount;
+			rightCount -= swapCount;
+			leftStart += swapCount;
+			rightStart += swapCount;
+			if( leftCount == 0 ) {
+				leftStart = 0;
+				leftBase = first;
+			}
+			if( rightCount == 0 ) {
+				rightStart = 0;
+				rightBase = last;
+			}
+		}
+
+		// Only one side can have misplaced elements left. Move them to the border.
+		if( leftCount != 0 ) {
+			while( leftCount-- > 0 ) {
+				swap( leftBase[leftOffsets[leftStart + leftCount]], *--last );
+			}
+			first = last;
+		}
+		if( rightCount != 0 ) {
+			while( rightCount-- > 0 ) {
+				swap( *( rightBase - rightOffsets[rightStart + rightCount] ), *first );
+				first++;
+			}
+			last = first;
+		}
+	}
+
+	const int pivotPos = static_cast<int>( first - arr ) - 1;
+	arr[0] = move( arr[pivotPos] );
+	arr[pivotPos] = move( pivot );
+	return pivotPos;
+}
+
+// Partition around the pivot at arr[0]. Elements equal to the pivot go to the left part.
+// Used when the pivot is equal to the element before the array, so the left part is already sorted afterwards.
+template <class LessAction, class Type>
+int partitionLeft( Type* arr, int elemCount, const LessAction& less )
+{
+	Type pivot = move( arr[0] );
+	int first = 0;
+	int last = elemCount;
+	while( less( pivot, arr[--last] ) ) {
+	}
+	if( last + 1 == elemCount ) {
+		while( first < last && !less( pivot, arr[++first] ) ) {
+		}
+	} else {
+		while( !less( pivot, arr[++first] ) ) {
+		}
+	}
+
+	while( first < last ) {
+		swap( arr[first], arr[last] );
+		while( less( pivot, arr[--last] ) ) {
+		}
+		while( !less( pivot, arr[++first] ) ) {
+		}
+	}
+
+	arr[0] = move( arr[last] );
+	arr[last] = move( pivot );
+	return last;
+}
+
+// Swap some elements to break the pattern that causes bad partitions.
+template <class Type>
+void breakPattern( Type* arr, int elemCount )
+{
+	if( elemCount < introSortInsertionCutoff ) {
+		return;
+	}
+	const int quarter = elemCount / 4;
+	swap( arr[0], arr[quarter] );
+	swap( arr[elemCount - 1], arr[elemCount - quarter] );
+	if( elemCount > introSortNintherCutoff ) {
+		swap( arr[1], arr[quarter + 1] );
+		swap( arr[2], arr[quarter + 2] );
+		swap( arr[elemCount - 2], arr[elemCount - quarter - 1] );
+		swap( arr[elemCount - 3], arr[elemCount - quarter - 2] );
+	}
+}
+
+template <class LessAction, class Type>
+void introSortStep( Type* arr, int elemCount, const LessAction& less, int badPartitionsLeft, bool isLeftmost )
+{
+	for( ;; ) {
+		if( elemCount <= introSortInsertionCutoff ) {
+			if( isLeftmost ) {
+				guardedInsertionSort( arr, elemCount, less );
+			} else {
+				unguardedInsertionSort( arr, elemCount, less );
+			}
+			return;
+		}
+
+		// Place the pivot at the start.
+		const int half = elemCount / 2;
+		if( elemCount > introSortNintherCutoff ) {
+			sortThree( arr[0], arr[half], arr[elemCount - 1], less );
+			sortThree( arr[1], arr[half - 1], arr[elemCount - 2], less );
+			sortThree( arr[2], arr[half + 1], arr[elemCount - 3], less );
+			sortThree( arr[half - 1], arr[half], arr[half + 1], less );
+			swap( arr[0], arr[half] );
+		} else {
+			sortThree( arr[half], arr[0], arr[elemCount - 1], less );
+		}
+
+		// If the pivot is equal to the preceding element, this array contains only elements that are not less than the pivot.
+		// All elements equal to the pivot can be put in their final place at once.
+		if( !isLeftmost && !less( arr[-1], arr[0] ) ) {
+			const int pivotPos = partitionLeft( arr, elemCount, less );
+			arr += pivotPos + 1;
+			elemCount -= pivotPos + 1;
+			continue;
+		}
+
+		bool isAlreadyPartitioned;
+		const int pivotPos = CIntroSortBranchless<Type>::Result ? partitionRightBranchless( arr, elemCount, less, isAlreadyPartitioned )
+			: partitionRight( arr, elemCount, less, isAlreadyPartitioned );
+		const int leftSize = pivotPos;
+		const int rightSize = elemCount - pivotPos - 1;
+
+		if( leftSize < elemCount / introSortBadPartitionRatio || rightSize < elemCount / introSortBadPartitionRatio ) {
+			badPartitionsLeft--;
+			if( badPartitionsLeft == 0 ) {
+				// The input is adversarial, fall back to heap sort to guarantee n*log(n) time.
+				heapSort( arr, elemCount, less );
+				return;
+			}
+			breakPattern( arr, leftSize );
+			breakPattern( arr + pivotPos + 1, rightSize );
+		} else if( isAlreadyPartitioned && partialInsertionSort( arr, leftSize, less ) && partialInsertionSort( arr + pivotPos + 1, rightSize, less ) ) {
+			// The array is most likely already sorted.
+			return;
+		}
+
+		// Recurse into the smaller part to limit the stack depth.
+		if( leftSize < rightSize ) {
+			introSortStep( arr, leftSize, less, badPartitionsLeft, isLeftmost );
+			arr += pivotPos + 1;
+			elemCount = rightSize;
+			isLeftmost = false;
+		} else {
+			introSortStep( arr + pivotPos + 1, rightSize, less, badPartitionsLeft, false );
+			elemCount = leftSize;
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Unsigned integer type of the given size.
+template <int size>
+struct CRadixBits;
+
+template <>
+struct CRadixBits<1> {
+	typedef BYTE Result;
+};
+
+template <>
+struct CRadixBits<2> {
+	typedef WORD Result;
+};
+
+template <>
+struct CRadixBits<4> {
+	typedef DWORD Result;
+};
+
+template <>
+struct CRadixBits<8> {
+	typedef unsigned __int64 Result;
+};
+
+// Convert the key to an unsigned integer that has the same order.
+template <class Key>
+auto getRadixBits( Key key )
+{
+	staticAssert( Types::IsNumeric<Key>::Result );
+	typedef typename CRadixBits<sizeof( Key )>::Result TBits;
+	const TBits signBit = static_cast<TBits>( static_cast<TBits>( 1 ) << ( CHAR_BIT * sizeof( TBits ) - 1 ) );
+	if constexpr( Types::IsFloatingPoint<Key>::Result ) {
+		TBits bits;
+		::memcpy( &bits, &key, sizeof( key ) );
+		// Negative values have all bits flipped to reverse their order, positive values are moved above them.
+		return static_cast<TBits>( ( bits & signBit ) != 0 ? ~bits : bits | signBit );
+	} else if constexpr( Key( -1 ) < Key( 0 ) ) {
+		return static_cast<TBits>( static_cast<TBits>( key ) ^ signBit );
+	} else {
+		return static_cast<TBits>( key );
+	}
+}
+
+// Number of buckets in a single radix sort pass.
+static const int radixSortBucketCount = 256;
+// Arrays with this or smaller size are sorted with IntroSort by RadixSort.
+static const int radixSortCutoff = 64;
+
+// LSD radix sort by bytes. The result is placed in arr, temp is used as a scratch buffer.
+template <class Type, class KeyExtractor>
+void radixSort( Type* arr, Type* temp, int elemCount, const KeyExtractor& getKey )
+{
+	typedef decltype( getRadixBits( getKey( *arr ) ) ) TBits;
+	const int passCount = sizeof( TBits );
+
+	// Build the histograms for all passes at once.
+	int counts[passCount][radixSortBucketCount] = {};
+	for( int i = 0; i < elemCount; i++ ) {
+		const TBits bits = getRadixBits( getKey( arr[i] ) );
+		for( int pass = 0; pass < passCount; pass++ ) {
+			counts[pass][( bits >> ( pass * CHAR_BIT ) ) & 0xFF]++;
+		}
+	}
+
+	const TBits firstBits = getRadixBits( getKey( arr[0] ) );
+	Type* src = arr;
+	Type* dest = temp;
+	for( int pass = 0; pass < passCount; pass++ ) {
+		const int shift = pass * CHAR_BIT;
+		int* passCounts = counts[pass];
+		if( passCounts[( firstBits >> shift ) & 0xFF] == elemCount ) {
+			// All keys have the same byte, the pass changes nothing.
+			continue;
+		}
+
+		int offset = 0;
+		for( int bucket = 0; bucket < radixSortBucketCount; bucket++ ) {
+			const int count = passCounts[bucket];
+			passCounts[bucket] = offset;
+			offset += count;
+		}
+		for( int i = 0; i < elemCount; i++ ) {
+			const int bucket = static_cast<int>( ( getRadixBits( getKey( src[i] ) ) >> shift ) & 0xFF );
+			::new( dest + passCounts[bucket]++ ) Type( src[i] );
+		}
+		swap( src, dest );
+	}
+
+	if( src != arr ) {
+		::memcpy( arr, src, elemCount * sizeof( Type ) );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Introspective sort with an arbitrary comparison function.
+// Pivot is chosen as a median of three or a pseudomedian of nine, patterns that produce bad partitions are broken up
+// and the sort falls back to heap sort after too many of them, so the worst case is n*log(n).
+// Elements that are cheap to copy are partitioned without branching on comparison results.
+template <class LessAction, class Type>
+void IntroSort( Type* arr, int elemCount, const LessAction& less )
+{
+	assert( elemCount >= 0 );
+	if( elemCount <= 1 ) {
+		return;
+	}
+	int log2Size = 0;
+	for( int size = elemCount; size > 1; size >>= 1 ) {
+		log2Size++;
+	}
+	RelibInternal::introSortStep( arr, elemCount, less, log2Size, true );
+}
+
+template <class LessAction, class Type>
+void IntroSort( CArrayBuffer<Type> arr, const LessAction& less )
+{
+	IntroSort( arr.Ptr(), arr.Size(), less );
+}
+
+// LSD radix sort of elements by an arithmetic key. The sort is stable.
+// getKey must return an integral or a floating point value for the given element.
+// tempBuffer must have the same size as the array.
+template <class Type, class KeyExtractor>
+void RadixSort( CArrayBuffer<Type> arr, const KeyExtractor& getKey, CArrayBuffer<Type> tempBuffer )
+{
+	staticAssert( Types::HasTrivialCopyConstructor<Type>::Result );
+	assert( tempBuffer.Size() >= arr.Size() );
+	if( arr.Size() <= 1 ) {
+		return;
+	}
+	RelibInternal::radixSort( arr.Ptr(), tempBuffer.Ptr(), arr.Size(), getKey );
+}
+
+// Radix sort that allocates a temporary buffer on the runtime heap.
+template <class Type, class KeyExtractor>
+void RadixSort( CArrayBuffer<Type> arr, const KeyExtractor& getKey )
+{
+	staticAssert( Types::HasTrivialCopyConstructor<Type>::Result );
+	const int elemCount = arr.Size();
+	if( elemCount <= RelibInternal::radixSortCutoff ) {
+		// Small arrays are sorted faster by the stable insertion sort.
+		if( elemCount > 1 ) {
+			RelibInternal::guardedInsertionSort( arr.Ptr(), elemCount, [&getKey]( const Type& left, const Type& right ) {
+				return RelibInternal::getRadixBits( getKey( left ) ) < RelibInternal::getRadixBits( getKey( right ) ); } );
+		}
+		return;
+	}
+	CMemoryOwner<CRuntimeHeap> tempOwner( RELIB_STATIC_ALLOCATE( CRuntimeHeap, elemCount * sizeof( Type ) ) );
+	RelibInternal::radixSort( arr.Ptr(), static_cast<Type*>( tempOwner.Ptr() ), elemCount, getKey );
+}
+
+// Radix sort of the arithmetic values.
+template <class Type>
+void RadixSort( CArrayBuffer<Type> arr )
+{
+	RadixSort( arr, []( Type value ) { return value; } );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Sort.
 
 }	// namespace Relib.
\ No newline at end of file
@@ -137,18 +137,14 @@ const ElemType* end( const CStackArray<ElemType, dim>& arr )
 template <class ElemType, int dim>
 CArchiveWriter& operator<<( CArchiveWriter& archive, const CStackArray<ElemType, dim>& arr )
 {
-	for( const auto& elem : arr ) {
-		archive << elem;
-	}
+	WriteArrayData( archive, arr.Ptr(), dim );
 	return archive;
 }
 
 template <class ElemType, int dim>
 CArchiveReader& operator>>( CArchiveReader& archive, CStackArray<ElemType, dim>& arr )
 {
-	for( const auto& elem : arr ) {
-		archive >> elem;
-	}
+	ReadArrayData( archive, arr.Ptr(), dim );
 	return archive;
 }
 
@@ -6,6 +6,7 @@
 #include <Color.h>
 #include <Optional.h>
 #include <DateTime.h>
+#include <DecimalConversions.h>
 #include <RawStringBuffer.h>
 #include <Relimits.h>
 #include <StackArray.h>
@@ -29,6 +30,8 @@ public:
 	static COptional<CColor> ParseColor( CBaseStringPart<T> str );
 	static COptional<unsigned> ParseHexValue( CBaseStringPart<T> str );
 
+	// Fixed notation with the given number of fractional digits or the shortest round trip representation for Decimal::ShortestDigitCount.
+	// The fixed notation is the default of Str for compatibility, the shortest representation has to be requested explicitly.
 	template <class FltType>
 	static CBaseString<T> FloatToString( FltType value, int digitCount );
 
@@ -36,15 +39,6 @@ private:
 	static const int base10 = 10;
 	static const int base16 = 16;
 
-	template <class IntType>
-	static int parseFloatPart( CBaseStringPart<T> str, int strPos, IntType& result, bool& isMinus );
-	template <class FltType>
-	static int parseMantissa( CBaseStringPart<T> str, int strPos, FltType& result );
-	template <class FltType, class IntType>
-	static FltType mergeBaseWithMantissa( IntType base, FltType mantissa, bool isMinus );
-	template <class FltType, class IntType>
-	static FltType mergeFloatWithExponent( FltType flt, IntType exp, bool isMinus );
-
 	template <class IntType>
 	static COptional<IntType> parsePositiveInteger( CBaseStringPart<T> str );
 	static COptional<unsigned> parseHexValue( CBaseStringPart<T> str );
@@ -52,9 +46,6 @@ private:
 
 	static T getMinusSign();
 	static T getZeroSymbol();
-	static T getDecimalPoint();
-	static T getSmallExponentLetter();
-	static T getLargeExponentLetter();
 	static T getCapitalA();
 	static T getCapitalF();
 	static T getA();
@@ -326,180 +317,10 @@ template <class T>
 template <class FltType>
 COptional<FltType> CCommonConversionFunctions<T>::ParseFloat( CBaseStringPart<T> str )
 {
-	typedef typename CLimits<FltType>::SameSizedIntType TIntType;
-	const FltType maxValue = CLimits<FltType>::Max;
-	const FltType minValue = CLimits<FltType>::Min;
-	const auto length = str.Length();
-
-	int parsePos = 0;
-	TIntType floatBase;
-	bool isMinus;
-	parsePos = parseFloatPart( str, parsePos, floatBase, isMinus );
-	if( parsePos == NotFound || floatBase > maxValue || floatBase < minValue ) {
-		return COptional<FltType>();
-	}
-	FltType floatResult;
-	if( parsePos < length && str[parsePos] == getDecimalPoint() ) {
-		FltType mantissa;
-		parsePos = parseMantissa( str, parsePos + 1, mantissa );
-		if( parsePos == NotFound ) {
-			return COptional<FltType>();
-		}
-		floatResult = mergeBaseWithMantissa( floatBase, mantissa, isMinus );
-	} else {
-		floatResult = isMinus ? static_cast<FltType>( -floatBase ) : static_cast<FltType>( floatBase );
-	}
-	if( parsePos < length && ( str[parsePos] == getSmallExponentLetter() || str[parsePos] == getLargeExponentLetter() ) ) {
-		TIntType exponent;
-		bool isExpMinus;
-		parsePos = parseFloatPart( str, parsePos + 1, exponent, isExpMinus );
-		if( parsePos == NotFound ) {
-			return COptional<FltType>();
-		}
-		floatResult = mergeFloatWithExponent( floatResult, exponent, isExpMinus );
-	}
-
-	return parsePos == length ? COptional<FltType>( floatResult ) : COptional<FltType>();
-}
-
-template <class T>
-template <class IntType>
-int CCommonConversionFunctions<T>::parseFloatPart( CBaseStringPart<T> str, int strPos, IntType& result, bool& isMinus )
-{
-	const IntType maxValue = CLimits<IntType>::Max;
-	const int maxDigits = CLimits<IntType>::MaxDigitsBase10;
-	const T zero = getZeroSymbol();
-	const auto length = str.Length();
-
-	if( strPos >= length ) {
-		return NotFound;
-	}
-	isMinus = str[strPos] == getMinusSign();
-
-	IntType currentResult = 0;
-	const auto startPos = strPos + isMinus;
-	for( int i = startPos; i < length; i++ ) {
-		const T currentChar = str[i];
-		if( !str.IsCharDigit( currentChar ) ) {
-			result = currentResult;
-			return i;
-		}
-		const int currentDigit = currentChar - zero;
-		if( i - startPos == maxDigits ) {
-			if( result > ( maxValue - currentDigit ) / base10 ) {
-				return NotFound;
-			}
-			currentResult = currentResult * base10 + currentDigit;
-			result = currentResult;
-			return i + 1;
-		}
-		currentResult = currentResult * base10 + currentDigit;
-	}
-
-	result = currentResult;
-	return length;
-}
-
-template <class T>
-template <class FltType>
-int CCommonConversionFunctions<T>::parseMantissa( CBaseStringPart<T> str, int strPos, FltType& result )
-{
-	const T zero = getZeroSymbol();
-
+	FltType result;
 	const auto length = str.Length();
-	auto currentResult = FltType( 0 );
-	auto currentBaseModifier = FltType( 0.1 );
-	for( int i = strPos; i < length; i++ ) {
-		const T ch = str[i];
-		if( !str.IsCharDigit( ch ) ) {
-			result = currentResult;
-			return i;
-		}
-		const int currentDigit = ch - zero;
-		currentResult += currentDigit * currentBaseModifier;
-		currentBaseModifier *= FltType( 0.1 );
-	}
-
-	result = currentResult;
-	return length;
-}
-
-template <class T>
-template <class FltType, class IntType>
-FltType CCommonConversionFunctions<T>::mergeBaseWithMantissa( IntType base, FltType mantissa, bool isMinus )
-{
-	const FltType fBase = static_cast<FltType>( base );
-	return isMinus ? -fBase - mantissa : fBase + mantissa;
-}
-
-template <class T>
-template <class FltType, class IntType>
-FltType CCommonConversionFunctions<T>::mergeFloatWithExponent( FltType flt, IntType exp, bool isMinus )
-{
-	if( !isMinus ) {
-		while( exp > 9 ) {
-			flt *= 1000000000;
-			exp -= 9;
-		}
-		while( exp > 4 ) {
-			flt *= 10000;
-			exp -= 4;
-		}
-		while( exp > 0 ) {
-			flt *= 10;
-			exp--;
-		}
-	} else {
-		while( exp > 9 ) {
-			flt /= 1000000000;
-			exp -= 9;
-		}
-		while( exp > 4 ) {
-			flt /= 10000;
-			exp -= 4;
-		}
-		while( exp > 0 ) {
-			flt /= 10;
-			exp--;
-		}
-	}
-	return flt;
-}
-
-template <>
-inline char CCommonConversionFunctions<char>::getDecimalPoint()
-{
-	return '.';
-}
-
-template <>
-inline wchar_t CCommonConversionFunctions<wchar_t>::getDecimalPoint()
-{
-	return L'.';
-}
-
-template <>
-inline char CCommonConversionFunctions<char>::getSmallExponentLetter()
-{
-	return 'e';
-}
-
-template <>
-inline wchar_t CCommonConversionFunctions<wchar_t>::getSmallExponentLetter()
-{
-	return L'e';
-}
-
-template <>
-inline char CCommonConversionFunctions<char>::getLargeExponentLetter()
-{
-	return 'E';
-}
-
-template <>
-inline wchar_t CCommonConversionFunctions<wchar_t>::getLargeExponentLetter()
-{
-	return L'E';
+	const auto parsedLength = Decimal::Parse( str.begin(), length, result );
+	return parsedLength > 0 && parsedLength == length ? COptional<FltType>( result ) : COptional<FltType>();
 }
 
 template <class T>
@@ -559,38 +380,16 @@ template <class T>
 template <class FltType>
 CBaseString<T> CCommonConversionFunctions<T>::FloatToString( FltType value, int digitCount )
 {
-	assert( digitCount >= 0 );
 	CBaseString<T> result;
-	FltType currentFractPart;
-	if( value >= 0 ) {
-		const auto intPart = static_cast<unsigned>( value );
-		result = CStrConversionFunctions<T>::ToString( intPart );
-		currentFractPart = value - intPart;
+	if( digitCount == Decimal::ShortestDigitCount ) {
+		auto resultBuffer = result.CreateRawBuffer( Decimal::MaxShortestLength );
+		resultBuffer.Release( Decimal::FormatShortest( value, resultBuffer.Ptr() ) );
 	} else {
-		const auto intPart = static_cast<unsigned>( -value );
-		result = getMinusSign() + CStrConversionFunctions<T>::ToString( intPart );
-		currentFractPart = -value - intPart;
-	}
-
-	if( digitCount == 0 ) {
-		return result;
-	}
-
-	const int intLength = result.Length();
-	const int resultLength = intLength + digitCount + 1;
-	auto resultBuffer = result.CreateRawBuffer( resultLength );
-	resultBuffer[intLength] = getDecimalPoint();
-
-	for( int i = intLength + 1; i < resultLength; i++ ) {
-		currentFractPart *= 10;
-		const int currentDigit = static_cast<int>( currentFractPart );
-		resultBuffer[i] = numeric_cast<T>( getZeroSymbol() + currentDigit );
-
-		currentFractPart -= currentDigit;
+		assert( digitCount >= 0 );
+		auto resultBuffer = result.CreateRawBuffer( Decimal::GetMaxFixedLength( value, digitCount ) );
+		resultBuffer.Release( Decimal::FormatFixed( value, digitCount, resultBuffer.Ptr() ) );
 	}
-
-	resultBuffer.Release( resultLength );
-	return move( result );
+	return result;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -626,6 +425,7 @@ public:
 	static CString ToString( unsigned value, int base = 10 );
 	static CString ToString( __int64 value, int base = 10 );
 	static CString ToString( double value, int digitCount = 3 );
+	static CString ToString( float value, int digitCount = 3 );
 	static CString ToString( char value );
 	static CString ToString( CStringPart value );
 	static CString ToString( const char* value );
@@ -790,6 +590,11 @@ inline CString CStrConversionFunctions<char>::ToString( double value, int digitC
 	return FloatToString( value, digitCount );
 }
 
+inline CString CStrConversionFunctions<char>::ToString( float value, int digitCount )
+{
+	return FloatToString( value, digitCount );
+}
+
 inline CString CStrConversionFunctions<char>::ToString( char value )
 {
 	return CString( &value, 1 );
@@ -915,6 +720,7 @@ public:
 	static CUnicodeString ToString( unsigned value, int base = 10 );
 	static CUnicodeString ToString( __int64 value, int base = 10 );
 	static CUnicodeString ToString( double value, int digitCount = 3 );
+	static CUnicodeString ToString( float value, int digitCount = 3 );
 	static CUnicodeString ToString( wchar_t value );
 	static CUnicodeString ToString( CUnicodePart value );
 	static CUnicodeString ToString( const wchar_t* value );
@@ -1083,6 +889,11 @@ inline CUnicodeString CStrConversionFunctions<wchar_t>::ToString( double value,
 	return FloatToString( value, digitCount );
 }
 
+inline CUnicodeString CStrConversionFunctions<wchar_t>::ToString( float value, int digitCount )
+{
+	return FloatToString( value, digitCount );
+}
+
 inline CUnicodeString CStrConversionFunctions<wchar_t>::ToString( wchar_t value )
 {
 	return CUnicodeString( &value, 1 );
@@ -1,26 +1,53 @@
 #pragma once
 #include <Redefs.h>
-#include <GeneralBlockAllocator.h>
 #include <StaticAllocators.h>
 #include <DynamicAllocators.h>
-#include <ObjectPool.h>
+#include <Array.h>
+#include <Atomic.h>
+#include <PtrOwner.h>
 
 namespace Relib {
 
+namespace RelibInternal {
+	class CStringThreadHeap;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Number of block size classes in the string allocator.
+static const int StringSizeClassCount = 16;
+
+// String allocator statistics.
+struct CStringAllocatorStatistics {
+	// Total size of allocated blocks in every size class.
+	__int64 LiveBytes[StringSizeClassCount] = {};
+	// Total size of allocated strings that are too large for the size classes.
+	__int64 LargeLiveBytes = 0;
+	// Total size of free blocks cached in the thread magazines.
+	__int64 CachedBytes = 0;
+	// Number of freed blocks.
+	__int64 FreeCount = 0;
+	// Number of blocks that were freed on a thread other than the one that allocated them.
+	// These blocks are counted as live until the owner heap collects them.
+	__int64 RemoteFreeCount = 0;
+};
+
 //////////////////////////////////////////////////////////////////////////
 
 // Memory allocator for strings.
-// Allocates smaller strings in thread local blocks.
+// Smaller strings are allocated in size classes from thread local heaps. Every heap owns pages of blocks with the same size.
+// Each size class of a heap has a magazine, a small stack of free blocks. Allocations and frees on the owner thread use the magazine,
+// the magazine exchanges blocks with the pages in batches.
+// Blocks freed on other threads are gathered in runs with the same owner and pushed to a lock-free list of the owner heap at once.
+// The owner collects them into the magazines when a magazine runs out of free blocks.
+// Every size class keeps one page without allocated blocks, other empty pages are returned to the system.
 class REAPI CStringAllocator {
 public:
 	CStringAllocator();
+	~CStringAllocator();
 
-	auto& GetSmallPool()
-		{ return smallBlockAllocators; }
-	auto& GetMediumPool()
-		{ return mediumBlockAllocators; }
-	auto& GetLargePool()
-		{ return largeBlockAllocators; }
+	// Block size of the given size class.
+	static int GetSizeClassBlockSize( int sizeClass );
 
 	// Allocate memory of at least realSize.
 	CRawBuffer AllocateSized( int realSize );
@@ -28,30 +55,34 @@ public:
 	void Free( CRawBuffer buffer );
 
 #ifdef _DEBUG
+	// Only large strings are tracked by the file name and line. Strings that fit the size classes can be tracked with GetStatistics.
 	CRawBuffer AllocateSized( int size, const char* fileName, int line );
 #endif
 
+	// Gather the statistics of all the threads.
+	// Threads are not stopped during the gathering, the values may be slightly outdated.
+	CStringAllocatorStatistics GetStatistics() const;
+
 private:
-	static const int smallBlockSize = 32;
-	static const int mediumBlockSize = 64;
-	static const int largeBlockSize = 128;
-
-	template <int blockSize>
-	using TStringBlockAllocator = CGeneralBlockAllocator<blockSize, alignof( wchar_t ), CProcessHeap, CDynamicByteResizeStrategy<16 * blockSize>>;
-	template <int blockSize>
-	using TStringAllocatorPool = RelibInternal::CObjectPool<TStringBlockAllocator<blockSize>, 4, CProcessHeap, CProcessHeap>;
-
-	// Block allocators are stored in a global pool.
-	// Every thread gets its own allocator.
-	// Since strings can travel between threads, blocks from one allocator might end up being freed on another one.
-	// That's why block allocators are not destroyed and are instead reused when thread ends.
-	// All allocators are destroyed at program cleanup.
-	TStringAllocatorPool<smallBlockSize> smallBlockAllocators;
-	TStringAllocatorPool<mediumBlockSize> mediumBlockAllocators;
-	TStringAllocatorPool<largeBlockSize> largeBlockAllocators;
+	class CThreadHeapHolder;
+
+	// Heaps are not destroyed when their thread ends. 
+	// Since strings can travel between threads, the blocks of a heap may still be in use, so the heap is reused by the next thread.
+	// All heaps are destroyed at program cleanup.
+	CArray<CPtrOwner<RelibInternal::CStringThreadHeap>> threadHeaps;
+	CArray<RelibInternal::CStringThreadHeap*> freeThreadHeaps;
 
 	// Large strings are stored in a global synchronized heap.
 	CHeapAllocator heapManager;
+	CAtomic<__int64> largeLiveBytes{ 0 };
+
+	RelibInternal::CStringThreadHeap& getThreadHeap();
+	RelibInternal::CStringThreadHeap& acquireThreadHeap();
+	void releaseThreadHeap( RelibInternal::CStringThreadHeap& heap );
+
+	// Copying is prohibited.
+	CStringAllocator( CStringAllocator& ) = delete;
+	void operator=( CStringAllocator& ) = delete;
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -21,8 +21,11 @@ public:
 	static int Length( const char* str );
 	static int CompareNoCase( CStringData<char> left, CStringData<char> right );
 
-	using CCommonStringOperations::Find;
+	// Search is performed with SSE2.
+	static int Find( CStringData<char> data, char symbol, int from );
 	static int Find( CStringData<char> data, CStringData<char> substring, int from );
+	static int FindCommon( CStringData<char> data, CStringData<char> substring, int from );
+	static int FindNoCase( CStringData<char> data, CStringData<char> substring, int from );
 
 	static void MakeUpper( char* buffer, int length );
 	static void MakeLower( char* buffer, int length );
@@ -67,6 +70,14 @@ private:
 
 //////////////////////////////////////////////////////////////////////////
 
+inline int CStringOperations<char>::FindCommon( CStringData<char> data, CStringData<char> substring, int from )
+{
+	if( substring.IsEmpty() ) {
+		return from < data.Length() ? from : NotFound;
+	}
+	return Find( data, substring, from );
+}
+
 inline bool CStringOperations<char>::IsCharWhiteSpace( char ch )
 {
 	return ::isspace( static_cast<unsigned char>( ch ) ) != 0;
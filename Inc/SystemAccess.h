@@ -0,0 +1,56 @@
+#pragma once
+#include <Redefs.h>
+#include <Component.h>
+#include <ComponentGroup.h>
+#include <DynamicBitset.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Declaration of components that a system reads and writes.
+// Systems with non-conflicting access may be executed concurrently. Conflicting systems are executed by the order of their priority.
+class CSystemAccess {
+public:
+	// Declare read access to the component data.
+	void Read( const CBaseComponent& component )
+		{ readSet |= component.GetComponentId(); }
+	void Read( const CComponentGroup& group )
+		{ readSet |= group.GetComponentSet(); }
+
+	// Declare write access to the component data. Writing includes reading.
+	void Write( const CBaseComponent& component )
+		{ writeSet |= component.GetComponentId(); }
+	void Write( const CComponentGroup& group )
+		{ writeSet |= group.GetComponentSet(); }
+
+	// Exclusive systems are never executed concurrently with other systems.
+	// Systems that create or destroy entities or access any data besides the declared components must be exclusive.
+	bool IsExclusive() const
+		{ return isExclusive; }
+	void SetExclusive()
+		{ isExclusive = true; }
+
+	// Check if the systems with the given access declarations can't be executed concurrently.
+	bool ConflictsWith( const CSystemAccess& other ) const;
+
+private:
+	CDynamicBitSet<> readSet;
+	CDynamicBitSet<> writeSet;
+	bool isExclusive = false;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+inline bool CSystemAccess::ConflictsWith( const CSystemAccess& other ) const
+{
+	if( isExclusive || other.isExclusive ) {
+		return true;
+	}
+	return writeSet.Intersects( other.writeSet ) || writeSet.Intersects( other.readSet ) || readSet.Intersects( other.writeSet );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
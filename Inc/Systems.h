@@ -2,6 +2,8 @@
 #include <ExternalObject.h>
 #include <Action.h>
 #include <TemplateUtils.h>
+#include <SystemAccess.h>
+#include <EntityGroupRange.h>
 
 namespace Relib {
 
@@ -26,6 +28,11 @@ public:
 	// System priority is queried once when the system is added to the ECS.
 	virtual int GetPriority() const
 		{ return 0; }
+
+	// Components that the system reads and writes. Systems that don't declare their access are exclusive.
+	// Component access is queried once when the system is added to the ECS.
+	virtual void GetComponentAccess( CSystemAccess& result ) const
+		{ result.SetExclusive(); }
 };
 
 //////////////////////////////////////////////////////////////////////////
@@ -49,6 +56,14 @@ class IUpdateSystem : public IBaseSystem {
 public:
 	virtual void RunEntityListUpdate( CEntityGroupRange range, ISystemContext& context ) = 0;
 
+	// Number of entities in the chunks that are updated concurrently. Zero means that the entity list is not split.
+	// Chunk size is queried once when the system is added to the ECS.
+	virtual int GetEntityChunkSize() const
+		{ return 0; }
+	// Update a chunk of entities from a single group. Called instead of RunEntityListUpdate when the ECS has a thread pool and the chunk size is positive.
+	virtual void RunEntityChunkUpdate( CEntityRange, ISystemContext& )
+		{ assert( false ); }
+
 	// Systems operate on entities that possess a certain set of components. GetTargetGroup determines, which entity group is passed during the system operation.
 	// Target group is queried once when the system is added to the ECS.
 	virtual const CComponentGroup& GetTargetGroup() const = 0;
@@ -59,6 +74,14 @@ class IDrawSystem : public IBaseSystem {
 public:
 	virtual void RunEntityListDraw( CEntityGroupConstRange range, const ISystemContext& context ) const = 0;
 
+	// Number of entities in the chunks that are drawn concurrently. Zero means that the entity list is not split.
+	// Chunk size is queried once when the system is added to the ECS.
+	virtual int GetEntityChunkSize() const
+		{ return 0; }
+	// Draw a chunk of entities from a single group. Called instead of RunEntityListDraw when the ECS has a thread pool and the chunk size is positive.
+	virtual void RunEntityChunkDraw( CEntityConstRange, const ISystemContext& ) const
+		{ assert( false ); }
+
 	// Systems operate on entities that possess a certain set of components. GetTargetGroup determines, which entity group is passed during the system operation.
 	// Target group is queried once when the system is added to the ECS.
 	virtual const CComponentGroup& GetTargetGroup() const = 0;
@@ -129,7 +152,7 @@ void CBaseUpdateSystem<System>::RunEntityListUpdate( CEntityGroupRange range, IS
 
 	// Get the actual type of required update context. It is assumed to be the second argument of the UpdateEntities method.
 	typedef Types::FunctionInfo<decltype( &System::UpdateEntities )>::ArgsTuple TArgsTuple;
-	using TRealContextType = typename TArgsTuple::template Elem<1>;
+	using TRealContextType = typename TArgsTuple::template Elem<2>;
 	typedef Types::PureType<TRealContextType>::Result TPureContextType;
 	staticAssert( ( Types::IsDerivedFrom<TPureContextType, ISystemContext>::Result ) );
 
@@ -153,7 +176,7 @@ void CBaseDrawSystem<System>::RunEntityListDraw( CEntityGroupConstRange range, c
 
 	// Get the actual type of required system context. It is assumed to be the second argument of the DrawEntities method.
 	typedef Types::FunctionInfo<decltype( &System::DrawEntities )>::ArgsTuple TArgsTuple;
-	using TRealContextType = typename TArgsTuple::template Elem<1>;
+	using TRealContextType = typename TArgsTuple::template Elem<2>;
 	typedef Types::PureType<TRealContextType>::Result TPureContextType;
 	staticAssert( ( Types::IsDerivedFrom<TPureContextType, ISystemContext>::Result ) );
 
@@ -163,5 +186,82 @@ void CBaseDrawSystem<System>::RunEntityListDraw( CEntityGroupConstRange range, c
 
 //////////////////////////////////////////////////////////////////////////
 
+// Default number of entities in a concurrently processed chunk.
+static const int DefaultEntityChunkSize = 4096;
+
+// Common base class for update systems that process entities in independent chunks. Uses CRTP to call the UpdateEntities method with the casted context.
+// UpdateEntities takes a range of entities from a single group. It must be safe to call it concurrently for different ranges.
+template <class System>
+class CBaseChunkUpdateSystem : public IUpdateSystem {
+public:
+	virtual int GetEntityChunkSize() const override
+		{ return DefaultEntityChunkSize; }
+
+	virtual void RunEntityListUpdate( CEntityGroupRange range, ISystemContext& context ) override final;
+	virtual void RunEntityChunkUpdate( CEntityRange chunk, ISystemContext& context ) override final;
+};
+
+template <class System>
+void CBaseChunkUpdateSystem<System>::RunEntityListUpdate( CEntityGroupRange range, ISystemContext& context )
+{
+	for( auto entities : range ) {
+		RunEntityChunkUpdate( entities, context );
+	}
+}
+
+template <class System>
+void CBaseChunkUpdateSystem<System>::RunEntityChunkUpdate( CEntityRange chunk, ISystemContext& context )
+{
+	staticAssert( ( Types::IsDerivedFrom<System, CBaseChunkUpdateSystem<System>>::Result ) );
+
+	// Get the actual type of required update context. It is assumed to be the second argument of the UpdateEntities method.
+	typedef Types::FunctionInfo<decltype( &System::UpdateEntities )>::ArgsTuple TArgsTuple;
+	using TRealContextType = typename TArgsTuple::template Elem<2>;
+	typedef Types::PureType<TRealContextType>::Result TPureContextType;
+	staticAssert( ( Types::IsDerivedFrom<TPureContextType, ISystemContext>::Result ) );
+
+	auto& realContext = static_cast<TRealContextType&>( context );
+	static_cast<System&>( *this ).UpdateEntities( chunk, realContext );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Common base class for draw systems that process entities in independent chunks. Uses CRTP to call the DrawEntities method with the casted context.
+// DrawEntities takes a range of entities from a single group. It must be safe to call it concurrently for different ranges.
+template <class System>
+class CBaseChunkDrawSystem : public IDrawSystem {
+public:
+	virtual int GetEntityChunkSize() const override
+		{ return DefaultEntityChunkSize; }
+
+	virtual void RunEntityListDraw( CEntityGroupConstRange range, const ISystemContext& context ) const override final;
+	virtual void RunEntityChunkDraw( CEntityConstRange chunk, const ISystemContext& context ) const override final;
+};
+
+template <class System>
+void CBaseChunkDrawSystem<System>::RunEntityListDraw( CEntityGroupConstRange range, const ISystemContext& context ) const
+{
+	for( auto entities : range ) {
+		RunEntityChunkDraw( entities, context );
+	}
+}
+
+template <class System>
+void CBaseChunkDrawSystem<System>::RunEntityChunkDraw( CEntityConstRange chunk, const ISystemContext& context ) const
+{
+	staticAssert( ( Types::IsDerivedFrom<System, CBaseChunkDrawSystem<System>>::Result ) );
+
+	// Get the actual type of required system context. It is assumed to be the second argument of the DrawEntities method.
+	typedef Types::FunctionInfo<decltype( &System::DrawEntities )>::ArgsTuple TArgsTuple;
+	using TRealContextType = typename TArgsTuple::template Elem<2>;
+	typedef Types::PureType<TRealContextType>::Result TPureContextType;
+	staticAssert( ( Types::IsDerivedFrom<TPureContextType, ISystemContext>::Result ) );
+
+	const auto& realContext = static_cast<const TRealContextType&>( context );
+	static_cast<const System&>( *this ).DrawEntities( chunk, realContext );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Relib.
 
@@ -0,0 +1,390 @@
+#pragma once
+#include <Redefs.h>
+#include <Future.h>
+#include <ThreadPool.h>
+#include <Optional.h>
+#include <Reassert.h>
+#include <Remath.h>
+#include <StaticAllocators.h>
+
+// Coroutines require C++20. The header is empty when compiled with an earlier standard.
+#ifdef __cpp_impl_coroutine
+#include <coroutine>
+#include <exception>
+
+namespace Relib {
+
+template <class T>
+class CTask;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Tag that marks the allocator argument of a task coroutine.
+// Frame of a coroutine with parameters ( TTaskAllocatorArg, Allocator& allocator, ... ) is allocated with the allocator.
+// Member coroutines take the same parameters after the implicit object parameter.
+enum TTaskAllocatorArg {
+	TaskAllocatorArg
+};
+
+// Executor that runs actions immediately on the calling thread.
+class CInlineExecutor {
+public:
+	template <class Action>
+	void Execute( Action&& action )
+		{ action(); }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+// Frame allocation for task coroutines.
+// The frame is prefixed with a header that remembers the allocator that created it.
+class CTaskFrameAllocation {
+public:
+	static void* operator new( size_t size );
+	template <class Allocator, class... Args>
+	static void* operator new( size_t size, TTaskAllocatorArg, Allocator& allocator, Args&... );
+	template <class Owner, class Allocator, class... Args>
+	static void* operator new( size_t size, Owner&, TTaskAllocatorArg, Allocator& allocator, Args&... );
+	static void operator delete( void* ptr, size_t size );
+
+private:
+	struct CFrameHeader {
+		void( *FreeFunction )( void* allocator, void* ptr );
+		void* Allocator;
+	};
+	static const int frameHeaderSize = CeilTo( static_cast<int>( sizeof( CFrameHeader ) ), AllocatorAlignment );
+
+	static void* initFrame( void* frameMemory, void( *freeFunction )( void*, void* ), void* allocator );
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+inline void* CTaskFrameAllocation::operator new( size_t size )
+{
+	void* frameMemory = RELIB_STATIC_ALLOCATE( CProcessHeap, static_cast<int>( size ) + frameHeaderSize );
+	const auto freeFunction = []( void*, void* ptr ) { CProcessHeap::Free( ptr ); };
+	return initFrame( frameMemory, freeFunction, nullptr );
+}
+
+template <class Allocator, class... Args>
+void* CTaskFrameAllocation::operator new( size_t size, TTaskAllocatorArg, Allocator& allocator, Args&... )
+{
+	void* frameMemory = RELIB_ALLOCATE( allocator, static_cast<int>( size ) + frameHeaderSize );
+	const auto freeFunction = []( void* frameAllocator, void* ptr ) { static_cast<Allocator*>( frameAllocator )->Free( ptr ); };
+	return initFrame( frameMemory, freeFunction, &allocator );
+}
+
+template <class Owner, class Allocator, class... Args>
+void* CTaskFrameAllocation::operator new( size_t size, Owner&, TTaskAllocatorArg, Allocator& allocator, Args&... )
+{
+	return operator new( size, TaskAllocatorArg, allocator );
+}
+
+inline void CTaskFrameAllocation::operator delete( void* ptr, size_t )
+{
+	BYTE* frameMemory = static_cast<BYTE*>( ptr ) - frameHeaderSize;
+	const CFrameHeader header = *reinterpret_cast<CFrameHeader*>( frameMemory );
+	header.FreeFunction( header.Allocator, frameMemory );
+}
+
+inline void* CTaskFrameAllocation::initFrame( void* frameMemory, void( *freeFunction )( void*, void* ), void* allocator )
+{
+	assert( frameMemory != nullptr );
+	::new( frameMemory ) CFrameHeader{ freeFunction, allocator };
+	return static_cast<BYTE*>( frameMemory ) + frameHeaderSize;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Awaiter that transfers control to the continuation of a finished task.
+class CTaskFinalAwaiter {
+public:
+	bool await_ready() const noexcept
+		{ return false; }
+	template <class Promise>
+	std::coroutine_handle<> await_suspend( std::coroutine_handle<Promise> handle ) noexcept
+		{ return handle.promise().Finish( handle ); }
+	void await_resume() const noexcept {}
+};
+
+// Common part of the task promises. ResultType is the type of the stored task result.
+template <class ResultType>
+class CTaskPromiseBase : public CTaskFrameAllocation {
+public:
+	// Tasks are lazy, the body is run when the task is awaited or started.
+	std::suspend_always initial_suspend() const noexcept
+		{ return {}; }
+	CTaskFinalAwaiter final_suspend() const noexcept
+		{ return {}; }
+	// Exceptions are stored and the task is finished as usual.
+	// The exception is rethrown in the awaiting coroutine, started tasks abandon their future with it.
+	void unhandled_exception()
+		{ exception = std::current_exception(); }
+
+	ResultType& GetResult()
+		{ return *result; }
+	const std::exception_ptr& GetException() const
+		{ return exception; }
+
+	void SetContinuation( std::coroutine_handle<> newValue )
+		{ continuation = newValue; }
+	void SetResultState( CSharedPtr<CFutureSharedState<ResultType>, CProcessHeap> newValue )
+		{ resultState = move( newValue ); }
+
+	std::coroutine_handle<> Finish( std::coroutine_handle<> handle ) noexcept;
+
+protected:
+	COptional<ResultType> result;
+
+private:
+	// Exception that has escaped the task body.
+	std::exception_ptr exception;
+	// Coroutine that awaits the task.
+	std::coroutine_handle<> continuation;
+	// Shared state of the started task.
+	CSharedPtr<CFutureSharedState<ResultType>, CProcessHeap> resultState;
+};
+
+template <class ResultType>
+std::coroutine_handle<> CTaskPromiseBase<ResultType>::Finish( std::coroutine_handle<> handle ) noexcept
+{
+	if( continuation != nullptr ) {
+		// Symmetric transfer to the awaiting coroutine doesn't grow the stack.
+		return continuation;
+	}
+
+	// A started task owns its frame. The result is passed to the shared state and the frame is destroyed.
+	assert( resultState != nullptr );
+	auto state = move( resultState );
+	if( exception != nullptr ) {
+		const auto reason = exception;
+		handle.destroy();
+		state->Abandon( reason );
+	} else {
+		state->CreateValue( move( *result ) );
+		handle.destroy();
+	}
+	return std::noop_coroutine();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T>
+class CTaskPromise : public CTaskPromiseBase<T> {
+public:
+	CTask<T> get_return_object();
+
+	template <class Arg>
+	void return_value( Arg&& arg )
+		{ this->result.CreateValue( forward<Arg>( arg ) ); }
+};
+
+template <>
+class CTaskPromise<void> : public CTaskPromiseBase<CEmptyTaskResult> {
+public:
+	CTask<void> get_return_object();
+
+	void return_void()
+		{ result.CreateValue(); }
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Awaiter that starts a task and resumes the caller after the task is finished.
+template <class T>
+class CTaskAwaiter {
+public:
+	explicit CTaskAwaiter( std::coroutine_handle<CTaskPromise<T>> _handle ) : handle( _handle ) {}
+
+	bool await_ready() const noexcept
+		{ return false; }
+	std::coroutine_handle<> await_suspend( std::coroutine_handle<> caller ) noexcept;
+	T await_resume();
+
+private:
+	std::coroutine_handle<CTaskPromise<T>> handle;
+};
+
+template <class T>
+std::coroutine_handle<> CTaskAwaiter<T>::await_suspend( std::coroutine_handle<> caller ) noexcept
+{
+	handle.promise().SetContinuation( caller );
+	return handle;
+}
+
+template <class T>
+T CTaskAwaiter<T>::await_resume()
+{
+	const auto& exception = handle.promise().GetException();
+	if( exception != nullptr ) {
+		std::rethrow_exception( exception );
+	}
+	if constexpr( !Types::IsSame<T, void>::Result ) {
+		return move( handle.promise().GetResult() );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Awaiter that resumes the caller on the thread that creates the future value.
+template <class T>
+class CFutureAwaiter {
+public:
+	explicit CFutureAwaiter( CFuture<T> _future ) : future( move( _future ) ) {}
+
+	bool await_ready() const
+		{ return future.TryGetValue() != nullptr; }
+	void await_suspend( std::coroutine_handle<> caller );
+	T& await_resume()
+		{ return future.GetValue(); }
+
+private:
+	CFuture<T> future;
+};
+
+template <class T>
+void CFutureAwaiter<T>::await_suspend( std::coroutine_handle<> caller )
+{
+	// The caller may be resumed and destroyed before the continuation is attached, the awaiter must not be used afterwards.
+	// The caller is resumed on abandonment too, await_resume rethrows the reason.
+	CFuture<T> futureCopy = future;
+	futureCopy.ThenOrAbandoned( [caller]( T& ) { caller.resume(); }, [caller]( const std::exception_ptr& ) { caller.resume(); } );
+}
+
+// Awaiter that resumes the caller on an executor.
+template <class Executor>
+class CExecutorAwaiter {
+public:
+	explicit CExecutorAwaiter( Executor& _executor ) : executor( _executor ) {}
+
+	bool await_ready() const
+		{ return false; }
+	void await_suspend( std::coroutine_handle<> caller )
+		{ executor.Execute( [caller]() { caller.resume(); } ); }
+	void await_resume() const {}
+
+private:
+	Executor& executor;
+};
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Coroutine that produces a value of type T.
+// The body is started when the task is awaited by another coroutine or when Start is called.
+// Awaiting coroutine is resumed right after the task is finished without growing the stack.
+template <class T>
+class CTask {
+public:
+	typedef RelibInternal::CTaskPromise<T> promise_type;
+	typedef typename Types::Conditional<Types::IsSame<T, void>::Result, CEmptyTaskResult, T>::Result TResultType;
+
+	CTask() = default;
+	CTask( CTask&& other ) : handle( other.handle ) { other.handle = nullptr; }
+	CTask& operator=( CTask&& other );
+	~CTask();
+
+	bool IsNull() const
+		{ return handle == nullptr; }
+
+	// Await the task from another coroutine. The task is run on the awaiting thread.
+	RelibInternal::CTaskAwaiter<T> operator co_await() &&;
+
+	// Run the task from the ordinary code. The task is run on the calling thread until its first suspension.
+	// The task frame is owned by the task itself after the call. The result is passed through the returned future.
+	// Tasks that return void produce CEmptyTaskResult. The future is abandoned with the exception if the task throws.
+	CFuture<TResultType> Start() &&;
+
+	// Promises create tasks.
+	friend promise_type;
+
+private:
+	std::coroutine_handle<promise_type> handle;
+
+	explicit CTask( std::coroutine_handle<promise_type> _handle ) : handle( _handle ) {}
+
+	// Copying is prohibited.
+	CTask( const CTask& ) = delete;
+	void operator=( const CTask& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T>
+CTask<T>& CTask<T>::operator=( CTask&& other )
+{
+	swap( handle, other.handle );
+	return *this;
+}
+
+template <class T>
+CTask<T>::~CTask()
+{
+	if( handle != nullptr ) {
+		handle.destroy();
+	}
+}
+
+template <class T>
+RelibInternal::CTaskAwaiter<T> CTask<T>::operator co_await() &&
+{
+	assert( handle != nullptr );
+	return RelibInternal::CTaskAwaiter<T>( handle );
+}
+
+template <class T>
+CFuture<typename CTask<T>::TResultType> CTask<T>::Start() &&
+{
+	assert( handle != nullptr );
+	auto resultState = CreateShared<RelibInternal::CFutureSharedState<TResultType>, CProcessHeap>();
+	handle.promise().SetResultState( resultState );
+	const auto startHandle = handle;
+	handle = nullptr;
+	startHandle.resume();
+	return CFuture<TResultType>( move( resultState ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+template <class T>
+CTask<T> CTaskPromise<T>::get_return_object()
+{
+	return CTask<T>( std::coroutine_handle<CTaskPromise<T>>::from_promise( *this ) );
+}
+
+inline CTask<void> CTaskPromise<void>::get_return_object()
+{
+	return CTask<void>( std::coroutine_handle<CTaskPromise<void>>::from_promise( *this ) );
+}
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Await the future from a coroutine.
+// The coroutine is resumed on the thread that creates the value, e.g. inside CWebConnectionScheduler::Run for scheduled connections.
+// The returned reference is valid while the future is alive. Abandonment reason of the future is rethrown in the coroutine.
+template <class T>
+RelibInternal::CFutureAwaiter<T> operator co_await( CFuture<T> future )
+{
+	return RelibInternal::CFutureAwaiter<T>( move( future ) );
+}
+
+// Suspend the coroutine and resume it on the executor.
+// Executor must provide an Execute method that takes an action without arguments, CThreadPool and CInlineExecutor are examples.
+template <class Executor>
+RelibInternal::CExecutorAwaiter<Executor> ResumeOn( Executor& executor )
+{
+	return RelibInternal::CExecutorAwaiter<Executor>( executor );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
+#endif	// __cpp_impl_coroutine.
@@ -0,0 +1,143 @@
+#pragma once
+#include <PortableDefs.h>
+#include <atomic>
+#include <exception>
+#include <utility>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+class CTaskSchedulerData;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Unit of work for the task scheduler.
+class ISchedulerTask {
+public:
+	virtual ~ISchedulerTask() {}
+
+	virtual void Run() = 0;
+};
+
+// Scheduler task that invokes a callable.
+template <class Action>
+class CSchedulerActionTask : public ISchedulerTask {
+public:
+	explicit CSchedulerActionTask( Action&& _action ) : action( std::move( _action ) ) {}
+
+	void Run() override
+		{ action(); }
+
+private:
+	Action action;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Work-stealing scheduler behind CThreadPool.
+// Every worker has a lock-free deque of tasks. Tasks added by a worker go to its own deque, tasks from other threads go to a shared queue.
+// Idle workers steal tasks from the other deques.
+// Only the standard library is used, so the scheduler builds and runs on every platform with std::thread.
+class REAPI CTaskScheduler {
+public:
+	// Handler for the exceptions that escape a task. It is called from the catch block on the thread that ran the task.
+	typedef void ( *TExceptionHandler )();
+
+	// Thread count must be positive. Exceptions that escape the tasks are dropped if the handler is null.
+	CTaskScheduler( int threadCount, TExceptionHandler exceptionHandler );
+	// Waits for all the added tasks to finish.
+	~CTaskScheduler();
+
+	int ThreadCount() const;
+
+	// Schedule the task. The scheduler deletes the task after running it.
+	void AddTask( ISchedulerTask* task );
+	template <class Action>
+	void Execute( Action action );
+
+	// Run one pending task on the calling thread. Returns false if no task was available.
+	// Unlike waiting on a result, this is safe to call from a worker.
+	bool RunPendingTask();
+	// Execute the pending tasks on the calling thread until the counter becomes not less than the target value.
+	void WaitFor( const std::atomic<int>& counter, int targetValue );
+
+	// Call action( index ) for every index in [begin, end). Grain size must be positive.
+	// The range is split into chunks of grainSize indices that are processed by the workers and the calling thread.
+	// Returns after all the indices are processed.
+	// If the action throws, the remaining chunks are skipped and the first exception is rethrown on the calling thread.
+	template <class Action>
+	void ParallelFor( int begin, int end, int grainSize, const Action& action );
+
+private:
+	CTaskSchedulerData* data;
+
+	// Copying is prohibited.
+	CTaskScheduler( CTaskScheduler& ) = delete;
+	void operator=( CTaskScheduler& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Action>
+void CTaskScheduler::Execute( Action action )
+{
+	AddTask( new CSchedulerActionTask<Action>( std::move( action ) ) );
+}
+
+template <class Action>
+void CTaskScheduler::ParallelFor( int begin, int end, int grainSize, const Action& action )
+{
+	if( begin >= end ) {
+		return;
+	}
+	const long long rangeSize = static_cast<long long>( end ) - begin;
+	const int chunkCount = static_cast<int>( ( rangeSize + grainSize - 1 ) / grainSize );
+	std::atomic<int> nextChunk( 0 );
+	// The first exception thrown by the action. No new chunks are taken after a failure.
+	std::atomic<bool> hasFailed( false );
+	std::exception_ptr failure;
+	const auto processChunks = [&]() {
+		try {
+			for( ;; ) {
+				const int chunk = nextChunk++;
+				if( chunk >= chunkCount || hasFailed.load() ) {
+					return;
+				}
+				const long long chunkBegin = begin + static_cast<long long>( chunk ) * grainSize;
+				const long long chunkEnd = chunkBegin + grainSize < end ? chunkBegin + grainSize : end;
+				for( int i = static_cast<int>( chunkBegin ); i < chunkEnd; i++ ) {
+					action( i );
+				}
+			}
+		} catch( ... ) {
+			if( !hasFailed.exchange( true ) ) {
+				failure = std::current_exception();
+			}
+		}
+	};
+
+	// Helper tasks reference the stack of this call, so it must not return before they finish.
+	const int helperCount = ThreadCount() < chunkCount - 1 ? ThreadCount() : chunkCount - 1;
+	std::atomic<int> finishedHelperCount( 0 );
+	for( int i = 0; i < helperCount; i++ ) {
+		Execute( [&processChunks, &finishedHelperCount]() {
+			processChunks();
+			finishedHelperCount++;
+		} );
+	}
+
+	processChunks();
+	WaitFor( finishedHelperCount, helperCount );
+	// The failure is written before the helper count is increased, so it is visible after the wait.
+	if( failure != nullptr ) {
+		std::rethrow_exception( failure );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
@@ -163,6 +163,11 @@ struct IsFloatingPoint : BoolType<std::is_floating_point<Type>::value> {};
 template <class Type>
 struct IsNumeric : BoolType<std::is_arithmetic<Type>::value || std::is_enum<Type>::value> {};
 
+// Types which archive representation is the same as their memory representation.
+// Contiguous arrays of such types are serialized with a single copy. Can be specialized for plain structures without padding.
+template <class Type>
+struct IsBitwiseSerializable : BoolType<std::is_arithmetic<Type>::value && !std::is_same<Type, bool>::value> {};
+
 template <class Type>
 struct IsFunction : public BoolType<std::is_function<Type>::value> {};
 
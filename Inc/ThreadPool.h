@@ -0,0 +1,81 @@
+#pragma once
+#include <Redefs.h>
+#include <Atomic.h>
+#include <Future.h>
+#include <StaticAllocators.h>
+#include <TaskScheduler.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Pool of worker threads that execute submitted actions.
+// Scheduling is done by RelibInternal::CTaskScheduler, which uses only the standard library and can be built and tested on its own on any platform.
+// The pool adds futures and library error logging on top of it.
+class REAPI CThreadPool {
+public:
+	// Zero thread count stands for the number of processors.
+	explicit CThreadPool( int threadCount = 0 );
+	// Waits for all the submitted tasks to finish.
+	~CThreadPool();
+
+	int ThreadCount() const;
+
+	// Schedule the action for execution. Returns a future for the action result.
+	// Actions that return void produce CEmptyTaskResult. The future is abandoned with the exception if the action throws.
+	template <class Action>
+	auto Submit( Action action );
+	// Schedule the action without tracking its result.
+	template <class Action>
+	void Execute( Action action );
+
+	// Call action( index ) for every index in [begin, end).
+	// The range is split into chunks of grainSize indices that are processed by the workers and the calling thread.
+	// Returns after all the indices are processed.
+	// If the action throws, the remaining chunks are skipped and the first exception is rethrown on the calling thread.
+	template <class Action>
+	void ParallelFor( int begin, int end, int grainSize, const Action& action );
+
+	// Execute the pending tasks on the calling thread until the counter becomes not less than the target value.
+	// Unlike waiting on a future, this is safe to call from a worker.
+	void WaitFor( const CAtomic<int>& counter, int targetValue );
+
+private:
+	RelibInternal::CTaskScheduler scheduler;
+
+	// Copying is prohibited.
+	CThreadPool( CThreadPool& ) = delete;
+	void operator=( CThreadPool& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class Action>
+auto CThreadPool::Submit( Action action )
+{
+	typedef decltype( action() ) TReturnType;
+	typedef typename Types::Conditional<Types::IsSame<TReturnType, void>::Result, CEmptyTaskResult, TReturnType>::Result TResultType;
+	auto resultState = CreateShared<RelibInternal::CFutureSharedState<TResultType>, CProcessHeap>();
+	Execute( [state = resultState, userAction = move( action )]() mutable {
+		state->CreateValueFromAction( userAction );
+	} );
+	return CFuture<TResultType>( move( resultState ) );
+}
+
+template <class Action>
+void CThreadPool::Execute( Action action )
+{
+	scheduler.Execute( move( action ) );
+}
+
+template <class Action>
+void CThreadPool::ParallelFor( int begin, int end, int grainSize, const Action& action )
+{
+	assert( grainSize > 0 );
+	scheduler.ParallelFor( begin, end, grainSize, action );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
@@ -43,6 +43,7 @@ bool REAPI TryConvertUtf16ToUtf32( wchar_t hiCh, wchar_t loCh, unsigned& result
 
 // Convert the first char of a given sequence to UTF32.
 // Return the number of symbols used for conversion or 0 in case of an invalid sequence.
+// Overlong encodings, encoded surrogates and codes above U+10FFFF are invalid.
 int REAPI TryConvertUtf8ToUtf32( const char* str, int length, unsigned& result );
 // Return the number of symbols used for conversion or 0 in case of an invalid sequence.
 // Result must have at least 4 bytes allocated.
@@ -50,6 +51,36 @@ int REAPI TryConvertUtf32ToUtf8( int utf32, char* result );
 
 //////////////////////////////////////////////////////////////////////////
 
+// Text conversion between UTF8 and UTF16.
+// ASCII parts of the text are converted in blocks with SSE2, other symbols are converted one by one.
+
+// Symbol that replaces invalid sequences in the lenient conversion.
+extern const wchar_t Utf16ReplacementChar;
+
+// Check the text encoding.
+bool REAPI IsValidUtf8( const char* str, int length );
+// Surrogates must form pairs.
+bool REAPI IsValidUtf16( const wchar_t* str, int length );
+
+// Size of the result buffer that is enough for the UTF16 conversion.
+inline int GetMaxUtf16Length( int utf8Length )
+	{ return utf8Length; }
+// Exact length of the UTF8 conversion result. Invalid surrogates are counted as replacement chars.
+int REAPI GetUtf8Length( const wchar_t* str, int length );
+
+// Convert the text. Result must have GetMaxUtf16Length( length ) symbols allocated.
+// Return the number of written symbols or NotFound in case of an invalid sequence.
+int REAPI TryConvertUtf8ToUtf16( const char* str, int length, wchar_t* result );
+// Lenient conversion. Maximal invalid subparts are replaced with a single replacement char.
+int REAPI ConvertUtf8ToUtf16( const char* str, int length, wchar_t* result );
+// Convert the text. Result must have GetUtf8Length( str, length ) symbols allocated.
+// Return the number of written symbols or NotFound in case of an unpaired surrogate.
+int REAPI TryConvertUtf16ToUtf8( const wchar_t* str, int length, char* result );
+// Lenient conversion. Unpaired surrogates are replaced with the replacement char.
+int REAPI ConvertUtf16ToUtf8( const wchar_t* str, int length, char* result );
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Unicode.
 
 }	// namespace Relib.
@@ -485,21 +485,26 @@ inline typename CVector<VecType, dim>::FloatingPointVecType operator*( const CVe
 template <class VecType, int dim>
 inline CArchiveWriter& operator<<( CArchiveWriter& archive, const CVector<VecType, dim>& vec )
 {
-	for( const auto& elem : vec ) {
-		archive << elem;
-	}
+	WriteArrayData( archive, vec.Ptr(), dim );
 	return archive;
 }
 
 template <class VecType, int dim>
 inline CArchiveReader& operator>>( CArchiveReader& archive, CVector<VecType, dim>& vec )
 {
-	for( auto& elem : vec ) {
-		archive >> elem;
-	}
+	ReadArrayData( archive, vec.Ptr(), dim );
 	return archive;
 }
 
+namespace Types {
+
+// Vectors without padding are serialized in their memory order.
+template <class VecType, int dim>
+struct IsBitwiseSerializable<CVector<VecType, dim>> : public BoolType<IsBitwiseSerializable<VecType>::Result && sizeof( CVector<VecType, dim> ) == dim * sizeof( VecType )> {
+};
+
+}	// namespace Types.
+
 // Range-based for loops support.
 
 template <class VecType, int dim>
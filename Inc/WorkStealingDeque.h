@@ -0,0 +1,204 @@
+#pragma once
+#include <PortableDefs.h>
+#include <atomic>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Size of the padding that keeps the concurrently modified fields on separate cache lines.
+static const int workStealingPaddingSize = 64;
+
+// Lock-free double-ended queue of pointers for work stealing.
+// The owner thread pushes and pops the elements at the bottom, other threads steal the elements from the top.
+// Chase-Lev algorithm with the memory ordering from "Correct and Efficient Work-Stealing for Weak Memory Models".
+// Only the standard library is used, so the deque builds on every platform.
+template <class T>
+class CWorkStealingDeque {
+public:
+	// Initial capacity must be a power of two.
+	explicit CWorkStealingDeque( int initialCapacity = 256 );
+	~CWorkStealingDeque();
+
+	// Approximate element count. Exact only for the owner thread when there are no thieves.
+	int Size() const;
+	bool IsEmpty() const
+		{ return Size() == 0; }
+
+	// Owner thread operations.
+	void Push( T* elem );
+	// Returns null if the deque is empty.
+	T* Pop();
+
+	// Operation for other threads. Returns null if the deque is empty or the element was taken by another thread.
+	T* Steal();
+
+private:
+	// Circular buffer of element pointers.
+	class CBuffer {
+	public:
+		CBuffer( int capacity, CBuffer* previous );
+		~CBuffer();
+
+		long long Capacity() const
+			{ return mask + 1; }
+		T* Get( long long pos ) const
+			{ return elements[pos & mask].load( std::memory_order_relaxed ); }
+		void Put( long long pos, T* elem )
+			{ elements[pos & mask].store( elem, std::memory_order_relaxed ); }
+
+		// The buffer that was replaced by this one.
+		CBuffer* Previous() const
+			{ return previous; }
+
+	private:
+		std::atomic<T*>* elements;
+		long long mask;
+		CBuffer* previous;
+
+		// Copying is prohibited.
+		CBuffer( CBuffer& ) = delete;
+		void operator=( CBuffer& ) = delete;
+	};
+
+	std::atomic<long long> top;
+	unsigned char topPadding[workStealingPaddingSize];
+	std::atomic<long long> bottom;
+	// The current buffer. Thieves may still read from the old buffers, so the whole chain is freed with the deque.
+	std::atomic<CBuffer*> buffer;
+	unsigned char bottomPadding[workStealingPaddingSize];
+
+	CBuffer* growBuffer( CBuffer* oldBuffer, long long topPos, long long bottomPos );
+
+	// Copying is prohibited.
+	CWorkStealingDeque( CWorkStealingDeque& ) = delete;
+	void operator=( CWorkStealingDeque& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T>
+CWorkStealingDeque<T>::CBuffer::CBuffer( int capacity, CBuffer* _previous ) :
+	elements( new std::atomic<T*>[capacity] ),
+	mask( capacity - 1 ),
+	previous( _previous )
+{
+	for( int i = 0; i < capacity; i++ ) {
+		elements[i].store( nullptr, std::memory_order_relaxed );
+	}
+}
+
+template <class T>
+CWorkStealingDeque<T>::CBuffer::~CBuffer()
+{
+	delete[] elements;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class T>
+CWorkStealingDeque<T>::CWorkStealingDeque( int initialCapacity ) :
+	top( 0 ),
+	bottom( 0 ),
+	buffer( new CBuffer( initialCapacity, nullptr ) )
+{
+}
+
+template <class T>
+CWorkStealingDeque<T>::~CWorkStealingDeque()
+{
+	CBuffer* current = buffer.load( std::memory_order_relaxed );
+	while( current != nullptr ) {
+		CBuffer* previous = current->Previous();
+		delete current;
+		current = previous;
+	}
+}
+
+template <class T>
+int CWorkStealingDeque<T>::Size() const
+{
+	const long long bottomPos = bottom.load( std::memory_order_relaxed );
+	const long long topPos = top.load( std::memory_order_relaxed );
+	return bottomPos > topPos ? static_cast<int>( bottomPos - topPos ) : 0;
+}
+
+template <class T>
+void CWorkStealingDeque<T>::Push( T* elem )
+{
+	const long long bottomPos = bottom.load( std::memory_order_relaxed );
+	const long long topPos = top.load( std::memory_order_acquire );
+	CBuffer* currentBuffer = buffer.load( std::memory_order_relaxed );
+	if( bottomPos - topPos > currentBuffer->Capacity() - 1 ) {
+		currentBuffer = growBuffer( currentBuffer, topPos, bottomPos );
+	}
+	currentBuffer->Put( bottomPos, elem );
+	std::atomic_thread_fence( std::memory_order_release );
+	bottom.store( bottomPos + 1, std::memory_order_relaxed );
+}
+
+template <class T>
+T* CWorkStealingDeque<T>::Pop()
+{
+	const long long bottomPos = bottom.load( std::memory_order_relaxed ) - 1;
+	CBuffer* currentBuffer = buffer.load( std::memory_order_relaxed );
+	bottom.store( bottomPos, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	long long topPos = top.load( std::memory_order_relaxed );
+
+	if( topPos > bottomPos ) {
+		// The deque is empty.
+		bottom.store( bottomPos + 1, std::memory_order_relaxed );
+		return nullptr;
+	}
+
+	T* result = currentBuffer->Get( bottomPos );
+	if( topPos == bottomPos ) {
+		// The last element. Race with the thieves for it.
+		if( !top.compare_exchange_strong( topPos, topPos + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
+			result = nullptr;
+		}
+		bottom.store( bottomPos + 1, std::memory_order_relaxed );
+	}
+	return result;
+}
+
+template <class T>
+T* CWorkStealingDeque<T>::Steal()
+{
+	long long topPos = top.load( std::memory_order_acquire );
+	std::atomic_thread_fence( std::memory_order_seq_cst );
+	const long long bottomPos = bottom.load( std::memory_order_acquire );
+	if( topPos >= bottomPos ) {
+		return nullptr;
+	}
+
+	CBuffer* currentBuffer = buffer.load( std::memory_order_acquire );
+	T* result = currentBuffer->Get( topPos );
+	if( !top.compare_exchange_strong( topPos, topPos + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) ) {
+		// Lost the race to another thief or the owner.
+		return nullptr;
+	}
+	return result;
+}
+
+template <class T>
+typename CWorkStealingDeque<T>::CBuffer* CWorkStealingDeque<T>::growBuffer( CBuffer* oldBuffer, long long topPos, long long bottomPos )
+{
+	const long long newCapacity = oldBuffer->Capacity() * 2;
+	CBuffer* newBuffer = new CBuffer( static_cast<int>( newCapacity ), oldBuffer );
+	for( long long pos = topPos; pos < bottomPos; pos++ ) {
+		newBuffer->Put( pos, oldBuffer->Get( pos ) );
+	}
+	buffer.store( newBuffer, std::memory_order_release );
+	return newBuffer;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
@@ -1,25 +1,127 @@
 #pragma once
 #include <Redefs.h>
+#include <Array.h>
+#include <ArrayBuffer.h>
+#include <PtrOwner.h>
+#include <FileViews.h>
 
 #ifndef RELIB_NO_ZLIB
 
+struct z_stream_s;
+
 namespace Relib {
 
+class CThreadPool;
+
 //////////////////////////////////////////////////////////////////////////
 
 // Mechanism for inflating and deflating data. Uses ZLib for inflation/deflation algorithms.
+// Converter with a thread pool splits large data into blocks that are compressed in parallel.
 class REAPI CZipConverter {
 public:
+	// ZLib default compression level.
+	static const int DefaultCompressionLevel = -1;
+	static const int DefaultBlockSize = 1024 * 1024;
+
+	// Compression level is in the range from 0 to 9 or is the default level.
+	// Thread pool must outlive the converter.
+	explicit CZipConverter( int compressionLevel = DefaultCompressionLevel, CThreadPool* threadPool = nullptr, int blockSize = DefaultBlockSize );
+
+	// Compress the data into a single zlib stream.
+	// Blocks of a parallel compression are primed with the end of the previous block, their concatenation is a regular zlib stream.
 	void ZipData( CArrayView<BYTE> data, CArray<BYTE>& result );
+	// Decompress a zlib stream or a block container. Blocks of a container are decompressed in parallel.
 	void UnzipData( CArrayView<BYTE> data, CArray<BYTE>& result );
 
+	// Compress the data into a block container.
+	// Blocks of a container are compressed independently and are preceded by the block index, so every block can be decompressed on its own.
+	void ZipBlocks( CArrayView<BYTE> data, CArray<BYTE>& result );
+	// Block container information.
+	static bool IsBlockContainer( CArrayView<BYTE> data );
+	static int GetBlockCount( CArrayView<BYTE> container );
+	// Decompress a single block of the container. Block data is appended to the result.
+	void UnzipBlock( CArrayView<BYTE> container, int blockIndex, CArray<BYTE>& result );
+
+	// Streaming classes share the allocation functions.
+	friend class CZipStreamWriter;
+	friend class CZipStreamReader;
+
 private:
+	int compressionLevel;
+	int blockSize;
+	CThreadPool* threadPool;
+
+	void zipParallel( CArrayView<BYTE> data, CArray<BYTE>& result );
+	void unzipBlocks( CArrayView<BYTE> container, CArray<BYTE>& result );
+	template <class Action>
+	void forEachBlock( int blockCount, const Action& action );
+
+	static void deflateBlock( CArrayView<BYTE> data, CArrayView<BYTE> dictionary, int level, int windowBits, int flushMode, CArray<BYTE>& result );
+	static void inflateStream( CArrayView<BYTE> data, CArray<BYTE>& result );
+	static void inflateBlock( CArrayView<BYTE> data, CArrayBuffer<BYTE> result );
+
 	static void* allocationFunction( void* opaque, unsigned itemCoun, unsigned itemSize );
 	static void freeFunction( void* opaque, void* ptr );
 };
 
 //////////////////////////////////////////////////////////////////////////
 
+// Incremental deflation of the data that is produced in portions.
+// Compressed data is written to the target file through a fixed buffer, the uncompressed data is never held as a whole.
+class REAPI CZipStreamWriter {
+public:
+	static const int DefaultBufferSize = 256 * 1024;
+
+	explicit CZipStreamWriter( CFileWriteView target, int bufferSize = DefaultBufferSize );
+	~CZipStreamWriter();
+
+	// Compress the next portion of the data.
+	void Write( CArrayView<BYTE> data );
+	// Write the remaining compressed data and the stream end. Nothing can be written afterwards.
+	void Finish();
+
+private:
+	CFileWriteView target;
+	CPtrOwner<z_stream_s> zStream;
+	CArray<BYTE> outputBuffer;
+
+	void deflateInput( int flushMode );
+
+	// Copying is prohibited.
+	CZipStreamWriter( CZipStreamWriter& ) = delete;
+	void operator=( CZipStreamWriter& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Incremental inflation of the data that is received in portions.
+class REAPI CZipStreamReader {
+public:
+	CZipStreamReader();
+	~CZipStreamReader();
+
+	// Check if the current input has been consumed.
+	bool NeedsInput() const;
+	// Check if the end of the compressed stream has been reached.
+	bool IsStreamEnd() const
+		{ return isStreamEnd; }
+
+	// Set the next portion of the compressed data. The input must stay valid until it's consumed.
+	void SetInput( CArrayView<BYTE> data );
+	// Decompress the input into the result buffer. Return the number of decompressed bytes.
+	int Read( CArrayBuffer<BYTE> result );
+
+private:
+	CPtrOwner<z_stream_s> zStream;
+	bool isStreamEnd = false;
+
+	// Copying is prohibited.
+	CZipStreamReader( CZipStreamReader& ) = delete;
+	void operator=( CZipStreamReader& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Relib.
 
 #endif // RELIB_NO_ZLIB
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <BaseString.h>
 #include <FileOwners.h>
 #include <FileViews.h>
+#include <FileMapping.h>
 #include <MessageLog.h>
 #include <MessageUtils.h>
 #include <Ptr.h>
@@ -15,13 +16,224 @@ extern const CError Err_CompressedArchive;
 
 //////////////////////////////////////////////////////////////////////////
 
+static const BYTE fileArchivePrefix = 0xFA;
+static const BYTE binaryArchivePrefix = 0xBA;
+static const BYTE compressedArchivePrefix = 0xCA;
+
 namespace RelibInternal {
 
+	// Size of the mapped file part.
+	static const int archiveMappingWindowSize = 16 * 1024 * 1024;
+	// Size of the chunks that are read from file views and inflated from compressed archives.
+	static const int archiveReadChunkSize = 1024 * 1024;
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// Source of the streamed archive data.
+	// Named files are mapped to memory a window at a time, file views are read in chunks. Compressed data is inflated into chunks.
+	class CArchiveSource {
+	public:
+		explicit CArchiveSource( CStringPart fileName );
+		explicit CArchiveSource( CFileReadView file );
+
+		// Get the next data window. The previous window becomes invalid. Return an empty window at the end of the data.
+		CArrayView<BYTE> ReadWindow();
+		// Check if there is no data after the last window.
+		bool IsEnd() const;
+
+		// Inflate the rest of the data. The unread part of the last window is used as the first input.
+		void StartInflation( CArrayView<BYTE> windowRest );
+
+	private:
+		CPtrOwner<CFileMapping> mapping;
+		CMappingReadView mappingView;
+		__int64 mappingOffset = 0;
+		__int64 fileLength = 0;
+
+		CFileReadView file;
+		CArray<BYTE> fileChunk;
+
+	#ifndef RELIB_NO_ZLIB
+		CPtrOwner<CZipStreamReader> zipStream;
+		CArray<BYTE> inflatedChunk;
+		// The last inflated byte is held back until the stream end is found, so the end is always known after a window is returned.
+		bool hasHeldByte = false;
+
+		CArrayView<BYTE> inflateWindow();
+	#endif
+		CArrayView<BYTE> readRawWindow();
+	};
+
+	CArchiveSource::CArchiveSource( CStringPart fileName ) :
+		mapping( CreateOwner<CFileMapping>( fileName, CFileMapping::MM_ReadOnly ) )
+	{
+		fileLength = mapping->GetFileLength();
+	}
+
+	CArchiveSource::CArchiveSource( CFileReadView _file ) :
+		file( _file )
+	{
+		fileChunk.IncreaseSizeNoInitialize( archiveReadChunkSize );
+	}
+
+	CArrayView<BYTE> CArchiveSource::ReadWindow()
+	{
+	#ifndef RELIB_NO_ZLIB
+		if( zipStream != nullptr ) {
+			return inflateWindow();
+		}
+	#endif
+		return readRawWindow();
+	}
+
+	bool CArchiveSource::IsEnd() const
+	{
+	#ifndef RELIB_NO_ZLIB
+		if( zipStream != nullptr ) {
+			return zipStream->IsStreamEnd() && !hasHeldByte;
+		}
+	#endif
+		return mapping != nullptr ? mappingOffset == fileLength : file.IsEndOfFile();
+	}
+
+	CArrayView<BYTE> CArchiveSource::readRawWindow()
+	{
+		if( mapping != nullptr ) {
+			mappingView.Close();
+			const auto windowSize = static_cast<int>( min<__int64>( fileLength - mappingOffset, archiveMappingWindowSize ) );
+			if( windowSize == 0 ) {
+				return CArrayView<BYTE>();
+			}
+			mappingView = mapping->CreateReadView( mappingOffset, windowSize );
+			mappingOffset += windowSize;
+			return CArrayView<BYTE>( mappingView.GetBuffer(), windowSize );
+		}
+		const auto readSize = file.Read( fileChunk.Ptr(), fileChunk.Size() );
+		return CArrayView<BYTE>( fileChunk.Ptr(), readSize );
+	}
+
+	void CArchiveSource::StartInflation( CArrayView<BYTE> windowRest )
+	{
+	#ifndef RELIB_NO_ZLIB
+		assert( zipStream == nullptr );
+		zipStream = CreateOwner<CZipStreamReader>();
+		zipStream->SetInput( windowRest );
+		inflatedChunk.IncreaseSizeNoInitialize( archiveReadChunkSize );
+	#else
+		windowRest;
+		check( false, Err_CompressedArchive );
+	#endif
+	}
+
+#ifndef RELIB_NO_ZLIB
+	CArrayView<BYTE> CArchiveSource::inflateWindow()
+	{
+		int inflatedSize = 0;
+		if( hasHeldByte ) {
+			inflatedChunk[0] = inflatedChunk.Last();
+			inflatedSize = 1;
+		}
+		while( inflatedSize < inflatedChunk.Size() && !zipStream->IsStreamEnd() ) {
+			if( zipStream->NeedsInput() ) {
+				const auto input = readRawWindow();
+				// Compressed stream is truncated.
+				check( !input.IsEmpty(), Err_SmallArchive );
+				zipStream->SetInput( input );
+			}
+			inflatedSize += zipStream->Read( inflatedChunk.Mid( inflatedSize ) );
+		}
+		hasHeldByte = !zipStream->IsStreamEnd();
+		return inflatedChunk.Left( hasHeldByte ? inflatedSize - 1 : inflatedSize );
+	}
+#endif
+
+	//////////////////////////////////////////////////////////////////////////
+
+	// Target of the streamed archive data. Data is written to the file directly or through the incremental deflation.
+	class CArchiveTarget {
+	public:
+		CArchiveTarget( CStringPart fileName, TArchiveCompression compression );
+		CArchiveTarget( CFileWriteView file, TArchiveCompression compression );
+
+		void Write( CArrayView<BYTE> data );
+		void Finish();
+
+	private:
+		CPtrOwner<CFileWriter> ownedFile;
+		CFileWriteView file;
+	#ifndef RELIB_NO_ZLIB
+		CPtrOwner<CZipStreamWriter> zipStream;
+	#endif
+
+		void initialize( TArchiveCompression compression );
+	};
+
+	CArchiveTarget::CArchiveTarget( CStringPart fileName, TArchiveCompression compression ) :
+		ownedFile( CreateOwner<CFileWriter>( fileName, FCM_CreateAlways ) )
+	{
+		file = *ownedFile;
+		initialize( compression );
+	}
+
+	CArchiveTarget::CArchiveTarget( CFileWriteView _file, TArchiveCompression compression ) :
+		file( _file )
+	{
+		initialize( compression );
+	}
+
+	void CArchiveTarget::initialize( TArchiveCompression compression )
+	{
+		if( compression == AC_None ) {
+			file.Write( &fileArchivePrefix, sizeof( fileArchivePrefix ) );
+			return;
+		}
+	#ifndef RELIB_NO_ZLIB
+		file.Write( &compressedArchivePrefix, sizeof( compressedArchivePrefix ) );
+		zipStream = CreateOwner<CZipStreamWriter>( file );
+	#else
+		check( false, Err_CompressedArchive );
+	#endif
+	}
+
+	void CArchiveTarget::Write( CArrayView<BYTE> data )
+	{
+	#ifndef RELIB_NO_ZLIB
+		if( zipStream != nullptr ) {
+			zipStream->Write( data );
+			return;
+		}
+	#endif
+		file.Write( data.Ptr(), data.Size() );
+	}
+
+	void CArchiveTarget::Finish()
+	{
+	#ifndef RELIB_NO_ZLIB
+		if( zipStream != nullptr ) {
+			zipStream->Finish();
+		}
+	#endif
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+
 	CArchive::CArchive()
-		: currentBufferPos( 0 )
+		: readWindow( nullptr ),
+		  readWindowSize( 0 ),
+		  currentBufferPos( 0 ),
+		  writeChunkSize( 0 )
+	{
+	}
+
+	CArchive::~CArchive()
 	{
 	}
 
+	bool CArchive::isEndOfReading() const
+	{
+		return currentBufferPos == readWindowSize && ( source == nullptr || source->IsEnd() );
+	}
+
 	void CArchive::increaseBuffer( int bufferSize )
 	{
 		buffer.IncreaseSizeNoInitialize( bufferSize );
@@ -31,18 +243,151 @@ namespace RelibInternal {
 	{
 		currentBufferPos = 0;
 		buffer = move( newBuffer );
+		readWindow = buffer.Ptr();
+		readWindowSize = buffer.Size();
 	}
 
 	CArray<BYTE> CArchive::detachBuffer()
 	{
+		assert( target == nullptr );
+		// The buffer is larger than the written data.
+		buffer.DeleteLast( buffer.Size() - currentBufferPos );
 		currentBufferPos = 0;
 		return move( buffer );
 	}
 
-	void CArchive::skip( int byteCount )
+	void CArchive::attachSource( CPtrOwner<CArchiveSource> newSource )
+	{
+		source = move( newSource );
+		readWindow = nullptr;
+		readWindowSize = 0;
+		currentBufferPos = 0;
+	}
+
+	void CArchive::attachTarget( CPtrOwner<CArchiveTarget> newTarget, int reserveSize, int chunkSize )
+	{
+		assert( reserveSize >= 0 );
+		assert( chunkSize > 0 );
+		target = move( newTarget );
+		writeChunkSize = chunkSize;
+		buffer.Empty();
+		buffer.IncreaseSizeNoInitialize( min( reserveSize, chunkSize ) );
+		currentBufferPos = 0;
+	}
+
+	void CArchive::startSourceInflation()
+	{
+		assert( source != nullptr );
+		source->StartInflation( CArrayView<BYTE>( readWindow + currentBufferPos, readWindowSize - currentBufferPos ) );
+		readWindow = nullptr;
+		readWindowSize = 0;
+		currentBufferPos = 0;
+	}
+
+	void CArchive::closeTarget()
+	{
+		assert( target != nullptr );
+		flushWriteChunk();
+		target->Finish();
+		target = nullptr;
+		buffer.FreeBuffer();
+	}
+
+	void CArchive::skipReading( int byteCount )
 	{
 		assert( byteCount >= 0 );
-		currentBufferPos += byteCount;
+		for( ;; ) {
+			const auto skipSize = min( byteCount, readWindowSize - currentBufferPos );
+			currentBufferPos += skipSize;
+			byteCount -= skipSize;
+			if( byteCount == 0 ) {
+				return;
+			}
+			check( moveReadWindow(), Err_SmallArchive );
+		}
+	}
+
+	void CArchive::skipWriting( int byteCount )
+	{
+		assert( byteCount >= 0 );
+		if( target == nullptr ) {
+			if( byteCount > buffer.Size() - currentBufferPos ) {
+				buffer.IncreaseSizeNoInitialize( currentBufferPos + byteCount );
+			}
+			currentBufferPos += byteCount;
+			return;
+		}
+		// Skipped bytes of a streamed archive are zeroed.
+		const BYTE zeroBlock[256]{};
+		while( byteCount > 0 ) {
+			const auto writeSize = min( byteCount, static_cast<int>( sizeof( zeroBlock ) ) );
+			write( zeroBlock, writeSize );
+			byteCount -= writeSize;
+		}
+	}
+
+	// Read the data that crosses the window end.
+	void CArchive::readSlow( void* ptr, int size )
+	{
+		auto dest = static_cast<BYTE*>( ptr );
+		for( ;; ) {
+			const auto copySize = min( size, readWindowSize - currentBufferPos );
+			if( copySize > 0 ) {
+				::memcpy( dest, readWindow + currentBufferPos, copySize );
+				currentBufferPos += copySize;
+				dest += copySize;
+				size -= copySize;
+			}
+			if( size == 0 ) {
+				return;
+			}
+			check( moveReadWindow(), Err_SmallArchive );
+		}
+	}
+
+	// Write the data that doesn't fit in the buffer.
+	void CArchive::writeSlow( const void* ptr, int size )
+	{
+		if( target == nullptr ) {
+			buffer.IncreaseSizeNoInitialize( max( 2 * buffer.Size(), currentBufferPos + size ) );
+			::memcpy( buffer.Ptr() + currentBufferPos, ptr, size );
+			currentBufferPos += size;
+			return;
+		}
+
+		if( currentBufferPos + size > writeChunkSize ) {
+			flushWriteChunk();
+			if( size >= writeChunkSize ) {
+				// Large data is written directly.
+				target->Write( CArrayView<BYTE>( static_cast<const BYTE*>( ptr ), size ) );
+				return;
+			}
+		}
+		if( currentBufferPos + size > buffer.Size() ) {
+			buffer.IncreaseSizeNoInitialize( min( writeChunkSize, max( 2 * buffer.Size(), currentBufferPos + size ) ) );
+		}
+		::memcpy( buffer.Ptr() + currentBufferPos, ptr, size );
+		currentBufferPos += size;
+	}
+
+	bool CArchive::moveReadWindow()
+	{
+		if( source == nullptr ) {
+			return false;
+		}
+		const auto window = source->ReadWindow();
+		readWindow = window.Ptr();
+		readWindowSize = window.Size();
+		currentBufferPos = 0;
+		return readWindowSize > 0;
+	}
+
+	void CArchive::flushWriteChunk()
+	{
+		if( currentBufferPos > 0 ) {
+			target->Write( buffer.Left( currentBufferPos ) );
+			currentBufferPos = 0;
+		}
 	}
 
 	int CArchive::readSmallValue()
@@ -162,21 +507,15 @@ namespace RelibInternal {
 
 //////////////////////////////////////////////////////////////////////////
 
-static const BYTE fileArchivePrefix = 0xFA;
-static const BYTE binaryArchivePrefix = 0xBA;
-static const BYTE compressedArchivePrefix = 0xCA;
 CArchiveReader::CArchiveReader( CStringPart fileName )
-	: CArchiveReader( CFileReader( fileName, FCM_OpenExisting ) )
 {
+	attachSource( CreateOwner<RelibInternal::CArchiveSource>( fileName ) );
+	handleArchiveFlags();
 }
 
 CArchiveReader::CArchiveReader( CFileReadView file )
 {
-	const auto length = file.GetLength32();
-	auto& detachedBuffer = getBuffer();
-	detachedBuffer.IncreaseSizeNoInitialize( length );
-	file.Read( detachedBuffer.Ptr(), length );
-
+	attachSource( CreateOwner<RelibInternal::CArchiveSource>( file ) );
 	handleArchiveFlags();
 }
 
@@ -191,6 +530,10 @@ void CArchiveReader::handleArchiveFlags()
 	BYTE archiveFlag;
 	( *this ) >> archiveFlag;
 	if( archiveFlag == compressedArchivePrefix ) {
+		if( hasSource() ) {
+			startSourceInflation();
+			return;
+		}
 #ifndef RELIB_NO_ZLIB
 		CZipConverter zipper;
 		CArray<BYTE> unzippedData;
@@ -211,7 +554,17 @@ CArchiveWriter::CArchiveWriter( int reserveSize )
 {
 	const auto flagByteSize = sizeof( fileArchivePrefix );
 	increaseBuffer( reserveSize + flagByteSize );
-	skip( flagByteSize );
+	skipWriting( flagByteSize );
+}
+
+CArchiveWriter::CArchiveWriter( CFileWriteView file, TArchiveCompression compression, int chunkSize )
+{
+	attachTarget( CreateOwner<RelibInternal::CArchiveTarget>( file, compression ), chunkSize, chunkSize );
+}
+
+CArchiveWriter::CArchiveWriter( CStringPart fileName, TArchiveCompression compression, int reserveSize, int chunkSize )
+{
+	attachTarget( CreateOwner<RelibInternal::CArchiveTarget>( fileName, compression ), reserveSize, chunkSize );
 }
 
 extern const CStringView UncommitedArchiveError;
@@ -222,6 +575,13 @@ CArchiveWriter::~CArchiveWriter()
 	}
 }
 
+void CArchiveWriter::Close()
+{
+	if( hasTarget() ) {
+		closeTarget();
+	}
+}
+
 void CArchiveWriter::FlushToFile( CStringPart fileName )
 {
 	CFileWriter file( fileName, FCM_CreateAlways );
@@ -269,16 +629,15 @@ void CArchiveWriter::writeArchiveFlag( BYTE flagValue, CArray<BYTE>& dest ) cons
 
 //////////////////////////////////////////////////////////////////////////
 
-CFileArchiveWriter::CFileArchiveWriter( CStringPart _fileName, int reserveSize )
-	: CArchiveWriter( reserveSize ),
-	  fileName( _fileName )
+CFileArchiveWriter::CFileArchiveWriter( CStringPart fileName, int reserveSize, int chunkSize )
+	: CArchiveWriter( fileName, AC_None, reserveSize, chunkSize )
 {
 }
 
 CFileArchiveWriter::~CFileArchiveWriter()
 {
 	try {
-		FlushToFile( fileName );
+		Close();
 	} catch( CException& e ) {
 		Log::Exception( e );
 	}
@@ -287,16 +646,15 @@ CFileArchiveWriter::~CFileArchiveWriter()
 //////////////////////////////////////////////////////////////////////////
 
 #ifndef RELIB_NO_ZLIB
-CCompressedArchiveWriter::CCompressedArchiveWriter( CStringPart _fileName, int reserveSize )
-	: CArchiveWriter( reserveSize ),
-	  fileName( _fileName )
+CCompressedArchiveWriter::CCompressedArchiveWriter( CStringPart fileName, int reserveSize, int chunkSize )
+	: CArchiveWriter( fileName, AC_Zlib, reserveSize, chunkSize )
 {
 }
 
 CCompressedArchiveWriter::~CCompressedArchiveWriter()
 {
 	try {
-		FlushToCompressedFile( fileName );
+		Close();
 	} catch( CException& e ) {
 		Log::Exception( e );
 	}
@@ -0,0 +1,533 @@
+#include <AsyncMessageLog.h>
+#include <StrConversions.h>
+#include <UnicodeUtils.h>
+#include <DateTime.h>
+#include <Remath.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Header of a message in the ring buffer. Message text follows the header.
+struct CLogRecordHeader {
+	// Text length in bytes. Padding records that fill the buffer end are marked with NotFound.
+	int TextLength;
+	int Type;
+	// Addition time as a FILETIME value.
+	__int64 Time;
+};
+
+// Records start at aligned positions, so a header always fits before the buffer end.
+static const int logRecordAlignment = sizeof( CLogRecordHeader );
+
+//////////////////////////////////////////////////////////////////////////
+
+// Single producer single consumer ring buffer of log messages.
+// Positions grow continuously and are wrapped by the buffer mask.
+// The buffer is owned by the log and by the thread that adds messages to it, the last owner deletes it.
+class CLogRingBuffer {
+public:
+	explicit CLogRingBuffer( int bufferSize );
+
+	// The thread has ended and won't add messages anymore. Its reference is released.
+	bool IsThreadFinished() const
+		{ return isThreadFinished.Load( std::memory_order_acquire ); }
+	void FinishThread();
+	// The log has been destroyed. Its reference is released.
+	bool IsLogClosed() const
+		{ return isLogClosed.Load( std::memory_order_acquire ); }
+	void CloseLog();
+
+	// Maximum message length that fits in the buffer.
+	int GetMaxTextLength() const
+		{ return buffer.Size() / 2 - sizeof( CLogRecordHeader ); }
+	// Check if the consumer should be woken up early.
+	bool IsHalfFull() const
+		{ return writePos.Load( std::memory_order_relaxed ) - readPos.Load( std::memory_order_relaxed ) >= static_cast<unsigned>( buffer.Size() / 2 ); }
+
+	// Producer side. Return false if there is not enough free space.
+	bool TryPush( CStringPart text, TLogMessageType type, __int64 time );
+	// Consumer side. Pass all the available messages to the action.
+	template <class Action>
+	int PopAll( Action action );
+
+private:
+	CArray<BYTE> buffer;
+	unsigned mask;
+	// Read position that was last seen by the producer.
+	unsigned cachedReadPos = 0;
+	// Producer and consumer positions are kept on separate cache lines.
+	alignas( 64 ) CAtomic<unsigned> writePos{ 0 };
+	alignas( 64 ) CAtomic<unsigned> readPos{ 0 };
+	CAtomic<int> ownerCount{ 2 };
+	CAtomic<bool> isThreadFinished{ false };
+	CAtomic<bool> isLogClosed{ false };
+
+	void release();
+	bool hasFreeSpace( unsigned pos, unsigned size );
+	CLogRecordHeader& getHeader( unsigned pos );
+};
+
+CLogRingBuffer::CLogRingBuffer( int bufferSize )
+{
+	int size = logRecordAlignment * 4;
+	while( size < bufferSize ) {
+		size *= 2;
+	}
+	buffer.IncreaseSizeNoInitialize( size );
+	mask = static_cast<unsigned>( size - 1 );
+}
+
+void CLogRingBuffer::FinishThread()
+{
+	isThreadFinished.Store( true, std::memory_order_release );
+	release();
+}
+
+void CLogRingBuffer::CloseLog()
+{
+	isLogClosed.Store( true, std::memory_order_release );
+	release();
+}
+
+void CLogRingBuffer::release()
+{
+	if( ownerCount.PreDecrement() == 0 ) {
+		delete this;
+	}
+}
+
+bool CLogRingBuffer::TryPush( CStringPart text, TLogMessageType type, __int64 time )
+{
+	assert( text.Length() <= GetMaxTextLength() );
+	const auto recordSize = static_cast<unsigned>( CeilTo( sizeof( CLogRecordHeader ) + text.Length(), logRecordAlignment ) );
+	auto pos = writePos.Load( std::memory_order_relaxed );
+	const auto tailSize = static_cast<unsigned>( buffer.Size() ) - ( pos & mask );
+	if( recordSize > tailSize ) {
+		// Fill the buffer end and start from the beginning.
+		if( !hasFreeSpace( pos, tailSize ) ) {
+			return false;
+		}
+		getHeader( pos ).TextLength = NotFound;
+		pos += tailSize;
+		writePos.Store( pos, std::memory_order_release );
+	}
+	if( !hasFreeSpace( pos, recordSize ) ) {
+		return false;
+	}
+
+	auto& header = getHeader( pos );
+	header.TextLength = text.Length();
+	header.Type = type;
+	header.Time = time;
+	::memcpy( &header + 1, text.begin(), text.Length() );
+	writePos.Store( pos + recordSize, std::memory_order_release );
+	return true;
+}
+
+template <class Action>
+int CLogRingBuffer::PopAll( Action action )
+{
+	auto pos = readPos.Load( std::memory_order_relaxed );
+	const auto endPos = writePos.Load( std::memory_order_acquire );
+	int count = 0;
+	while( pos != endPos ) {
+		const auto& header = getHeader( pos );
+		if( header.TextLength == NotFound ) {
+			pos += static_cast<unsigned>( buffer.Size() ) - ( pos & mask );
+			continue;
+		}
+		action( CStringPart( reinterpret_cast<const char*>( &header + 1 ), header.TextLength ), header.Time );
+		pos += static_cast<unsigned>( CeilTo( sizeof( CLogRecordHeader ) + header.TextLength, logRecordAlignment ) );
+		count++;
+	}
+	readPos.Store( pos, std::memory_order_release );
+	return count;
+}
+
+bool CLogRingBuffer::hasFreeSpace( unsigned pos, unsigned size )
+{
+	const auto bufferSize = static_cast<unsigned>( buffer.Size() );
+	if( pos - cachedReadPos + size <= bufferSize ) {
+		return true;
+	}
+	cachedReadPos = readPos.Load( std::memory_order_acquire );
+	return pos - cachedReadPos + size <= bufferSize;
+}
+
+CLogRecordHeader& CLogRingBuffer::getHeader( unsigned pos )
+{
+	return *reinterpret_cast<CLogRecordHeader*>( buffer.Ptr() + ( pos & mask ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Log identifiers are never reused, so a stale thread cache never matches a new log.
+static CAtomic<int> nextAsyncLogId{ 0 };
+
+// Buffer that was last used by the current thread.
+static thread_local int cachedAsyncLogId = NotFound;
+static thread_local CLogRingBuffer* cachedLogBuffer = nullptr;
+
+// Buffers of the current thread in all the logs. The thread references are released when the thread ends.
+class CThreadLogBuffers {
+public:
+	~CThreadLogBuffers();
+
+	CLogRingBuffer* Find( int logId ) const;
+	// Buffers of the destroyed logs are released at the same time.
+	void Add( int logId, CLogRingBuffer& buffer );
+
+private:
+	struct CThreadBuffer {
+		int LogId;
+		CLogRingBuffer* Buffer;
+	};
+
+	CArray<CThreadBuffer> buffers;
+};
+
+CThreadLogBuffers::~CThreadLogBuffers()
+{
+	cachedAsyncLogId = NotFound;
+	cachedLogBuffer = nullptr;
+	for( const auto& threadBuffer : buffers ) {
+		threadBuffer.Buffer->FinishThread();
+	}
+}
+
+CLogRingBuffer* CThreadLogBuffers::Find( int logId ) const
+{
+	for( const auto& threadBuffer : buffers ) {
+		if( threadBuffer.LogId == logId ) {
+			return threadBuffer.Buffer;
+		}
+	}
+	return nullptr;
+}
+
+void CThreadLogBuffers::Add( int logId, CLogRingBuffer& buffer )
+{
+	for( int i = buffers.Size() - 1; i >= 0; i-- ) {
+		if( buffers[i].Buffer->IsLogClosed() ) {
+			buffers[i].Buffer->FinishThread();
+			buffers.DeleteAt( i );
+		}
+	}
+	buffers.Add( CThreadBuffer{ logId, &buffer } );
+}
+
+static thread_local CThreadLogBuffers threadLogBuffers;
+
+// Size of the formatted text that is collected before writing.
+static const int logOutputBatchSize = 64 * 1024;
+// FILETIME ticks in a second.
+static const __int64 fileTimeSecond = 10000000;
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+extern CCriticalSection FileWriteSection;
+namespace RelibInternal {
+	extern const char Utf16LEFileTag[2];
+}
+CAsyncMessageLog::CAsyncMessageLog( CStringPart fileName, TLogOverflowPolicy _overflowPolicy, int _threadBufferSize ) :
+	logId( RelibInternal::nextAsyncLogId.PostIncrement() ),
+	overflowPolicy( _overflowPolicy ),
+	threadBufferSize( _threadBufferSize ),
+	addTimestamps( true ),
+	isUnicodeTarget( true )
+{
+	{
+		CCriticalSectionLock lock( FileWriteSection );
+		ownedFile = CreateOwner<CFileWriter>( fileName, FCM_CreateOrOpen );
+		if( ownedFile->SeekToEnd() == 0 ) {
+			// File is empty, make it unicode.
+			ownedFile->Write( RelibInternal::Utf16LEFileTag, sizeof( RelibInternal::Utf16LEFileTag ) );
+		}
+	}
+	target = *ownedFile;
+	startWriter();
+}
+
+CAsyncMessageLog::CAsyncMessageLog( TLogOverflowPolicy _overflowPolicy, int _threadBufferSize ) :
+	CAsyncMessageLog( CFileWriteView( ::GetStdHandle( STD_OUTPUT_HANDLE ) ), _overflowPolicy, _threadBufferSize )
+{
+}
+
+CAsyncMessageLog::CAsyncMessageLog( CFileWriteView file, TLogOverflowPolicy _overflowPolicy, int _threadBufferSize ) :
+	logId( RelibInternal::nextAsyncLogId.PostIncrement() ),
+	overflowPolicy( _overflowPolicy ),
+	threadBufferSize( _threadBufferSize ),
+	addTimestamps( false ),
+	isUnicodeTarget( false ),
+	target( file )
+{
+	startWriter();
+}
+
+CAsyncMessageLog::~CAsyncMessageLog()
+{
+	Shutdown();
+	for( auto buffer : threadBuffers ) {
+		buffer->CloseLog();
+	}
+}
+
+void CAsyncMessageLog::startWriter()
+{
+	assert( threadBufferSize > 0 );
+	writerOutput.ReserveBuffer( RelibInternal::logOutputBatchSize );
+	writerThread.Start( [this]() { return runWriter(); } );
+}
+
+void CAsyncMessageLog::Flush()
+{
+	CCriticalSectionLock lock( section );
+	if( isWriterStopping ) {
+		return;
+	}
+	const auto flushId = ++flushRequestCount;
+	writerWakeup.WakeOne();
+	flushWakeup.Sleep( lock, [&]() { return flushedCount >= flushId; } );
+}
+
+void CAsyncMessageLog::Shutdown()
+{
+	if( isShutDown.Exchange( true ) ) {
+		return;
+	}
+	{
+		CCriticalSectionLock lock( section );
+		isWriterStopping = true;
+	}
+	writerWakeup.WakeOne();
+	writerThread.Wait();
+}
+
+void CAsyncMessageLog::AddMessage( CString text, TLogMessageType type )
+{
+	if( isShutDown.Load( std::memory_order_relaxed ) ) {
+		droppedMessageCount.PreIncrement();
+		return;
+	}
+
+	// The time is captured here, date formatting is left to the writer.
+	FILETIME fileTime;
+	::GetSystemTimeAsFileTime( &fileTime );
+	const auto time = static_cast<__int64>( ( static_cast<unsigned __int64>( fileTime.dwHighDateTime ) << 32 ) | fileTime.dwLowDateTime );
+
+	auto& buffer = getThreadBuffer();
+	// Long messages are cut at a UTF-8 character boundary.
+	auto messageLength = min( text.Length(), buffer.GetMaxTextLength() );
+	while( messageLength < text.Length() && messageLength > 0 && ( text[messageLength] & 0xC0 ) == 0x80 ) {
+		messageLength--;
+	}
+	const auto messageText = text.Left( messageLength );
+	if( buffer.TryPush( messageText, type, time ) ) {
+		if( buffer.IsHalfFull() ) {
+			wakeWriter();
+		}
+		return;
+	}
+
+	if( overflowPolicy == LOP_Drop ) {
+		droppedMessageCount.PreIncrement();
+		wakeWriter();
+		return;
+	}
+	blockedMessageCount.PreIncrement();
+	while( !buffer.TryPush( messageText, type, time ) ) {
+		if( isShutDown.Load( std::memory_order_relaxed ) ) {
+			droppedMessageCount.PreIncrement();
+			return;
+		}
+		wakeWriter();
+		::SwitchToThread();
+	}
+}
+
+RelibInternal::CLogRingBuffer& CAsyncMessageLog::getThreadBuffer()
+{
+	if( RelibInternal::cachedAsyncLogId == logId ) {
+		return *RelibInternal::cachedLogBuffer;
+	}
+	return findThreadBuffer();
+}
+
+RelibInternal::CLogRingBuffer& CAsyncMessageLog::findThreadBuffer()
+{
+	auto result = RelibInternal::threadLogBuffers.Find( logId );
+	if( result == nullptr ) {
+		result = new RelibInternal::CLogRingBuffer( threadBufferSize );
+		RelibInternal::threadLogBuffers.Add( logId, *result );
+		CCriticalSectionLock lock( section );
+		threadBuffers.Add( result );
+	}
+	RelibInternal::cachedAsyncLogId = logId;
+	RelibInternal::cachedLogBuffer = result;
+	return *result;
+}
+
+// The writer wakes up periodically, so a missed wake up only delays the writing.
+void CAsyncMessageLog::wakeWriter()
+{
+	writerWakeup.WakeOne();
+}
+
+int CAsyncMessageLog::runWriter()
+{
+	for( ;; ) {
+		int flushId;
+		bool isStopping;
+		{
+			CCriticalSectionLock lock( section );
+			if( flushedCount == flushRequestCount && !isWriterStopping ) {
+				writerWakeup.SleepFor( lock, MaxWriteDelay );
+			}
+			flushId = flushRequestCount;
+			isStopping = isWriterStopping;
+			// Buffers are only removed by the writer thread.
+			writerBuffers.Empty();
+			for( auto buffer : threadBuffers ) {
+				writerBuffers.Add( buffer );
+			}
+		}
+
+		writeMessages();
+
+		{
+			CCriticalSectionLock lock( section );
+			flushedCount = flushId;
+			removeFinishedBuffers();
+		}
+		flushWakeup.WakeAll();
+		if( isStopping ) {
+			return 0;
+		}
+	}
+}
+
+// Messages are only formatted while they are taken from the buffers, so the buffer space is always released.
+// Output is written between the buffers and consists of whole messages.
+void CAsyncMessageLog::writeMessages()
+{
+	finishedBuffers.Empty();
+	for( auto buffer : writerBuffers ) {
+		// The thread adds no messages after finishing, so its buffer is empty after this pass.
+		if( buffer->IsThreadFinished() ) {
+			finishedBuffers.Add( buffer );
+		}
+		buffer->PopAll( [this]( CStringPart text, __int64 time ) { formatMessage( text, time ); } );
+		if( writerOutput.Size() >= RelibInternal::logOutputBatchSize ) {
+			writeOutput();
+		}
+	}
+	writeOutput();
+}
+
+// Buffers of the ended threads have been emptied by the writer and are released.
+void CAsyncMessageLog::removeFinishedBuffers()
+{
+	if( finishedBuffers.IsEmpty() ) {
+		return;
+	}
+	threadBuffers.DeleteMatching( [this]( RelibInternal::CLogRingBuffer* buffer ) {
+		for( auto finishedBuffer : finishedBuffers ) {
+			if( finishedBuffer == buffer ) {
+				return true;
+			}
+		}
+		return false;
+	} );
+	for( auto buffer : finishedBuffers ) {
+		buffer->CloseLog();
+	}
+	finishedBuffers.Empty();
+}
+
+// Messages are formatted the same way as in the synchronous logs.
+// A message that cannot be formatted is dropped, the writer thread must keep running.
+void CAsyncMessageLog::formatMessage( CStringPart text, __int64 time )
+{
+	const auto messageStart = writerOutput.Size();
+	try {
+		if( addTimestamps ) {
+			updateTimestamp( time );
+			appendOutput( timestampStr );
+		}
+		const auto length = text.Length();
+		int copyStart = 0;
+		for( int i = 0; i < length; i++ ) {
+			if( text[i] == '\n' && ( i == 0 || text[i - 1] != '\r' ) ) {
+				appendOutput( text.Mid( copyStart, i - copyStart ) );
+				appendOutput( "\r" );
+				copyStart = i;
+			}
+		}
+		appendOutput( text.Mid( copyStart ) );
+		appendOutput( "\r\n" );
+		writerMessageCount++;
+	} catch( ... ) {
+		writerOutput.DeleteLast( writerOutput.Size() - messageStart );
+		droppedMessageCount.PreIncrement();
+	}
+}
+
+// Timestamps have a second precision, so the formatted string is reused for all the messages of the same second.
+void CAsyncMessageLog::updateTimestamp( __int64 time )
+{
+	const auto second = time / RelibInternal::fileTimeSecond;
+	if( second == timestampSecond ) {
+		return;
+	}
+	FILETIME fileTime;
+	fileTime.dwLowDateTime = static_cast<DWORD>( time );
+	fileTime.dwHighDateTime = static_cast<DWORD>( time >> 32 );
+	FILETIME localFileTime;
+	SYSTEMTIME localTime;
+	::FileTimeToLocalFileTime( &fileTime, &localFileTime );
+	::FileTimeToSystemTime( &localFileTime, &localTime );
+	const CDateTime date( localTime.wYear, localTime.wMonth, localTime.wDay, localTime.wHour, localTime.wMinute, localTime.wSecond );
+	timestampStr = Str( date, "[YYYY.MM.DD H:M:S] " );
+	timestampSecond = second;
+}
+
+void CAsyncMessageLog::appendOutput( CStringPart text )
+{
+	const auto length = text.Length();
+	const auto pos = writerOutput.Size();
+	writerOutput.IncreaseSizeNoInitialize( pos + length );
+	::memcpy( writerOutput.Ptr() + pos, text.begin(), length );
+}
+
+// Errors cannot be reported through the log itself. Messages of a failed write are counted as dropped.
+void CAsyncMessageLog::writeOutput()
+{
+	if( writerOutput.IsEmpty() ) {
+		return;
+	}
+	try {
+		if( isUnicodeTarget ) {
+			writerUnicodeOutput.Empty();
+			writerUnicodeOutput.IncreaseSizeNoInitialize( Unicode::GetMaxUtf16Length( writerOutput.Size() ) );
+			const auto unicodeLength = Unicode::ConvertUtf8ToUtf16( writerOutput.Ptr(), writerOutput.Size(), writerUnicodeOutput.Ptr() );
+			target.Write( writerUnicodeOutput.Ptr(), unicodeLength * sizeof( wchar_t ) );
+		} else {
+			target.Write( writerOutput.Ptr(), writerOutput.Size() );
+		}
+	} catch( ... ) {
+		droppedMessageCount.FetchAdd( writerMessageCount );
+	}
+	writerOutput.Empty();
+	writerMessageCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
@@ -0,0 +1,383 @@
+#include <EntityCommandBuffer.h>
+#include <EntityContainer.h>
+#include <EntityGroup.h>
+#include <ComponentGroup.h>
+#include <Entity.h>
+#include <MemoryOwner.h>
+#include <StaticAllocators.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Size of a value arena page. Larger values are allocated separately.
+static const int entityCommandPageSize = 64 * 1024;
+
+// Commands recorded by a single thread.
+class CEntityCommandStream {
+public:
+	struct CValueCommand {
+		int CreatedEntity;
+		const CBaseComponent* Component;
+		void* Value;
+	};
+	struct CChangeCommand {
+		CEntityRef Entity;
+		const CBaseComponent* Component;
+		// Null for the component removal.
+		void* Value;
+	};
+
+	// Thread that records into the stream.
+	DWORD ThreadId;
+	CArray<const CComponentGroup*> Creations;
+	CArray<CValueCommand> CreatedValues;
+	CArray<CChangeCommand> Changes;
+	CArray<CEntityRef> Destructions;
+
+	explicit CEntityCommandStream( DWORD threadId ) : ThreadId( threadId ) {}
+	~CEntityCommandStream()
+		{ Empty(); }
+
+	bool IsEmpty() const
+		{ return Creations.IsEmpty() && Changes.IsEmpty() && Destructions.IsEmpty(); }
+
+	void* AllocateValue( int size );
+	void Empty();
+
+private:
+	// Arena pages. Values are never moved, the pages are reused after the stream is emptied.
+	CArray<CMemoryOwner<>> pages;
+	int currentPage = 0;
+	int currentPageOffset = 0;
+	// Values that don't fit in a page.
+	CArray<CMemoryOwner<>> largeValues;
+
+	static void destroyValue( const CBaseComponent& component, void* value );
+};
+
+void* CEntityCommandStream::AllocateValue( int size )
+{
+	const auto byteSize = CeilTo( size, AllocatorAlignment );
+	if( byteSize > entityCommandPageSize ) {
+		largeValues.Add( CRuntimeHeap::Allocate( byteSize ) );
+		return largeValues.Last().Ptr();
+	}
+
+	if( currentPageOffset + byteSize > entityCommandPageSize ) {
+		currentPage++;
+		currentPageOffset = 0;
+	}
+	if( currentPage == pages.Size() ) {
+		pages.Add( CRuntimeHeap::Allocate( entityCommandPageSize ) );
+	}
+	const auto result = static_cast<BYTE*>( pages[currentPage].Ptr() ) + currentPageOffset;
+	currentPageOffset += byteSize;
+	return result;
+}
+
+void CEntityCommandStream::Empty()
+{
+	for( const auto& command : CreatedValues ) {
+		destroyValue( *command.Component, command.Value );
+	}
+	for( const auto& command : Changes ) {
+		if( command.Value != nullptr ) {
+			destroyValue( *command.Component, command.Value );
+		}
+	}
+
+	Creations.Empty();
+	CreatedValues.Empty();
+	Changes.Empty();
+	Destructions.Empty();
+	largeValues.Empty();
+	currentPage = 0;
+	currentPageOffset = 0;
+}
+
+void CEntityCommandStream::destroyValue( const CBaseComponent& component, void* value )
+{
+	const auto destroyPtr = component.GetDestroyFunction();
+	if( destroyPtr != nullptr ) {
+		destroyPtr( value, component.GetSize() );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Buffer identifiers are never reused, so a stale thread cache never matches a new buffer.
+static CAtomic<int> nextCommandBufferId{ 0 };
+
+// Stream that was last used by the current thread.
+static thread_local int cachedCommandBufferId = NotFound;
+static thread_local CEntityCommandStream* cachedCommandStream = nullptr;
+
+// Cached lookup of the entity groups by the recorded component groups.
+struct CCreationGroup {
+	const CComponentGroup* Components;
+	CEntityGroup* Group;
+};
+
+// Cached entity group change caused by adding or removing a component.
+struct CGroupTransition {
+	CEntityGroup* Source;
+	const CBaseComponent* Component;
+	bool IsAddition;
+	CEntityGroup* Target;
+};
+
+// Number of entities that will be added to a group during the playback.
+struct CGroupReservation {
+	CEntityGroup* Group;
+	int NewEntityCount;
+};
+
+static void addReservation( CArray<CGroupReservation>& reservations, CEntityGroup& group )
+{
+	for( auto& reservation : reservations ) {
+		if( reservation.Group == &group ) {
+			reservation.NewEntityCount++;
+			return;
+		}
+	}
+	reservations.Add( &group, 1 );
+}
+
+static void reserveGroups( CArrayView<CGroupReservation> reservations )
+{
+	for( const auto& reservation : reservations ) {
+		reservation.Group->ReserveBuffer( reservation.Group->Size() + reservation.NewEntityCount );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+CEntityCommandBuffer::CEntityCommandBuffer() :
+	bufferId( RelibInternal::nextCommandBufferId.PostIncrement() )
+{
+}
+
+CEntityCommandBuffer::~CEntityCommandBuffer()
+{
+}
+
+bool CEntityCommandBuffer::IsEmpty() const
+{
+	for( const auto& stream : streams ) {
+		if( !stream->IsEmpty() ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int CEntityCommandBuffer::CreateEntity( const CComponentGroup& componentGroup )
+{
+	auto& creations = getThreadStream().Creations;
+	creations.Add( &componentGroup );
+	return creations.Size() - 1;
+}
+
+void CEntityCommandBuffer::RemoveComponent( CEntityRef entity, const CBaseComponent& component )
+{
+	getThreadStream().Changes.Add( entity, &component, nullptr );
+}
+
+void CEntityCommandBuffer::DestroyEntity( CEntityRef entity )
+{
+	getThreadStream().Destructions.Add( entity );
+}
+
+void* CEntityCommandBuffer::allocateValue( int size )
+{
+	return getThreadStream().AllocateValue( size );
+}
+
+void CEntityCommandBuffer::addCreatedValue( int createdEntity, const CBaseComponent& component, void* value )
+{
+	auto& stream = getThreadStream();
+	assert( createdEntity >= 0 && createdEntity < stream.Creations.Size() );
+	assert( stream.Creations[createdEntity]->GetComponentSet().Has( component.GetComponentId() ) );
+	stream.CreatedValues.Add( createdEntity, &component, value );
+}
+
+void CEntityCommandBuffer::addComponentValue( CEntityRef entity, const CBaseComponent& component, void* value )
+{
+	getThreadStream().Changes.Add( entity, &component, value );
+}
+
+RelibInternal::CEntityCommandStream& CEntityCommandBuffer::getThreadStream()
+{
+	if( RelibInternal::cachedCommandBufferId == bufferId ) {
+		return *RelibInternal::cachedCommandStream;
+	}
+	return findThreadStream();
+}
+
+RelibInternal::CEntityCommandStream& CEntityCommandBuffer::findThreadStream()
+{
+	const auto threadId = ::GetCurrentThreadId();
+	RelibInternal::CEntityCommandStream* result = nullptr;
+	{
+		CCriticalSectionLock lock( streamSection );
+		for( auto& stream : streams ) {
+			if( stream->ThreadId == threadId ) {
+				result = stream.Ptr();
+				break;
+			}
+		}
+		if( result == nullptr ) {
+			result = streams.Add( CreateOwner<RelibInternal::CEntityCommandStream>( threadId ) ).Ptr();
+		}
+	}
+
+	RelibInternal::cachedCommandBufferId = bufferId;
+	RelibInternal::cachedCommandStream = result;
+	return *result;
+}
+
+void CEntityCommandBuffer::Playback( CEntityContainer& container )
+{
+	createEntities( container );
+	changeComponents( container );
+	destroyEntities( container );
+	Empty();
+}
+
+void CEntityCommandBuffer::Empty()
+{
+	for( auto& stream : streams ) {
+		stream->Empty();
+	}
+}
+
+void CEntityCommandBuffer::createEntities( CEntityContainer& container )
+{
+	// Find the target groups and reserve them for all the new entities.
+	CArray<RelibInternal::CCreationGroup> creationGroups;
+	CArray<RelibInternal::CGroupReservation> reservations;
+	CArray<CEntityGroup*> targetGroups;
+	for( const auto& stream : streams ) {
+		for( auto components : stream->Creations ) {
+			CEntityGroup* targetGroup = nullptr;
+			for( const auto& creationGroup : creationGroups ) {
+				if( creationGroup.Components == components ) {
+					targetGroup = creationGroup.Group;
+					break;
+				}
+			}
+			if( targetGroup == nullptr ) {
+				targetGroup = &container.getOrCreateEntityGroup( *components );
+				creationGroups.Add( components, targetGroup );
+			}
+			RelibInternal::addReservation( reservations, *targetGroup );
+			targetGroups.Add( targetGroup );
+		}
+	}
+	RelibInternal::reserveGroups( reservations );
+
+	// Create the entities and move the recorded values to them.
+	CArray<int> groupPositions;
+	int targetPos = 0;
+	for( const auto& stream : streams ) {
+		const auto firstTargetPos = targetPos;
+		groupPositions.Empty();
+		for( int i = 0; i < stream->Creations.Size(); i++ ) {
+			auto& group = *targetGroups[targetPos];
+			targetPos++;
+			const auto data = container.createEntityData();
+			const auto groupPos = group.AddEntity( data );
+			data->Entity = CEntity( group, groupPos, data );
+			groupPositions.Add( groupPos );
+		}
+
+		for( const auto& command : stream->CreatedValues ) {
+			auto& group = *targetGroups[firstTargetPos + command.CreatedEntity];
+			const auto groupPos = groupPositions[command.CreatedEntity];
+			command.Component->MoveAssignValue( command.Value, group.GetRawValue( *command.Component, groupPos ) );
+		}
+	}
+}
+
+void CEntityCommandBuffer::changeComponents( CEntityContainer& container )
+{
+	CArray<RelibInternal::CGroupTransition> transitions;
+	const auto findTargetGroup = [&]( CEntityGroup& source, const CBaseComponent& component, bool isAddition ) -> CEntityGroup& {
+		for( const auto& transition : transitions ) {
+			if( transition.Source == &source && transition.Component == &component && transition.IsAddition == isAddition ) {
+				return *transition.Target;
+			}
+		}
+
+		CComponentGroup targetComponents;
+		for( auto sourceComponent : source.GetComponentGroup().GetComponents() ) {
+			if( isAddition || sourceComponent != &component ) {
+				targetComponents.Add( *sourceComponent );
+			}
+		}
+		if( isAddition ) {
+			targetComponents.Add( component );
+		}
+		auto& target = container.getOrCreateEntityGroup( targetComponents );
+		transitions.Add( &source, &component, isAddition, &target );
+		return target;
+	};
+
+	// Entities that change several times in a row are reserved by their first transition only. Reservation doesn't affect the result.
+	CArray<RelibInternal::CGroupReservation> reservations;
+	for( auto& stream : streams ) {
+		for( auto& command : stream->Changes ) {
+			if( !command.Entity.IsValid() ) {
+				continue;
+			}
+			auto& source = command.Entity->getOwnerGroup();
+			const auto isAddition = command.Value != nullptr;
+			if( source.HasComponent( *command.Component ) != isAddition ) {
+				RelibInternal::addReservation( reservations, findTargetGroup( source, *command.Component, isAddition ) );
+			}
+		}
+	}
+	RelibInternal::reserveGroups( reservations );
+
+	for( auto& stream : streams ) {
+		for( auto& command : stream->Changes ) {
+			if( !command.Entity.IsValid() ) {
+				continue;
+			}
+			auto& fullData = *command.Entity->GetFullData();
+			auto& source = fullData.Entity.getOwnerGroup();
+			const auto isAddition = command.Value != nullptr;
+			if( source.HasComponent( *command.Component ) != isAddition ) {
+				container.moveEntityToGroup( fullData, findTargetGroup( source, *command.Component, isAddition ) );
+			}
+			if( isAddition ) {
+				auto& entity = fullData.Entity;
+				command.Component->MoveAssignValue( command.Value, entity.getOwnerGroup().GetRawValue( *command.Component, entity.getGroupPos() ) );
+			}
+		}
+	}
+}
+
+void CEntityCommandBuffer::destroyEntities( CEntityContainer& container )
+{
+	for( const auto& stream : streams ) {
+		for( const auto& entity : stream->Destructions ) {
+			// The same entity may be destroyed by several commands.
+			if( entity.IsValid() ) {
+				container.DestroyEntity( entity.GetEntity() );
+			}
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
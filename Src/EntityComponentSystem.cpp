@@ -8,7 +8,11 @@
 #include <Systems.h>
 #include <SystemOwner.h>
 #include <EntityGroupRange.h>
+#include <EntityQuery.h>
 #include <EntityInitializer.h>
+#include <ThreadPool.h>
+#include <StaticArray.h>
+#include <exception>
 
 namespace Relib {
 
@@ -23,6 +27,22 @@ CEntityComponentSystem::~CEntityComponentSystem()
 {
 }
 
+void CEntityComponentSystem::SetEntityContainer( CEntityContainer* newValue )
+{
+	entities = newValue;
+	for( auto& system : writeSystems ) {
+		system.QueryIndex = registerTargetQuery( system.TargetGroup );
+	}
+	for( auto& system : readSystems ) {
+		system.QueryIndex = registerTargetQuery( system.TargetGroup );
+	}
+}
+
+int CEntityComponentSystem::registerTargetQuery( const CComponentGroup* targetGroup )
+{
+	return entities == nullptr || targetGroup == nullptr ? NotFound : entities->RegisterQuery( CEntityQuery( *targetGroup ) );
+}
+
 void CEntityComponentSystem::ClearEntities()
 {
 	assert( entities != nullptr );
@@ -64,7 +84,12 @@ void CEntityComponentSystem::doAddSystem( IUpdateSystem*, CPtrOwner<IUpdateSyste
 	const auto newPriority = newSystem->GetPriority();
 	const auto systemPos = SearchSortedPos( writeSystems, newPriority, WeakGreaterByAction( &CUpdateSystemInfo::Priority ) );
 	const auto& newGroup = newSystem->GetTargetGroup();
-	writeSystems.InsertAt( systemPos, move( newSystem ), newPriority, &newGroup );
+	CSystemAccess newAccess;
+	newSystem->GetComponentAccess( newAccess );
+	const auto chunkSize = newSystem->GetEntityChunkSize();
+	const auto queryIndex = registerTargetQuery( &newGroup );
+	writeSystems.InsertAt( systemPos, move( newSystem ), newPriority, &newGroup, queryIndex, move( newAccess ), chunkSize );
+	updateSchedule( writeSystems, writeSchedule );
 }
 
 void CEntityComponentSystem::doAddSystem( IDrawSystem*, CPtrOwner<IDrawSystem> newSystem )
@@ -72,21 +97,32 @@ void CEntityComponentSystem::doAddSystem( IDrawSystem*, CPtrOwner<IDrawSystem> n
 	const auto newPriority = newSystem->GetPriority();
 	const auto systemPos = SearchSortedPos( readSystems, newPriority, WeakGreaterByAction( &CDrawSystemInfo::Priority ) );
 	const auto& newGroup = newSystem->GetTargetGroup();
-	readSystems.InsertAt( systemPos, move( newSystem ), newPriority, &newGroup );
+	CSystemAccess newAccess;
+	newSystem->GetComponentAccess( newAccess );
+	const auto chunkSize = newSystem->GetEntityChunkSize();
+	const auto queryIndex = registerTargetQuery( &newGroup );
+	readSystems.InsertAt( systemPos, move( newSystem ), newPriority, &newGroup, queryIndex, move( newAccess ), chunkSize );
+	updateSchedule( readSystems, readSchedule );
 }
 
 void CEntityComponentSystem::doAddSystem( IWriteSystem*, CPtrOwner<IWriteSystem> newSystem )
 {
 	const auto newPriority = newSystem->GetPriority();
 	const auto systemPos = SearchSortedPos( writeSystems, newPriority, WeakGreaterByAction( &CUpdateSystemInfo::Priority ) );
-	writeSystems.InsertAt( systemPos, move( newSystem ), newPriority, nullptr );
+	CSystemAccess newAccess;
+	newSystem->GetComponentAccess( newAccess );
+	writeSystems.InsertAt( systemPos, move( newSystem ), newPriority, nullptr, NotFound, move( newAccess ), 0 );
+	updateSchedule( writeSystems, writeSchedule );
 }
 
 void CEntityComponentSystem::doAddSystem( IReadSystem*, CPtrOwner<IReadSystem> newSystem )
 {
 	const auto newPriority = newSystem->GetPriority();
 	const auto systemPos = SearchSortedPos( readSystems, newPriority, WeakGreaterByAction( &CDrawSystemInfo::Priority ) );
-	readSystems.InsertAt( systemPos, move( newSystem ), newPriority, nullptr );
+	CSystemAccess newAccess;
+	newSystem->GetComponentAccess( newAccess );
+	readSystems.InsertAt( systemPos, move( newSystem ), newPriority, nullptr, NotFound, move( newAccess ), 0 );
+	updateSchedule( readSystems, readSchedule );
 }
 
 void CEntityComponentSystem::doRemoveSystem( const IWriteSystem* ptr )
@@ -94,6 +130,7 @@ void CEntityComponentSystem::doRemoveSystem( const IWriteSystem* ptr )
 	const auto systemPos = SearchPos( writeSystems, ptr, EqualByAction( &CUpdateSystemInfo::System ) );
 	assert( systemPos != NotFound );
 	writeSystems.DeleteAt( systemPos );
+	updateSchedule( writeSystems, writeSchedule );
 }
 
 void CEntityComponentSystem::doRemoveSystem( const IUpdateSystem* ptr )
@@ -101,6 +138,7 @@ void CEntityComponentSystem::doRemoveSystem( const IUpdateSystem* ptr )
 	const auto systemPos = SearchPos( writeSystems, ptr, EqualByAction( &CUpdateSystemInfo::System ) );
 	assert( systemPos != NotFound );
 	writeSystems.DeleteAt( systemPos );
+	updateSchedule( writeSystems, writeSchedule );
 }
 
 void CEntityComponentSystem::doRemoveSystem( const IReadSystem* ptr )
@@ -108,6 +146,7 @@ void CEntityComponentSystem::doRemoveSystem( const IReadSystem* ptr )
 	const auto systemPos = SearchPos( readSystems, ptr, EqualByAction( &CDrawSystemInfo::System ) );
 	assert( systemPos != NotFound );
 	readSystems.DeleteAt( systemPos );
+	updateSchedule( readSystems, readSchedule );
 }
 
 void CEntityComponentSystem::doRemoveSystem( const IDrawSystem* ptr )
@@ -115,6 +154,7 @@ void CEntityComponentSystem::doRemoveSystem( const IDrawSystem* ptr )
 	const auto systemPos = SearchPos( readSystems, ptr, EqualByAction( &CDrawSystemInfo::System ) );
 	assert( systemPos != NotFound );
 	readSystems.DeleteAt( systemPos );
+	updateSchedule( readSystems, readSchedule );
 }
 
 CEntityGroupRange CEntityComponentSystem::Entities( const CComponentGroup& group )
@@ -129,8 +169,31 @@ CEntityGroupConstRange CEntityComponentSystem::Entities( const CComponentGroup&
 	return CEntityGroupConstRange( *entities, group );
 }
 
+int CEntityComponentSystem::RegisterQuery( const CEntityQuery& query )
+{
+	assert( entities != nullptr );
+	return entities->RegisterQuery( query );
+}
+
+CEntityGroupRange CEntityComponentSystem::QueryEntities( int queryIndex )
+{
+	assert( entities != nullptr );
+	return CEntityGroupRange( *entities, queryIndex );
+}
+
+CEntityGroupConstRange CEntityComponentSystem::QueryEntities( int queryIndex ) const
+{
+	assert( entities != nullptr );
+	return CEntityGroupConstRange( *entities, queryIndex );
+}
+
 void CEntityComponentSystem::RunUpdateSystems( ISystemContext& context )
 {
+	if( threadPool != nullptr ) {
+		runSchedule( *threadPool, writeSchedule, [this, &context]( int systemPos ) { runScheduledUpdateSystem( writeSystems[systemPos], context ); } );
+		return;
+	}
+
 	for( auto& system : writeSystems ) {
 		if( system.TargetGroup == nullptr ) {
 			runWriteSystem( system, context );
@@ -149,11 +212,16 @@ void CEntityComponentSystem::runWriteSystem( CUpdateSystemInfo& target, ISystemC
 void CEntityComponentSystem::runUpdateSystem( CUpdateSystemInfo& target, ISystemContext& context )
 {
 	auto& system = static_cast<IUpdateSystem&>( *target.System.Ptr() );
-	system.RunEntityListUpdate( Entities( *target.TargetGroup ), context );
+	system.RunEntityListUpdate( QueryEntities( target.QueryIndex ), context );
 }
 
 void CEntityComponentSystem::RunDrawSystems( const ISystemContext& context ) const
 {
+	if( threadPool != nullptr ) {
+		runSchedule( *threadPool, readSchedule, [this, &context]( int systemPos ) { runScheduledDrawSystem( readSystems[systemPos], context ); } );
+		return;
+	}
+
 	for( const auto& system : readSystems ) {
 		if( system.TargetGroup == nullptr ) {
 			runReadSystem( system, context );
@@ -172,7 +240,132 @@ void CEntityComponentSystem::runReadSystem( const CDrawSystemInfo& target, const
 void CEntityComponentSystem::runDrawSystem( const CDrawSystemInfo& target, const ISystemContext& context ) const
 {
 	auto& system = static_cast<const IDrawSystem&>( *target.System.Ptr() );
-	system.RunEntityListDraw( Entities( *target.TargetGroup ), context );
+	system.RunEntityListDraw( QueryEntities( target.QueryIndex ), context );
+}
+
+void CEntityComponentSystem::runScheduledUpdateSystem( CUpdateSystemInfo& target, ISystemContext& context )
+{
+	if( target.TargetGroup == nullptr ) {
+		runWriteSystem( target, context );
+		return;
+	}
+	if( target.ChunkSize <= 0 ) {
+		runUpdateSystem( target, context );
+		return;
+	}
+
+	// Entity groups are split into chunks that are updated concurrently. The first chunk failure is rethrown by ParallelFor and stops the schedule run.
+	auto& system = static_cast<IUpdateSystem&>( *target.System.Ptr() );
+	const auto chunkSize = target.ChunkSize;
+	for( auto groupPos : entities->GetQueryGroups( target.QueryIndex ) ) {
+		auto& group = entities->GetEntityGroup( groupPos );
+		const auto entityCount = group.Size();
+		const auto chunkCount = ( entityCount + chunkSize - 1 ) / chunkSize;
+		threadPool->ParallelFor( 0, chunkCount, 1, [&]( int chunkPos ) {
+			const auto chunkStart = chunkPos * chunkSize;
+			system.RunEntityChunkUpdate( CEntityRange( group, chunkStart, min( chunkStart + chunkSize, entityCount ) ), context );
+		} );
+	}
+}
+
+void CEntityComponentSystem::runScheduledDrawSystem( const CDrawSystemInfo& target, const ISystemContext& context ) const
+{
+	if( target.TargetGroup == nullptr ) {
+		runReadSystem( target, context );
+		return;
+	}
+	if( target.ChunkSize <= 0 ) {
+		runDrawSystem( target, context );
+		return;
+	}
+
+	// Entity groups are split into chunks that are drawn concurrently. The first chunk failure is rethrown by ParallelFor and stops the schedule run.
+	const auto& system = static_cast<const IDrawSystem&>( *target.System.Ptr() );
+	const auto chunkSize = target.ChunkSize;
+	for( auto groupPos : entities->GetQueryGroups( target.QueryIndex ) ) {
+		const auto& group = entities->GetEntityGroup( groupPos );
+		const auto entityCount = group.Size();
+		const auto chunkCount = ( entityCount + chunkSize - 1 ) / chunkSize;
+		threadPool->ParallelFor( 0, chunkCount, 1, [&]( int chunkPos ) {
+			const auto chunkStart = chunkPos * chunkSize;
+			system.RunEntityChunkDraw( CEntityConstRange( group, chunkStart, min( chunkStart + chunkSize, entityCount ) ), context );
+		} );
+	}
+}
+
+template <class SystemInfo>
+void CEntityComponentSystem::updateSchedule( const CArray<SystemInfo>& systems, CSystemSchedule& schedule )
+{
+	const auto systemCount = systems.Size();
+	schedule.Dependents.Empty();
+	schedule.Dependents.IncreaseSize( systemCount );
+	schedule.DependencyCounts.Empty();
+	schedule.DependencyCounts.IncreaseSize( systemCount );
+	// Systems are sorted by priority. A system waits for all the conflicting systems with a higher priority.
+	for( int i = 0; i < systemCount; i++ ) {
+		for( int j = 0; j < i; j++ ) {
+			if( systems[j].Access.ConflictsWith( systems[i].Access ) ) {
+				schedule.Dependents[j].Add( i );
+				schedule.DependencyCounts[i]++;
+			}
+		}
+	}
+}
+
+template <class RunAction>
+void CEntityComponentSystem::runSchedule( CThreadPool& pool, const CSystemSchedule& schedule, const RunAction& runSystem )
+{
+	// State of a single schedule execution. Every finished system starts the dependents that have no more systems to wait for.
+	struct CScheduleRun {
+		CThreadPool& Pool;
+		const CSystemSchedule& Schedule;
+		const RunAction& RunSystem;
+		CStaticArray<CAtomic<int>> RemainingCounts;
+		CAtomic<int> FinishedCount{ 0 };
+		CAtomic<bool> HasFailed{ false };
+		std::exception_ptr Failure;
+
+		CScheduleRun( CThreadPool& pool, const CSystemSchedule& schedule, const RunAction& runSystem ) : Pool( pool ), Schedule( schedule ), RunSystem( runSystem ) {}
+
+		void Start( int systemPos )
+			{ Pool.Execute( [this, systemPos]() { Run( systemPos ); } ); }
+		void Run( int systemPos )
+		{
+			// Systems are skipped after a failure, but the dependency counters are still updated to finish the execution.
+			if( !HasFailed.Load() ) {
+				try {
+					RunSystem( systemPos );
+				} catch( ... ) {
+					if( !HasFailed.Exchange( true ) ) {
+						Failure = std::current_exception();
+					}
+				}
+			}
+			for( int dependentPos : Schedule.Dependents[systemPos] ) {
+				if( RemainingCounts[dependentPos].PreDecrement() == 0 ) {
+					Start( dependentPos );
+				}
+			}
+			FinishedCount.PreIncrement();
+		}
+	};
+
+	const auto systemCount = schedule.DependencyCounts.Size();
+	CScheduleRun run( pool, schedule, runSystem );
+	run.RemainingCounts.ResetSize( systemCount );
+	for( int i = 0; i < systemCount; i++ ) {
+		run.RemainingCounts[i].Store( schedule.DependencyCounts[i] );
+	}
+	for( int i = 0; i < systemCount; i++ ) {
+		if( schedule.DependencyCounts[i] == 0 ) {
+			run.Start( i );
+		}
+	}
+	// The calling thread executes the pool tasks while waiting.
+	pool.WaitFor( run.FinishedCount, systemCount );
+	if( run.Failure != nullptr ) {
+		std::rethrow_exception( run.Failure );
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -11,7 +11,8 @@ namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
-CEntityContainer::CEntityContainer()
+CEntityContainer::CEntityContainer( TEntityStorageMode _groupStorageMode ) :
+	groupStorageMode( _groupStorageMode )
 {
 }
 
@@ -58,6 +59,25 @@ int CEntityContainer::MatchNextEntityGroup( int startIndex, const CComponentGrou
 	return NotFound;
 }
 
+int CEntityContainer::RegisterQuery( const CEntityQuery& query )
+{
+	const auto queryCount = queries.Size();
+	for( int i = 0; i < queryCount; i++ ) {
+		if( queries[i].Query == query ) {
+			return i;
+		}
+	}
+
+	auto& newCache = queries.Add( query );
+	const auto groupCount = entityGroups.Size();
+	for( int i = 0; i < groupCount; i++ ) {
+		if( query.Matches( entityGroups[i]->GetComponentGroup() ) ) {
+			newCache.Groups.Add( i );
+		}
+	}
+	return queryCount;
+}
+
 CFullEntityData& CEntityContainer::CreateEntity( const CComponentGroup& componentGroup )
 {
 	const auto data = createEntityData();
@@ -127,16 +147,26 @@ CEntityGroup& CEntityContainer::getOrCreateEntityGroup( const CComponentGroup& c
 		}
 	}
 
-	return *entityGroups.Add( CreateOwner<CEntityGroup>( copy( componentGroup ) ) );
+	const auto newGroupIndex = entityGroups.Size();
+	auto& newGroup = *entityGroups.Add( CreateOwner<CEntityGroup>( copy( componentGroup ), groupStorageMode ) );
+	// Group indices only grow, so the cached lists stay sorted.
+	for( auto& cache : queries ) {
+		if( cache.Query.Matches( componentGroup ) ) {
+			cache.Groups.Add( newGroupIndex );
+		}
+	}
+	return newGroup;
 }
 
 void CEntityContainer::DestroyEntity( CEntity entity )
 {
 	const auto fullData = entity.GetFullData();
 	returnEmptyEntity( *fullData );
+	removeGroupEntity( entity.getOwnerGroup(), entity.getGroupPos() );
+}
 
-	const auto groupPos = entity.getGroupPos();
-	auto& group = entity.getOwnerGroup();
+void CEntityContainer::removeGroupEntity( CEntityGroup& group, int groupPos )
+{
 	const auto lastGroupPos = group.Size() - 1;
 	if( groupPos != lastGroupPos ) {
 		const auto movedData = group.MoveEntity( lastGroupPos, groupPos );
@@ -146,6 +176,23 @@ void CEntityContainer::DestroyEntity( CEntity entity )
 	group.DeleteLastEntity();
 }
 
+void CEntityContainer::moveEntityToGroup( CFullEntityData& fullData, CEntityGroup& newGroup )
+{
+	auto& oldGroup = fullData.Entity.getOwnerGroup();
+	const auto oldGroupPos = fullData.Entity.getGroupPos();
+	assert( &oldGroup != &newGroup );
+	const auto newGroupPos = newGroup.AddEntity( &fullData );
+	// Values of the common components are moved, new components keep the default value.
+	for( auto component : newGroup.GetComponentGroup().GetComponents() ) {
+		if( oldGroup.HasComponent( *component ) ) {
+			component->MoveAssignValue( oldGroup.GetRawValue( *component, oldGroupPos ), newGroup.GetRawValue( *component, newGroupPos ) );
+		}
+	}
+
+	removeGroupEntity( oldGroup, oldGroupPos );
+	fullData.Entity = CEntity( newGroup, newGroupPos, &fullData );
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 }	// namespace Relib.
@@ -8,12 +8,19 @@ namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
-CEntityGroup::CEntityGroup( CComponentGroup _componentGroup ) :
-	componentGroup( move( _componentGroup ) )
+// Chunks never hold more than 2^maxChunkCapacityLog entities.
+static const int maxChunkCapacityLog = 16;
+
+CEntityGroup::CEntityGroup( CComponentGroup _componentGroup, TEntityStorageMode _storageMode ) :
+	componentGroup( move( _componentGroup ) ),
+	storageMode( _storageMode )
 {
 	const auto components = componentGroup.GetComponents();
 	const auto componentCount = components.Size();
 	if( componentCount == 0 ) {
+		if( storageMode == ESM_Chunked ) {
+			initChunkLayout();
+		}
 		return;
 	}
 	int trivialComponentCount = 0;
@@ -58,14 +65,120 @@ CEntityGroup::CEntityGroup( CComponentGroup _componentGroup ) :
 			destructiblePos++;
 		}
 	}
+
+	if( storageMode == ESM_Chunked ) {
+		initChunkLayout();
+	}
+}
+
+CEntityGroup::~CEntityGroup()
+{
+	if( storageMode == ESM_Chunked ) {
+		Empty();
+		return;
+	}
+
+	// Component data is constructed for the whole capacity.
+	const auto elemCount = entityDataPtrs.Capacity();
+	for( auto& data : destructibleEntityDataOwner ) {
+		data.DestroyPtr( data.Data.Ptr(), data.ElemSize * elemCount );
+	}
+}
+
+void CEntityGroup::initChunkLayout()
+{
+	// Find the largest power of two entity count that fits in a chunk with all the component arrays aligned.
+	int entityByteSize = 0;
+	for( const auto& data : entityDataOwner ) {
+		entityByteSize += data.ElemSize;
+	}
+	for( const auto& data : destructibleEntityDataOwner ) {
+		entityByteSize += data.ElemSize;
+	}
+	const auto componentCount = entityDataOwner.Size() + destructibleEntityDataOwner.Size();
+	const auto paddingByteSize = componentCount * ( EntityChunkAlignment - 1 );
+	chunkCapacityLog = 0;
+	while( chunkCapacityLog < maxChunkCapacityLog && ( 2 << chunkCapacityLog ) * entityByteSize + paddingByteSize <= EntityChunkByteSize ) {
+		chunkCapacityLog++;
+	}
+	chunkCapacity = 1 << chunkCapacityLog;
+
+	int offset = 0;
+	for( auto& data : entityDataOwner ) {
+		data.ChunkOffset = offset;
+		offset = CeilTo( offset + chunkCapacity * data.ElemSize, EntityChunkAlignment );
+	}
+	for( auto& data : destructibleEntityDataOwner ) {
+		data.ChunkOffset = offset;
+		offset = CeilTo( offset + chunkCapacity * data.ElemSize, EntityChunkAlignment );
+	}
+	chunkByteSize = max( offset, 1 );
+}
+
+void CEntityGroup::addChunk()
+{
+	// Allocated memory is aligned manually to keep the component arrays on separate cache lines.
+	CMemoryOwner<> buffer( CRuntimeHeap::Allocate( chunkByteSize + EntityChunkAlignment - 1 ) );
+	const auto bufferAddress = reinterpret_cast<UINT_PTR>( buffer.Ptr() );
+	const auto alignmentOffset = ( EntityChunkAlignment - bufferAddress % EntityChunkAlignment ) % EntityChunkAlignment;
+	const auto data = static_cast<BYTE*>( buffer.Ptr() ) + alignmentOffset;
+
+	// All the entities in a chunk are constructed beforehand, same as in the contiguous storage.
+	for( const auto& componentData : entityDataOwner ) {
+		::memset( data + componentData.ChunkOffset, 0, chunkCapacity * componentData.ElemSize );
+	}
+	for( const auto& componentData : destructibleEntityDataOwner ) {
+		componentData.ConstructPtr( data + componentData.ChunkOffset, chunkCapacity * componentData.ElemSize );
+	}
+	chunks.Add( move( buffer ), data, changeVersion.PreIncrement() );
+}
+
+void CEntityGroup::deleteLastChunk()
+{
+	const auto data = chunks.Last().Data;
+	for( const auto& componentData : destructibleEntityDataOwner ) {
+		componentData.DestroyPtr( data + componentData.ChunkOffset, chunkCapacity * componentData.ElemSize );
+	}
+	chunks.DeleteLast();
+}
+
+void CEntityGroup::markEntityChanged( int entityIndex )
+{
+	if( storageMode == ESM_Chunked ) {
+		MarkChunkChanged( entityIndex >> chunkCapacityLog );
+	}
+}
+
+CEntityRange CEntityGroup::ChunkEntities( int chunkIndex )
+{
+	assert( storageMode == ESM_Chunked );
+	const auto chunkStart = chunkIndex << chunkCapacityLog;
+	return CEntityRange{ *this, chunkStart, min( chunkStart + chunkCapacity, entityDataPtrs.Size() ) };
+}
+
+CEntityConstRange CEntityGroup::ChunkEntities( int chunkIndex ) const
+{
+	assert( storageMode == ESM_Chunked );
+	const auto chunkStart = chunkIndex << chunkCapacityLog;
+	return CEntityConstRange{ *this, chunkStart, min( chunkStart + chunkCapacity, entityDataPtrs.Size() ) };
 }
 
 void CEntityGroup::Empty()
 {
+	if( storageMode == ESM_Chunked ) {
+		while( !chunks.IsEmpty() ) {
+			deleteLastChunk();
+		}
+		entityDataPtrs.Empty();
+		return;
+	}
+
+	// Unused entity data stays constructed, so the destroyed values are reset to the default state.
 	const auto elemCount = entityDataPtrs.Size();
 	for( auto& data : destructibleEntityDataOwner ) {
 		const auto byteSize = data.ElemSize * elemCount;
 		data.DestroyPtr( data.Data.Ptr(), byteSize );
+		data.ConstructPtr( data.Data.Ptr(), byteSize );
 	}
 
 	entityDataPtrs.Empty();
@@ -81,11 +194,33 @@ CEntityConstRange CEntityGroup::Entities() const
 	return CEntityConstRange{ *this, 0, entityDataPtrs.Size() };
 }
 
+void CEntityGroup::ReserveBuffer( int entityCount )
+{
+	if( storageMode == ESM_Chunked ) {
+		const auto chunkCount = ( entityCount + chunkCapacity - 1 ) >> chunkCapacityLog;
+		while( chunks.Size() < chunkCount ) {
+			addChunk();
+		}
+		entityDataPtrs.ReserveBuffer( entityCount );
+	} else if( entityDataPtrs.Capacity() < entityCount ) {
+		growEntityDataSize( entityCount );
+	}
+}
+
 int CEntityGroup::AddEntity( CFullEntityData* newData )
 {
 	const auto newIndex = entityDataPtrs.Size();
+	if( storageMode == ESM_Chunked ) {
+		if( ( newIndex >> chunkCapacityLog ) == chunks.Size() ) {
+			addChunk();
+		}
+		entityDataPtrs.Add( newData );
+		markEntityChanged( newIndex );
+		return newIndex;
+	}
+
 	if( entityDataPtrs.Capacity() == newIndex ) {
-		growEntityDataSize();
+		growEntityDataSize( newIndex + 1 );
 	}
 	entityDataPtrs.AddWithinCapacity( newData );
 	return newIndex;
@@ -99,8 +234,7 @@ int CEntityGroup::InitializeEntity( CFullEntityData* newData, RelibInternal::CFi
 		const auto componentData = filledData.GetTrivialData( i );
 		const auto id = componentData.Id - componentIdOffset;
 		const auto size = entityDataIndex[id]->ElemSize;
-		const auto data = reinterpret_cast<BYTE*>( entityDataIndex[id]->Data.Ptr() );
-		::memcpy( data + resultIndex * size, componentData.Data, size );
+		::memcpy( getEntityData( *entityDataIndex[id], resultIndex ), componentData.Data, size );
 	}
 
 	const auto destructibleCompCount = filledData.GetDestructibleComponentCount();
@@ -108,9 +242,7 @@ int CEntityGroup::InitializeEntity( CFullEntityData* newData, RelibInternal::CFi
 		auto componentData = filledData.GetDestructibleData( i );
 		const auto id = componentData.Id - componentIdOffset;
 		auto destructibleData = static_cast<CDestructibleComponentData*>( entityDataIndex[id] );
-		const auto size = destructibleData->ElemSize;
-		const auto data = reinterpret_cast<BYTE*>( destructibleData->Data.Ptr() );
-		const auto destData = data + resultIndex * size;
+		const auto destData = getEntityData( *destructibleData, resultIndex );
 		destructibleData->MoveAssignPtr( componentData.Data, destData );
 	}
 
@@ -123,25 +255,28 @@ CFullEntityData* CEntityGroup::MoveEntity( int srcIndex, int destIndex )
 	const auto srcData = entityDataPtrs[srcIndex];
 	moveEntityData( srcIndex, destIndex );
 	entityDataPtrs[destIndex] = srcData;
+	markEntityChanged( srcIndex );
+	markEntityChanged( destIndex );
 	return srcData;
 }
 
 void CEntityGroup::DeleteLastEntity()
 {
 	const auto lastDataPos = entityDataPtrs.Size() - 1;
-	for( auto& data : destructibleEntityDataOwner ) {
-		const auto byteSize = data.ElemSize;
-		const auto bytePtr = static_cast<BYTE*>( data.Data.Ptr() );
-		data.DestroyPtr( bytePtr + lastDataPos * byteSize, byteSize );
-	}
-
+	destroyEntityData( lastDataPos );
 	entityDataPtrs.DeleteLast();
+	if( storageMode == ESM_Chunked ) {
+		markEntityChanged( lastDataPos );
+		// One empty chunk is kept to avoid reallocations when entities are added and removed repeatedly.
+		if( chunks.Size() - ChunkCount() > 1 ) {
+			deleteLastChunk();
+		}
+	}
 }
 
-void CEntityGroup::growEntityDataSize()
+void CEntityGroup::growEntityDataSize( int newMinSize )
 {
 	const auto oldSize = entityDataPtrs.Capacity();
-	const auto newMinSize = oldSize + 1;
 	const auto newSize = CDefaultGrowStrategy<8>::GrowValue( oldSize, newMinSize );
 	entityDataPtrs.ReserveBuffer( newSize );
 
@@ -172,15 +307,25 @@ void CEntityGroup::growEntityDataSize()
 void CEntityGroup::moveEntityData( int srcIndex, int destIndex )
 {
 	for( auto& data : entityDataOwner ) {
-		const auto buffer = static_cast<BYTE*>( data.Data.Ptr() );
-		const auto byteSize = data.ElemSize;
-		::memcpy( buffer + destIndex * byteSize, buffer + srcIndex * byteSize, byteSize );
+		::memcpy( getEntityData( data, destIndex ), getEntityData( data, srcIndex ), data.ElemSize );
+	}
+
+	for( auto& data : destructibleEntityDataOwner ) {
+		data.MoveAssignPtr( getEntityData( data, srcIndex ), getEntityData( data, destIndex ) );
+	}
+}
+
+void CEntityGroup::destroyEntityData( int entityIndex )
+{
+	// Entities are reset to the default state. Component data stays constructed for the whole allocated storage.
+	for( auto& data : entityDataOwner ) {
+		::memset( getEntityData( data, entityIndex ), 0, data.ElemSize );
 	}
 
 	for( auto& data : destructibleEntityDataOwner ) {
-		const auto buffer = static_cast<BYTE*>( data.Data.Ptr() );
-		const auto byteSize = data.ElemSize;
-		data.MoveAssignPtr( buffer + srcIndex * byteSize, buffer + destIndex * byteSize );
+		const auto entityData = getEntityData( data, entityIndex );
+		data.DestroyPtr( entityData, data.ElemSize );
+		data.ConstructPtr( entityData, data.ElemSize );
 	}
 }
 
@@ -10,31 +10,41 @@ namespace Relib {
 
 void CEventSystem::AddExternalEventTarget( int classId, const IExternalObject* eventAction, CExternalEventTarget& target )
 {
-	if( classId >= listeners.Size() ) {
-		listeners.IncreaseSize( classId + 1 );
-	}
-	listeners[classId].Add( eventAction );
-
-	target = CExternalEventTarget( *this, eventAction, classId );
+	const int slot = getOrCreateListeners( classId ).Actions.Add( eventAction );
+	target = CExternalEventTarget( *this, eventAction, classId, createListenerId( slot, false ) );
 }
 
-void CEventSystem::removeListener( int classId, const IExternalObject* listenerObject )
+void CEventSystem::DispatchPostedEvents()
 {
-	auto& listenerList = listeners[classId];
-	const int listenerCount = listenerList.Size();
-	for( int i = 0; i < listenerCount; i++ ) {
-		if( listenerList[i] == listenerObject ) {
-			listenerList.DeleteAt( i );
-			return;
+	for( int classId = 0; classId < eventQueues.Size(); classId++ ) {
+		if( eventQueues[classId] != nullptr ) {
+			eventQueues[classId]->Dispatch( listeners[classId] );
 		}
 	}
+}
+
+void CEventSystem::addEventTarget( int classId, CTypelessActionOwner action, CEventTarget& target, bool isBatchAction )
+{
+	assert( classId >= 0 );
+	auto& classListeners = getOrCreateListeners( classId );
+	auto& listenerList = isBatchAction ? classListeners.BatchActions : classListeners.Actions;
+	const int slot = listenerList.Add( action.GetActionObject() );
+	target = CEventTarget( *this, move( action ), classId, createListenerId( slot, isBatchAction ) );
+}
 
-	assert( false );
+RelibInternal::CEventListeners& CEventSystem::getOrCreateListeners( int classId )
+{
+	if( classId >= listeners.Size() ) {
+		listeners.IncreaseSize( classId + 1 );
+	}
+	return listeners[classId];
 }
 
-void CEventSystem::removeListener( int classId, const CTypelessActionOwner& listenerObject )
+void CEventSystem::removeListener( int classId, int listenerId )
 {
-	removeListener( classId, listenerObject.GetActionObject() );
+	auto& classListeners = listeners[classId];
+	auto& listenerList = listenerId % 2 == 1 ? classListeners.BatchActions : classListeners.Actions;
+	listenerList.Delete( listenerId / 2 );
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,431 @@
+#include <FilePack.h>
+#include <FileCollection.h>
+#include <FileOwners.h>
+#include <FileSystem.h>
+#include <Errors.h>
+#include <HashUtils.h>
+#include <Sort.h>
+#include <ThreadPool.h>
+#include <ZipConverter.h>
+
+#ifndef RELIB_NO_ZLIB
+#include <zlib\zlib.h>
+#endif
+
+namespace Relib {
+
+extern const CError Err_BadCollectionData;
+extern const CError Err_DuplicatePackFile;
+extern const CError Err_CompressedArchive;
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+	// Pack header at the start of the file.
+	struct CFilePackHeader {
+		int Magic;
+		int Version;
+		int FileCount;
+		int HashTableSize;
+		__int64 DirectoryOffset;
+		int DirectorySize;
+		int Reserved;
+	};
+
+	// Directory entry. The directory consists of the entries, the hash table of the entry indices and the file names.
+	struct CFilePackEntry {
+		__int64 DataOffset;
+		int StoredSize;
+		int DataSize;
+		unsigned Checksum;
+		int NameOffset;
+		int NameLength;
+		DWORD Flags;
+	};
+
+}	// namespace RelibInternal.
+
+// Directory is aligned for the direct access to the entries.
+static const int packDirectoryAlignment = 8;
+// Limits of the data that is prepared by the builder at once.
+static const int maxPackBatchDataSize = 64 * 1024 * 1024;
+static const int maxPackBatchFileCount = 1024;
+
+static bool isPackNameLess( CStringPart left, CStringPart right )
+{
+	const auto compareResult = ::memcmp( left.begin(), right.begin(), min( left.Length(), right.Length() ) );
+	return compareResult < 0 || ( compareResult == 0 && left.Length() < right.Length() );
+}
+
+static bool isPackNameEqual( CStringPart left, CStringPart right )
+{
+	return left.Length() == right.Length() && ::memcmp( left.begin(), right.begin(), left.Length() ) == 0;
+}
+
+static int findPackNameHash( CStringPart name, int hashTableSize )
+{
+	return GetStrongStringHash( name ) & ( hashTableSize - 1 );
+}
+
+static unsigned findPackChecksum( CArrayView<BYTE> data )
+{
+#ifndef RELIB_NO_ZLIB
+	return crc32( crc32( 0, Z_NULL, 0 ), data.Ptr(), data.Size() );
+#else
+	data;
+	check( false, Err_CompressedArchive );
+	return 0;
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CFilePack::CFilePack( CStringPart fileName ) :
+	mapping( fileName, CFileMapping::MM_ReadOnly )
+{
+	readDirectory();
+}
+
+// Map the directory and check its consistency. File data is checked when it's read.
+void CFilePack::readDirectory()
+{
+	const auto fileLength = mapping.GetFileLength();
+	RelibInternal::CFilePackHeader header;
+	check( fileLength >= sizeof( header ), Err_BadCollectionData );
+	{
+		const auto headerView = mapping.CreateReadView( 0, sizeof( header ) );
+		::memcpy( &header, headerView.GetBuffer(), sizeof( header ) );
+	}
+	check( header.Magic == GetMagicNumber() && header.Version == Version, Err_BadCollectionData );
+
+	fileCount = header.FileCount;
+	hashTableSize = header.HashTableSize;
+	const bool isHashTableValid = hashTableSize > fileCount && fileCount >= 0 && ( hashTableSize & ( hashTableSize - 1 ) ) == 0;
+	const bool isDirectoryPosValid = header.DirectoryOffset >= sizeof( header ) && header.DirectoryOffset % packDirectoryAlignment == 0
+		&& header.DirectorySize >= 0 && header.DirectoryOffset + header.DirectorySize == fileLength;
+	check( isHashTableValid && isDirectoryPosValid, Err_BadCollectionData );
+	const __int64 tablesSize = static_cast<__int64>( fileCount ) * sizeof( RelibInternal::CFilePackEntry ) + static_cast<__int64>( hashTableSize ) * sizeof( int );
+	check( tablesSize <= header.DirectorySize, Err_BadCollectionData );
+
+	directoryView = mapping.CreateReadView( header.DirectoryOffset, header.DirectorySize );
+	const auto directory = directoryView.GetBuffer();
+	entries = reinterpret_cast<const RelibInternal::CFilePackEntry*>( directory );
+	hashTable = reinterpret_cast<const int*>( entries + fileCount );
+	names = reinterpret_cast<const char*>( hashTable + hashTableSize );
+	const auto namesSize = header.DirectorySize - static_cast<int>( tablesSize );
+
+	for( int i = 0; i < fileCount; i++ ) {
+		checkEntry( entries[i], header.DirectoryOffset, namesSize );
+	}
+	for( int i = 0; i < hashTableSize; i++ ) {
+		check( hashTable[i] >= NotFound && hashTable[i] < fileCount, Err_BadCollectionData );
+	}
+}
+
+void CFilePack::checkEntry( const RelibInternal::CFilePackEntry& entry, __int64 directoryOffset, int namesSize ) const
+{
+	const bool isNameValid = entry.NameOffset >= 0 && entry.NameLength >= 0 && entry.NameLength <= namesSize - entry.NameOffset;
+	const bool isDataValid = entry.DataOffset >= sizeof( RelibInternal::CFilePackHeader ) && entry.StoredSize >= 0 && entry.DataSize >= 0
+		&& entry.DataOffset + entry.StoredSize <= directoryOffset;
+	const bool isSizeValid = ( entry.Flags & FPF_Compressed ) != 0 || entry.StoredSize == entry.DataSize;
+	check( isNameValid && isDataValid && isSizeValid, Err_BadCollectionData );
+}
+
+const RelibInternal::CFilePackEntry& CFilePack::getEntry( int filePos ) const
+{
+	assert( filePos >= 0 && filePos < fileCount );
+	return entries[filePos];
+}
+
+CStringPart CFilePack::GetFileName( int filePos ) const
+{
+	const auto& entry = getEntry( filePos );
+	return CStringPart( names + entry.NameOffset, entry.NameLength );
+}
+
+int CFilePack::GetFileSize( int filePos ) const
+{
+	return getEntry( filePos ).DataSize;
+}
+
+DWORD CFilePack::GetFileFlags( int filePos ) const
+{
+	return getEntry( filePos ).Flags;
+}
+
+int CFilePack::FindFile( CStringPart fileName ) const
+{
+	int hashPos = findPackNameHash( fileName, hashTableSize );
+	// The table always has free positions, the probe count limit only guards against corrupted tables.
+	for( int i = 0; i < hashTableSize; i++ ) {
+		const auto filePos = hashTable[hashPos];
+		if( filePos == NotFound ) {
+			return NotFound;
+		}
+		if( isPackNameEqual( GetFileName( filePos ), fileName ) ) {
+			return filePos;
+		}
+		hashPos = ( hashPos + 1 ) & ( hashTableSize - 1 );
+	}
+	return NotFound;
+}
+
+CMappingReadView CFilePack::GetFileData( int filePos ) const
+{
+	const auto& entry = getEntry( filePos );
+	// Compressed files can only be read.
+	assert( ( entry.Flags & FPF_Compressed ) == 0 );
+	return mapStoredData( entry );
+}
+
+CMappingReadView CFilePack::mapStoredData( const RelibInternal::CFilePackEntry& entry ) const
+{
+	// Zero length view stands for the whole file.
+	return entry.StoredSize == 0 ? CMappingReadView() : mapping.CreateReadView( entry.DataOffset, entry.StoredSize );
+}
+
+void CFilePack::ReadFileData( int filePos, CArray<BYTE>& result ) const
+{
+	const auto& entry = getEntry( filePos );
+	const auto dataPos = result.Size();
+	readStoredData( entry, result );
+	if( ( entry.Flags & FPF_Checksum ) != 0 ) {
+		check( findPackChecksum( result.Mid( dataPos ) ) == entry.Checksum, Err_BadCollectionData );
+	}
+}
+
+bool CFilePack::CheckFile( int filePos ) const
+{
+	const auto& entry = getEntry( filePos );
+	if( ( entry.Flags & FPF_Checksum ) == 0 ) {
+		return true;
+	}
+	if( ( entry.Flags & FPF_Compressed ) == 0 ) {
+		const auto view = mapStoredData( entry );
+		return findPackChecksum( CArrayView<BYTE>( view.GetBuffer(), entry.DataSize ) ) == entry.Checksum;
+	}
+	CArray<BYTE> data;
+	readStoredData( entry, data );
+	return findPackChecksum( data ) == entry.Checksum;
+}
+
+void CFilePack::readStoredData( const RelibInternal::CFilePackEntry& entry, CArray<BYTE>& result ) const
+{
+	const auto view = mapStoredData( entry );
+	const CArrayView<BYTE> storedData( view.GetBuffer(), entry.StoredSize );
+	if( ( entry.Flags & FPF_Compressed ) == 0 ) {
+		const auto dataPos = result.Size();
+		result.IncreaseSizeNoInitialize( dataPos + storedData.Size() );
+		::memcpy( result.Ptr() + dataPos, storedData.Ptr(), storedData.Size() );
+		return;
+	}
+#ifndef RELIB_NO_ZLIB
+	const auto dataPos = result.Size();
+	CZipConverter().UnzipData( storedData, result );
+	check( result.Size() - dataPos == entry.DataSize, Err_BadCollectionData );
+#else
+	check( false, Err_CompressedArchive );
+#endif
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+void CFilePackBuilder::AddFile( CStringPart fileName, CArrayView<BYTE> data, DWORD flags )
+{
+	auto& file = sourceFiles.Add();
+	file.Name = fileName;
+	file.Data = data;
+	file.DataSize = data.Size();
+	file.Flags = flags;
+}
+
+void CFilePackBuilder::AddFolder( CStringPart folderName, DWORD flags )
+{
+	const auto fullName = FileSystem::CreateFullPath( folderName );
+	CArray<CFileStatus> folderFiles;
+	FileSystem::GetFilesInDir( fullName, folderFiles, FileSystem::FIF_Files | FileSystem::FIF_Recursive );
+	for( const auto& status : folderFiles ) {
+		assert( status.FullName.HasPrefix( fullName ) );
+		auto relativeName = status.FullName.Mid( fullName.Length() );
+		if( !relativeName.IsEmpty() && ( relativeName[0] == '\\' || relativeName[0] == '/' ) ) {
+			relativeName = relativeName.Mid( 1 );
+		}
+		auto& file = sourceFiles.Add();
+		file.Name = relativeName;
+		file.SourcePath = status.FullName;
+		file.DataSize = numeric_cast<int>( status.Length );
+		file.Flags = flags;
+	}
+}
+
+void CFilePackBuilder::AddCollection( const CFileCollection& collection, DWORD flags )
+{
+	for( int i = 0; i < collection.GetFileCount(); i++ ) {
+		AddFile( collection.GetFileName( i ), collection.GetFileData( i ), flags );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+	// File data that is ready for writing.
+	struct CPreparedPackFile {
+		CArray<BYTE> FileData;
+		CArray<BYTE> ZippedData;
+		CArrayView<BYTE> StoredData;
+	};
+
+}	// namespace RelibInternal.
+
+// Read the file if necessary, find its checksum and compress it.
+static void preparePackFile( CStringPart sourcePath, CArrayView<BYTE> data, DWORD flags, RelibInternal::CPreparedPackFile& result, RelibInternal::CFilePackEntry& entry )
+{
+	if( !sourcePath.IsEmpty() ) {
+		CFileReader file( sourcePath, FCM_OpenExisting );
+		const auto length = file.GetLength32();
+		result.FileData.IncreaseSizeNoInitialize( length );
+		file.Read( result.FileData.Ptr(), length );
+		data = result.FileData;
+	}
+
+	entry.DataSize = data.Size();
+	entry.Flags = flags;
+	entry.Checksum = ( flags & FPF_Checksum ) != 0 ? findPackChecksum( data ) : 0;
+	result.StoredData = data;
+	if( ( flags & FPF_Compressed ) != 0 ) {
+#ifndef RELIB_NO_ZLIB
+		CZipConverter().ZipData( data, result.ZippedData );
+		if( result.ZippedData.Size() < data.Size() ) {
+			result.StoredData = result.ZippedData;
+		} else {
+			// Incompressible data is stored as is.
+			entry.Flags &= ~FPF_Compressed;
+		}
+#else
+		check( false, Err_CompressedArchive );
+#endif
+	}
+	entry.StoredSize = result.StoredData.Size();
+}
+
+void CFilePackBuilder::WritePack( CStringPart fileName, CThreadPool* threadPool )
+{
+	const int fileCount = sourceFiles.Size();
+	CArray<int> fileOrder;
+	for( int i = 0; i < fileCount; i++ ) {
+		fileOrder.Add( i );
+	}
+	Sort::IntroSort( CArrayBuffer<int>( fileOrder ), [this]( int left, int right ) { return isPackNameLess( sourceFiles[left].Name, sourceFiles[right].Name ); } );
+	for( int i = 1; i < fileCount; i++ ) {
+		const auto& name = sourceFiles[fileOrder[i]].Name;
+		check( !isPackNameEqual( sourceFiles[fileOrder[i - 1]].Name, name ), Err_DuplicatePackFile, name );
+	}
+
+	std::exception_ptr failure;
+	{
+		CFileWriter file( fileName, FCM_CreateAlways );
+		try {
+			writePackFile( file, fileOrder, threadPool );
+		} catch( ... ) {
+			failure = std::current_exception();
+		}
+	}
+	if( failure != nullptr ) {
+		// The incomplete pack is deleted after the file is closed. The original error is more important than the deletion failure.
+		try {
+			FileSystem::Delete( fileName );
+		} catch( const CException& ) {
+		}
+		std::rethrow_exception( failure );
+	}
+}
+
+// Write the header, the file data and the directory. Files are prepared in batches, the first preparation error stops the writing.
+void CFilePackBuilder::writePackFile( CFileWriter& file, const CArray<int>& fileOrder, CThreadPool* threadPool ) const
+{
+	const int fileCount = sourceFiles.Size();
+	RelibInternal::CFilePackHeader header{};
+	file.Write( &header, sizeof( header ) );
+	__int64 dataOffset = sizeof( header );
+
+	CArray<RelibInternal::CFilePackEntry> entries;
+	entries.IncreaseSize( fileCount );
+	CArray<RelibInternal::CPreparedPackFile> batchFiles;
+	for( int batchStart = 0; batchStart < fileCount; ) {
+		// Batch size is limited to keep the prepared data in memory.
+		int batchEnd = batchStart;
+		__int64 batchDataSize = 0;
+		while( batchEnd < fileCount && batchEnd - batchStart < maxPackBatchFileCount && ( batchEnd == batchStart || batchDataSize < maxPackBatchDataSize ) ) {
+			batchDataSize += sourceFiles[fileOrder[batchEnd]].DataSize;
+			batchEnd++;
+		}
+
+		batchFiles.Empty();
+		batchFiles.IncreaseSize( batchEnd - batchStart );
+		const auto prepareFile = [&]( int filePos ) {
+			const auto& source = sourceFiles[fileOrder[filePos]];
+			preparePackFile( source.SourcePath, source.Data, source.Flags, batchFiles[filePos - batchStart], entries[filePos] );
+		};
+		if( threadPool != nullptr ) {
+			threadPool->ParallelFor( batchStart, batchEnd, 1, prepareFile );
+		} else {
+			for( int i = batchStart; i < batchEnd; i++ ) {
+				prepareFile( i );
+			}
+		}
+
+		for( int i = batchStart; i < batchEnd; i++ ) {
+			const auto storedData = batchFiles[i - batchStart].StoredData;
+			file.Write( storedData.Ptr(), storedData.Size() );
+			entries[i].DataOffset = dataOffset;
+			dataOffset += storedData.Size();
+		}
+		batchStart = batchEnd;
+	}
+
+	const BYTE padding[packDirectoryAlignment]{};
+	const auto paddingSize = static_cast<int>( ( packDirectoryAlignment - dataOffset % packDirectoryAlignment ) % packDirectoryAlignment );
+	file.Write( padding, paddingSize );
+	header.DirectoryOffset = dataOffset + paddingSize;
+
+	// Names and the hash table.
+	CString packNames;
+	header.HashTableSize = GetPow2HashTableSize( 2 * fileCount );
+	CArray<int> hashTable;
+	hashTable.IncreaseSizeNoInitialize( header.HashTableSize );
+	for( auto& filePos : hashTable ) {
+		filePos = NotFound;
+	}
+	for( int i = 0; i < fileCount; i++ ) {
+		const auto& name = sourceFiles[fileOrder[i]].Name;
+		entries[i].NameOffset = packNames.Length();
+		entries[i].NameLength = name.Length();
+		packNames += name;
+
+		int hashPos = findPackNameHash( name, header.HashTableSize );
+		while( hashTable[hashPos] != NotFound ) {
+			hashPos = ( hashPos + 1 ) & ( header.HashTableSize - 1 );
+		}
+		hashTable[hashPos] = i;
+	}
+
+	const auto entriesSize = fileCount * static_cast<int>( sizeof( RelibInternal::CFilePackEntry ) );
+	const auto hashTableByteSize = header.HashTableSize * static_cast<int>( sizeof( int ) );
+	file.Write( entries.Ptr(), entriesSize );
+	file.Write( hashTable.Ptr(), hashTableByteSize );
+	file.Write( packNames.Ptr(), packNames.Length() );
+
+	header.Magic = CFilePack::GetMagicNumber();
+	header.Version = CFilePack::Version;
+	header.FileCount = fileCount;
+	header.DirectorySize = entriesSize + hashTableByteSize + packNames.Length();
+	file.SeekToBegin();
+	file.Write( &header, sizeof( header ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
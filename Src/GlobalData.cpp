@@ -128,6 +128,7 @@ extern const CError Err_RegistryWriteError{ "Failed to write to a registry key.
 extern const CError Err_ZlibInitError{ "Failed to initialize ZLib. Error code: %0." };
 extern const CError Err_ZlibInflateError{ "Failed to unzip data. Error code: %0." };
 extern const CError Err_BadCollectionData{ "File collection data is corrupted." };
+extern const CError Err_DuplicatePackFile{ "File pack contains a duplicate file name: %0." };
 extern const CError Err_CreateTempFile( "Unable to open the temporary files folder.\nFolder name: %0.");
 
 // Other.
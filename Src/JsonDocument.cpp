@@ -1,6 +1,8 @@
 #include <JsonDocument.h>
 #include <JsonValues.h>
+#include <JsonScalarParser.h>
 #include <FileOwners.h>
+#include <DecimalConversions.h>
 #include <Remath.h>
 
 namespace Relib {
@@ -18,37 +20,41 @@ CString CJsonParseException::GetMessageText() const
 void CJsonDocument::Empty()
 {
 	root = nullptr;
+	jsonText = CStringView();
+	structuralIndex.Empty();
 	jsonData.Reset();
 }
 
-void CJsonDocument::CreateFromFile( CStringPart fileName )
+void CJsonDocument::CreateFromFile( CStringPart fileName, TJsonParseMode mode )
 {
 	CFileReader jsonFile( fileName, FCM_OpenExisting );
-	CreateFromFile( jsonFile );
+	CreateFromFile( jsonFile, mode );
 }
 
-void CJsonDocument::CreateFromFile( CFileReader& jsonFile )
+void CJsonDocument::CreateFromFile( CFileReader& jsonFile, TJsonParseMode mode )
 {
 	Empty();
 	const auto length = jsonFile.GetLength32();
 	if( length == 0 ) {
 		return;
 	}
-	auto jsonStrBuffer = jsonData.Create( length + 1, alignof( char ) );
-	CArrayBuffer<BYTE> jsonArrayBuffer( static_cast<BYTE*>( jsonStrBuffer.Ptr() ), length + 1 );
+	auto jsonStrBuffer = jsonData.Create( length + JsonTextPadding, alignof( char ) );
+	CArrayBuffer<BYTE> jsonArrayBuffer( static_cast<BYTE*>( jsonStrBuffer.Ptr() ), length + JsonTextPadding );
 	int bufferStartPos;
 	const auto encoding = jsonFile.ReadByteString( jsonArrayBuffer.Left( length ), bufferStartPos );
 	encoding;
 	assert( encoding == FTE_UTF8 || encoding == FTE_Undefined );
-	jsonArrayBuffer[length] = 0;
+	::memset( jsonArrayBuffer.Mid( length ).Ptr(), 0, JsonTextPadding );
 	const CStringView jsonStr( reinterpret_cast<const char*>( jsonArrayBuffer.Mid( bufferStartPos ).Ptr() ), length - bufferStartPos );
-	parseJson( jsonStr );
+	parseJson( jsonStr, mode );
 }
 
-void CJsonDocument::CreateFromString( CStringPart str )
+void CJsonDocument::CreateFromString( CStringPart str, TJsonParseMode mode )
 {
-	const auto jsonStr = allocateStringView( str );
-	parseJson( jsonStr );
+	// Values that are parsed on demand refer to the current text, so the previous content can't be kept.
+	Empty();
+	const auto jsonStr = allocateJsonText( str );
+	parseJson( jsonStr, mode );
 }
 
 CString CJsonDocument::GetDocumentString() const
@@ -67,226 +73,250 @@ CString CJsonDocument::GetFormattedString() const
 	return result;
 }
 
-void CJsonDocument::parseJson( CStringView jsonStr )
+void CJsonDocument::parseJson( CStringView jsonStr, TJsonParseMode mode )
 {
-	CJsonPosition startPos;
-	auto& parseResult = parseElement( jsonStr, startPos );
-	if( startPos.Pos != jsonStr.Length() ) {
-		throwParseException( startPos );
+	jsonText = jsonStr;
+	parseMode = mode;
+	const auto errorPos = structuralIndex.Build( jsonStr, mode == JPM_OnDemand );
+	if( errorPos != NotFound ) {
+		throwParseException( errorPos );
 	}
-	root = &parseResult;
-}
-
-void CJsonDocument::throwParseException( CJsonPosition parsePos ) const
-{
-	throw CJsonParseException( parsePos.LineNumber, parsePos.Pos - parsePos.LineStartPos );
-}
 
-CJsonDocument::CJsonPosition CJsonDocument::getNextPos( CJsonPosition parsePos ) const
-{
-	return CJsonPosition{ parsePos.Pos + 1, parsePos.LineNumber, parsePos.LineStartPos };
+	int index = 0;
+	auto& parseResult = parseValue( index );
+	if( index != structuralIndex.Size() ) {
+		throwStructuralException( index );
+	}
+	root = &parseResult;
+	if( mode == JPM_Full ) {
+		structuralIndex.Empty();
+		jsonText = CStringView();
+	}
 }
 
-CJsonDocument::CJsonPosition CJsonDocument::skipWhitespace( CStringView str, CJsonPosition startPos ) const
+void CJsonDocument::throwParseException( int textPos ) const
 {
-	int resultPos = startPos.Pos;
-	int lineNumber = startPos.LineNumber;
-	int lineStartPos = startPos.LineStartPos;
-	while( CStringPart::IsCharWhiteSpace( str[resultPos] ) ) {
-		if( str[resultPos] == '\n' ) {
+	// Line positions are only needed for the error message, so they are not tracked during the parsing.
+	int lineNumber = 1;
+	int lineStartPos = 0;
+	for( int i = 0; i < textPos; i++ ) {
+		if( jsonText[i] == '\n' ) {
 			lineNumber++;
-			lineStartPos = resultPos + 1;
+			lineStartPos = i + 1;
 		}
-		resultPos++;
 	}
-	return CJsonPosition{ resultPos, lineNumber, lineStartPos };
+	throw CJsonParseException( lineNumber, textPos - lineStartPos );
 }
 
-CStringPart CJsonDocument::parseString( CStringView str, CJsonPosition& parsePos )
+void CJsonDocument::throwStructuralException( int index ) const
 {
-	const auto strStartPos = parsePos.Pos + 1;
-	const auto endOrEscapePos = str.FindOneOf( CStringView( "\\\"" ), strStartPos );
-	if( endOrEscapePos == NotFound ) {
-		throwParseException( parsePos );
-	}
-	if( str[endOrEscapePos] == '\\' ) {
-		return replaceEscapeSequences( str, endOrEscapePos, parsePos );
-	} else {
-		parsePos.Pos = endOrEscapePos + 1;
-		return str.Mid( strStartPos, endOrEscapePos - strStartPos );
-	}
+	throwParseException( index < structuralIndex.Size() ? structuralIndex[index] : jsonText.Length() );
 }
 
-CStringPart CJsonDocument::replaceEscapeSequences( CStringView str, int firstEscapePos, CJsonPosition& parsePos )
+char CJsonDocument::getStructuralChar( int index ) const
 {
-	const auto startPos = parsePos.Pos + 1;
-	auto strPtr = const_cast<char*>( str.Ptr() );
-	int destStrPos = firstEscapePos;
-	int srcStrPos = firstEscapePos + 1;
-	strPtr[destStrPos++] = getEscapeCharacter( str[srcStrPos++] );
-	for( ;; ) {
-		const auto ch = str[srcStrPos];
-		if( ch == L'\\' ) {
-			const auto escapeCh = getEscapeCharacter( str[srcStrPos + 1] );
-			strPtr[destStrPos++] = escapeCh;
-			srcStrPos += 2;
-		} else if( ch == L'"' ) {
-			parsePos.Pos = srcStrPos + 1;
-			return str.Mid( startPos, destStrPos - startPos );
-		} else if( ch == 0 ) {
-			throwParseException( parsePos );
-		} else {
-			strPtr[destStrPos++] = str[srcStrPos++];
-		}
-	}
+	return index < structuralIndex.Size() ? jsonText[structuralIndex[index]] : 0;
 }
 
-char CJsonDocument::getEscapeCharacter( char escapeCode ) const
+CJsonValue& CJsonDocument::parseValue( int& index )
 {
-	switch( escapeCode ) {
+	const auto textPos = index < structuralIndex.Size() ? structuralIndex[index] : jsonText.Length();
+	switch( getStructuralChar( index ) ) {
+		case '{': {
+			auto& obj = allocateJsonObject( nullptr, nullptr, 0 );
+			if( parseMode == JPM_OnDemand ) {
+				obj.setLazySource( *this, index );
+				index = structuralIndex.GetClosingIndex( index ) + 1;
+			} else {
+				parseObjectValues( obj, index );
+			}
+			return obj;
+		}
+		case '[': {
+			auto& arr = allocateJsonDynamicArray( nullptr, nullptr, 0 );
+			if( parseMode == JPM_OnDemand ) {
+				arr.setLazySource( *this, index );
+				index = structuralIndex.GetClosingIndex( index ) + 1;
+			} else {
+				parseArrayValues( arr, index );
+			}
+			return arr;
+		}
 		case '"':
-		case '\\':
-		case '/':
-			return escapeCode;
-		case 'b':
-			return '\b';
-		case 'n':
-			return '\n';
-		case 'r':
-			return '\r';
+			index++;
+			return allocateJsonString( parseString( textPos ) );
 		case 't':
-			return '\t';
+			index++;
+			parseLiteral( textPos, "true" );
+			return allocateJsonBool( true );
+		case 'f':
+			index++;
+			parseLiteral( textPos, "false" );
+			return allocateJsonBool( false );
+		case 'n':
+			index++;
+			parseLiteral( textPos, "null" );
+			return allocateJsonNull();
 		default:
-			return escapeCode;
+			index++;
+			return allocateJsonNumber( parseNumber( textPos ) );
 	}
 }
 
-double CJsonDocument::parseNumber( CStringView str, CJsonPosition& parsePos ) const
+// Index must point to the opening bracket. It is moved past the closing bracket.
+void CJsonDocument::parseArrayValues( CJsonDynamicArray& arr, int& index )
 {
-	const auto startPos = parsePos.Pos;
-	int endPos = startPos;
-	while( CStringView::IsCharDigit( str[endPos] ) || str[endPos] == '.' || str[endPos] == 'e' || str[endPos] == '-' ) {
-		endPos++;
+	index++;
+	if( getStructuralChar( index ) == ']' ) {
+		index++;
+		return;
 	}
 
-	const auto numberStr = str.Mid( startPos, endPos - startPos );
-	const auto result = Value<double>( numberStr );
-	if( !result.IsValid() ) {
-		throwParseException( parsePos );
+	CJsonListNode<CJsonValue*>* listHead = nullptr;
+	CJsonListNode<CJsonValue*>* currentNode = nullptr;
+	int listSize = 0;
+	for( ;; ) {
+		auto& value = parseValue( index );
+		currentNode = currentNode == nullptr ? allocateListNode<CJsonValue*>() : addListNode( *currentNode );
+		currentNode->Value = &value;
+		if( listHead == nullptr ) {
+			listHead = currentNode;
+		}
+		listSize++;
+
+		const auto separator = getStructuralChar( index );
+		if( separator == ']' ) {
+			index++;
+			break;
+		} else if( separator != ',' ) {
+			throwStructuralException( index );
+		}
+		index++;
 	}
-	parsePos.Pos = endPos;
-	return *result;
+	arr.setList( listHead, currentNode, listSize );
 }
 
-CJsonObject& CJsonDocument::parseObject( CStringView str, CJsonPosition& parsePos )
+// Index must point to the opening bracket. It is moved past the closing bracket.
+void CJsonDocument::parseObjectValues( CJsonObject& obj, int& index )
 {
-	const auto internalStartPos = getNextPos( parsePos );
-	auto currentPos = skipWhitespace( str, internalStartPos );
-	if( str[currentPos.Pos] == L'}' ) {
-		parsePos = getNextPos( currentPos );
-		return allocateJsonObject( nullptr, nullptr, 0 );
+	index++;
+	if( getStructuralChar( index ) == '}' ) {
+		index++;
+		return;
 	}
 
-	auto currentNode = allocateListNode<CJsonKeyValue>();
-	const auto listHead = currentNode;
-	int listSize = 1;
+	CJsonListNode<CJsonKeyValue>* listHead = nullptr;
+	CJsonListNode<CJsonKeyValue>* currentNode = nullptr;
+	int listSize = 0;
 	for( ;; ) {
-		if( str[currentPos.Pos] != '"' ) {
-			throwParseException( currentPos );
+		if( getStructuralChar( index ) != '"' ) {
+			throwStructuralException( index );
 		}
-		const auto keyName = parseString( str, currentPos );
-		currentPos = skipWhitespace( str, currentPos );
-		if( str[currentPos.Pos] != ':' ) {
-			throwParseException( currentPos );
+		const auto keyName = parseString( structuralIndex[index] );
+		index++;
+		if( getStructuralChar( index ) != ':' ) {
+			throwStructuralException( index );
 		}
-		currentPos = skipWhitespace( str, getNextPos( currentPos ) );
-		auto& keyValue = parseValue( str, currentPos );
-		currentPos = skipWhitespace( str, currentPos );
-		currentNode->Value = CJsonKeyValue{ keyName, &keyValue };
-		if( str[currentPos.Pos] == L'}' ) {
-			parsePos = getNextPos( currentPos );
-			return allocateJsonObject( listHead, currentNode, listSize );
-		} else if( str[currentPos.Pos] != ',' ) {
-			throwParseException( currentPos );
+		index++;
+		auto& value = parseValue( index );
+		currentNode = currentNode == nullptr ? allocateListNode<CJsonKeyValue>() : addListNode( *currentNode );
+		currentNode->Value = CJsonKeyValue{ keyName, &value };
+		if( listHead == nullptr ) {
+			listHead = currentNode;
 		}
-		currentNode = addListNode( *currentNode );
-		currentPos = skipWhitespace( str, getNextPos( currentPos ) );
 		listSize++;
+
+		const auto separator = getStructuralChar( index );
+		if( separator == '}' ) {
+			index++;
+			break;
+		} else if( separator != ',' ) {
+			throwStructuralException( index );
+		}
+		index++;
+	}
+	obj.setList( listHead, currentNode, listSize );
+	if( listSize >= keyIndexThreshold ) {
+		buildKeyIndex( obj );
 	}
 }
 
-CJsonValue& CJsonDocument::parseArray( CStringView str, CJsonPosition& parsePos )
+void CJsonDocument::ExpandArray( CJsonDynamicArray& arr, int sourcePos )
 {
-	auto currentPos = skipWhitespace( str, getNextPos( parsePos ) );
-	if( str[currentPos.Pos] == ']' ) {
-		parsePos = getNextPos( currentPos );
-		return allocateJsonDynamicArray( nullptr, nullptr, 0 );
-	}
+	assert( !jsonText.IsEmpty() );
+	int index = sourcePos;
+	parseArrayValues( arr, index );
+	assert( index == structuralIndex.GetClosingIndex( sourcePos ) + 1 );
+}
 
-	auto& firstValue = parseValue( str, currentPos );
-	parsePos = skipWhitespace( str, currentPos );
-	return parseValueList( str, parsePos, ']', firstValue );
+void CJsonDocument::ExpandObject( CJsonObject& obj, int sourcePos )
+{
+	assert( !jsonText.IsEmpty() );
+	int index = sourcePos;
+	parseObjectValues( obj, index );
+	assert( index == structuralIndex.GetClosingIndex( sourcePos ) + 1 );
 }
 
-CJsonValue& CJsonDocument::parseValueList( CStringView str, CJsonPosition& currentPos, char terminator, CJsonValue& firstValue )
+// Text position must point to the opening quote.
+CStringPart CJsonDocument::parseString( int textPos )
 {
-	auto currentNode = allocateListNode<CJsonValue*>();
-	currentNode->Value = &firstValue;
-	const auto listHead = currentNode;
-	int listSize = 1;
-	for( ;; ) {
-		if( str[currentPos.Pos] == terminator ) {
-			currentPos = getNextPos( currentPos );
-			return allocateJsonDynamicArray( listHead, currentNode, listSize );
-		} else if( str[currentPos.Pos] != ',' ) {
-			throwParseException( currentPos );
+	const auto startPos = textPos + 1;
+	const auto endOrEscapePos = RelibInternal::CJsonScalarParser::FindQuoteOrEscape( jsonText.Ptr(), startPos );
+	if( jsonText[endOrEscapePos] == '\\' ) {
+		int endPos;
+		if( !RelibInternal::CJsonScalarParser::ReplaceEscapeSequences( const_cast<char*>( jsonText.Ptr() ), endOrEscapePos, endPos ) ) {
+			throwParseException( endPos );
 		}
-		currentPos = skipWhitespace( str, getNextPos( currentPos ) );
-		currentNode = addListNode( *currentNode );
-		auto& value = parseValue( str, currentPos );
-		currentNode->Value = &value;
-		currentPos = skipWhitespace( str, currentPos );
-		listSize++;
+		return jsonText.Mid( startPos, endPos - startPos );
 	}
+	return jsonText.Mid( startPos, endOrEscapePos - startPos );
 }
 
-CJsonValue& CJsonDocument::parseValue( CStringView str, CJsonPosition& parsePos )
+double CJsonDocument::parseNumber( int textPos ) const
 {
-	const auto firstCh = str[parsePos.Pos];
-	switch( firstCh ) {
-		case 't':
-			parsePos.Pos += 4;
-			return allocateJsonBool( true );
-		case 'f':
-			parsePos.Pos += 5;
-			return allocateJsonBool( false );
-		case 'n':
-			parsePos.Pos += 4;
-			return allocateJsonNull();
-		case '{':
-			return parseObject( str, parsePos );
-		case '[':
-			return parseArray( str, parsePos );
-		case '"':
-			return allocateJsonString( parseString( str, parsePos ) );
-		default:
-			return allocateJsonNumber( parseNumber( str, parsePos ) );
+	int pos = textPos;
+	double result;
+	if( !RelibInternal::CJsonScalarParser::ParseNumber( jsonText.Ptr(), pos, result ) ) {
+		throwParseException( pos );
 	}
+	checkScalarEnd( pos );
+	return result;
 }
 
-CJsonValue& CJsonDocument::parseElement( CStringView str, CJsonPosition& parsePos )
+void CJsonDocument::parseLiteral( int textPos, CStringView literal ) const
 {
-	parsePos = skipWhitespace( str, parsePos );
-	auto& result = parseValue( str, parsePos );
-	parsePos = skipWhitespace( str, parsePos );
-	return result;
+	// Text padding guarantees that the comparison doesn't read past the buffer.
+	if( ::memcmp( jsonText.Ptr() + textPos, literal.Ptr(), literal.Length() ) != 0 ) {
+		throwParseException( textPos );
+	}
+	checkScalarEnd( textPos + literal.Length() );
+}
+
+// Check that a scalar value is not followed by other characters.
+void CJsonDocument::checkScalarEnd( int textPos ) const
+{
+	switch( jsonText.Ptr()[textPos] ) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case ',':
+		case ']':
+		case '}':
+		case ':':
+			return;
+		default:
+			if( textPos != jsonText.Length() ) {
+				throwParseException( textPos );
+			}
+	}
 }
 
-CStringView CJsonDocument::allocateStringView( CStringPart source )
+CStringView CJsonDocument::allocateJsonText( CStringPart source )
 {
 	const auto length = source.Length();
-	auto strBuffer = allocateStringBuffer( source, length + 1 );
-	reinterpret_cast<BYTE*>( strBuffer.Ptr() )[length] = 0;
+	auto strBuffer = allocateStringBuffer( source, length + JsonTextPadding );
+	::memset( static_cast<BYTE*>( strBuffer.Ptr() ) + length, 0, JsonTextPadding );
 	return CStringView( static_cast<const char*>( strBuffer.Ptr() ), length );
 }
 
@@ -369,9 +399,14 @@ void CJsonDocument::writeToString( const CJsonNull&, CString& result ) const
 
 void CJsonDocument::writeToString( const CJsonNumber& value, CString& result ) const
 {
-	const auto resultNum = value.GetNumber();
-	const auto digitCount = HasFractionalPart( resultNum ) ? 16 : 0;
-	result += Str( resultNum, digitCount );
+	// JSON has no representation for infinities and NaNs.
+	if( !std::isfinite( value.GetNumber() ) ) {
+		result += "null";
+		return;
+	}
+	char buffer[Decimal::MaxShortestLength];
+	const auto length = Decimal::FormatShortest( value.GetNumber(), buffer );
+	result += CStringPart( buffer, length );
 }
 
 void CJsonDocument::writeToString( const CJsonString& value, CString& result ) const
@@ -379,6 +414,9 @@ void CJsonDocument::writeToString( const CJsonString& value, CString& result ) c
 	writeStringValue( value.GetString(), result );
 }
 
+static const char hexDigits[] = "0123456789ABCDEF";
+
+// Control characters without a short escape are written as \u00XX.
 void CJsonDocument::writeStringValue( CStringPart str, CString& result ) const
 {
 	auto localResult = Str( '"' );
@@ -397,6 +435,9 @@ void CJsonDocument::writeStringValue( CStringPart str, CString& result ) const
 			case '\b':
 				localResult += "\\b";
 				break;
+			case '\f':
+				localResult += "\\f";
+				break;
 			case '\n':
 				localResult += "\\n";
 				break;
@@ -407,7 +448,13 @@ void CJsonDocument::writeStringValue( CStringPart str, CString& result ) const
 				localResult += "\\t";
 				break;
 			default:
-				localResult += ch;
+				if( static_cast<BYTE>( ch ) < 0x20 ) {
+					localResult += "\\u00";
+					localResult += hexDigits[static_cast<BYTE>( ch ) >> 4];
+					localResult += hexDigits[ch & 0xF];
+				} else {
+					localResult += ch;
+				}
 				break;
 		}
 	}
@@ -532,6 +579,53 @@ void CJsonDocument::AddObjectValue( CJsonObject& obj, CStringPart key, CJsonValu
 		newNode->Value = CJsonKeyValue{ docKey, &val };
 		obj.setTail( newNode );
 	}
+	updateKeyIndex( obj );
+}
+
+// Key index is kept at most half full.
+void CJsonDocument::buildKeyIndex( CJsonObject& obj )
+{
+	const auto slotCount = GetPow2HashTableSize( 2 * obj.listSize );
+	auto slotBuffer = jsonData.Create( slotCount * sizeof( CJsonKeySlot ), alignof( CJsonKeySlot ) );
+	::memset( slotBuffer.Ptr(), 0, slotCount * sizeof( CJsonKeySlot ) );
+	const auto slots = static_cast<CJsonKeySlot*>( slotBuffer.Ptr() );
+	for( auto node = obj.listHead; node != nullptr; node = node->Next ) {
+		insertKeySlot( slots, slotCount, *node );
+	}
+	obj.keySlots = slots;
+	obj.keySlotCount = slotCount;
+}
+
+// Update the key index after a value has been added to the object.
+void CJsonDocument::updateKeyIndex( CJsonObject& obj )
+{
+	if( obj.keySlots == nullptr ) {
+		if( obj.listSize >= keyIndexThreshold ) {
+			buildKeyIndex( obj );
+		}
+	} else if( 2 * obj.listSize > obj.keySlotCount ) {
+		// The previous slot array stays in the arena until the document is emptied.
+		buildKeyIndex( obj );
+	} else {
+		insertKeySlot( obj.keySlots, obj.keySlotCount, *obj.listTail );
+	}
+}
+
+void CJsonDocument::insertKeySlot( CJsonKeySlot* slots, int slotCount, CJsonListNode<CJsonKeyValue>& node )
+{
+	const auto hash = CDefaultHash<CStringPart>::HashKey( node.Value.Key );
+	const auto slotMask = slotCount - 1;
+	for( int slotPos = hash & slotMask;; slotPos = ( slotPos + 1 ) & slotMask ) {
+		auto& slot = slots[slotPos];
+		if( slot.Node == nullptr ) {
+			slot = CJsonKeySlot{ hash, &node };
+			return;
+		}
+		if( slot.Hash == hash && slot.Node->Value.Key == node.Value.Key ) {
+			// Duplicate keys are found by their first occurrence.
+			return;
+		}
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,309 @@
+#include <JsonReader.h>
+#include <JsonScalarParser.h>
+#include <Remath.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+CJsonReader::CJsonReader( CFileReadView _file, int bufferSize ) :
+	file( _file )
+{
+	assert( bufferSize > 0 );
+	buffer.IncreaseSizeNoInitialize( bufferSize + JsonTextPadding );
+	buffer[0] = 0;
+	// Skip the UTF-8 byte order mark.
+	if( fillBuffer( 3 ) && ::memcmp( buffer.Ptr(), "\xEF\xBB\xBF", 3 ) == 0 ) {
+		bufferPos = 3;
+		lineStartOffset = 3;
+	}
+}
+
+bool CJsonReader::Read()
+{
+	if( !skipWhitespace() ) {
+		if( state != RS_Value || !containers.IsEmpty() ) {
+			throwParseException( bufferEnd );
+		}
+		return false;
+	}
+
+	const auto ch = buffer[bufferPos];
+	switch( state ) {
+		case RS_Value:
+			return readValue();
+		case RS_FirstValue:
+			if( ch == ']' ) {
+				bufferPos++;
+				return endContainer();
+			}
+			return readValue();
+		case RS_FirstKey:
+			if( ch == '}' ) {
+				bufferPos++;
+				return endContainer();
+			}
+			return readKey();
+		case RS_Colon:
+			if( ch != ':' ) {
+				throwParseException( bufferPos );
+			}
+			bufferPos++;
+			state = RS_Value;
+			if( !skipWhitespace() ) {
+				throwParseException( bufferEnd );
+			}
+			return readValue();
+		case RS_Separator: {
+			const bool isObject = containers.Last();
+			if( ch == ( isObject ? '}' : ']' ) ) {
+				bufferPos++;
+				return endContainer();
+			}
+			if( ch != ',' ) {
+				throwParseException( bufferPos );
+			}
+			bufferPos++;
+			if( !skipWhitespace() ) {
+				throwParseException( bufferEnd );
+			}
+			return isObject ? readKey() : readValue();
+		}
+		default:
+			assert( false );
+			return false;
+	}
+}
+
+void CJsonReader::SkipContainer()
+{
+	assert( event == JRE_StartObject || event == JRE_StartArray );
+	const auto startDepth = containers.Size() - 1;
+	while( containers.Size() > startDepth ) {
+		// End of the stream inside a container is an error.
+		Read();
+	}
+}
+
+// Make sure that the buffer has at least count unread bytes. Return false if the stream ends earlier.
+bool CJsonReader::fillBuffer( int count )
+{
+	if( bufferEnd - bufferPos >= count ) {
+		return true;
+	}
+	if( isFileEnd ) {
+		return false;
+	}
+
+	const auto unreadSize = bufferEnd - bufferPos;
+	::memmove( buffer.Ptr(), buffer.Ptr() + bufferPos, unreadSize );
+	bufferOffset += bufferPos;
+	bufferPos = 0;
+	bufferEnd = unreadSize;
+	if( count > getBufferCapacity() ) {
+		// A single value doesn't fit in the buffer.
+		buffer.IncreaseSizeNoInitialize( max( 2 * getBufferCapacity(), count ) + JsonTextPadding );
+	}
+
+	while( bufferEnd < count ) {
+		const auto readSize = file.Read( buffer.Ptr() + bufferEnd, getBufferCapacity() - bufferEnd );
+		if( readSize == 0 ) {
+			isFileEnd = true;
+			break;
+		}
+		bufferEnd += readSize;
+	}
+	// Scalar parsing relies on the terminating character.
+	buffer[bufferEnd] = 0;
+	return bufferEnd >= count;
+}
+
+int CJsonReader::getBufferCapacity() const
+{
+	return buffer.Size() - JsonTextPadding;
+}
+
+// Move to the next non-whitespace character. Return false if the stream has ended.
+bool CJsonReader::skipWhitespace()
+{
+	for( ;; ) {
+		if( bufferPos == bufferEnd && !fillBuffer( 1 ) ) {
+			return false;
+		}
+		const auto ch = buffer[bufferPos];
+		if( ch == '\n' ) {
+			lineNumber++;
+			lineStartOffset = bufferOffset + bufferPos + 1;
+		} else if( ch != ' ' && ch != '\t' && ch != '\r' ) {
+			return true;
+		}
+		bufferPos++;
+	}
+}
+
+// The colon is checked on the next read, refilling the buffer would invalidate the key.
+bool CJsonReader::readKey()
+{
+	if( buffer[bufferPos] != '"' ) {
+		throwParseException( bufferPos );
+	}
+	readString();
+	event = JRE_Key;
+	state = RS_Colon;
+	return true;
+}
+
+bool CJsonReader::readValue()
+{
+	switch( buffer[bufferPos] ) {
+		case '{':
+			bufferPos++;
+			containers.Add( true );
+			event = JRE_StartObject;
+			state = RS_FirstKey;
+			return true;
+		case '[':
+			bufferPos++;
+			containers.Add( false );
+			event = JRE_StartArray;
+			state = RS_FirstValue;
+			return true;
+		case '"':
+			readString();
+			event = JRE_String;
+			break;
+		case 't':
+			readLiteral( "true" );
+			boolValue = true;
+			event = JRE_Bool;
+			break;
+		case 'f':
+			readLiteral( "false" );
+			boolValue = false;
+			event = JRE_Bool;
+			break;
+		case 'n':
+			readLiteral( "null" );
+			event = JRE_Null;
+			break;
+		default:
+			readNumber();
+			event = JRE_Number;
+			break;
+	}
+	finishValue();
+	return true;
+}
+
+bool CJsonReader::endContainer()
+{
+	event = containers.Last() ? JRE_EndObject : JRE_EndArray;
+	containers.DeleteLast();
+	finishValue();
+	return true;
+}
+
+void CJsonReader::finishValue()
+{
+	state = containers.IsEmpty() ? RS_Value : RS_Separator;
+}
+
+// String is read from the opening quote and unescaped in the buffer.
+void CJsonReader::readString()
+{
+	int offset = 1;
+	int firstEscapeOffset = NotFound;
+	for( ;; ) {
+		const auto unreadSize = bufferEnd - bufferPos;
+		if( offset < unreadSize ) {
+			offset = RelibInternal::CJsonScalarParser::FindQuoteOrEscape( buffer.Ptr() + bufferPos, offset, unreadSize );
+			if( offset < unreadSize ) {
+				if( buffer[bufferPos + offset] == '"' ) {
+					break;
+				}
+				if( firstEscapeOffset == NotFound ) {
+					firstEscapeOffset = offset;
+				}
+				// Skip the escaped character.
+				offset += 2;
+				continue;
+			}
+		}
+		if( !fillBuffer( offset + 1 ) ) {
+			throwParseException( bufferEnd );
+		}
+	}
+
+	const auto str = buffer.Ptr() + bufferPos;
+	int endOffset = offset;
+	if( firstEscapeOffset != NotFound && !RelibInternal::CJsonScalarParser::ReplaceEscapeSequences( str, firstEscapeOffset, endOffset ) ) {
+		throwParseException( bufferPos + endOffset );
+	}
+	stringValue = CStringPart( str + 1, endOffset - 1 );
+	bufferPos += offset + 1;
+}
+
+void CJsonReader::readNumber()
+{
+	int offset = 0;
+	for( ;; ) {
+		const auto unreadSize = bufferEnd - bufferPos;
+		for( ; offset < unreadSize && isNumberChar( buffer[bufferPos + offset] ); offset++ ) {
+		}
+		if( offset < unreadSize || !fillBuffer( offset + 1 ) ) {
+			break;
+		}
+	}
+
+	int pos = bufferPos;
+	if( !RelibInternal::CJsonScalarParser::ParseNumber( buffer.Ptr(), pos, numberValue ) || pos != bufferPos + offset ) {
+		throwParseException( pos );
+	}
+	bufferPos = pos;
+	checkScalarEnd();
+}
+
+void CJsonReader::readLiteral( CStringView literal )
+{
+	const auto length = literal.Length();
+	if( !fillBuffer( length ) || ::memcmp( buffer.Ptr() + bufferPos, literal.Ptr(), length ) != 0 ) {
+		throwParseException( bufferPos );
+	}
+	bufferPos += length;
+	checkScalarEnd();
+}
+
+// Numbers and literals must be followed by a delimiter.
+void CJsonReader::checkScalarEnd()
+{
+	if( !fillBuffer( 1 ) ) {
+		return;
+	}
+	switch( buffer[bufferPos] ) {
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case ',':
+		case ']':
+		case '}':
+		case ':':
+			return;
+		default:
+			throwParseException( bufferPos );
+	}
+}
+
+bool CJsonReader::isNumberChar( char ch ) const
+{
+	return CStringView::IsCharDigit( ch ) || ch == '-' || ch == '+' || ch == '.' || ch == 'e' || ch == 'E';
+}
+
+void CJsonReader::throwParseException( int pos ) const
+{
+	throw CJsonParseException( lineNumber, static_cast<int>( bufferOffset + pos - lineStartOffset ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
@@ -0,0 +1,244 @@
+#include <JsonScalarParser.h>
+#include <StrConversions.h>
+#include <DecimalConversions.h>
+#include <Remath.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+static int getQuoteOrEscapeMask( const char* str, int pos )
+{
+	const auto block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( str + pos ) );
+	return _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( block, _mm_set1_epi8( '"' ) ), _mm_cmpeq_epi8( block, _mm_set1_epi8( '\\' ) ) ) );
+}
+
+int CJsonScalarParser::FindQuoteOrEscape( const char* str, int startPos )
+{
+	for( int pos = startPos;; pos += 16 ) {
+		const auto mask = getQuoteOrEscapeMask( str, pos );
+		if( mask != 0 ) {
+			DWORD bitPos;
+			_BitScanForward( &bitPos, mask );
+			return pos + static_cast<int>( bitPos );
+		}
+	}
+}
+
+int CJsonScalarParser::FindQuoteOrEscape( const char* str, int startPos, int endPos )
+{
+	for( int pos = startPos; pos < endPos; pos += 16 ) {
+		const auto mask = getQuoteOrEscapeMask( str, pos );
+		if( mask != 0 ) {
+			DWORD bitPos;
+			_BitScanForward( &bitPos, mask );
+			return min( pos + static_cast<int>( bitPos ), endPos );
+		}
+	}
+	return endPos;
+}
+
+// The result is never longer than the source.
+bool CJsonScalarParser::ReplaceEscapeSequences( char* str, int firstEscapePos, int& endPos )
+{
+	int destPos = firstEscapePos;
+	int srcPos = firstEscapePos;
+	for( ;; ) {
+		if( str[srcPos] == '"' ) {
+			endPos = destPos;
+			return true;
+		}
+		assert( str[srcPos] == '\\' );
+		const auto escapeCode = str[srcPos + 1];
+		if( escapeCode == 'u' ) {
+			if( !replaceUnicodeEscape( str, srcPos, destPos ) ) {
+				endPos = srcPos;
+				return false;
+			}
+		} else {
+			str[destPos++] = getEscapeCharacter( escapeCode );
+			srcPos += 2;
+		}
+
+		const auto nextPos = FindQuoteOrEscape( str, srcPos );
+		const auto copyLength = nextPos - srcPos;
+		::memmove( str + destPos, str + srcPos, copyLength );
+		destPos += copyLength;
+		srcPos = nextPos;
+	}
+}
+
+// Replace a \uXXXX sequence or a surrogate pair of them with UTF-8.
+bool CJsonScalarParser::replaceUnicodeEscape( char* str, int& srcPos, int& destPos )
+{
+	int pos = srcPos + 2;
+	unsigned code;
+	if( !parseHexCode( str, pos, code ) ) {
+		srcPos = pos;
+		return false;
+	}
+	if( code >= 0xD800 && code < 0xDC00 && str[pos] == '\\' && str[pos + 1] == 'u' ) {
+		int lowPos = pos + 2;
+		unsigned lowCode;
+		if( !parseHexCode( str, lowPos, lowCode ) ) {
+			srcPos = lowPos;
+			return false;
+		}
+		if( lowCode >= 0xDC00 && lowCode < 0xE000 ) {
+			code = 0x10000 + ( ( code - 0xD800 ) << 10 ) + ( lowCode - 0xDC00 );
+			pos = lowPos;
+		}
+	}
+	srcPos = pos;
+
+	if( code < 0x80 ) {
+		str[destPos++] = static_cast<char>( code );
+	} else if( code < 0x800 ) {
+		str[destPos++] = static_cast<char>( 0xC0 | ( code >> 6 ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( code & 0x3F ) );
+	} else if( code < 0x10000 ) {
+		str[destPos++] = static_cast<char>( 0xE0 | ( code >> 12 ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( code & 0x3F ) );
+	} else {
+		str[destPos++] = static_cast<char>( 0xF0 | ( code >> 18 ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( ( code >> 12 ) & 0x3F ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( ( code >> 6 ) & 0x3F ) );
+		str[destPos++] = static_cast<char>( 0x80 | ( code & 0x3F ) );
+	}
+	return true;
+}
+
+bool CJsonScalarParser::parseHexCode( const char* str, int& pos, unsigned& result )
+{
+	result = 0;
+	const auto endPos = pos + 4;
+	for( ; pos < endPos; pos++ ) {
+		const auto ch = str[pos];
+		unsigned digit;
+		if( ch >= '0' && ch <= '9' ) {
+			digit = ch - '0';
+		} else if( ch >= 'a' && ch <= 'f' ) {
+			digit = ch - 'a' + 10;
+		} else if( ch >= 'A' && ch <= 'F' ) {
+			digit = ch - 'A' + 10;
+		} else {
+			return false;
+		}
+		result = result * 16 + digit;
+	}
+	return true;
+}
+
+char CJsonScalarParser::getEscapeCharacter( char escapeCode )
+{
+	switch( escapeCode ) {
+		case '"':
+		case '\\':
+		case '/':
+			return escapeCode;
+		case 'b':
+			return '\b';
+		case 'f':
+			return '\f';
+		case 'n':
+			return '\n';
+		case 'r':
+			return '\r';
+		case 't':
+			return '\t';
+		default:
+			return escapeCode;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Maximum number of decimal digits that always fit in the mantissa accumulator.
+static const int maxMantissaDigitCount = 19;
+
+// The mantissa is accumulated during the validation and converted without rescanning.
+// Only the numbers with longer mantissas are parsed again to round them correctly.
+bool CJsonScalarParser::ParseNumber( const char* str, int& pos, double& result )
+{
+	const auto startPos = pos;
+	const bool isNegative = str[pos] == '-';
+	if( isNegative ) {
+		pos++;
+	}
+
+	unsigned __int64 mantissa = 0;
+	int digitCount = 0;
+	int exponent = 0;
+	bool isTruncated = false;
+	const auto addDigit = [&]( char digit ) {
+		if( digitCount == maxMantissaDigitCount ) {
+			isTruncated = isTruncated || digit != '0';
+			return false;
+		}
+		mantissa = mantissa * 10 + ( digit - '0' );
+		if( mantissa != 0 ) {
+			digitCount++;
+		}
+		return true;
+	};
+
+	const auto integerStartPos = pos;
+	for( ; CStringView::IsCharDigit( str[pos] ); pos++ ) {
+		if( !addDigit( str[pos] ) ) {
+			exponent++;
+		}
+	}
+	if( pos == integerStartPos ) {
+		return false;
+	}
+	if( str[pos] == '.' ) {
+		pos++;
+		const auto fractionStartPos = pos;
+		for( ; CStringView::IsCharDigit( str[pos] ); pos++ ) {
+			if( addDigit( str[pos] ) ) {
+				exponent--;
+			}
+		}
+		if( pos == fractionStartPos ) {
+			return false;
+		}
+	}
+	if( str[pos] == 'e' || str[pos] == 'E' ) {
+		pos++;
+		const bool isExponentNegative = str[pos] == '-';
+		if( str[pos] == '-' || str[pos] == '+' ) {
+			pos++;
+		}
+		const auto exponentStartPos = pos;
+		int exponentValue = 0;
+		for( ; CStringView::IsCharDigit( str[pos] ); pos++ ) {
+			// Larger exponents overflow or underflow anyway.
+			if( exponentValue < 100000 ) {
+				exponentValue = exponentValue * 10 + ( str[pos] - '0' );
+			}
+		}
+		if( pos == exponentStartPos ) {
+			return false;
+		}
+		exponent += isExponentNegative ? -exponentValue : exponentValue;
+	}
+
+	if( isTruncated ) {
+		const auto parsedLength = Decimal::Parse( str + startPos, pos - startPos, result );
+		assert( parsedLength == pos - startPos );
+		return true;
+	}
+	const auto value = Decimal::ComputeDouble( mantissa, exponent );
+	result = isNegative ? -value : value;
+	return true;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
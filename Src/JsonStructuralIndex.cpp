@@ -0,0 +1,176 @@
+#include <JsonStructuralIndex.h>
+#include <Remath.h>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Size of the text block that is classified at once. Every bit of a block mask corresponds to a single character.
+static const int jsonBlockSize = 64;
+
+// Character masks of a single block.
+struct CJsonBlockMasks {
+	unsigned __int64 Backslashes;
+	unsigned __int64 Quotes;
+	unsigned __int64 Whitespace;
+	unsigned __int64 Operators;
+};
+
+static unsigned __int64 getCharMask( __m128i block, char ch )
+{
+	return static_cast<unsigned>( _mm_movemask_epi8( _mm_cmpeq_epi8( block, _mm_set1_epi8( ch ) ) ) );
+}
+
+static void classifyJsonBlock( const char* blockPtr, CJsonBlockMasks& result )
+{
+	result = CJsonBlockMasks{};
+	// Brackets differ from their square counterparts by a single bit.
+	const auto bracketBit = _mm_set1_epi8( 0x20 );
+	for( int i = 0; i < jsonBlockSize / 16; i++ ) {
+		const auto block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( blockPtr + i * 16 ) );
+		const auto shift = i * 16;
+		result.Backslashes |= getCharMask( block, '\\' ) << shift;
+		result.Quotes |= getCharMask( block, '"' ) << shift;
+		result.Whitespace |= ( getCharMask( block, ' ' ) | getCharMask( block, '\t' ) | getCharMask( block, '\n' ) | getCharMask( block, '\r' ) ) << shift;
+		const auto bracketBlock = _mm_or_si128( block, bracketBit );
+		result.Operators |= ( getCharMask( bracketBlock, '{' ) | getCharMask( bracketBlock, '}' ) | getCharMask( block, ':' ) | getCharMask( block, ',' ) ) << shift;
+	}
+}
+
+static int findLowestBit( unsigned __int64 mask )
+{
+	assert( mask != 0 );
+	DWORD result;
+#ifdef _WIN64
+	_BitScanForward64( &result, mask );
+#else
+	const auto lowPart = static_cast<DWORD>( mask );
+	if( lowPart != 0 ) {
+		_BitScanForward( &result, lowPart );
+	} else {
+		_BitScanForward( &result, static_cast<DWORD>( mask >> 32 ) );
+		result += 32;
+	}
+#endif
+	return static_cast<int>( result );
+}
+
+// Find the characters that are escaped by a backslash. Escape state of the last block character is carried to the next block.
+static unsigned __int64 findEscapedChars( unsigned __int64 backslashes, bool& isNextEscaped )
+{
+	unsigned __int64 result = isNextEscaped ? 1 : 0;
+	if( isNextEscaped ) {
+		backslashes &= ~1ULL;
+	}
+	isNextEscaped = false;
+	while( backslashes != 0 ) {
+		const auto pos = findLowestBit( backslashes );
+		if( pos == jsonBlockSize - 1 ) {
+			isNextEscaped = true;
+			break;
+		}
+		const auto escapedBit = 1ULL << ( pos + 1 );
+		result |= escapedBit;
+		// The escaped character is not an escape itself.
+		backslashes &= ~( ( escapedBit << 1 ) - 1 );
+	}
+	return result;
+}
+
+// Every bit of the result is the xor of all the preceding bits of the mask including itself.
+static unsigned __int64 prefixXor( unsigned __int64 mask )
+{
+	mask ^= mask << 1;
+	mask ^= mask << 2;
+	mask ^= mask << 4;
+	mask ^= mask << 8;
+	mask ^= mask << 16;
+	mask ^= mask << 32;
+	return mask;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+int CJsonStructuralIndex::Build( CStringView text, bool shouldMatchBrackets )
+{
+	Empty();
+	const auto length = text.Length();
+	// Most texts have a structural character for every few bytes.
+	positions.ReserveBuffer( length / 4 + jsonBlockSize );
+
+	bool isNextEscaped = false;
+	unsigned __int64 inStringCarry = 0;
+	unsigned __int64 scalarCarry = 0;
+	for( int blockPos = 0; blockPos < length; blockPos += jsonBlockSize ) {
+		CJsonBlockMasks masks;
+		classifyJsonBlock( text.Ptr() + blockPos, masks );
+
+		const auto escaped = findEscapedChars( masks.Backslashes, isNextEscaped );
+		const auto quotes = masks.Quotes & ~escaped;
+		// Bits of the opening quotes and string contents are set.
+		const auto inString = prefixXor( quotes ) ^ inStringCarry;
+		inStringCarry = 0ULL - ( inString >> ( jsonBlockSize - 1 ) );
+
+		const auto outside = ~( inString | quotes );
+		const auto operators = masks.Operators & outside;
+		const auto scalars = outside & ~( masks.Operators | masks.Whitespace );
+		const auto scalarStarts = scalars & ~( ( scalars << 1 ) | scalarCarry );
+		scalarCarry = scalars >> ( jsonBlockSize - 1 );
+
+		auto structurals = operators | scalarStarts | ( quotes & inString );
+		const auto blockLength = length - blockPos;
+		if( blockLength < jsonBlockSize ) {
+			structurals &= ( 1ULL << blockLength ) - 1;
+		}
+
+		if( positions.Capacity() - positions.Size() < jsonBlockSize ) {
+			positions.ReserveBuffer( max( positions.Capacity() * 2, positions.Size() + jsonBlockSize ) );
+		}
+		while( structurals != 0 ) {
+			positions.AddWithinCapacity( blockPos + findLowestBit( structurals ) );
+			structurals &= structurals - 1;
+		}
+	}
+
+	if( inStringCarry != 0 ) {
+		// Unterminated string.
+		return length;
+	}
+	return shouldMatchBrackets ? matchBrackets( text ) : NotFound;
+}
+
+void CJsonStructuralIndex::Empty()
+{
+	positions.FreeBuffer();
+	closingIndices.FreeBuffer();
+}
+
+int CJsonStructuralIndex::matchBrackets( CStringView text )
+{
+	const auto count = positions.Size();
+	closingIndices.IncreaseSizeNoInitialize( count );
+	CArray<int> openIndices;
+	for( int i = 0; i < count; i++ ) {
+		const auto ch = text[positions[i]];
+		if( ch == '{' || ch == '[' ) {
+			openIndices.Add( i );
+		} else if( ch == '}' || ch == ']' ) {
+			const auto openingCh = ch == '}' ? '{' : '[';
+			if( openIndices.IsEmpty() || text[positions[openIndices.Last()]] != openingCh ) {
+				return positions[i];
+			}
+			closingIndices[openIndices.Last()] = i;
+			openIndices.DeleteLast();
+		}
+	}
+	return openIndices.IsEmpty() ? NotFound : text.Length();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
@@ -0,0 +1,262 @@
+#include <JsonWriter.h>
+#include <StrConversions.h>
+#include <DecimalConversions.h>
+#include <MessageLog.h>
+#include <Remath.h>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+CJsonWriter::CJsonWriter( CFileWriteView _file, int bufferSize ) :
+	file( _file )
+{
+	assert( bufferSize > 0 );
+	buffer.ReserveBuffer( bufferSize );
+}
+
+CJsonWriter::~CJsonWriter()
+{
+	try {
+		Flush();
+	} catch( CException& e ) {
+		Log::Exception( e );
+	}
+}
+
+void CJsonWriter::StartObject()
+{
+	startContainer( true, '{' );
+}
+
+void CJsonWriter::EndObject()
+{
+	endContainer( true, '}' );
+}
+
+void CJsonWriter::StartArray()
+{
+	startContainer( false, '[' );
+}
+
+void CJsonWriter::EndArray()
+{
+	endContainer( false, ']' );
+}
+
+void CJsonWriter::WriteKey( CStringPart key )
+{
+	assert( !containers.IsEmpty() && containers.Last() && !isAfterKey );
+	if( needsSeparator ) {
+		writeChar( ',' );
+	}
+	writeEscapedString( key );
+	writeChar( ':' );
+	isAfterKey = true;
+}
+
+void CJsonWriter::WriteString( CStringPart str )
+{
+	startValue();
+	writeEscapedString( str );
+}
+
+void CJsonWriter::WriteNumber( int value )
+{
+	startValue();
+	writeText( Str( value ) );
+}
+
+void CJsonWriter::WriteNumber( double value )
+{
+	// JSON has no representation for infinities and NaNs.
+	if( !std::isfinite( value ) ) {
+		WriteNull();
+		return;
+	}
+	startValue();
+	char buffer[Decimal::MaxShortestLength];
+	const auto length = Decimal::FormatShortest( value, buffer );
+	writeText( CStringPart( buffer, length ) );
+}
+
+void CJsonWriter::WriteBool( bool value )
+{
+	startValue();
+	writeText( value ? "true" : "false" );
+}
+
+void CJsonWriter::WriteNull()
+{
+	startValue();
+	writeText( "null" );
+}
+
+void CJsonWriter::WriteValue( const CJsonValue& value )
+{
+	staticAssert( JVT_EnumCount == 6 );
+	switch( value.GetType() ) {
+		case JVT_Null:
+			WriteNull();
+			break;
+		case JVT_Number:
+			WriteNumber( static_cast<const CJsonNumber&>( value ).GetNumber() );
+			break;
+		case JVT_String:
+			WriteString( static_cast<const CJsonString&>( value ).GetString() );
+			break;
+		case JVT_Bool:
+			WriteBool( static_cast<const CJsonBool&>( value ).GetBool() );
+			break;
+		case JVT_Array:
+			writeArray( static_cast<const CJsonDynamicArray&>( value ) );
+			break;
+		case JVT_Object:
+			writeObject( static_cast<const CJsonObject&>( value ) );
+			break;
+		default:
+			assert( false );
+			break;
+	}
+}
+
+void CJsonWriter::Flush()
+{
+	if( !buffer.IsEmpty() ) {
+		file.Write( buffer.Ptr(), buffer.Size() );
+		buffer.Empty();
+	}
+}
+
+// Write the separator of a new value.
+void CJsonWriter::startValue()
+{
+	if( containers.IsEmpty() ) {
+		if( needsSeparator ) {
+			writeChar( '\n' );
+		}
+	} else if( containers.Last() ) {
+		assert( isAfterKey );
+	} else if( needsSeparator ) {
+		writeChar( ',' );
+	}
+	needsSeparator = true;
+	isAfterKey = false;
+}
+
+void CJsonWriter::startContainer( bool isObject, char bracket )
+{
+	startValue();
+	writeChar( bracket );
+	containers.Add( isObject );
+	needsSeparator = false;
+}
+
+void CJsonWriter::endContainer( bool isObject, char bracket )
+{
+	assert( !containers.IsEmpty() && containers.Last() == isObject && !isAfterKey );
+	isObject;
+	writeChar( bracket );
+	containers.DeleteLast();
+	needsSeparator = true;
+}
+
+void CJsonWriter::writeObject( const CJsonObject& obj )
+{
+	StartObject();
+	for( const auto& keyValue : obj.GetKeyValueList() ) {
+		WriteKey( keyValue.Key );
+		WriteValue( *keyValue.Value );
+	}
+	EndObject();
+}
+
+void CJsonWriter::writeArray( const CJsonDynamicArray& arr )
+{
+	StartArray();
+	for( const auto& value : arr.GetValues() ) {
+		WriteValue( *value );
+	}
+	EndArray();
+}
+
+static const char hexDigits[] = "0123456789ABCDEF";
+
+// The escaped character set is the same as in the document writer.
+// Control characters without a short escape are written as \u00XX.
+void CJsonWriter::writeEscapedString( CStringPart str )
+{
+	writeChar( '"' );
+	int copyStart = 0;
+	const auto length = str.Length();
+	for( int i = 0; i < length; i++ ) {
+		char escapeCode;
+		switch( str[i] ) {
+			case '"':
+			case '\\':
+			case '/':
+				escapeCode = str[i];
+				break;
+			case '\b':
+				escapeCode = 'b';
+				break;
+			case '\f':
+				escapeCode = 'f';
+				break;
+			case '\n':
+				escapeCode = 'n';
+				break;
+			case '\r':
+				escapeCode = 'r';
+				break;
+			case '\t':
+				escapeCode = 't';
+				break;
+			default:
+				if( static_cast<BYTE>( str[i] ) >= 0x20 ) {
+					continue;
+				}
+				escapeCode = 'u';
+				break;
+		}
+		writeText( str.Mid( copyStart, i - copyStart ) );
+		writeChar( '\\' );
+		writeChar( escapeCode );
+		if( escapeCode == 'u' ) {
+			writeText( "00" );
+			writeChar( hexDigits[static_cast<BYTE>( str[i] ) >> 4] );
+			writeChar( hexDigits[str[i] & 0xF] );
+		}
+		copyStart = i + 1;
+	}
+	writeText( str.Mid( copyStart ) );
+	writeChar( '"' );
+}
+
+void CJsonWriter::writeText( CStringPart text )
+{
+	const auto length = text.Length();
+	if( buffer.Size() + length > buffer.Capacity() ) {
+		Flush();
+		if( length > buffer.Capacity() ) {
+			// Large strings are written directly.
+			file.Write( text.begin(), length );
+			return;
+		}
+	}
+	const auto pos = buffer.Size();
+	buffer.IncreaseSizeNoInitialize( pos + length );
+	::memcpy( buffer.Ptr() + pos, text.begin(), length );
+}
+
+void CJsonWriter::writeChar( char ch )
+{
+	if( buffer.Size() == buffer.Capacity() ) {
+		Flush();
+	}
+	buffer.AddWithinCapacity( ch );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
@@ -1,52 +1,507 @@
 #include <StringAllocator.h>
+#include <Errors.h>
 
 namespace Relib {
 
+extern CCriticalSection StringAllocatorSection;
+
 //////////////////////////////////////////////////////////////////////////
 
-extern CCriticalSection StringAllocatorSection;
-template <class PoolType>
-static auto createObjectInPool( PoolType& pool )
+// Size classes are spaced so that the wasted memory is at most a third of the block.
+static constexpr int sizeClassBlockSizes[StringSizeClassCount] = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+static const int sizeClassGranularity = 16;
+static const int maxSizeClassBlockSize = 4096;
+
+// Size class for every size rounded up to the granularity.
+struct CSizeClassTable {
+	BYTE SizeClasses[maxSizeClassBlockSize / sizeClassGranularity + 1];
+};
+
+static constexpr CSizeClassTable createSizeClassTable()
 {
-	CCriticalSectionLock lock( StringAllocatorSection );
-	return pool.GetOrCreate();
+	CSizeClassTable result{};
+	int sizeClass = 0;
+	for( int i = 0; i <= maxSizeClassBlockSize / sizeClassGranularity; i++ ) {
+		while( sizeClassBlockSizes[sizeClass] < i * sizeClassGranularity ) {
+			sizeClass++;
+		}
+		result.SizeClasses[i] = static_cast<BYTE>( sizeClass );
+	}
+	return result;
+}
+
+static constexpr CSizeClassTable sizeClassTable = createSizeClassTable();
+
+static int getSizeClass( int size )
+{
+	assert( size <= maxSizeClassBlockSize );
+	return sizeClassTable.SizeClasses[( size + sizeClassGranularity - 1 ) / sizeClassGranularity];
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+// Free block in a string page.
+struct CStringFreeBlock {
+	CStringFreeBlock* Next;
+};
+
+// Page of blocks of a single size class.
+// Pages are aligned to the virtual allocation granularity, so the page of a block is found from its address.
+struct CStringPage {
+	// Heap that allocates from the page.
+	CStringThreadHeap* Owner;
+	// List of all the pages in the owner heap.
+	CStringPage* PrevInHeap;
+	CStringPage* NextInHeap;
+	// List of the pages with free blocks. Full pages are not in the list.
+	CStringPage* PrevAvailable;
+	CStringPage* NextAvailable;
+	bool IsAvailable;
+	int SizeClass;
+	int BlockSize;
+	// Number of allocated blocks. Blocks in the remote free list of the owner are considered allocated.
+	int UsedCount;
+	int BlockCount;
+	CStringFreeBlock* FreeBlocks;
+	// Start of the memory that has never been allocated.
+	BYTE* UnusedBegin;
+	BYTE* PageEnd;
+};
+
+static const int stringPageSize = 64 * 1024;
+// Empty pages that are kept for each size class, so that allocations near a page boundary do not allocate and free pages all the time.
+static const int maxEmptyStringPageCount = 1;
+static const int stringPageHeaderSize = CeilTo( static_cast<int>( sizeof( CStringPage ) ), sizeClassGranularity );
+
+// Magazines hold at most this much memory, but no less than minMagazineCapacity and no more than maxMagazineCapacity blocks.
+static const int magazineByteSize = 8 * 1024;
+static const int minMagazineCapacity = 4;
+static const int maxMagazineCapacity = 64;
+// Blocks of another heap that are freed together with a single atomic operation.
+static const int maxPendingRemoteFreeCount = 64;
+
+static constexpr int getMagazineCapacity( int sizeClass )
+{
+	return magazineByteSize / sizeClassBlockSizes[sizeClass] < minMagazineCapacity ? minMagazineCapacity
+		: magazineByteSize / sizeClassBlockSizes[sizeClass] > maxMagazineCapacity ? maxMagazineCapacity
+		: magazineByteSize / sizeClassBlockSizes[sizeClass];
 }
 
-static auto& getSmallAllocator( CStringAllocator& allocator )
+// Free blocks of a single size class cached by the thread heap.
+// Blocks in a magazine are allocated from the point of view of their pages. Allocations and frees on the owner thread only touch the magazine,
+// the pages are updated in batches when the magazine is refilled or flushed.
+struct CStringMagazine {
+	int Count = 0;
+	void* Blocks[maxMagazineCapacity];
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+// Allocator for a single thread.
+class CStringThreadHeap {
+public:
+	CStringThreadHeap() = default;
+	~CStringThreadHeap();
+
+	void* Allocate( int sizeClass );
+	// Free the block on the owner thread.
+	void Free( CStringPage* page, void* ptr );
+	// Free the block of another heap. The blocks are passed to their owner in batches.
+	void FreeRemote( CStringPage* page, void* ptr );
+	// Take the blocks that were freed on other threads.
+	void CollectRemoteFrees();
+	// Return the blocks cached in the magazines and the remote frees to the pages and pass the pending blocks to their owner.
+	// Called when the thread ends.
+	void ReleaseCachedBlocks();
+
+	void AddStatistics( CStringAllocatorStatistics& result ) const;
+
+private:
+	CStringMagazine magazines[StringSizeClassCount];
+	// First page with free blocks for each size class.
+	CStringPage* availablePages[StringSizeClassCount] = {};
+	CStringPage* firstPage = nullptr;
+	// Number of pages without allocated blocks for each size class.
+	int emptyPageCounts[StringSizeClassCount] = {};
+	// Blocks freed on other threads.
+	CAtomic<CStringFreeBlock*> remoteFreeBlocks{ nullptr };
+	// Blocks of another heap freed on this thread that are not yet passed to the owner.
+	CStringThreadHeap* pendingOwner = nullptr;
+	CStringFreeBlock* firstPendingBlock = nullptr;
+	CStringFreeBlock* lastPendingBlock = nullptr;
+	int pendingBlockCount = 0;
+
+	// Statistics are only changed by the owner thread.
+	CAtomic<__int64> liveBytes[StringSizeClassCount] = {};
+	CAtomic<__int64> cachedBytes{ 0 };
+	CAtomic<__int64> freeCount{ 0 };
+	CAtomic<__int64> remoteFreeCount{ 0 };
+
+	void pushRemoteFrees( CStringFreeBlock* first, CStringFreeBlock* last );
+	void flushPendingBlocks();
+	void refillMagazine( int sizeClass );
+	void flushMagazine( int sizeClass, int blockCount );
+	void* allocateFromPage( int sizeClass );
+	void freeToPage( CStringPage* page, void* ptr );
+	CStringPage* createPage( int sizeClass );
+	void deletePage( CStringPage* page );
+	void addAvailablePage( CStringPage* page );
+	void deleteAvailablePage( CStringPage* page );
+	static void increment( CAtomic<__int64>& value, __int64 delta );
+
+	// Copying is prohibited.
+	CStringThreadHeap( CStringThreadHeap& ) = delete;
+	void operator=( CStringThreadHeap& ) = delete;
+};
+
+//////////////////////////////////////////////////////////////////////////
+
+static CStringPage* getStringPage( void* ptr )
 {
-	thread_local auto poolRef = createObjectInPool( allocator.GetSmallPool() );
-	return poolRef.Value(); 
+	return reinterpret_cast<CStringPage*>( reinterpret_cast<UINT_PTR>( ptr ) & ~static_cast<UINT_PTR>( stringPageSize - 1 ) );
 }
 
-static auto& getMediumAllocator( CStringAllocator& allocator )
+CStringThreadHeap::~CStringThreadHeap()
 {
-	thread_local auto poolRef = createObjectInPool( allocator.GetMediumPool() );
-	return poolRef.Value();
+	while( firstPage != nullptr ) {
+		const auto next = firstPage->NextInHeap;
+		const BOOL result = ::VirtualFree( firstPage, 0, MEM_RELEASE );
+		result;
+		assert( result != 0 );
+		firstPage = next;
+	}
 }
 
-static auto& getLargeAllocator( CStringAllocator& allocator )
+void* CStringThreadHeap::Allocate( int sizeClass )
 {
-	thread_local auto poolRef = createObjectInPool( allocator.GetLargePool() );
-	return poolRef.Value();
+	auto& magazine = magazines[sizeClass];
+	if( magazine.Count == 0 ) {
+		refillMagazine( sizeClass );
+	}
+	magazine.Count--;
+	const int blockSize = sizeClassBlockSizes[sizeClass];
+	increment( liveBytes[sizeClass], blockSize );
+	increment( cachedBytes, -blockSize );
+	return magazine.Blocks[magazine.Count];
 }
 
+void CStringThreadHeap::Free( CStringPage* page, void* ptr )
+{
+	assert( page->Owner == this );
+	const int sizeClass = page->SizeClass;
+	auto& magazine = magazines[sizeClass];
+	if( magazine.Count == getMagazineCapacity( sizeClass ) ) {
+		flushMagazine( sizeClass, magazine.Count / 2 );
+	}
+	magazine.Blocks[magazine.Count] = ptr;
+	magazine.Count++;
+	increment( liveBytes[sizeClass], -page->BlockSize );
+	increment( cachedBytes, page->BlockSize );
+	increment( freeCount, 1 );
+}
+
+// Consumer threads usually free long runs of blocks from the same producer, so the runs are pushed at once.
+void CStringThreadHeap::FreeRemote( CStringPage* page, void* ptr )
+{
+	assert( page->Owner != this );
+	if( page->Owner != pendingOwner || pendingBlockCount == maxPendingRemoteFreeCount ) {
+		flushPendingBlocks();
+		pendingOwner = page->Owner;
+	}
+	auto block = static_cast<CStringFreeBlock*>( ptr );
+	block->Next = firstPendingBlock;
+	firstPendingBlock = block;
+	if( lastPendingBlock == nullptr ) {
+		lastPendingBlock = block;
+	}
+	pendingBlockCount++;
+}
+
+// Blocks freed remotely fill the magazines first, so they are reused without going through their pages.
+void CStringThreadHeap::CollectRemoteFrees()
+{
+	auto block = remoteFreeBlocks.Exchange( nullptr, std::memory_order_acquire );
+	while( block != nullptr ) {
+		const auto next = block->Next;
+		const auto page = getStringPage( block );
+		const int sizeClass = page->SizeClass;
+		increment( liveBytes[sizeClass], -page->BlockSize );
+		increment( freeCount, 1 );
+		increment( remoteFreeCount, 1 );
+		auto& magazine = magazines[sizeClass];
+		if( magazine.Count < getMagazineCapacity( sizeClass ) ) {
+			magazine.Blocks[magazine.Count] = block;
+			magazine.Count++;
+			increment( cachedBytes, page->BlockSize );
+		} else {
+			freeToPage( page, block );
+		}
+		block = next;
+	}
+}
+
+void CStringThreadHeap::ReleaseCachedBlocks()
+{
+	flushPendingBlocks();
+	CollectRemoteFrees();
+	for( int i = 0; i < StringSizeClassCount; i++ ) {
+		flushMagazine( i, magazines[i].Count );
+	}
+}
+
+void CStringThreadHeap::AddStatistics( CStringAllocatorStatistics& result ) const
+{
+	for( int i = 0; i < StringSizeClassCount; i++ ) {
+		result.LiveBytes[i] += liveBytes[i].Load( std::memory_order_relaxed );
+	}
+	result.CachedBytes += cachedBytes.Load( std::memory_order_relaxed );
+	result.FreeCount += freeCount.Load( std::memory_order_relaxed );
+	result.RemoteFreeCount += remoteFreeCount.Load( std::memory_order_relaxed );
+}
+
+void CStringThreadHeap::pushRemoteFrees( CStringFreeBlock* first, CStringFreeBlock* last )
+{
+	auto head = remoteFreeBlocks.Load( std::memory_order_relaxed );
+	do {
+		last->Next = head;
+	} while( !remoteFreeBlocks.CompareExchangeStrong( head, first, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+void CStringThreadHeap::flushPendingBlocks()
+{
+	if( pendingBlockCount == 0 ) {
+		return;
+	}
+	pendingOwner->pushRemoteFrees( firstPendingBlock, lastPendingBlock );
+	pendingOwner = nullptr;
+	firstPendingBlock = nullptr;
+	lastPendingBlock = nullptr;
+	pendingBlockCount = 0;
+}
+
+// Take the remote frees or fill half of the magazine from the pages, so that the following frees don't flush it right away.
+// The remote frees are collected first, they can also make some pages available instead of creating new ones.
+void CStringThreadHeap::refillMagazine( int sizeClass )
+{
+	auto& magazine = magazines[sizeClass];
+	assert( magazine.Count == 0 );
+	if( remoteFreeBlocks.Load( std::memory_order_relaxed ) != nullptr ) {
+		CollectRemoteFrees();
+		if( magazine.Count > 0 ) {
+			return;
+		}
+	}
+	const int refillCount = getMagazineCapacity( sizeClass ) / 2;
+	for( ; magazine.Count < refillCount; magazine.Count++ ) {
+		magazine.Blocks[magazine.Count] = allocateFromPage( sizeClass );
+	}
+	increment( cachedBytes, refillCount * sizeClassBlockSizes[sizeClass] );
+}
+
+// Return the oldest blocks of the magazine to their pages. The recently freed blocks are more likely to be in the cache.
+void CStringThreadHeap::flushMagazine( int sizeClass, int blockCount )
+{
+	auto& magazine = magazines[sizeClass];
+	assert( blockCount <= magazine.Count );
+	for( int i = 0; i < blockCount; i++ ) {
+		freeToPage( getStringPage( magazine.Blocks[i] ), magazine.Blocks[i] );
+	}
+	magazine.Count -= blockCount;
+	::memmove( magazine.Blocks, magazine.Blocks + blockCount, magazine.Count * sizeof( magazine.Blocks[0] ) );
+	increment( cachedBytes, -static_cast<__int64>( blockCount ) * sizeClassBlockSizes[sizeClass] );
+}
+
+void* CStringThreadHeap::allocateFromPage( int sizeClass )
+{
+	CStringPage* page = availablePages[sizeClass];
+	if( page == nullptr ) {
+		page = createPage( sizeClass );
+	}
+
+	if( page->UsedCount == 0 ) {
+		emptyPageCounts[sizeClass]--;
+	}
+	void* result;
+	if( page->FreeBlocks != nullptr ) {
+		result = page->FreeBlocks;
+		page->FreeBlocks = page->FreeBlocks->Next;
+	} else {
+		assert( page->UnusedBegin + page->BlockSize <= page->PageEnd );
+		result = page->UnusedBegin;
+		page->UnusedBegin += page->BlockSize;
+	}
+	page->UsedCount++;
+	if( page->UsedCount == page->BlockCount ) {
+		deleteAvailablePage( page );
+	}
+	return result;
+}
+
+void CStringThreadHeap::freeToPage( CStringPage* page, void* ptr )
+{
+	assert( page->Owner == this );
+	auto block = static_cast<CStringFreeBlock*>( ptr );
+	block->Next = page->FreeBlocks;
+	page->FreeBlocks = block;
+	page->UsedCount--;
+
+	if( !page->IsAvailable ) {
+		addAvailablePage( page );
+	}
+	if( page->UsedCount == 0 ) {
+		if( emptyPageCounts[page->SizeClass] < maxEmptyStringPageCount ) {
+			emptyPageCounts[page->SizeClass]++;
+		} else {
+			deletePage( page );
+		}
+	}
+}
+
+CStringPage* CStringThreadHeap::createPage( int sizeClass )
+{
+	// Virtual allocations are aligned to the allocation granularity of 64 KB.
+	BYTE* pageMemory = static_cast<BYTE*>( ::VirtualAlloc( 0, stringPageSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE ) );
+	checkMemoryError( pageMemory != nullptr );
+	assert( getStringPage( pageMemory ) == reinterpret_cast<CStringPage*>( pageMemory ) );
+
+	auto page = ::new( pageMemory ) CStringPage{};
+	page->Owner = this;
+	page->SizeClass = sizeClass;
+	page->BlockSize = sizeClassBlockSizes[sizeClass];
+	page->BlockCount = ( stringPageSize - stringPageHeaderSize ) / page->BlockSize;
+	page->UnusedBegin = pageMemory + stringPageHeaderSize;
+	page->PageEnd = pageMemory + stringPageSize;
+
+	page->NextInHeap = firstPage;
+	if( firstPage != nullptr ) {
+		firstPage->PrevInHeap = page;
+	}
+	firstPage = page;
+	addAvailablePage( page );
+	emptyPageCounts[sizeClass]++;
+	return page;
+}
+
+void CStringThreadHeap::deletePage( CStringPage* page )
+{
+	assert( page->UsedCount == 0 );
+	deleteAvailablePage( page );
+	if( page->PrevInHeap != nullptr ) {
+		page->PrevInHeap->NextInHeap = page->NextInHeap;
+	} else {
+		firstPage = page->NextInHeap;
+	}
+	if( page->NextInHeap != nullptr ) {
+		page->NextInHeap->PrevInHeap = page->PrevInHeap;
+	}
+	const BOOL result = ::VirtualFree( page, 0, MEM_RELEASE );
+	result;
+	assert( result != 0 );
+}
+
+void CStringThreadHeap::addAvailablePage( CStringPage* page )
+{
+	assert( !page->IsAvailable );
+	auto& firstAvailable = availablePages[page->SizeClass];
+	page->PrevAvailable = nullptr;
+	page->NextAvailable = firstAvailable;
+	if( firstAvailable != nullptr ) {
+		firstAvailable->PrevAvailable = page;
+	}
+	firstAvailable = page;
+	page->IsAvailable = true;
+}
+
+void CStringThreadHeap::deleteAvailablePage( CStringPage* page )
+{
+	assert( page->IsAvailable );
+	if( page->PrevAvailable != nullptr ) {
+		page->PrevAvailable->NextAvailable = page->NextAvailable;
+	} else {
+		availablePages[page->SizeClass] = page->NextAvailable;
+	}
+	if( page->NextAvailable != nullptr ) {
+		page->NextAvailable->PrevAvailable = page->PrevAvailable;
+	}
+	page->IsAvailable = false;
+}
+
+void CStringThreadHeap::increment( CAtomic<__int64>& value, __int64 delta )
+{
+	value.Store( value.Load( std::memory_order_relaxed ) + delta, std::memory_order_relaxed );
+}
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+// Owner of the thread heap. Returns the heap to the string allocator when the thread ends.
+class CStringAllocator::CThreadHeapHolder {
+public:
+	explicit CThreadHeapHolder( CStringAllocator& _allocator ) : allocator( _allocator ), heap( _allocator.acquireThreadHeap() ) {}
+	~CThreadHeapHolder()
+		{ allocator.releaseThreadHeap( heap ); }
+
+	RelibInternal::CStringThreadHeap& GetHeap()
+		{ return heap; }
+
+private:
+	CStringAllocator& allocator;
+	RelibInternal::CStringThreadHeap& heap;
+};
+
 //////////////////////////////////////////////////////////////////////////
 
-CStringAllocator::CStringAllocator() 
+CStringAllocator::CStringAllocator()
 {
 	heapManager.Create( 0 );
 	heapManager.SetLowFragmentation( true );
 }
 
+CStringAllocator::~CStringAllocator()
+{
+}
+
+int CStringAllocator::GetSizeClassBlockSize( int sizeClass )
+{
+	assert( sizeClass >= 0 && sizeClass < StringSizeClassCount );
+	return sizeClassBlockSizes[sizeClass];
+}
+
+RelibInternal::CStringThreadHeap& CStringAllocator::getThreadHeap()
+{
+	thread_local CThreadHeapHolder holder( *this );
+	return holder.GetHeap();
+}
+
+RelibInternal::CStringThreadHeap& CStringAllocator::acquireThreadHeap()
+{
+	CCriticalSectionLock lock( StringAllocatorSection );
+	if( freeThreadHeaps.IsEmpty() ) {
+		threadHeaps.Add( CreateOwner<RelibInternal::CStringThreadHeap>() );
+		return *threadHeaps.Last();
+	}
+	auto& result = *freeThreadHeaps.Last();
+	freeThreadHeaps.DeleteLast();
+	return result;
+}
+
+void CStringAllocator::releaseThreadHeap( RelibInternal::CStringThreadHeap& heap )
+{
+	heap.ReleaseCachedBlocks();
+	CCriticalSectionLock lock( StringAllocatorSection );
+	freeThreadHeaps.Add( &heap );
+}
+
 CRawBuffer CStringAllocator::AllocateSized( int realSize )
 {
-	if( realSize <= smallBlockSize ) {
-		return getSmallAllocator( *this ).AllocateSized( smallBlockSize );
-	} else if( realSize <= mediumBlockSize ) {
-		return getMediumAllocator( *this ).AllocateSized( mediumBlockSize );
-	} else if( realSize <= largeBlockSize ) {
-		return getLargeAllocator( *this ).AllocateSized( largeBlockSize );
+	if( realSize <= maxSizeClassBlockSize ) {
+		const int sizeClass = getSizeClass( realSize );
+		return { getThreadHeap().Allocate( sizeClass ), sizeClassBlockSizes[sizeClass] };
 	} else {
+		largeLiveBytes.FetchAdd( realSize, std::memory_order_relaxed );
 		return heapManager.AllocateSized( realSize );
 	}
 }
@@ -55,13 +510,19 @@ void CStringAllocator::Free( CRawBuffer buffer )
 {
 	const int allocatedSize = buffer.Size();
 	void* ptr = buffer.Ptr();
-	if( allocatedSize <= smallBlockSize ) {
-		getSmallAllocator( *this ).Free( ptr );
-	} else if( allocatedSize <= mediumBlockSize ) {
-		getMediumAllocator( *this ).Free( ptr );
-	} else if( allocatedSize <= largeBlockSize ) {
-		getLargeAllocator( *this ).Free( ptr );
+	if( allocatedSize <= maxSizeClassBlockSize ) {
+		if( ptr == nullptr ) {
+			return;
+		}
+		const auto page = RelibInternal::getStringPage( ptr );
+		auto& heap = getThreadHeap();
+		if( page->Owner == &heap ) {
+			heap.Free( page, ptr );
+		} else {
+			heap.FreeRemote( page, ptr );
+		}
 	} else {
+		largeLiveBytes.FetchAdd( -allocatedSize, std::memory_order_relaxed );
 		heapManager.Free( ptr );
 	}
 }
@@ -69,18 +530,26 @@ void CStringAllocator::Free( CRawBuffer buffer )
 #ifdef _DEBUG
 CRawBuffer CStringAllocator::AllocateSized( int realSize, const char* fileName, int line )
 {
-	if( realSize <= smallBlockSize ) {
-		return getSmallAllocator( *this ).AllocateSized( smallBlockSize, fileName, line );
-	} else if( realSize <= mediumBlockSize ) {
-		return getMediumAllocator( *this ).AllocateSized( mediumBlockSize, fileName, line );
-	} else if( realSize <= largeBlockSize ) {
-		return getLargeAllocator( *this ).AllocateSized( largeBlockSize, fileName, line );
+	if( realSize <= maxSizeClassBlockSize ) {
+		return AllocateSized( realSize );
 	} else {
+		largeLiveBytes.FetchAdd( realSize, std::memory_order_relaxed );
 		return heapManager.AllocateSized( realSize, fileName, line );
 	}
 }
 #endif
 
+CStringAllocatorStatistics CStringAllocator::GetStatistics() const
+{
+	CStringAllocatorStatistics result;
+	CCriticalSectionLock lock( StringAllocatorSection );
+	for( const auto& heap : threadHeaps ) {
+		heap->AddStatistics( result );
+	}
+	result.LargeLiveBytes = largeLiveBytes.Load( std::memory_order_relaxed );
+	return result;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 extern REAPI CStringAllocator StringAllocator;
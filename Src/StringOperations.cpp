@@ -6,6 +6,7 @@
 #include <UnicodeSet.h>
 #include <BaseString.h>
 #include <StrConversions.h>
+#include <UnicodeUtils.h>
 #include <mbstring.h>
 
 namespace Relib {
@@ -37,13 +38,144 @@ int CStringOperations<char>::CompareNoCase( CStringData<char> left, CStringData<
 	}
 }
 
+// Byte strings are searched in blocks of 16 symbols. Blocks never cross the string bounds, remaining symbols are checked one by one.
+static const int searchBlockSize = 16;
+
+static __m128i loadSearchBlock( const char* ptr )
+{
+	return _mm_loadu_si128( reinterpret_cast<const __m128i*>( ptr ) );
+}
+
+static unsigned matchSearchBlock( __m128i block, __m128i symbol )
+{
+	return _mm_movemask_epi8( _mm_cmpeq_epi8( block, symbol ) );
+}
+
+static int findLowestBit( unsigned mask )
+{
+	assert( mask != 0 );
+	DWORD result;
+	_BitScanForward( &result, mask );
+	return result;
+}
+
+int CStringOperations<char>::Find( CStringData<char> data, char symbol, int from )
+{
+	const int length = data.Length();
+	assert( from >= 0 && from <= length );
+	const char* buffer = data.begin();
+	const __m128i symbolBlock = _mm_set1_epi8( symbol );
+
+	int pos = from;
+	for( ; pos + searchBlockSize <= length; pos += searchBlockSize ) {
+		const unsigned mask = matchSearchBlock( loadSearchBlock( buffer + pos ), symbolBlock );
+		if( mask != 0 ) {
+			return pos + findLowestBit( mask );
+		}
+	}
+	for( ; pos < length; pos++ ) {
+		if( buffer[pos] == symbol ) {
+			return pos;
+		}
+	}
+	return NotFound;
+}
+
 int CStringOperations<char>::Find( CStringData<char> data, CStringData<char> substring, int from )
 {
+	const int length = data.Length();
+	assert( from >= 0 && from <= length );
+	const int substrLength = substring.Length();
+	if( substrLength <= 1 ) {
+		return substrLength == 0 ? from : Find( data, substring.First(), from );
+	}
+
 	const char* buffer = data.begin();
-	assert( from >= 0 && from <= data.Length() );
+	const char* substrBuffer = substring.begin();
+	const int lastSymbolOffset = substrLength - 1;
+	const int lastStartPos = length - substrLength;
+	const __m128i firstSymbol = _mm_set1_epi8( substrBuffer[0] );
+	const __m128i lastSymbol = _mm_set1_epi8( substrBuffer[lastSymbolOffset] );
+
+	// Positions that match the first and the last symbol of the substring are found for the whole block, the middle part is compared for these positions only.
+	int pos = from;
+	for( ; pos + searchBlockSize - 1 <= lastStartPos; pos += searchBlockSize ) {
+		const unsigned firstMask = matchSearchBlock( loadSearchBlock( buffer + pos ), firstSymbol );
+		unsigned mask = firstMask & matchSearchBlock( loadSearchBlock( buffer + pos + lastSymbolOffset ), lastSymbol );
+		for( ; mask != 0; mask &= mask - 1 ) {
+			const int startPos = pos + findLowestBit( mask );
+			if( ::memcmp( buffer + startPos + 1, substrBuffer + 1, substrLength - 2 ) == 0 ) {
+				return startPos;
+			}
+		}
+	}
+	for( ; pos <= lastStartPos; pos++ ) {
+		if( buffer[pos] == substrBuffer[0] && ::memcmp( buffer + pos + 1, substrBuffer + 1, lastSymbolOffset ) == 0 ) {
+			return pos;
+		}
+	}
+	return NotFound;
+}
+
+static int toLowerCase( char symbol )
+{
+	return ::tolower( static_cast<unsigned char>( symbol ) );
+}
+
+static bool equalsNoCase( const char* left, const char* right, int length )
+{
+	for( int i = 0; i < length; i++ ) {
+		if( toLowerCase( left[i] ) != toLowerCase( right[i] ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Get the mask of the block symbols that match the given symbol in any case.
+static unsigned matchSearchBlockNoCase( __m128i block, __m128i lowerSymbol, __m128i upperSymbol )
+{
+	return _mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( block, lowerSymbol ), _mm_cmpeq_epi8( block, upperSymbol ) ) );
+}
+
+int CStringOperations<char>::FindNoCase( CStringData<char> data, CStringData<char> substring, int from )
+{
+	const int length = data.Length();
+	assert( from >= 0 && from <= length );
+	const int substrLength = substring.Length();
+	if( substrLength == 0 ) {
+		return from < length ? from : NotFound;
+	}
 
-	const char* findResult = ::strstr( buffer + from, substring.begin() );
-	return findResult != nullptr ? numeric_cast<int>( findResult - buffer ) : NotFound;
+	const char* buffer = data.begin();
+	const char* substrBuffer = substring.begin();
+	const int lastSymbolOffset = substrLength - 1;
+	const int lastStartPos = length - substrLength;
+	const int firstLower = toLowerCase( substrBuffer[0] );
+	const int lastLower = toLowerCase( substrBuffer[lastSymbolOffset] );
+	const __m128i firstLowerSymbol = _mm_set1_epi8( static_cast<char>( firstLower ) );
+	const __m128i firstUpperSymbol = _mm_set1_epi8( static_cast<char>( ::toupper( firstLower ) ) );
+	const __m128i lastLowerSymbol = _mm_set1_epi8( static_cast<char>( lastLower ) );
+	const __m128i lastUpperSymbol = _mm_set1_epi8( static_cast<char>( ::toupper( lastLower ) ) );
+
+	// Same filtering as in the case sensitive search. Each symbol is compared with its lower and upper case variants.
+	int pos = from;
+	for( ; pos + searchBlockSize - 1 <= lastStartPos; pos += searchBlockSize ) {
+		const unsigned firstMask = matchSearchBlockNoCase( loadSearchBlock( buffer + pos ), firstLowerSymbol, firstUpperSymbol );
+		unsigned mask = firstMask & matchSearchBlockNoCase( loadSearchBlock( buffer + pos + lastSymbolOffset ), lastLowerSymbol, lastUpperSymbol );
+		for( ; mask != 0; mask &= mask - 1 ) {
+			const int startPos = pos + findLowestBit( mask );
+			if( equalsNoCase( buffer + startPos, substrBuffer, substrLength ) ) {
+				return startPos;
+			}
+		}
+	}
+	for( ; pos <= lastStartPos; pos++ ) {
+		if( toLowerCase( buffer[pos] ) == firstLower && equalsNoCase( buffer + pos, substrBuffer, substrLength ) ) {
+			return pos;
+		}
+	}
+	return NotFound;
 }
 
 void CStringOperations<char>::MakeUpper( char* buffer, int length )
@@ -77,6 +209,14 @@ void CStringOperations<char>::doConvertStr( CStringData<wchar_t> convertData, un
 	const int length = convertData.Length();
 	const wchar_t* buffer = convertData.begin();
 
+	if( codePage == CP_UTF8 ) {
+		// UTF8 conversion doesn't depend on the system, invalid surrogates are replaced like in WideCharToMultiByte.
+		const int resultLength = Unicode::GetUtf8Length( buffer, length );
+		auto resultBuffer = result.CreateRawBuffer( resultLength );
+		Unicode::ConvertUtf16ToUtf8( buffer, length, resultBuffer );
+		resultBuffer.Release( resultLength );
+		return;
+	}
 	if( codePage == CP_ACP ) {
 		codePage = ::GetACP();
 	} else if( codePage == CP_OEMCP ) {
@@ -157,6 +297,13 @@ void CStringOperations<wchar_t>::ConvertStr( CStringData<char> convertData, unsi
 	const char* buffer = convertData.begin();
 	assert( length >= 0 );
 
+	if( codePage == CP_UTF8 ) {
+		// UTF8 conversion doesn't depend on the system, invalid sequences are replaced like in MultiByteToWideChar.
+		auto resultBuffer = result.CreateRawBuffer( Unicode::GetMaxUtf16Length( length ) );
+		const int resultLength = Unicode::ConvertUtf8ToUtf16( buffer, length, resultBuffer );
+		resultBuffer.Release( resultLength );
+		return;
+	}
 	const DWORD flags = convertCodePageToFlags( codePage );
 	const int requiredLength = ::MultiByteToWideChar( codePage, flags, buffer, length, 0, 0 );
 	if( requiredLength >= 0 ) {
@@ -0,0 +1,205 @@
+#include <TaskScheduler.h>
+#include <WorkStealingDeque.h>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Relib {
+
+namespace RelibInternal {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Worker index of the threads outside the scheduler.
+static const int notWorkerIndex = -1;
+
+// Worker thread with its own task deque.
+class CSchedulerWorker {
+public:
+	CWorkStealingDeque<ISchedulerTask> Tasks;
+	std::thread Thread;
+};
+
+// Scheduler state. Workers sleep on standard library synchronization primitives.
+class CTaskSchedulerData {
+public:
+	std::vector<std::unique_ptr<CSchedulerWorker>> Workers;
+	CTaskScheduler::TExceptionHandler ExceptionHandler = nullptr;
+
+	// Queue of the tasks added from outside the scheduler.
+	std::mutex QueueMutex;
+	std::deque<ISchedulerTask*> SharedQueue;
+
+	// Number of the added tasks that are not taken by a worker yet.
+	std::atomic<int> PendingTaskCount{ 0 };
+	// Number of the workers that are sleeping or about to sleep.
+	std::atomic<int> SleepingWorkerCount{ 0 };
+	std::mutex SleepMutex;
+	std::condition_variable WakeCondition;
+	// Guarded by SleepMutex.
+	bool IsStopping = false;
+};
+
+// Scheduler and worker index of the current thread.
+static thread_local CTaskSchedulerData* currentScheduler = nullptr;
+static thread_local int currentWorkerIndex = notWorkerIndex;
+
+static void runTask( CTaskSchedulerData& scheduler, ISchedulerTask* task )
+{
+	// Exceptions must not leave the worker. Tasks that need to report errors deliver them through their own state.
+	try {
+		task->Run();
+	} catch( ... ) {
+		if( scheduler.ExceptionHandler != nullptr ) {
+			scheduler.ExceptionHandler();
+		}
+	}
+	delete task;
+}
+
+static ISchedulerTask* popSharedTask( CTaskSchedulerData& scheduler )
+{
+	std::lock_guard<std::mutex> lock( scheduler.QueueMutex );
+	if( scheduler.SharedQueue.empty() ) {
+		return nullptr;
+	}
+	ISchedulerTask* result = scheduler.SharedQueue.front();
+	scheduler.SharedQueue.pop_front();
+	return result;
+}
+
+// Find a task for the given worker. Worker index is notWorkerIndex for the threads outside the scheduler.
+// Own deque is checked first, then the shared queue, then the tasks are stolen from the other workers.
+static ISchedulerTask* takeTask( CTaskSchedulerData& scheduler, int workerIndex )
+{
+	ISchedulerTask* result = nullptr;
+	if( workerIndex != notWorkerIndex ) {
+		result = scheduler.Workers[workerIndex]->Tasks.Pop();
+	}
+	if( result == nullptr ) {
+		result = popSharedTask( scheduler );
+	}
+	const int workerCount = static_cast<int>( scheduler.Workers.size() );
+	const int firstVictim = workerIndex == notWorkerIndex ? 0 : workerIndex + 1;
+	for( int i = 0; i < workerCount && result == nullptr; i++ ) {
+		const int victim = ( firstVictim + i ) % workerCount;
+		if( victim != workerIndex ) {
+			result = scheduler.Workers[victim]->Tasks.Steal();
+		}
+	}
+
+	if( result != nullptr ) {
+		scheduler.PendingTaskCount--;
+	}
+	return result;
+}
+
+static void workerThreadProc( CTaskSchedulerData* scheduler, int workerIndex )
+{
+	currentScheduler = scheduler;
+	currentWorkerIndex = workerIndex;
+	for( ;; ) {
+		ISchedulerTask* task = takeTask( *scheduler, workerIndex );
+		if( task != nullptr ) {
+			runTask( *scheduler, task );
+			continue;
+		}
+		if( scheduler->PendingTaskCount.load() > 0 ) {
+			// A task is being pushed or another thread has won the race for it.
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock( scheduler->SleepMutex );
+		// The sleeping count is increased before checking for the tasks, so the adding thread either sees the sleeper or the sleeper sees the task.
+		scheduler->SleepingWorkerCount++;
+		while( scheduler->PendingTaskCount.load() <= 0 && !scheduler->IsStopping ) {
+			scheduler->WakeCondition.wait( lock );
+		}
+		scheduler->SleepingWorkerCount--;
+		if( scheduler->IsStopping && scheduler->PendingTaskCount.load() <= 0 ) {
+			break;
+		}
+	}
+	currentScheduler = nullptr;
+	currentWorkerIndex = notWorkerIndex;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CTaskScheduler::CTaskScheduler( int threadCount, TExceptionHandler exceptionHandler ) :
+	data( new CTaskSchedulerData )
+{
+	data->ExceptionHandler = exceptionHandler;
+	// All the deques must exist before the workers start stealing.
+	for( int i = 0; i < threadCount; i++ ) {
+		data->Workers.push_back( std::unique_ptr<CSchedulerWorker>( new CSchedulerWorker ) );
+	}
+	for( int i = 0; i < threadCount; i++ ) {
+		data->Workers[i]->Thread = std::thread( workerThreadProc, data, i );
+	}
+}
+
+CTaskScheduler::~CTaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock( data->SleepMutex );
+		data->IsStopping = true;
+	}
+	data->WakeCondition.notify_all();
+	for( auto& worker : data->Workers ) {
+		worker->Thread.join();
+	}
+	delete data;
+}
+
+int CTaskScheduler::ThreadCount() const
+{
+	return static_cast<int>( data->Workers.size() );
+}
+
+void CTaskScheduler::AddTask( ISchedulerTask* task )
+{
+	data->PendingTaskCount++;
+	if( currentScheduler == data ) {
+		data->Workers[currentWorkerIndex]->Tasks.Push( task );
+	} else {
+		std::lock_guard<std::mutex> lock( data->QueueMutex );
+		data->SharedQueue.push_back( task );
+	}
+
+	if( data->SleepingWorkerCount.load() > 0 ) {
+		std::lock_guard<std::mutex> lock( data->SleepMutex );
+		data->WakeCondition.notify_one();
+	}
+}
+
+bool CTaskScheduler::RunPendingTask()
+{
+	const int workerIndex = currentScheduler == data ? currentWorkerIndex : notWorkerIndex;
+	ISchedulerTask* task = takeTask( *data, workerIndex );
+	if( task == nullptr ) {
+		return false;
+	}
+	runTask( *data, task );
+	return true;
+}
+
+void CTaskScheduler::WaitFor( const std::atomic<int>& counter, int targetValue )
+{
+	while( counter.load() < targetValue ) {
+		if( !RunPendingTask() ) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibInternal.
+
+}	// namespace Relib.
+
@@ -0,0 +1,60 @@
+#include <ThreadPool.h>
+#include <Errors.h>
+#include <MessageLog.h>
+#include <Reutils.h>
+#include <thread>
+
+namespace Relib {
+
+//////////////////////////////////////////////////////////////////////////
+
+// Exception handler of the pool tasks.
+// Actions that need to report errors deliver them through futures, everything else is logged.
+static void logTaskException()
+{
+	try {
+		throw;
+	} catch( const CException& e ) {
+		Log::CriticalException( e );
+	} catch( const std::exception& e ) {
+		Log::Error( "Unhandled exception in a thread pool task:", e.what() );
+	} catch( ... ) {
+		Log::Error( "Unhandled unknown exception in a thread pool task." );
+	}
+}
+
+static int getPoolThreadCount( int threadCount )
+{
+	return threadCount > 0 ? threadCount : GetProcessorCount();
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CThreadPool::CThreadPool( int threadCount ) :
+	scheduler( getPoolThreadCount( threadCount ), logTaskException )
+{
+	assert( scheduler.ThreadCount() > 0 );
+}
+
+CThreadPool::~CThreadPool()
+{
+}
+
+int CThreadPool::ThreadCount() const
+{
+	return scheduler.ThreadCount();
+}
+
+void CThreadPool::WaitFor( const CAtomic<int>& counter, int targetValue )
+{
+	while( counter.Load() < targetValue ) {
+		if( !scheduler.RunPendingTask() ) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace Relib.
+
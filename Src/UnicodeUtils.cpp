@@ -48,57 +48,83 @@ bool TryConvertUtf16ToUtf32( wchar_t hiCh, wchar_t loCh, unsigned& result )
 //////////////////////////////////////////////////////////////////////////
 
 const unsigned char utf8OneByteMask = 0x80;
-const unsigned char utf8TwoBytesMask = 0xE0;
-const unsigned char utf8ThreeBytesMask = 0xF0;
-const unsigned char utf8FourBytesMask = 0xF8;
-
 const unsigned char utf8TwoBytesMarker = 0xC0;
 const unsigned char utf8ThreeBytesMarker = 0xE0;
 const unsigned char utf8FourBytesMarker = 0xF0;
-static int getUtf8ByteCount( unsigned char firstByte, int length )
+const int utf8ContinuationInvMask = 0x3f;
+
+// Ranges of the first byte and the second byte of valid sequences.
+const unsigned utf8TwoBytesFirst = 0xC2;
+const unsigned utf8ThreeBytesFirst = 0xE0;
+const unsigned utf8FourBytesFirst = 0xF0;
+const unsigned utf8FourBytesLast = 0xF4;
+const unsigned utf8ContinuationFirst = 0x80;
+const unsigned utf8ContinuationLast = 0xBF;
+
+// Decode the first char of the sequence.
+// Return the number of bytes used or a negative length of the maximal invalid subpart.
+static int decodeUtf8( const BYTE* str, int length, unsigned& result )
 {
-	if( ( firstByte & utf8OneByteMask ) == 0 ) {
+	const unsigned firstByte = str[0];
+	if( firstByte < utf8OneByteMask ) {
+		result = firstByte;
 		return 1;
-	} else if( ( firstByte & utf8TwoBytesMask ) == utf8TwoBytesMarker ) {
-		return length >= 2 ? 2 : 0;
-	} else if( ( firstByte & utf8ThreeBytesMask ) == utf8ThreeBytesMarker ) {
-		return length >= 3 ? 3 : 0;
-	} else if( ( firstByte & utf8FourBytesMask ) == utf8FourBytesMarker ) {
-		return length >= 4 ? 4 : 0;
+	}
+
+	int byteCount;
+	unsigned secondFirst = utf8ContinuationFirst;
+	unsigned secondLast = utf8ContinuationLast;
+	if( firstByte < utf8TwoBytesFirst ) {
+		return -1;
+	} else if( firstByte < utf8ThreeBytesFirst ) {
+		byteCount = 2;
+		result = firstByte & 0x1F;
+	} else if( firstByte < utf8FourBytesFirst ) {
+		byteCount = 3;
+		result = firstByte & 0x0F;
+		// Overlong encodings and surrogates are excluded.
+		if( firstByte == 0xE0 ) {
+			secondFirst = 0xA0;
+		} else if( firstByte == 0xED ) {
+			secondLast = 0x9F;
+		}
+	} else if( firstByte <= utf8FourBytesLast ) {
+		byteCount = 4;
+		result = firstByte & 0x07;
+		// Overlong encodings and codes above U+10FFFF are excluded.
+		if( firstByte == 0xF0 ) {
+			secondFirst = 0x90;
+		} else if( firstByte == utf8FourBytesLast ) {
+			secondLast = 0x8F;
+		}
 	} else {
-		return 0;
+		return -1;
 	}
-}
 
+	for( int i = 1; i < byteCount; i++ ) {
+		if( i >= length ) {
+			return -i;
+		}
+		const unsigned nextByte = str[i];
+		if( nextByte < secondFirst || nextByte > secondLast ) {
+			return -i;
+		}
+		result = ( result << 6 ) | ( nextByte & utf8ContinuationInvMask );
+		secondFirst = utf8ContinuationFirst;
+		secondLast = utf8ContinuationLast;
+	}
+	return byteCount;
+}
 
-const int utf8ContinuationInvMask = 0x3f;
 int TryConvertUtf8ToUtf32( const char* str, int length, unsigned& result )
 {
-	const auto byteCount = getUtf8ByteCount( static_cast<unsigned char>( str[0] ), length );
-
-	switch( byteCount ) {
-		case 1:
-			result = static_cast<unsigned char>( str[0] );
-			return 1;
-		case 2:
-			result = ( static_cast<unsigned char>( str[0] ) & ~utf8TwoBytesMask ) << 6 
-				| ( static_cast<unsigned char>( str[1] ) & utf8ContinuationInvMask );
-			return 2;
-		case 3:
-			result = ( static_cast<unsigned char>( str[0] ) & ~utf8ThreeBytesMask ) << 12 
-				| ( static_cast<unsigned char>( str[1] ) & utf8ContinuationInvMask ) << 6
-				| ( static_cast<unsigned char>( str[2] ) & utf8ContinuationInvMask );
-			return 3;
-		case 4:
-			result = ( static_cast<unsigned char>( str[0] ) & ~utf8FourBytesMask ) << 18
-				| ( static_cast<unsigned char>( str[1] ) & utf8ContinuationInvMask ) << 12
-				| ( static_cast<unsigned char>( str[2] ) & utf8ContinuationInvMask ) << 6
-				| ( static_cast<unsigned char>( str[3] ) & utf8ContinuationInvMask );
-			return 4;
-		default:
-			result = 0;
-			return 0;
+	assert( length > 0 );
+	const int byteCount = decodeUtf8( reinterpret_cast<const BYTE*>( str ), length, result );
+	if( byteCount < 0 ) {
+		result = 0;
+		return 0;
 	}
+	return byteCount;
 }
 
 const int utf32OneByteValueSize = 0x80;
@@ -129,6 +155,245 @@ int TryConvertUtf32ToUtf8( int utf32, char* result )
 
 //////////////////////////////////////////////////////////////////////////
 
+extern const wchar_t Utf16ReplacementChar = 0xFFFD;
+
+// ASCII text is processed in blocks of 16 symbols.
+static const int asciiBlockSize = 16;
+static const int utf16BlockSize = asciiBlockSize / 2;
+
+// Find the mask of non-ASCII bytes in the block.
+static unsigned findUtf8NonAsciiMask( const BYTE* str )
+{
+	return _mm_movemask_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( str ) ) );
+}
+
+static int findLowestBit( unsigned mask )
+{
+	assert( mask != 0 );
+	DWORD result;
+	_BitScanForward( &result, mask );
+	return result;
+}
+
+bool IsValidUtf8( const char* str, int length )
+{
+	const BYTE* bytes = reinterpret_cast<const BYTE*>( str );
+	int pos = 0;
+	while( pos < length ) {
+		if( pos + asciiBlockSize <= length ) {
+			const unsigned nonAsciiMask = findUtf8NonAsciiMask( bytes + pos );
+			if( nonAsciiMask == 0 ) {
+				pos += asciiBlockSize;
+				continue;
+			}
+			pos += findLowestBit( nonAsciiMask );
+		}
+		do {
+			unsigned code;
+			const int byteCount = decodeUtf8( bytes + pos, length - pos, code );
+			if( byteCount < 0 ) {
+				return false;
+			}
+			pos += byteCount;
+		} while( pos < length && bytes[pos] >= utf8OneByteMask );
+	}
+	return true;
+}
+
+// Write the code in UTF16. Return the number of written symbols.
+static int writeUtf16( unsigned code, wchar_t* result )
+{
+	if( code < utf16HalfBase ) {
+		result[0] = static_cast<wchar_t>( code );
+		return 1;
+	}
+	const unsigned pairCode = code - utf16HalfBase;
+	result[0] = static_cast<wchar_t>( Utf16SurrogateHiFirst + ( pairCode >> utf16HalfShift ) );
+	result[1] = static_cast<wchar_t>( Utf16SurrogateLoFirst + ( pairCode & ( ( 1 << utf16HalfShift ) - 1 ) ) );
+	return 2;
+}
+
+// Convert UTF8 to UTF16. Every byte produces at most one symbol, so the result never outruns the source.
+// ASCII blocks are widened and written entirely, the symbols after the first non-ASCII byte are overwritten later.
+static int convertUtf8ToUtf16( const BYTE* str, int length, wchar_t* result, bool replaceInvalid )
+{
+	staticAssert( sizeof( wchar_t ) == 2 );
+	const __m128i zero = _mm_setzero_si128();
+	int srcPos = 0;
+	int destPos = 0;
+	while( srcPos < length ) {
+		if( srcPos + asciiBlockSize <= length ) {
+			const __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( str + srcPos ) );
+			__m128i* dest = reinterpret_cast<__m128i*>( result + destPos );
+			_mm_storeu_si128( dest, _mm_unpacklo_epi8( block, zero ) );
+			_mm_storeu_si128( dest + 1, _mm_unpackhi_epi8( block, zero ) );
+			const unsigned nonAsciiMask = _mm_movemask_epi8( block );
+			if( nonAsciiMask == 0 ) {
+				srcPos += asciiBlockSize;
+				destPos += asciiBlockSize;
+				continue;
+			}
+			const int asciiCount = findLowestBit( nonAsciiMask );
+			srcPos += asciiCount;
+			destPos += asciiCount;
+		}
+
+		// Non-ASCII symbols usually come in runs, the block conversion is retried after the run.
+		do {
+			unsigned code;
+			const int byteCount = decodeUtf8( str + srcPos, length - srcPos, code );
+			if( byteCount > 0 ) {
+				srcPos += byteCount;
+				destPos += writeUtf16( code, result + destPos );
+			} else if( replaceInvalid ) {
+				srcPos -= byteCount;
+				result[destPos++] = Utf16ReplacementChar;
+			} else {
+				return NotFound;
+			}
+		} while( srcPos < length && str[srcPos] >= utf8OneByteMask );
+	}
+	return destPos;
+}
+
+int TryConvertUtf8ToUtf16( const char* str, int length, wchar_t* result )
+{
+	return convertUtf8ToUtf16( reinterpret_cast<const BYTE*>( str ), length, result, false );
+}
+
+int ConvertUtf8ToUtf16( const char* str, int length, wchar_t* result )
+{
+	return convertUtf8ToUtf16( reinterpret_cast<const BYTE*>( str ), length, result, true );
+}
+
+// Find the mask of ASCII symbols in the block of 16 UTF16 symbols.
+static unsigned findUtf16AsciiMask( __m128i firstHalf, __m128i secondHalf )
+{
+	const __m128i nonAsciiBits = _mm_set1_epi16( static_cast<short>( 0xFF80 ) );
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i firstAscii = _mm_cmpeq_epi16( _mm_and_si128( firstHalf, nonAsciiBits ), zero );
+	const __m128i secondAscii = _mm_cmpeq_epi16( _mm_and_si128( secondHalf, nonAsciiBits ), zero );
+	return _mm_movemask_epi8( _mm_packs_epi16( firstAscii, secondAscii ) );
+}
+
+static __m128i loadUtf16Half( const wchar_t* str )
+{
+	return _mm_loadu_si128( reinterpret_cast<const __m128i*>( str ) );
+}
+
+// Find the length of the next non-ASCII symbol in UTF8 and the number of UTF16 symbols it takes.
+// Zero length is returned for an unpaired surrogate.
+static int measureUtf16Char( const wchar_t* str, int length, int& charLength )
+{
+	const unsigned code = str[0];
+	charLength = 1;
+	if( code < utf32TwoBytesValueSize ) {
+		return code < utf32OneByteValueSize ? 1 : 2;
+	}
+	if( !IsSurrogate( str[0] ) ) {
+		return 3;
+	}
+	if( IsSurrogateHi( str[0] ) && length > 1 && IsSurrogateLo( str[1] ) ) {
+		charLength = 2;
+		return 4;
+	}
+	return 0;
+}
+
+bool IsValidUtf16( const wchar_t* str, int length )
+{
+	for( int pos = 0; pos < length; ) {
+		int charLength;
+		if( measureUtf16Char( str + pos, length - pos, charLength ) == 0 ) {
+			return false;
+		}
+		pos += charLength;
+	}
+	return true;
+}
+
+static const int utf8ReplacementCharLength = 3;
+int GetUtf8Length( const wchar_t* str, int length )
+{
+	int pos = 0;
+	int result = 0;
+	while( pos < length ) {
+		if( pos + asciiBlockSize <= length ) {
+			const unsigned asciiMask = findUtf16AsciiMask( loadUtf16Half( str + pos ), loadUtf16Half( str + pos + utf16BlockSize ) );
+			if( asciiMask == 0xFFFF ) {
+				pos += asciiBlockSize;
+				result += asciiBlockSize;
+				continue;
+			}
+			const int asciiCount = findLowestBit( ~asciiMask );
+			pos += asciiCount;
+			result += asciiCount;
+		}
+		do {
+			int charLength;
+			const int byteCount = measureUtf16Char( str + pos, length - pos, charLength );
+			result += byteCount == 0 ? utf8ReplacementCharLength : byteCount;
+			pos += charLength;
+		} while( pos < length && str[pos] >= utf32OneByteValueSize );
+	}
+	return result;
+}
+
+// Convert UTF16 to UTF8. Every symbol produces at least one byte, so the result never outruns the source.
+// ASCII blocks are narrowed and written entirely, the bytes after the first non-ASCII symbol are overwritten later.
+static int convertUtf16ToUtf8( const wchar_t* str, int length, char* result, bool replaceInvalid )
+{
+	staticAssert( sizeof( wchar_t ) == 2 );
+	int srcPos = 0;
+	int destPos = 0;
+	while( srcPos < length ) {
+		if( srcPos + asciiBlockSize <= length ) {
+			const __m128i firstHalf = loadUtf16Half( str + srcPos );
+			const __m128i secondHalf = loadUtf16Half( str + srcPos + utf16BlockSize );
+			_mm_storeu_si128( reinterpret_cast<__m128i*>( result + destPos ), _mm_packus_epi16( firstHalf, secondHalf ) );
+			const unsigned asciiMask = findUtf16AsciiMask( firstHalf, secondHalf );
+			if( asciiMask == 0xFFFF ) {
+				srcPos += asciiBlockSize;
+				destPos += asciiBlockSize;
+				continue;
+			}
+			const int asciiCount = findLowestBit( ~asciiMask );
+			srcPos += asciiCount;
+			destPos += asciiCount;
+		}
+
+		do {
+			int charLength;
+			const int byteCount = measureUtf16Char( str + srcPos, length - srcPos, charLength );
+			unsigned code;
+			if( byteCount == 4 ) {
+				TryConvertUtf16ToUtf32( str[srcPos], str[srcPos + 1], code );
+			} else if( byteCount > 0 ) {
+				code = str[srcPos];
+			} else if( replaceInvalid ) {
+				code = Utf16ReplacementChar;
+			} else {
+				return NotFound;
+			}
+			srcPos += charLength;
+			destPos += TryConvertUtf32ToUtf8( code, result + destPos );
+		} while( srcPos < length && str[srcPos] >= utf32OneByteValueSize );
+	}
+	return destPos;
+}
+
+int TryConvertUtf16ToUtf8( const wchar_t* str, int length, char* result )
+{
+	return convertUtf16ToUtf8( str, length, result, false );
+}
+
+int ConvertUtf16ToUtf8( const wchar_t* str, int length, char* result )
+{
+	return convertUtf16ToUtf8( str, length, result, true );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 }	// namespace Unicode.
 
 }	// namespace Relib.
@@ -8,16 +8,285 @@
 #include <Array.h>
 #include <Errors.h>
 #include <StaticAllocators.h>
+#include <ThreadPool.h>
 
 namespace Relib {
 
 //////////////////////////////////////////////////////////////////////////
 
-const int minWriteChunk = 64 * 1024;
-const int maxWriteChunk = 64 * 1024 * 1024;
-const int minZipSize = minWriteChunk;
+// Window bits of the raw deflate streams that form the blocks of a parallel zlib stream.
+static const int rawDeflateWindowBits = -MAX_WBITS;
+// Size of the deflate window. Parallel blocks are primed with this much data of the previous block.
+static const int deflateWindowSize = 1 << MAX_WBITS;
+// Tag of the block container. Its first byte is not a valid zlib stream header.
+static const BYTE blockContainerTag[4] = { 'R', 'Z', 'B', 1 };
+// Maximum ratio of the uncompressed and the compressed deflate data sizes.
+static const int maxDeflateRatio = 1032;
 extern const CError Err_ZlibInitError;
+extern const CError Err_ZlibInflateError;
+
+CZipConverter::CZipConverter( int _compressionLevel, CThreadPool* _threadPool, int _blockSize ) :
+	compressionLevel( _compressionLevel ),
+	blockSize( _blockSize ),
+	threadPool( _threadPool )
+{
+	assert( compressionLevel == DefaultCompressionLevel || ( compressionLevel >= 0 && compressionLevel <= 9 ) );
+	// Priming dictionary must fit in the previous block.
+	assert( blockSize >= deflateWindowSize );
+}
+
+// Call action( blockIndex ) for every block. Blocks are processed by the thread pool if there is one.
+// The first exception thrown by the action is rethrown on the calling thread, the remaining blocks are skipped.
+template <class Action>
+void CZipConverter::forEachBlock( int blockCount, const Action& action )
+{
+	if( threadPool != nullptr && blockCount > 1 ) {
+		threadPool->ParallelFor( 0, blockCount, 1, action );
+	} else {
+		for( int i = 0; i < blockCount; i++ ) {
+			action( i );
+		}
+	}
+}
+
 void CZipConverter::ZipData( CArrayView<BYTE> data, CArray<BYTE>& result )
+{
+	if( threadPool != nullptr && data.Size() > blockSize ) {
+		zipParallel( data, result );
+	} else {
+		deflateBlock( data, CArrayView<BYTE>(), compressionLevel, MAX_WBITS, Z_FINISH, result );
+	}
+}
+
+// Compress the blocks in parallel and wrap them into a zlib stream.
+// Blocks are raw deflate streams, every block but the last is finished with a sync flush, so the concatenation is a single deflate stream.
+void CZipConverter::zipParallel( CArrayView<BYTE> data, CArray<BYTE>& result )
+{
+	const int blockCount = ( data.Size() - 1 ) / blockSize + 1;
+	CArray<CArray<BYTE>> zippedBlocks;
+	zippedBlocks.IncreaseSize( blockCount );
+	CArray<unsigned> blockChecksums;
+	blockChecksums.IncreaseSizeNoInitialize( blockCount );
+	forEachBlock( blockCount, [&]( int blockIndex ) {
+		const auto blockStart = blockIndex * blockSize;
+		const auto block = data.Mid( blockStart, min( blockSize, data.Size() - blockStart ) );
+		const auto dictionarySize = min( blockStart, deflateWindowSize );
+		const auto dictionary = data.Mid( blockStart - dictionarySize, dictionarySize );
+		const auto flushMode = blockIndex == blockCount - 1 ? Z_FINISH : Z_SYNC_FLUSH;
+		deflateBlock( block, dictionary, compressionLevel, rawDeflateWindowBits, flushMode, zippedBlocks[blockIndex] );
+		blockChecksums[blockIndex] = adler32( adler32( 0, Z_NULL, 0 ), block.Ptr(), block.Size() );
+	} );
+
+	// Zlib header with the level hint and the check bits.
+	const int levelHint = compressionLevel == DefaultCompressionLevel || compressionLevel == 6 ? 2 : compressionLevel < 2 ? 0 : compressionLevel < 6 ? 1 : 3;
+	int header = ( ( Z_DEFLATED + ( ( MAX_WBITS - 8 ) << 4 ) ) << 8 ) | ( levelHint << 6 );
+	header += 31 - header % 31;
+	result.Add( static_cast<BYTE>( header >> 8 ) );
+	result.Add( static_cast<BYTE>( header & 0xFF ) );
+
+	auto checksum = blockChecksums[0];
+	for( int i = 0; i < blockCount; i++ ) {
+		if( i > 0 ) {
+			const auto blockDataSize = min( blockSize, data.Size() - i * blockSize );
+			checksum = adler32_combine( checksum, blockChecksums[i], blockDataSize );
+		}
+		const auto writePos = result.Size();
+		result.IncreaseSizeNoInitialize( writePos + zippedBlocks[i].Size() );
+		::memcpy( result.Ptr() + writePos, zippedBlocks[i].Ptr(), zippedBlocks[i].Size() );
+		zippedBlocks[i].FreeBuffer();
+	}
+
+	// Adler-32 of the data in the big endian order.
+	for( int shift = 24; shift >= 0; shift -= 8 ) {
+		result.Add( static_cast<BYTE>( checksum >> shift ) );
+	}
+}
+
+void CZipConverter::UnzipData( CArrayView<BYTE> data, CArray<BYTE>& result )
+{
+	if( IsBlockContainer( data ) ) {
+		unzipBlocks( data, result );
+	} else {
+		inflateStream( data, result );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+	// Block container layout: tag, block size, uncompressed data size, block count, end offsets of the compressed blocks, compressed blocks.
+	// Every compressed block is a separate zlib stream.
+	class CZipBlockIndex {
+	public:
+		explicit CZipBlockIndex( CArrayView<BYTE> container );
+
+		int BlockSize() const
+			{ return blockSize; }
+		int DataSize() const
+			{ return dataSize; }
+		int BlockCount() const
+			{ return blockCount; }
+
+		// Uncompressed size of the block.
+		int GetBlockDataSize( int blockIndex ) const
+			{ return min( blockSize, dataSize - blockIndex * blockSize ); }
+		CArrayView<BYTE> GetZippedBlock( int blockIndex ) const;
+
+		static int GetHeaderSize( int blockCount )
+			{ return sizeof( blockContainerTag ) + ( 3 + blockCount ) * sizeof( int ); }
+		static void WriteValue( int value, BYTE* dest )
+			{ ::memcpy( dest, &value, sizeof( value ) ); }
+
+	private:
+		CArrayView<BYTE> container;
+		int blockSize = 0;
+		int dataSize = 0;
+		int blockCount = 0;
+
+		int readValue( int pos ) const;
+		int getBlockEnd( int blockIndex ) const;
+	};
+
+	CZipBlockIndex::CZipBlockIndex( CArrayView<BYTE> _container ) :
+		container( _container )
+	{
+		const int fixedHeaderSize = GetHeaderSize( 0 );
+		check( CZipConverter::IsBlockContainer( container ) && container.Size() >= fixedHeaderSize, Err_ZlibInflateError, Z_DATA_ERROR );
+		blockSize = readValue( sizeof( blockContainerTag ) );
+		dataSize = readValue( sizeof( blockContainerTag ) + sizeof( int ) );
+		blockCount = readValue( sizeof( blockContainerTag ) + 2 * sizeof( int ) );
+		const bool isSizeValid = blockSize > 0 && dataSize >= 0 && blockCount >= 0
+			&& blockCount <= ( container.Size() - fixedHeaderSize ) / static_cast<int>( sizeof( int ) )
+			&& dataSize <= static_cast<__int64>( blockCount ) * blockSize && dataSize > static_cast<__int64>( blockCount - 1 ) * blockSize;
+		check( isSizeValid, Err_ZlibInflateError, Z_DATA_ERROR );
+
+		// The data size is also limited by the size of the compressed blocks, so a corrupted header can't make the reader allocate more.
+		int prevEnd = GetHeaderSize( blockCount );
+		for( int i = 0; i < blockCount; i++ ) {
+			const auto blockEnd = getBlockEnd( i );
+			check( blockEnd >= prevEnd && blockEnd <= container.Size(), Err_ZlibInflateError, Z_DATA_ERROR );
+			check( GetBlockDataSize( i ) <= static_cast<__int64>( blockEnd - prevEnd ) * maxDeflateRatio, Err_ZlibInflateError, Z_DATA_ERROR );
+			prevEnd = blockEnd;
+		}
+	}
+
+	CArrayView<BYTE> CZipBlockIndex::GetZippedBlock( int blockIndex ) const
+	{
+		assert( blockIndex >= 0 && blockIndex < blockCount );
+		const auto blockStart = blockIndex == 0 ? GetHeaderSize( blockCount ) : getBlockEnd( blockIndex - 1 );
+		return container.Mid( blockStart, getBlockEnd( blockIndex ) - blockStart );
+	}
+
+	int CZipBlockIndex::readValue( int pos ) const
+	{
+		int value;
+		::memcpy( &value, container.Ptr() + pos, sizeof( value ) );
+		return value;
+	}
+
+	int CZipBlockIndex::getBlockEnd( int blockIndex ) const
+	{
+		return readValue( GetHeaderSize( 0 ) + blockIndex * sizeof( int ) );
+	}
+
+}	// namespace RelibInternal.
+
+//////////////////////////////////////////////////////////////////////////
+
+void CZipConverter::ZipBlocks( CArrayView<BYTE> data, CArray<BYTE>& result )
+{
+	const int blockCount = data.IsEmpty() ? 0 : ( data.Size() - 1 ) / blockSize + 1;
+	CArray<CArray<BYTE>> zippedBlocks;
+	zippedBlocks.IncreaseSize( blockCount );
+	forEachBlock( blockCount, [&]( int blockIndex ) {
+		const auto blockStart = blockIndex * blockSize;
+		const auto block = data.Mid( blockStart, min( blockSize, data.Size() - blockStart ) );
+		deflateBlock( block, CArrayView<BYTE>(), compressionLevel, MAX_WBITS, Z_FINISH, zippedBlocks[blockIndex] );
+	} );
+
+	const auto headerSize = RelibInternal::CZipBlockIndex::GetHeaderSize( blockCount );
+	int containerSize = headerSize;
+	for( const auto& block : zippedBlocks ) {
+		containerSize += block.Size();
+	}
+	const auto containerStart = result.Size();
+	result.IncreaseSizeNoInitialize( containerStart + containerSize );
+	auto dest = result.Ptr() + containerStart;
+	::memcpy( dest, blockContainerTag, sizeof( blockContainerTag ) );
+	auto indexDest = dest + sizeof( blockContainerTag );
+	RelibInternal::CZipBlockIndex::WriteValue( blockSize, indexDest );
+	RelibInternal::CZipBlockIndex::WriteValue( data.Size(), indexDest + sizeof( int ) );
+	RelibInternal::CZipBlockIndex::WriteValue( blockCount, indexDest + 2 * sizeof( int ) );
+	indexDest += 3 * sizeof( int );
+
+	int blockEnd = headerSize;
+	for( auto& block : zippedBlocks ) {
+		::memcpy( dest + blockEnd, block.Ptr(), block.Size() );
+		blockEnd += block.Size();
+		RelibInternal::CZipBlockIndex::WriteValue( blockEnd, indexDest );
+		indexDest += sizeof( int );
+		block.FreeBuffer();
+	}
+}
+
+bool CZipConverter::IsBlockContainer( CArrayView<BYTE> data )
+{
+	return data.Size() >= static_cast<int>( sizeof( blockContainerTag ) ) && ::memcmp( data.Ptr(), blockContainerTag, sizeof( blockContainerTag ) ) == 0;
+}
+
+int CZipConverter::GetBlockCount( CArrayView<BYTE> container )
+{
+	return RelibInternal::CZipBlockIndex( container ).BlockCount();
+}
+
+void CZipConverter::UnzipBlock( CArrayView<BYTE> container, int blockIndex, CArray<BYTE>& result )
+{
+	const RelibInternal::CZipBlockIndex index( container );
+	assert( blockIndex >= 0 && blockIndex < index.BlockCount() );
+	const auto writePos = result.Size();
+	const auto blockDataSize = index.GetBlockDataSize( blockIndex );
+	result.IncreaseSizeNoInitialize( writePos + blockDataSize );
+	inflateBlock( index.GetZippedBlock( blockIndex ), result.Mid( writePos ) );
+}
+
+void CZipConverter::unzipBlocks( CArrayView<BYTE> container, CArray<BYTE>& result )
+{
+	const RelibInternal::CZipBlockIndex index( container );
+	const auto writePos = result.Size();
+	result.IncreaseSizeNoInitialize( writePos + index.DataSize() );
+	try {
+		forEachBlock( index.BlockCount(), [&]( int blockIndex ) {
+			const auto blockDataStart = writePos + blockIndex * index.BlockSize();
+			inflateBlock( index.GetZippedBlock( blockIndex ), result.Mid( blockDataStart, index.GetBlockDataSize( blockIndex ) ) );
+		} );
+	} catch( ... ) {
+		// Partially decompressed data is not returned.
+		result.DeleteLast( result.Size() - writePos );
+		throw;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+namespace RelibInternal {
+
+	// Guard that releases the deflate stream state.
+	class CDeflateEndGuard {
+	public:
+		explicit CDeflateEndGuard( z_stream& _zStream ) : zStream( _zStream ) {}
+		~CDeflateEndGuard()
+			{ deflateEnd( &zStream ); }
+
+	private:
+		z_stream& zStream;
+	};
+
+}	// namespace RelibInternal.
+
+// Deflate the data and append it to the result.
+// Negative window bits produce a raw deflate stream. Dictionary primes the compression with the preceding data.
+void CZipConverter::deflateBlock( CArrayView<BYTE> data, CArrayView<BYTE> dictionary, int level, int windowBits, int flushMode, CArray<BYTE>& result )
 {
 	const auto resultStartSize = result.Size();
 	z_stream zStream;
@@ -25,33 +294,40 @@ void CZipConverter::ZipData( CArrayView<BYTE> data, CArray<BYTE>& result )
 	zStream.zalloc = allocationFunction;
 	zStream.zfree = freeFunction;
 
-	const auto initResult = deflateInit( &zStream, Z_DEFAULT_COMPRESSION );
+	const int defaultMemoryLevel = 8;
+	const auto initResult = deflateInit2( &zStream, level, Z_DEFLATED, windowBits, defaultMemoryLevel, Z_DEFAULT_STRATEGY );
 	check( initResult == Z_OK, Err_ZlibInitError, initResult );
+	// The result may fail to grow, the stream state is released in any case.
+	const RelibInternal::CDeflateEndGuard deflateEndGuard( zStream );
+	if( !dictionary.IsEmpty() ) {
+		deflateSetDictionary( &zStream, dictionary.Ptr(), dictionary.Size() );
+	}
 
 	zStream.avail_in = data.Size();
 	zStream.next_in = const_cast<BYTE*>( data.Ptr() );
-	const int writeChunk = Clamp( data.Size() / 4, minWriteChunk, maxWriteChunk );
-
+	// Flush marker is not included in the bound.
+	const int flushMarkerSize = 16;
+	int outputSize = static_cast<int>( deflateBound( &zStream, data.Size() ) ) + flushMarkerSize;
 	for( ;; ) {
-		const int writePos = result.Size();
-		result.IncreaseSizeNoInitialize( result.Size() + writeChunk );
-		zStream.avail_out = writeChunk;
+		const int writePos = resultStartSize + static_cast<int>( zStream.total_out );
+		result.IncreaseSizeNoInitialize( resultStartSize + outputSize );
+		zStream.avail_out = result.Size() - writePos;
 		zStream.next_out = result.Ptr() + writePos;
-		const auto deflateResult = deflate( &zStream, Z_FINISH );
+		const auto deflateResult = deflate( &zStream, flushMode );
 		assert( deflateResult != Z_STREAM_ERROR );
-		if( deflateResult == Z_STREAM_END ) {
-			const auto totalByteCount = zStream.total_out + resultStartSize;
-			result.DeleteLast( result.Size() - totalByteCount );
+		const bool isFinished = flushMode == Z_FINISH ? deflateResult == Z_STREAM_END : zStream.avail_out != 0;
+		if( isFinished ) {
 			break;
 		}
+		outputSize *= 2;
 	}
-	deflateEnd( &zStream );
+	result.DeleteLast( result.Size() - resultStartSize - static_cast<int>( zStream.total_out ) );
 }
 
 const int minReadChunk = 64 * 1024;
 const int maxReadChunk = 64 * 1024 * 1024;
-extern const CError Err_ZlibInflateError;
-void CZipConverter::UnzipData( CArrayView<BYTE> data, CArray<BYTE>& result )
+// Inflate a zlib stream of an unknown size.
+void CZipConverter::inflateStream( CArrayView<BYTE> data, CArray<BYTE>& result )
 {
 	const auto resultStartSize = result.Size();
 	z_stream zStream;
@@ -64,7 +340,7 @@ void CZipConverter::UnzipData( CArrayView<BYTE> data, CArray<BYTE>& result )
 	zStream.avail_in = data.Size();
 	zStream.next_in = const_cast<BYTE*>( data.Ptr() );
 	const int readChunk = Clamp( data.Size(), minReadChunk, maxReadChunk );
-		for( ;; ) {
+	for( ;; ) {
 		const int readPos = result.Size();
 		result.IncreaseSizeNoInitialize( result.Size() + readChunk );
 		zStream.avail_out = readChunk;
@@ -83,6 +359,126 @@ void CZipConverter::UnzipData( CArrayView<BYTE> data, CArray<BYTE>& result )
 	inflateEnd( &zStream );
 }
 
+// Inflate a zlib stream which size is known.
+void CZipConverter::inflateBlock( CArrayView<BYTE> data, CArrayBuffer<BYTE> result )
+{
+	z_stream zStream;
+	memset( &zStream, 0, sizeof( zStream ) );
+	zStream.zalloc = allocationFunction;
+	zStream.zfree = freeFunction;
+	const auto initResult = inflateInit( &zStream );
+	check( initResult == Z_OK, Err_ZlibInitError, initResult );
+
+	zStream.avail_in = data.Size();
+	zStream.next_in = const_cast<BYTE*>( data.Ptr() );
+	zStream.avail_out = result.Size();
+	zStream.next_out = result.Ptr();
+	const auto inflateResult = inflate( &zStream, Z_FINISH );
+	const bool isSizeValid = zStream.avail_out == 0;
+	inflateEnd( &zStream );
+	check( inflateResult == Z_STREAM_END && isSizeValid, Err_ZlibInflateError, inflateResult == Z_STREAM_END ? Z_DATA_ERROR : inflateResult );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CZipStreamWriter::CZipStreamWriter( CFileWriteView _target, int bufferSize ) :
+	target( _target ),
+	zStream( CreateOwner<z_stream_s>() )
+{
+	assert( bufferSize > 0 );
+	::memset( zStream.Ptr(), 0, sizeof( z_stream ) );
+	zStream->zalloc = CZipConverter::allocationFunction;
+	zStream->zfree = CZipConverter::freeFunction;
+	const auto initResult = deflateInit( zStream.Ptr(), Z_DEFAULT_COMPRESSION );
+	check( initResult == Z_OK, Err_ZlibInitError, initResult );
+	outputBuffer.IncreaseSizeNoInitialize( bufferSize );
+}
+
+CZipStreamWriter::~CZipStreamWriter()
+{
+	deflateEnd( zStream.Ptr() );
+}
+
+void CZipStreamWriter::Write( CArrayView<BYTE> data )
+{
+	zStream->avail_in = data.Size();
+	zStream->next_in = const_cast<BYTE*>( data.Ptr() );
+	deflateInput( Z_NO_FLUSH );
+}
+
+void CZipStreamWriter::Finish()
+{
+	zStream->avail_in = 0;
+	zStream->next_in = nullptr;
+	deflateInput( Z_FINISH );
+}
+
+// Deflate the whole input. The output buffer is written to the target every time it's filled.
+void CZipStreamWriter::deflateInput( int flushMode )
+{
+	for( ;; ) {
+		zStream->avail_out = outputBuffer.Size();
+		zStream->next_out = outputBuffer.Ptr();
+		const auto deflateResult = deflate( zStream.Ptr(), flushMode );
+		assert( deflateResult != Z_STREAM_ERROR );
+		const auto outputSize = outputBuffer.Size() - static_cast<int>( zStream->avail_out );
+		if( outputSize > 0 ) {
+			target.Write( outputBuffer.Ptr(), outputSize );
+		}
+		const bool isFinished = flushMode == Z_FINISH ? deflateResult == Z_STREAM_END : zStream->avail_out != 0;
+		if( isFinished ) {
+			break;
+		}
+	}
+	assert( zStream->avail_in == 0 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+CZipStreamReader::CZipStreamReader() :
+	zStream( CreateOwner<z_stream_s>() )
+{
+	::memset( zStream.Ptr(), 0, sizeof( z_stream ) );
+	zStream->zalloc = CZipConverter::allocationFunction;
+	zStream->zfree = CZipConverter::freeFunction;
+	const auto initResult = inflateInit( zStream.Ptr() );
+	check( initResult == Z_OK, Err_ZlibInitError, initResult );
+}
+
+CZipStreamReader::~CZipStreamReader()
+{
+	inflateEnd( zStream.Ptr() );
+}
+
+bool CZipStreamReader::NeedsInput() const
+{
+	return zStream->avail_in == 0;
+}
+
+void CZipStreamReader::SetInput( CArrayView<BYTE> data )
+{
+	assert( NeedsInput() );
+	zStream->avail_in = data.Size();
+	zStream->next_in = const_cast<BYTE*>( data.Ptr() );
+}
+
+int CZipStreamReader::Read( CArrayBuffer<BYTE> result )
+{
+	if( isStreamEnd ) {
+		return 0;
+	}
+	zStream->avail_out = result.Size();
+	zStream->next_out = result.Ptr();
+	const auto inflateResult = inflate( zStream.Ptr(), Z_NO_FLUSH );
+	if( inflateResult == Z_NEED_DICT || inflateResult == Z_DATA_ERROR || inflateResult == Z_MEM_ERROR ) {
+		check( false, Err_ZlibInflateError, inflateResult );
+	}
+	isStreamEnd = inflateResult == Z_STREAM_END;
+	return result.Size() - static_cast<int>( zStream->avail_out );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 void* CZipConverter::allocationFunction( void*, unsigned itemCount, unsigned itemSize )
 {
 	const auto byteCount = itemSize * itemCount;
@@ -0,0 +1,103 @@
+#include "TestFramework.h"
+#include <AsyncMessageLog.h>
+#include <FileOwners.h>
+#include <TempFile.h>
+#include <UnicodeUtils.h>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Text that the log writes to a file for the given actions.
+template <class LogAction>
+static CString getLoggedText( int threadBufferSize, const LogAction& action )
+{
+	const auto fileName = TempFile::New();
+	{
+		CFileWriter file( fileName, FCM_CreateAlways );
+		CAsyncMessageLog log( file, LOP_Block, threadBufferSize );
+		action( log );
+		log.Flush();
+	}
+	auto result = File::ReadText( fileName );
+	TempFile::Delete( fileName );
+	return result;
+}
+
+static int countLines( CStringPart text )
+{
+	int result = 0;
+	for( auto ch : text ) {
+		if( ch == '\n' ) {
+			result++;
+		}
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Messages that fail to be written are counted as dropped, the writer thread keeps running.
+RELIB_TEST( AsyncMessageLogSurvivesWriteErrors )
+{
+	const int messageCount = 100;
+	// Every write to an invalid handle fails.
+	CAsyncMessageLog log( CFileWriteView( INVALID_HANDLE_VALUE ) );
+	for( int round = 1; round <= 2; round++ ) {
+		for( int i = 0; i < messageCount; i++ ) {
+			log.AddMessage( CString( "failing message" ), LMT_Message );
+		}
+		log.Flush();
+		TEST_CHECK( log.GetDroppedMessageCount() == round * messageCount );
+	}
+}
+
+// Messages that don't fit in the thread buffer are cut without splitting a UTF-8 character.
+RELIB_TEST( AsyncMessageLogCutsLongMessagesAtCharacterBoundary )
+{
+	// One byte character followed by two byte characters, so the cut falls inside a character for every odd length.
+	CString message( "a" );
+	for( int i = 0; i < 1000; i++ ) {
+		message += "\xC3\xA9";
+	}
+	const auto text = getLoggedText( 256, [&]( CAsyncMessageLog& log ) { log.AddMessage( copy( message ), LMT_Message ); } );
+	TEST_CHECK( text.Length() > 2 && text.Length() < message.Length() );
+	const auto cutMessage = text.Left( text.Length() - 2 );
+	TEST_CHECK( text.Mid( cutMessage.Length() ) == "\r\n" );
+	TEST_CHECK( message.Left( cutMessage.Length() ) == cutMessage );
+	TEST_CHECK( Unicode::IsValidUtf8( cutMessage.begin(), cutMessage.Length() ) );
+}
+
+// Buffers of the ended threads are emptied before they are released.
+RELIB_TEST( AsyncMessageLogWritesMessagesOfEndedThreads )
+{
+	const int threadCount = 64;
+	const int messageCount = 100;
+	const auto text = getLoggedText( CAsyncMessageLog::DefaultThreadBufferSize, [&]( CAsyncMessageLog& log ) {
+		for( int i = 0; i < threadCount; i++ ) {
+			std::thread thread( [&]() {
+				for( int j = 0; j < messageCount; j++ ) {
+					log.AddMessage( CString( "thread message" ), LMT_Message );
+				}
+			} );
+			thread.join();
+		}
+	} );
+	TEST_CHECK( countLines( text ) == threadCount * messageCount );
+}
+
+// A thread may outlive the logs it has written to and use new ones.
+RELIB_TEST( AsyncMessageLogThreadOutlivesLog )
+{
+	for( int i = 0; i < 10; i++ ) {
+		const auto text = getLoggedText( CAsyncMessageLog::DefaultThreadBufferSize, [&]( CAsyncMessageLog& log ) {
+			log.AddMessage( CString( "main thread message" ), LMT_Message );
+		} );
+		TEST_CHECK( text == "main thread message\r\n" );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,306 @@
+#include "TestFramework.h"
+#include <DecimalConversions.h>
+#include <StrConversions.h>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class FltType>
+struct CTestBits;
+
+template <>
+struct CTestBits<double> {
+	typedef unsigned long long TBits;
+};
+
+template <>
+struct CTestBits<float> {
+	typedef unsigned TBits;
+};
+
+template <class FltType>
+static typename CTestBits<FltType>::TBits getBits( FltType value )
+{
+	typename CTestBits<FltType>::TBits bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	return bits;
+}
+
+// A random positive finite value. Every fourth value is subnormal.
+template <class FltType>
+static FltType createRandomValue( std::mt19937_64& random )
+{
+	typedef typename CTestBits<FltType>::TBits TBits;
+	const int mantissaBitCount = std::numeric_limits<FltType>::digits - 1;
+	for( ;; ) {
+		auto bits = static_cast<TBits>( random() ) & ( std::numeric_limits<TBits>::max() >> 1 );
+		if( random() % 4 == 0 ) {
+			bits &= ( static_cast<TBits>( 1 ) << mantissaBitCount ) - 1;
+		}
+		FltType result;
+		memcpy( &result, &bits, sizeof( result ) );
+		if( std::isfinite( result ) ) {
+			return result;
+		}
+	}
+}
+
+static std::string formatShortest( double value )
+{
+	char buffer[Decimal::MaxShortestLength];
+	return std::string( buffer, Decimal::FormatShortest( value, buffer ) );
+}
+
+static std::string formatShortest( float value )
+{
+	char buffer[Decimal::MaxShortestLength];
+	return std::string( buffer, Decimal::FormatShortest( value, buffer ) );
+}
+
+static std::string formatFixed( double value, int digitCount )
+{
+	std::vector<char> buffer( Decimal::GetMaxFixedLength( value, digitCount ) );
+	return std::string( buffer.data(), Decimal::FormatFixed( value, digitCount, buffer.data() ) );
+}
+
+// Parse the whole string. Return false if a part of the string is left.
+template <class FltType>
+static bool parseWhole( const std::string& str, FltType& result )
+{
+	return Decimal::Parse( str.data(), static_cast<int>( str.length() ), result ) == static_cast<int>( str.length() );
+}
+
+template <class FltType>
+static bool isParsedAs( const std::string& str, FltType expected )
+{
+	FltType result;
+	return parseWhole( str, result ) && getBits( result ) == getBits( expected );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Decimal integers as digit strings.
+
+static std::string addDigits( const std::string& left, const std::string& right )
+{
+	std::string result;
+	int carry = 0;
+	for( size_t i = 0; i < left.length() || i < right.length() || carry != 0; i++ ) {
+		int sum = carry;
+		sum += i < left.length() ? left[left.length() - 1 - i] - '0' : 0;
+		sum += i < right.length() ? right[right.length() - 1 - i] - '0' : 0;
+		result.insert( result.begin(), static_cast<char>( '0' + sum % 10 ) );
+		carry = sum / 10;
+	}
+	return result;
+}
+
+static std::string multiplyDigits( const std::string& digits, int multiplier )
+{
+	std::string result;
+	int carry = 0;
+	for( size_t i = digits.length(); i > 0 || carry != 0; ) {
+		int product = carry;
+		if( i > 0 ) {
+			i--;
+			product += ( digits[i] - '0' ) * multiplier;
+		}
+		result.insert( result.begin(), static_cast<char>( '0' + product % 10 ) );
+		carry = product / 10;
+	}
+	return result;
+}
+
+// The digits must be positive.
+static std::string decrementDigits( std::string digits )
+{
+	size_t pos = digits.length() - 1;
+	for( ; digits[pos] == '0'; pos-- ) {
+		digits[pos] = '9';
+	}
+	digits[pos]--;
+	return digits;
+}
+
+// Exact digits of the value scaled by 10^fractionDigitCount. The value must have no more fractional digits.
+static std::string getScaledDigits( double value, int fractionDigitCount )
+{
+	std::string result = formatFixed( value, fractionDigitCount );
+	const auto pointPos = result.find( '.' );
+	if( pointPos != std::string::npos ) {
+		result.erase( pointPos, 1 );
+	}
+	return result;
+}
+
+// Exact halfway point between the value and the next one in the form digits * 10^-exponent.
+template <class FltType>
+static std::string getHalfwayDigits( FltType value, int& exponent )
+{
+	const FltType next = std::nextafter( value, std::numeric_limits<FltType>::infinity() );
+	int ulpExponent;
+	std::frexp( static_cast<double>( next ) - static_cast<double>( value ), &ulpExponent );
+	// The difference is 2^( ulpExponent - 1 ), the halfway point has one more fractional digit.
+	const int fractionDigitCount = std::max( 1 - ulpExponent, 0 );
+	const auto sum = addDigits( getScaledDigits( value, fractionDigitCount ), getScaledDigits( next, fractionDigitCount ) );
+	exponent = fractionDigitCount + 1;
+	return multiplyDigits( sum, 5 );
+}
+
+static std::string createNumber( const std::string& digits, int negativeExponent )
+{
+	return digits + "e-" + std::to_string( negativeExponent );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+template <class FltType>
+static void checkShortestRoundTrip( int valueCount )
+{
+	std::mt19937_64 random( 18 );
+	int failureCount = 0;
+	for( int i = 0; i < valueCount; i++ ) {
+		const FltType value = createRandomValue<FltType>( random );
+		const FltType signedValue = i % 2 == 0 ? value : -value;
+		const auto str = formatShortest( signedValue );
+		const bool isCorrect = static_cast<int>( str.length() ) <= Decimal::MaxShortestLength && isParsedAs( str, signedValue );
+		failureCount += isCorrect ? 0 : 1;
+	}
+	TEST_CHECK( failureCount == 0 );
+}
+
+RELIB_TEST( DecimalShortestRoundTripsRandomDoubles )
+{
+	checkShortestRoundTrip<double>( 200000 );
+}
+
+RELIB_TEST( DecimalShortestRoundTripsRandomFloats )
+{
+	checkShortestRoundTrip<float>( 200000 );
+}
+
+RELIB_TEST( DecimalShortestWritesKnownValues )
+{
+	TEST_CHECK( formatShortest( 0.1 ) == "0.1" );
+	TEST_CHECK( formatShortest( 0.1f ) == "0.1" );
+	TEST_CHECK( formatShortest( 1.0 / 3 ) == "0.3333333333333333" );
+	TEST_CHECK( formatShortest( 1.0f / 3 ) == "0.33333334" );
+	TEST_CHECK( formatShortest( 0.0 ) == "0" );
+	TEST_CHECK( formatShortest( 100.0 ) == "100" );
+	TEST_CHECK( formatShortest( -1.5 ) == "-1.5" );
+	TEST_CHECK( formatShortest( 123456789012345680000.0 ) == "123456789012345680000" );
+	TEST_CHECK( formatShortest( 1e21 ) == "1e+21" );
+	TEST_CHECK( formatShortest( 0.000001 ) == "0.000001" );
+	TEST_CHECK( formatShortest( 1e-7 ) == "1e-7" );
+	TEST_CHECK( formatShortest( 5e-324 ) == "5e-324" );
+	TEST_CHECK( formatShortest( 1.7976931348623157e308 ) == "1.7976931348623157e+308" );
+	TEST_CHECK( formatShortest( 1e-45f ) == "1e-45" );
+	TEST_CHECK( formatShortest( 3.4028235e38f ) == "3.4028235e+38" );
+	// The boundary below a power of two is twice as close.
+	TEST_CHECK( formatShortest( 9007199254740992.0 ) == "9007199254740992" );
+	TEST_CHECK( formatShortest( std::numeric_limits<double>::infinity() ) == "inf" );
+	TEST_CHECK( formatShortest( -std::numeric_limits<double>::infinity() ) == "-inf" );
+	TEST_CHECK( formatShortest( std::numeric_limits<double>::quiet_NaN() ) == "nan" );
+	TEST_CHECK( formatShortest( std::numeric_limits<float>::infinity() ) == "inf" );
+}
+
+RELIB_TEST( DecimalFixedRoundsExactly )
+{
+	TEST_CHECK( formatFixed( 0.125, 2 ) == "0.12" );
+	TEST_CHECK( formatFixed( 0.375, 2 ) == "0.38" );
+	TEST_CHECK( formatFixed( 2.5, 0 ) == "2" );
+	TEST_CHECK( formatFixed( 0.1, 20 ) == "0.10000000000000000555" );
+	TEST_CHECK( formatFixed( -0.0004, 3 ) == "-0.000" );
+	TEST_CHECK( formatFixed( 1e20, 1 ) == "100000000000000000000.0" );
+	TEST_CHECK( formatFixed( 5e-324, 1074 ).length() == 1076 );
+	TEST_CHECK( formatFixed( 1.7976931348623157e308, 0 ).length() == 309 );
+}
+
+RELIB_TEST( DecimalStrConversions )
+{
+	TEST_CHECK( Str( 1.0 / 3 ) == "0.333" );
+	TEST_CHECK( Str( 0.1f ) == "0.100" );
+	TEST_CHECK( Str( 0.1, Decimal::ShortestDigitCount ) == "0.1" );
+	TEST_CHECK( Str( 0.1f, Decimal::ShortestDigitCount ) == "0.1" );
+	TEST_CHECK( UnicodeStr( 0.1f, Decimal::ShortestDigitCount ) == L"0.1" );
+	TEST_CHECK( *Value<double>( CStringPart( "1e-2" ) ) == 0.01 );
+	TEST_CHECK( *Value<float>( CStringPart( "0.1" ) ) == 0.1f );
+	TEST_CHECK( !Value<double>( CStringPart( "-" ) ).IsValid() );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Exact halfway points round to the even value. Any difference after the last digit moves the result.
+template <class FltType>
+static void checkHalfwayRounding( int valueCount )
+{
+	std::mt19937_64 random( 1018 );
+	int failureCount = 0;
+	for( int i = 0; i < valueCount; i++ ) {
+		const FltType value = createRandomValue<FltType>( random );
+		const FltType next = std::nextafter( value, std::numeric_limits<FltType>::infinity() );
+		if( !std::isfinite( next ) ) {
+			continue;
+		}
+		int exponent;
+		const auto halfway = getHalfwayDigits( value, exponent );
+		const FltType even = getBits( value ) % 2 == 0 ? value : next;
+		bool isCorrect = isParsedAs( createNumber( halfway, exponent ), even );
+		isCorrect = isParsedAs( createNumber( decrementDigits( halfway ) + "99999999", exponent + 8 ), value ) && isCorrect;
+		isCorrect = isParsedAs( createNumber( halfway + "00000001", exponent + 8 ), next ) && isCorrect;
+		failureCount += isCorrect ? 0 : 1;
+	}
+	TEST_CHECK( failureCount == 0 );
+}
+
+RELIB_TEST( DecimalParseRoundsHalfwayDoubles )
+{
+	checkHalfwayRounding<double>( 5000 );
+}
+
+RELIB_TEST( DecimalParseRoundsHalfwayFloats )
+{
+	checkHalfwayRounding<float>( 20000 );
+}
+
+// The exact expansion of a double has up to 767 significant digits.
+RELIB_TEST( DecimalParseLongMantissas )
+{
+	std::mt19937_64 random( 2018 );
+	int failureCount = 0;
+	for( int i = 0; i < 2000; i++ ) {
+		const double value = createRandomValue<double>( random );
+		const int fractionDigitCount = 1100;
+		const auto exactDigits = getScaledDigits( value, fractionDigitCount );
+		bool isCorrect = isParsedAs( createNumber( exactDigits, fractionDigitCount ), value );
+		isCorrect = isParsedAs( createNumber( exactDigits + "123456789", fractionDigitCount + 9 ), value ) && isCorrect;
+		isCorrect = isParsedAs( formatFixed( value, fractionDigitCount ), value ) && isCorrect;
+		failureCount += isCorrect ? 0 : 1;
+	}
+	TEST_CHECK( failureCount == 0 );
+
+	TEST_CHECK( isParsedAs( "9007199254740993", 9007199254740992.0 ) );
+	TEST_CHECK( isParsedAs( "9007199254740993.0000000000000000000000000001", 9007199254740994.0 ) );
+	TEST_CHECK( isParsedAs( "0." + std::string( 400, '0' ) + "1e400", 0.1 ) );
+	TEST_CHECK( isParsedAs( std::string( 400, '1' ) + "e-400", 1.0 / 9 ) );
+	TEST_CHECK( isParsedAs( "2.4703282292062328e-324", 5e-324 ) );
+	TEST_CHECK( isParsedAs( "2.4703282292062327e-324", 0.0 ) );
+	TEST_CHECK( isParsedAs( "1.7976931348623158e308", 1.7976931348623157e308 ) );
+	TEST_CHECK( isParsedAs( "1.7976931348623159e308", std::numeric_limits<double>::infinity() ) );
+	TEST_CHECK( isParsedAs( "1e-100000000000000000000", 0.0 ) );
+	TEST_CHECK( isParsedAs( "-1e+100000000000000000000", -std::numeric_limits<double>::infinity() ) );
+	TEST_CHECK( isParsedAs( "7.038531e-26", 7.038531e-26f ) );
+	TEST_CHECK( isParsedAs( "1.00000005960464477539062499", 1.0f ) );
+	TEST_CHECK( isParsedAs( "1.000000059604644775390625", 1.0f ) );
+	TEST_CHECK( isParsedAs( "1.00000005960464477539062501", 1.00000012f ) );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,165 @@
+#include "TestFramework.h"
+#include <EntityComponentSystem.h>
+#include <EntityContainer.h>
+#include <SystemOwner.h>
+#include <ThreadPool.h>
+#include <stdexcept>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+static CComponent<int> positionComponent;
+static CComponent<int> velocityComponent;
+static CComponentGroup movingGroup( positionComponent, velocityComponent );
+
+static const int testChunkSize = 100;
+
+struct CTestContext : public ISystemContext {
+	CAtomic<int> ChunkCount{ 0 };
+};
+
+// Moves every entity by one.
+class CMoveSystem : public CBaseChunkUpdateSystem<CMoveSystem> {
+public:
+	virtual int GetPriority() const override
+		{ return 1; }
+	virtual void GetComponentAccess( CSystemAccess& result ) const override
+		{ result.Write( positionComponent ); }
+	virtual int GetEntityChunkSize() const override
+		{ return testChunkSize; }
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return movingGroup; }
+
+	void UpdateEntities( CEntityRange range, CTestContext& context );
+};
+
+void CMoveSystem::UpdateEntities( CEntityRange range, CTestContext& context )
+{
+	context.ChunkCount.PreIncrement();
+	for( auto entity : range ) {
+		entity.GetValue( positionComponent )++;
+	}
+}
+
+// Reads the positions written by the move system, so it always runs after it.
+class CVelocitySystem : public CBaseChunkUpdateSystem<CVelocitySystem> {
+public:
+	virtual void GetComponentAccess( CSystemAccess& result ) const override
+		{ result.Read( positionComponent ); result.Write( velocityComponent ); }
+	virtual int GetEntityChunkSize() const override
+		{ return testChunkSize; }
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return movingGroup; }
+
+	void UpdateEntities( CEntityRange range, CTestContext& context );
+};
+
+void CVelocitySystem::UpdateEntities( CEntityRange range, CTestContext& )
+{
+	for( auto entity : range ) {
+		entity.GetValue( velocityComponent ) = 2 * entity.GetValue( positionComponent );
+	}
+}
+
+// Fails on a single entity.
+class CFailingUpdateSystem : public CBaseChunkUpdateSystem<CFailingUpdateSystem> {
+public:
+	virtual void GetComponentAccess( CSystemAccess& result ) const override
+		{ result.Read( positionComponent ); }
+	virtual int GetEntityChunkSize() const override
+		{ return testChunkSize; }
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return movingGroup; }
+
+	void UpdateEntities( CEntityRange range, CTestContext& context );
+};
+
+void CFailingUpdateSystem::UpdateEntities( CEntityRange range, CTestContext& )
+{
+	for( auto entity : range ) {
+		if( entity.GetValue( positionComponent ) == 555 ) {
+			throw std::runtime_error( "update failure" );
+		}
+	}
+}
+
+class CFailingDrawSystem : public CBaseChunkDrawSystem<CFailingDrawSystem> {
+public:
+	virtual void GetComponentAccess( CSystemAccess& result ) const override
+		{ result.Read( positionComponent ); }
+	virtual int GetEntityChunkSize() const override
+		{ return testChunkSize; }
+	virtual const CComponentGroup& GetTargetGroup() const override
+		{ return movingGroup; }
+
+	void DrawEntities( CEntityConstRange range, const CTestContext& context ) const;
+};
+
+void CFailingDrawSystem::DrawEntities( CEntityConstRange range, const CTestContext& ) const
+{
+	for( auto entity : range ) {
+		if( entity.GetValue( positionComponent ) == 777 ) {
+			throw 7;
+		}
+	}
+}
+
+static void createMovingEntities( CEntityComponentSystem& ecs, int count )
+{
+	for( int i = 0; i < count; i++ ) {
+		ecs.CreateEntity( movingGroup ).GetValue( positionComponent ) = i;
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// A system that reads the components written by a higher priority system sees all of its writes.
+RELIB_TEST( EcsConflictingSystemsRunInPriorityOrder )
+{
+	const int entityCount = 10000;
+	CEntityContainer container;
+	CEntityComponentSystem ecs( &container );
+	createMovingEntities( ecs, entityCount );
+	const auto velocitySystem = ecs.AddSystem( CreateOwner<CVelocitySystem>() );
+	const auto moveSystem = ecs.AddSystem( CreateOwner<CMoveSystem>() );
+	CThreadPool pool( 4 );
+	ecs.SetThreadPool( &pool );
+
+	for( int frame = 1; frame <= 10; frame++ ) {
+		CTestContext context;
+		ecs.RunUpdateSystems( context );
+		TEST_CHECK( context.ChunkCount.Load() == entityCount / testChunkSize );
+		bool isValid = true;
+		int entityPos = 0;
+		for( auto range : ecs.Entities( movingGroup ) ) {
+			for( auto entity : range ) {
+				isValid &= entity.GetValue( positionComponent ) == entityPos + frame;
+				isValid &= entity.GetValue( velocityComponent ) == 2 * ( entityPos + frame );
+				entityPos++;
+			}
+		}
+		TEST_CHECK( isValid && entityPos == entityCount );
+	}
+}
+
+// Exceptions from the entity chunks are rethrown on the thread that runs the systems.
+RELIB_TEST( EcsChunkedSystemErrorsReachCaller )
+{
+	CEntityContainer container;
+	CEntityComponentSystem ecs( &container );
+	createMovingEntities( ecs, 10000 );
+	const auto updateSystem = ecs.AddSystem( CreateOwner<CFailingUpdateSystem>() );
+	const auto drawSystem = ecs.AddSystem( CreateOwner<CFailingDrawSystem>() );
+	CThreadPool pool( 4 );
+	ecs.SetThreadPool( &pool );
+
+	for( int frame = 0; frame < 20; frame++ ) {
+		CTestContext context;
+		TEST_CHECK_THROWS( ecs.RunUpdateSystems( context ), std::runtime_error );
+		TEST_CHECK_THROWS( ecs.RunDrawSystems( context ), int );
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,136 @@
+#include "TestFramework.h"
+#include <EventSystem.h>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+struct CTestEvent : public CEvent<CTestEvent> {
+	int Value = 0;
+
+	explicit CTestEvent( int value ) : Value( value ) {}
+};
+
+static const int testListenerCount = 4;
+
+// Listeners that count their calls. The action of a listener can change the other listeners.
+class CTestListeners {
+public:
+	CEventTarget Targets[testListenerCount];
+	int CallCounts[testListenerCount] = {};
+
+	template <class Action>
+	void Add( CEventSystem& events, int listenerPos, const Action& action );
+	void AddCounting( CEventSystem& events, int listenerPos );
+};
+
+template <class Action>
+void CTestListeners::Add( CEventSystem& events, int listenerPos, const Action& action )
+{
+	events.AddEventTarget( [this, listenerPos, action]( const CTestEvent& ) {
+		CallCounts[listenerPos]++;
+		action();
+	}, Targets[listenerPos] );
+}
+
+void CTestListeners::AddCounting( CEventSystem& events, int listenerPos )
+{
+	events.AddEventTarget( [this, listenerPos]( const CTestEvent& ) { CallCounts[listenerPos]++; }, Targets[listenerPos] );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Removal of a visited listener moved the last listener into its place, the last listener was skipped.
+RELIB_TEST( EventSystemRemoveVisitedListenerInNotify )
+{
+	CEventSystem events;
+	CTestListeners listeners;
+	listeners.AddCounting( events, 0 );
+	listeners.Add( events, 1, [&]() { listeners.Targets[0] = CEventTarget(); } );
+	listeners.AddCounting( events, 2 );
+	listeners.AddCounting( events, 3 );
+
+	events.Notify( CTestEvent( 1 ) );
+	for( int i = 0; i < testListenerCount; i++ ) {
+		TEST_CHECK( listeners.CallCounts[i] == 1 );
+	}
+	events.Notify( CTestEvent( 2 ) );
+	TEST_CHECK( listeners.CallCounts[0] == 1 );
+	TEST_CHECK( listeners.CallCounts[1] == 2 && listeners.CallCounts[2] == 2 && listeners.CallCounts[3] == 2 );
+}
+
+// A listener removed by another listener is not called for the same event.
+RELIB_TEST( EventSystemRemoveNextListenerInNotify )
+{
+	CEventSystem events;
+	CTestListeners listeners;
+	listeners.Add( events, 0, [&]() { listeners.Targets[2] = CEventTarget(); } );
+	listeners.AddCounting( events, 1 );
+	listeners.AddCounting( events, 2 );
+	listeners.AddCounting( events, 3 );
+
+	events.Notify( CTestEvent( 1 ) );
+	TEST_CHECK( listeners.CallCounts[0] == 1 && listeners.CallCounts[1] == 1 && listeners.CallCounts[3] == 1 );
+	TEST_CHECK( listeners.CallCounts[2] == 0 );
+	TEST_CHECK( events.HasListeners<CTestEvent>() );
+}
+
+// A listener that removes another listener, adds a new one and removes itself during a posted batch.
+RELIB_TEST( EventSystemChangeListenersInPostedBatch )
+{
+	CEventSystem events;
+	events.CreateEventQueue<CTestEvent>( 16 );
+	CTestListeners listeners;
+	listeners.Add( events, 0, [&]() {
+		if( listeners.CallCounts[0] == 2 ) {
+			listeners.Targets[1] = CEventTarget();
+			listeners.AddCounting( events, 3 );
+		}
+	} );
+	listeners.AddCounting( events, 1 );
+	listeners.AddCounting( events, 2 );
+
+	for( int i = 0; i < 4; i++ ) {
+		TEST_CHECK( events.Post( CTestEvent( i ) ) );
+	}
+	int batchSum = 0;
+	CEventTarget batchTarget;
+	events.AddBatchEventTarget( [&]( const CArrayView<CTestEvent>& batch ) {
+		for( const auto& e : batch ) {
+			batchSum += e.Value;
+		}
+		batchTarget = CEventTarget();
+	}, batchTarget );
+	events.DispatchPostedEvents<CTestEvent>();
+
+	TEST_CHECK( batchSum == 6 );
+	TEST_CHECK( listeners.CallCounts[0] == 4 && listeners.CallCounts[2] == 4 );
+	// The second listener is removed on the second event, the new one is added on it.
+	TEST_CHECK( listeners.CallCounts[1] == 1 );
+	TEST_CHECK( listeners.CallCounts[3] == 3 );
+
+	// The removed batch listener doesn't receive the next batch.
+	TEST_CHECK( events.Post( CTestEvent( 10 ) ) );
+	events.DispatchPostedEvents();
+	TEST_CHECK( batchSum == 6 );
+	TEST_CHECK( listeners.CallCounts[0] == 5 && listeners.CallCounts[2] == 5 && listeners.CallCounts[3] == 4 );
+}
+
+// Generic notification iterates over the listeners in the same way.
+RELIB_TEST( EventSystemRemoveListenerInNotifyDynamic )
+{
+	CEventSystem events;
+	CTestListeners listeners;
+	listeners.AddCounting( events, 0 );
+	listeners.Add( events, 1, [&]() { listeners.Targets[0] = CEventTarget(); } );
+	listeners.AddCounting( events, 2 );
+
+	const CTestEvent e( 1 );
+	events.NotifyDynamic( e );
+	TEST_CHECK( listeners.CallCounts[0] == 1 && listeners.CallCounts[1] == 1 && listeners.CallCounts[2] == 1 );
+	events.NotifyDynamic( e );
+	TEST_CHECK( listeners.CallCounts[0] == 1 && listeners.CallCounts[1] == 2 && listeners.CallCounts[2] == 2 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
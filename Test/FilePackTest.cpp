@@ -0,0 +1,80 @@
+#include "TestFramework.h"
+#include <FilePack.h>
+#include <FileOperations.h>
+#include <FileSystem.h>
+#include <TempFile.h>
+#include <ThreadPool.h>
+#include <Errors.h>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int testFileCount = 20;
+
+static CString getTestFileText( int filePos )
+{
+	CString result;
+	for( int i = 0; i <= filePos; i++ ) {
+		result += "packed file text ";
+	}
+	return result;
+}
+
+// Folder with the test files next to the given temporary file.
+static CString createTestFolder( CStringPart tempName )
+{
+	CString folderName = Str( tempName ) + "Files";
+	FileSystem::CreateDir( folderName );
+	for( int i = 0; i < testFileCount; i++ ) {
+		File::WriteText( FileSystem::MergePath( folderName, Str( i ) + ".txt" ), getTestFileText( i ) );
+	}
+	return folderName;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( FilePackFolderRoundTrip )
+{
+	const auto packName = TempFile::New();
+	const auto folderName = createTestFolder( packName );
+	CThreadPool pool( 4 );
+	CFilePackBuilder builder;
+	builder.AddFolder( folderName, FPF_Compressed | FPF_Checksum );
+	builder.WritePack( packName, &pool );
+	{
+		CFilePack pack( packName );
+		TEST_CHECK( pack.GetFileCount() == testFileCount );
+		for( int i = 0; i < testFileCount; i++ ) {
+			const auto filePos = pack.FindFile( Str( i ) + ".txt" );
+			TEST_CHECK( filePos != NotFound );
+			TEST_CHECK( pack.CheckFile( filePos ) );
+			CArray<BYTE> data;
+			pack.ReadFileData( filePos, data );
+			TEST_CHECK( CStringPart( reinterpret_cast<const char*>( data.Ptr() ), data.Size() ) == getTestFileText( i ) );
+		}
+		TEST_CHECK( pack.FindFile( "missing.txt" ) == NotFound );
+	}
+	FileSystem::DeleteTree( folderName );
+	TempFile::Delete( packName );
+}
+
+// A file that can't be read fails the whole write, the incomplete pack is deleted.
+RELIB_TEST( FilePackBuilderDeletesPackOnReadError )
+{
+	const auto packName = TempFile::New();
+	const auto folderName = createTestFolder( packName );
+	CFilePackBuilder builder;
+	builder.AddFolder( folderName );
+	// Folder files are read when the pack is written.
+	FileSystem::Delete( FileSystem::MergePath( folderName, "7.txt" ) );
+	CThreadPool pool( 4 );
+	for( auto threadPool : { static_cast<CThreadPool*>( nullptr ), &pool } ) {
+		TEST_CHECK_THROWS( builder.WritePack( packName, threadPool ), CException );
+		TEST_CHECK( !FileSystem::FileExists( packName ) );
+	}
+	FileSystem::DeleteTree( folderName );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
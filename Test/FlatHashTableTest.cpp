@@ -0,0 +1,61 @@
+#include "TestFramework.h"
+#include <FlatHashTable.h>
+#include <FlatMap.h>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( FlatHashTableSetDeleteHas )
+{
+	CFlatHashTable<int> table;
+	for( int i = 0; i < 10000; i++ ) {
+		TEST_CHECK( table.Set( i * 7 ) );
+	}
+	TEST_CHECK( !table.Set( 7 ) );
+	TEST_CHECK( table.Size() == 10000 );
+	for( int i = 0; i < 10000; i += 2 ) {
+		table.Delete( i * 7 );
+	}
+	TEST_CHECK( table.Size() == 5000 );
+	for( int i = 0; i < 10000; i++ ) {
+		TEST_CHECK( table.HasValue( i * 7 ) == ( i % 2 == 1 ) );
+	}
+	long long sum = 0;
+	for( int value : table ) {
+		sum += value;
+	}
+	TEST_CHECK( sum == 7LL * 5000 * 5000 );
+}
+
+// Deleted slots of an index without elements must not survive Empty.
+// Otherwise the deleted markers pile up until no empty slot ends the probe sequence of a missing key.
+RELIB_TEST( FlatHashTableEmptyAfterDeletingEverything )
+{
+	CFlatHashTable<int> table;
+	for( int round = 0; round < 100; round++ ) {
+		for( int i = 0; i < 100; i++ ) {
+			table.Set( round * 1000 + i );
+		}
+		for( int i = 0; i < 100; i++ ) {
+			table.Delete( round * 1000 + i );
+		}
+		TEST_CHECK( table.IsEmpty() );
+		table.Empty();
+		TEST_CHECK( !table.HasValue( -1 ) );
+	}
+}
+
+RELIB_TEST( FlatMapGetOrCreate )
+{
+	CFlatMap<int, int> map;
+	for( int i = 0; i < 1000; i++ ) {
+		map.GetOrCreate( i % 100 ).Value() += i;
+	}
+	TEST_CHECK( map.Size() == 100 );
+	TEST_CHECK( map[7] == 7 * 10 + 100 * 45 );
+	TEST_CHECK( map.Get( 1000 ) == nullptr );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
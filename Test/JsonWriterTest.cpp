@@ -0,0 +1,87 @@
+#include "TestFramework.h"
+#include <JsonWriter.h>
+#include <JsonDocument.h>
+#include <FileOwners.h>
+#include <TempFile.h>
+#include <limits>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+// Text that the writer produces for the given actions.
+template <class WriteAction>
+static CString getWrittenText( const WriteAction& action )
+{
+	const auto fileName = TempFile::New();
+	{
+		CFileWriter file( fileName, FCM_CreateAlways );
+		CJsonWriter writer( file );
+		action( writer );
+		writer.Flush();
+	}
+	auto result = File::ReadText( fileName );
+	TempFile::Delete( fileName );
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( JsonWriterWritesNonFiniteNumbersAsNull )
+{
+	const double infinity = std::numeric_limits<double>::infinity();
+	const auto text = getWrittenText( [=]( CJsonWriter& writer ) {
+		writer.StartArray();
+		writer.WriteNumber( 1.5 );
+		writer.WriteNumber( std::numeric_limits<double>::quiet_NaN() );
+		writer.WriteNumber( infinity );
+		writer.WriteNumber( -infinity );
+		writer.WriteNumber( 2 );
+		writer.EndArray();
+	} );
+	TEST_CHECK( text == "[1.5,null,null,null,2]" );
+
+	CJsonDocument document;
+	auto& arr = document.CreateArray();
+	document.AddArrayValue( arr, document.CreateNumber( 0.1 ) );
+	document.AddArrayValue( arr, document.CreateNumber( -infinity ) );
+	document.AddArrayValue( arr, document.CreateNumber( std::numeric_limits<double>::quiet_NaN() ) );
+	document.SetRoot( arr );
+	TEST_CHECK( document.GetDocumentString() == "[0.1,null,null]" );
+}
+
+// Every control character is escaped, so the output is valid JSON and is parsed back to the same string.
+RELIB_TEST( JsonWritersEscapeControlCharacters )
+{
+	const char controlChars[] = "\x01\b\f\n\r\t\x1F \"\\/\x7F";
+	const CStringPart str( controlChars, sizeof( controlChars ) - 1 );
+	const CStringPart expectedText = "\"\\u0001\\b\\f\\n\\r\\t\\u001F \\\"\\\\\\/\x7F\"";
+	const auto text = getWrittenText( [=]( CJsonWriter& writer ) { writer.WriteString( str ); } );
+	TEST_CHECK( text == expectedText );
+
+	CJsonDocument document;
+	document.SetRoot( document.CreateString( str ) );
+	TEST_CHECK( document.GetDocumentString() == expectedText );
+
+	CJsonDocument parsedDocument;
+	parsedDocument.CreateFromString( Str( "[" ) + text + "]" );
+	TEST_CHECK( ( *parsedDocument.GetRoot().GetAsArray().begin() )->GetAsString() == str );
+}
+
+// Buffered text is written to the file when the writer is destroyed.
+RELIB_TEST( JsonWriterFlushesOnDestruction )
+{
+	const auto fileName = TempFile::New();
+	{
+		CFileWriter file( fileName, FCM_CreateAlways );
+		CJsonWriter writer( file );
+		writer.StartArray();
+		writer.WriteBool( true );
+		writer.EndArray();
+	}
+	TEST_CHECK( File::ReadText( fileName ) == "[true]" );
+	TempFile::Delete( fileName );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
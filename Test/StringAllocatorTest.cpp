@@ -0,0 +1,107 @@
+#include "TestFramework.h"
+#include <StringAllocator.h>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+static __int64 getTotalLiveBytes( const CStringAllocatorStatistics& statistics )
+{
+	__int64 result = statistics.LargeLiveBytes;
+	for( int i = 0; i < StringSizeClassCount; i++ ) {
+		result += statistics.LiveBytes[i];
+	}
+	return result;
+}
+
+// Size class of the given string size.
+static int getSizeClass( int size )
+{
+	int result = 0;
+	while( CStringAllocator::GetSizeClassBlockSize( result ) < size ) {
+		result++;
+	}
+	return result;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Blocks allocated on one thread and freed on another return to their heap when the heap is released.
+RELIB_TEST( StringAllocatorCrossThreadFree )
+{
+	const int stringCount = 5000;
+	auto& allocator = GetStringAllocator();
+	const auto statisticsBefore = allocator.GetStatistics();
+
+	std::vector<CRawBuffer> strings;
+	std::promise<void> allocated;
+	std::promise<void> freed;
+	std::thread producer( [&]() {
+		for( int i = 0; i < stringCount; i++ ) {
+			// Sizes of all the size classes and a few large strings.
+			const int size = 1 + ( i * 37 ) % 5000;
+			strings.push_back( allocator.AllocateSized( size ) );
+			memset( strings.back().Ptr(), 'a', size );
+		}
+		allocated.set_value();
+		// The producer heap collects the remote frees when its thread ends.
+		freed.get_future().wait();
+	} );
+
+	allocated.get_future().wait();
+	TEST_CHECK( getTotalLiveBytes( allocator.GetStatistics() ) > getTotalLiveBytes( statisticsBefore ) );
+	std::thread consumer( [&]() {
+		for( const auto& str : strings ) {
+			allocator.Free( str );
+		}
+	} );
+	consumer.join();
+	freed.set_value();
+	producer.join();
+
+	const auto statisticsAfter = allocator.GetStatistics();
+	TEST_CHECK( getTotalLiveBytes( statisticsAfter ) == getTotalLiveBytes( statisticsBefore ) );
+	TEST_CHECK( statisticsAfter.CachedBytes == statisticsBefore.CachedBytes );
+	const auto smallStringCount = statisticsAfter.FreeCount - statisticsBefore.FreeCount;
+	TEST_CHECK( smallStringCount > 0 && smallStringCount < stringCount );
+	TEST_CHECK( statisticsAfter.RemoteFreeCount - statisticsBefore.RemoteFreeCount == smallStringCount );
+}
+
+// Memory freed on other threads is reused, live bytes don't grow with the number of rounds.
+RELIB_TEST( StringAllocatorPingPong )
+{
+	const int roundCount = 20;
+	const int roundStringCount = 1000;
+	const int maxStringSize = 300;
+	auto& allocator = GetStringAllocator();
+	const auto statisticsBefore = allocator.GetStatistics();
+	for( int round = 0; round < roundCount; round++ ) {
+		std::vector<CRawBuffer> strings;
+		std::thread producer( [&]() {
+			for( int i = 0; i < roundStringCount; i++ ) {
+				strings.push_back( allocator.AllocateSized( 1 + ( i * 13 + round ) % maxStringSize ) );
+			}
+		} );
+		producer.join();
+		std::thread consumer( [&]() {
+			for( const auto& str : strings ) {
+				allocator.Free( str );
+			}
+			// The consumer heap also has blocks of its own.
+			for( int i = 0; i < 100; i++ ) {
+				allocator.Free( allocator.AllocateSized( 1 + i ) );
+			}
+		} );
+		consumer.join();
+	}
+	// Remote frees of the last rounds wait for the next threads that take their heaps.
+	const __int64 maxRoundBytes = roundStringCount * CStringAllocator::GetSizeClassBlockSize( getSizeClass( maxStringSize ) );
+	const auto statisticsAfter = allocator.GetStatistics();
+	TEST_CHECK( getTotalLiveBytes( statisticsAfter ) - getTotalLiveBytes( statisticsBefore ) <= 2 * maxRoundBytes );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
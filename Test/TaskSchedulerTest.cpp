@@ -0,0 +1,198 @@
+#include "TestFramework.h"
+#include <TaskScheduler.h>
+#include <WorkStealingDeque.h>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Relib::RelibInternal;
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( WorkStealingDequeOwnerOperations )
+{
+	CWorkStealingDeque<int> deque( 2 );
+	std::vector<int> values( 100 );
+	for( int i = 0; i < 100; i++ ) {
+		deque.Push( &values[i] );
+	}
+	TEST_CHECK( deque.Size() == 100 );
+	// The owner takes the newest element, thieves take the oldest.
+	TEST_CHECK( deque.Pop() == &values[99] );
+	TEST_CHECK( deque.Steal() == &values[0] );
+	for( int i = 98; i > 0; i-- ) {
+		TEST_CHECK( deque.Pop() == &values[i] );
+	}
+	TEST_CHECK( deque.Pop() == nullptr );
+	TEST_CHECK( deque.Steal() == nullptr );
+	TEST_CHECK( deque.IsEmpty() );
+}
+
+RELIB_TEST( WorkStealingDequeConcurrentSteal )
+{
+	const int elementCount = 200000;
+	const int thiefCount = 3;
+	std::vector<int> values( elementCount );
+	std::vector<std::atomic<int>> takeCounts( elementCount );
+	for( auto& count : takeCounts ) {
+		count.store( 0 );
+	}
+	CWorkStealingDeque<int> deque( 16 );
+	std::atomic<bool> isPushing( true );
+
+	std::vector<std::thread> thieves;
+	for( int i = 0; i < thiefCount; i++ ) {
+		thieves.emplace_back( [&]() {
+			while( isPushing.load() || !deque.IsEmpty() ) {
+				int* elem = deque.Steal();
+				if( elem != nullptr ) {
+					takeCounts[elem - values.data()]++;
+				}
+			}
+		} );
+	}
+	for( int i = 0; i < elementCount; i++ ) {
+		deque.Push( &values[i] );
+		if( i % 3 == 0 ) {
+			int* elem = deque.Pop();
+			if( elem != nullptr ) {
+				takeCounts[elem - values.data()]++;
+			}
+		}
+	}
+	isPushing.store( false );
+	for( int* elem = deque.Pop(); elem != nullptr; elem = deque.Pop() ) {
+		takeCounts[elem - values.data()]++;
+	}
+	for( auto& thief : thieves ) {
+		thief.join();
+	}
+
+	int wrongCount = 0;
+	for( auto& count : takeCounts ) {
+		wrongCount += count.load() == 1 ? 0 : 1;
+	}
+	TEST_CHECK( wrongCount == 0 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( TaskSchedulerRunsAllTasks )
+{
+	std::atomic<int> doneCount( 0 );
+	{
+		CTaskScheduler scheduler( 4, nullptr );
+		for( int i = 0; i < 10000; i++ ) {
+			scheduler.Execute( [&doneCount]() { doneCount++; } );
+		}
+		scheduler.WaitFor( doneCount, 10000 );
+		TEST_CHECK( doneCount.load() == 10000 );
+
+		// Tasks added by the workers go to their own deques.
+		std::atomic<int> nestedCount( 0 );
+		for( int i = 0; i < 100; i++ ) {
+			scheduler.Execute( [&scheduler, &nestedCount]() {
+				for( int j = 0; j < 100; j++ ) {
+					scheduler.Execute( [&nestedCount]() { nestedCount++; } );
+				}
+			} );
+		}
+		scheduler.WaitFor( nestedCount, 10000 );
+		TEST_CHECK( nestedCount.load() == 10000 );
+	}
+	// The destructor waits for the remaining tasks.
+	std::atomic<int> lateCount( 0 );
+	{
+		CTaskScheduler scheduler( 2, nullptr );
+		for( int i = 0; i < 1000; i++ ) {
+			scheduler.Execute( [&lateCount]() { lateCount++; } );
+		}
+	}
+	TEST_CHECK( lateCount.load() == 1000 );
+}
+
+static std::atomic<int> handledExceptionCount( 0 );
+
+static void countTaskException()
+{
+	try {
+		throw;
+	} catch( const std::runtime_error& ) {
+		handledExceptionCount++;
+	}
+}
+
+RELIB_TEST( TaskSchedulerHandlesTaskExceptions )
+{
+	handledExceptionCount.store( 0 );
+	std::atomic<int> doneCount( 0 );
+	{
+		CTaskScheduler scheduler( 2, countTaskException );
+		for( int i = 0; i < 100; i++ ) {
+			scheduler.Execute( [&doneCount, i]() {
+				doneCount++;
+				if( i % 2 == 0 ) {
+					throw std::runtime_error( "Task failure." );
+				}
+			} );
+		}
+		scheduler.WaitFor( doneCount, 100 );
+	}
+	TEST_CHECK( handledExceptionCount.load() == 50 );
+}
+
+RELIB_TEST( TaskSchedulerParallelForVisitsEveryIndex )
+{
+	CTaskScheduler scheduler( 4, nullptr );
+	const int indexCount = 100003;
+	std::vector<std::atomic<int>> visitCounts( indexCount );
+	for( auto& count : visitCounts ) {
+		count.store( 0 );
+	}
+	scheduler.ParallelFor( 0, indexCount, 97, [&]( int index ) { visitCounts[index]++; } );
+	int wrongCount = 0;
+	for( auto& count : visitCounts ) {
+		wrongCount += count.load() == 1 ? 0 : 1;
+	}
+	TEST_CHECK( wrongCount == 0 );
+
+	// Empty range and a single chunk.
+	std::atomic<int> callCount( 0 );
+	scheduler.ParallelFor( 5, 5, 1, [&]( int ) { callCount++; } );
+	TEST_CHECK( callCount.load() == 0 );
+	scheduler.ParallelFor( -10, 10, 100, [&]( int ) { callCount++; } );
+	TEST_CHECK( callCount.load() == 20 );
+}
+
+RELIB_TEST( TaskSchedulerParallelForNested )
+{
+	CTaskScheduler scheduler( 3, nullptr );
+	std::atomic<int> callCount( 0 );
+	scheduler.ParallelFor( 0, 64, 1, [&]( int ) {
+		scheduler.ParallelFor( 0, 64, 4, [&]( int ) { callCount++; } );
+	} );
+	TEST_CHECK( callCount.load() == 64 * 64 );
+}
+
+RELIB_TEST( TaskSchedulerParallelForRethrows )
+{
+	CTaskScheduler scheduler( 4, nullptr );
+	for( int attempt = 0; attempt < 20; attempt++ ) {
+		std::atomic<int> callCount( 0 );
+		TEST_CHECK_THROWS( scheduler.ParallelFor( 0, 100000, 10, [&]( int index ) {
+			callCount++;
+			if( index == 500 ) {
+				throw std::runtime_error( "Chunk failure." );
+			}
+		} ), std::runtime_error );
+		// The chunks that were not started after the failure are skipped.
+		TEST_CHECK( callCount.load() < 100000 );
+	}
+	// The scheduler stays usable.
+	std::atomic<int> callCount( 0 );
+	scheduler.ParallelFor( 0, 1000, 10, [&]( int ) { callCount++; } );
+	TEST_CHECK( callCount.load() == 1000 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
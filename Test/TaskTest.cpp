@@ -0,0 +1,81 @@
+#include "TestFramework.h"
+#include <Task.h>
+#include <Promise.h>
+#include <stdexcept>
+
+// Task.h is empty without coroutine support. The file is compiled as C++20 in the test project.
+#ifdef __cpp_impl_coroutine
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+static CTask<int> failingTask()
+{
+	throw std::runtime_error( "Task failure." );
+	co_return 0;
+}
+
+static CTask<int> catchingTask( bool& hasCaught )
+{
+	try {
+		co_return co_await failingTask();
+	} catch( const std::runtime_error& ) {
+		hasCaught = true;
+	}
+	co_return -1;
+}
+
+static CTask<int> awaitingTask( CFuture<int> future, bool shouldThrow )
+{
+	const int value = co_await future;
+	if( shouldThrow ) {
+		throw std::runtime_error( "Continuation failure." );
+	}
+	co_return value + 1;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// The exception of a task is rethrown in the awaiting coroutine, which then continues as usual.
+RELIB_TEST( TaskExceptionReachesAwaitingCoroutine )
+{
+	bool hasCaught = false;
+	auto future = catchingTask( hasCaught ).Start();
+	TEST_CHECK( hasCaught );
+	TEST_CHECK( future.GetValue() == -1 );
+}
+
+// A started task that throws abandons its future with the exception.
+RELIB_TEST( TaskStartedTaskAbandonsFuture )
+{
+	auto future = failingTask().Start();
+	TEST_CHECK_THROWS( future.GetValue(), std::runtime_error );
+}
+
+// A task that throws after being resumed by a continuation doesn't stop the other continuations of the producer.
+RELIB_TEST( TaskExceptionDoesNotEscapeIntoProducer )
+{
+	CPromise<int> promise;
+	auto failedResult = awaitingTask( promise.GetFuture(), true ).Start();
+	auto result = awaitingTask( promise.GetFuture(), false ).Start();
+	promise.CreateValue( 41 );
+	TEST_CHECK_THROWS( failedResult.GetValue(), std::runtime_error );
+	TEST_CHECK( result.GetValue() == 42 );
+}
+
+// A coroutine that awaits an abandoned future is resumed and co_await throws.
+RELIB_TEST( TaskAwaitOfAbandonedFutureThrows )
+{
+	CFuture<int> result;
+	{
+		CPromise<int> promise;
+		result = awaitingTask( promise.GetFuture(), false ).Start();
+	}
+	TEST_CHECK_THROWS( result.GetValue(), CAbandonedFutureException );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+#endif	// __cpp_impl_coroutine.
+
@@ -0,0 +1,85 @@
+#include "TestFramework.h"
+#include <exception>
+#include <stdio.h>
+#include <string.h>
+
+namespace RelibTest {
+
+//////////////////////////////////////////////////////////////////////////
+
+struct CTestInfo {
+	const char* Name;
+	TTestFunction Function;
+};
+
+static const int maxTestCount = 1024;
+
+// The registry is filled during static initialization, so it must not depend on constructors of other globals.
+static CTestInfo& getTest( int index )
+{
+	static CTestInfo tests[maxTestCount];
+	return tests[index];
+}
+
+static int& getTestCount()
+{
+	static int testCount = 0;
+	return testCount;
+}
+
+static int currentFailureCount = 0;
+
+CTestRegistration::CTestRegistration( const char* name, TTestFunction function )
+{
+	int& testCount = getTestCount();
+	if( testCount == maxTestCount ) {
+		fprintf( stderr, "Too many tests, %s is not registered.\n", name );
+		return;
+	}
+	getTest( testCount ).Name = name;
+	getTest( testCount ).Function = function;
+	testCount++;
+}
+
+void ReportFailure( const char* file, int line, const char* expression )
+{
+	fprintf( stderr, "%s(%d): check failed: %s\n", file, line, expression );
+	currentFailureCount++;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibTest.
+
+using namespace RelibTest;
+
+// Runs all the tests or the tests whose names contain the first argument.
+int main( int argc, char** argv )
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+	int runCount = 0;
+	int failedCount = 0;
+	for( int i = 0; i < getTestCount(); i++ ) {
+		const CTestInfo& test = getTest( i );
+		if( strstr( test.Name, filter ) == nullptr ) {
+			continue;
+		}
+		currentFailureCount = 0;
+		try {
+			test.Function();
+		} catch( const std::exception& e ) {
+			fprintf( stderr, "%s: unexpected exception: %s\n", test.Name, e.what() );
+			currentFailureCount++;
+		} catch( ... ) {
+			fprintf( stderr, "%s: unexpected exception.\n", test.Name );
+			currentFailureCount++;
+		}
+		printf( "%s %s\n", currentFailureCount == 0 ? "[  OK  ]" : "[FAILED]", test.Name );
+		fflush( stdout );
+		runCount++;
+		failedCount += currentFailureCount == 0 ? 0 : 1;
+	}
+	printf( "%d of %d tests passed.\n", runCount - failedCount, runCount );
+	return failedCount == 0 ? 0 : 1;
+}
+
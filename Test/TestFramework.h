@@ -0,0 +1,46 @@
+#pragma once
+
+// Minimal test registry for the library tests.
+// Only the standard library is used, so the portable tests build on every platform.
+
+namespace RelibTest {
+
+//////////////////////////////////////////////////////////////////////////
+
+typedef void ( *TTestFunction )();
+
+// Registers a test function during static initialization.
+class CTestRegistration {
+public:
+	CTestRegistration( const char* name, TTestFunction function );
+};
+
+// Report a failed check. The test continues after a failure.
+void ReportFailure( const char* file, int line, const char* expression );
+
+//////////////////////////////////////////////////////////////////////////
+
+}	// namespace RelibTest.
+
+// Define a test function that is run by the test executable.
+#define RELIB_TEST( name ) \
+	static void name(); \
+	static RelibTest::CTestRegistration name##Registration( #name, name ); \
+	static void name()
+
+// Check a condition and report the failure without stopping the test.
+#define TEST_CHECK( expr ) \
+	( ( expr ) ? ( void )0 : RelibTest::ReportFailure( __FILE__, __LINE__, #expr ) )
+
+// Check that the expression throws an exception of the given type.
+#define TEST_CHECK_THROWS( expr, ExceptionType ) \
+	do { \
+		bool hasThrown = false; \
+		try { \
+			expr; \
+		} catch( const ExceptionType& ) { \
+			hasThrown = true; \
+		} \
+		TEST_CHECK( hasThrown && #expr " throws " #ExceptionType ); \
+	} while( false )
+
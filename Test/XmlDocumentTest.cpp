@@ -0,0 +1,54 @@
+#include "TestFramework.h"
+#include <XmlDocument.h>
+#include <XmlElement.h>
+#include <StrConversions.h>
+
+//////////////////////////////////////////////////////////////////////////
+
+// The whole text of a tiny document is stored inline in the string object.
+RELIB_TEST( XmlDocumentParsesTinyDocument )
+{
+	CXmlDocument document;
+	document.LoadFromString( CUnicodeString( L"<a b='c'/>" ) );
+	TEST_CHECK( document.GetRoot().Name() == L"a" );
+	TEST_CHECK( document.GetRoot().GetAttributeValueText( L"b" ) == L"c" );
+
+	document.LoadFromString( CUnicodeString( L"<r><x/></r>" ) );
+	TEST_CHECK( document.GetRoot().Name() == L"r" );
+	TEST_CHECK( document.GetRoot().FirstChild()->Name() == L"x" );
+}
+
+// Element names are views of the document strings, so the strings must stay in place while the document grows.
+RELIB_TEST( XmlDocumentKeepsShortNamesWhileGrowing )
+{
+	const int childCount = 1000;
+	CXmlDocument document;
+	document.SetRoot( L"r" );
+	CXmlElement& root = document.GetRoot();
+	for( int i = 0; i < childCount; i++ ) {
+		CXmlElement& child = root.CreateChild( L"e" + UnicodeStr( i ) );
+		child.AddAttribute( L"k" + UnicodeStr( i ), i );
+	}
+
+	TEST_CHECK( root.Name() == L"r" );
+	int childPos = 0;
+	for( const CXmlElement& child : root.Children() ) {
+		TEST_CHECK( child.Name() == L"e" + UnicodeStr( childPos ) );
+		TEST_CHECK( child.GetAttributeValue( L"k" + UnicodeStr( childPos ), -1 ) == childPos );
+		childPos++;
+	}
+	TEST_CHECK( childPos == childCount );
+
+	// A parsed copy of the document.
+	CXmlDocument copy;
+	copy.LoadFromString( root.ToString() );
+	childPos = 0;
+	for( const CXmlElement& child : copy.GetRoot().Children() ) {
+		TEST_CHECK( child.Name() == L"e" + UnicodeStr( childPos ) );
+		childPos++;
+	}
+	TEST_CHECK( childPos == childCount );
+}
+
+//////////////////////////////////////////////////////////////////////////
+
@@ -0,0 +1,95 @@
+#include "TestFramework.h"
+#include <ZipConverter.h>
+#include <ThreadPool.h>
+#include <Errors.h>
+#include <string.h>
+
+using namespace Relib;
+
+//////////////////////////////////////////////////////////////////////////
+
+static const int testBlockSize = 64 * 1024;
+
+// Compressible data that differs from block to block.
+static CArray<BYTE> createTestData( int size )
+{
+	CArray<BYTE> result;
+	result.IncreaseSizeNoInitialize( size );
+	for( int i = 0; i < size; i++ ) {
+		result[i] = static_cast<BYTE>( ( i / 7 ) ^ ( i >> 12 ) );
+	}
+	return result;
+}
+
+static bool areEqual( CArrayView<BYTE> left, CArrayView<BYTE> right )
+{
+	return left.Size() == right.Size() && ::memcmp( left.Ptr(), right.Ptr(), left.Size() ) == 0;
+}
+
+static void writeHeaderValue( CArray<BYTE>& container, int pos, int value )
+{
+	::memcpy( container.Ptr() + pos, &value, sizeof( value ) );
+}
+
+// Positions of the block container header values.
+static const int containerBlockSizePos = 4;
+static const int containerDataSizePos = 8;
+
+//////////////////////////////////////////////////////////////////////////
+
+RELIB_TEST( ZipConverterParallelRoundTrip )
+{
+	const auto data = createTestData( 10 * testBlockSize + 123 );
+	CThreadPool pool( 4 );
+	CZipConverter converter( CZipConverter::DefaultCompressionLevel, &pool, testBlockSize );
+	CArray<BYTE> zipped;
+	converter.ZipData( data, zipped );
+	CArray<BYTE> unzipped;
+	CZipConverter().UnzipData( zipped, unzipped );
+	TEST_CHECK( areEqual( unzipped, data ) );
+
+	CArray<BYTE> container;
+	converter.ZipBlocks( data, container );
+	TEST_CHECK( CZipConverter::GetBlockCount( container ) == 11 );
+	CArray<BYTE> unzippedBlocks;
+	converter.UnzipData( container, unzippedBlocks );
+	TEST_CHECK( areEqual( unzippedBlocks, data ) );
+	CArray<BYTE> lastBlock;
+	converter.UnzipBlock( container, 10, lastBlock );
+	TEST_CHECK( areEqual( lastBlock, CArrayView<BYTE>( data ).Mid( 10 * testBlockSize ) ) );
+}
+
+// Failure of a single block reaches the caller of the parallel decompression, the result keeps its previous contents.
+RELIB_TEST( ZipConverterCorruptedBlockThrows )
+{
+	const auto data = createTestData( 10 * testBlockSize );
+	CThreadPool pool( 4 );
+	CZipConverter converter( CZipConverter::DefaultCompressionLevel, &pool, testBlockSize );
+	CArray<BYTE> container;
+	converter.ZipBlocks( data, container );
+	// Damage the middle of the container, the surrounding blocks stay valid.
+	for( int i = container.Size() / 2; i < container.Size() / 2 + 64; i++ ) {
+		container[i] = static_cast<BYTE>( ~container[i] );
+	}
+	CArray<BYTE> result;
+	result.Add( 42 );
+	TEST_CHECK_THROWS( converter.UnzipData( container, result ), CCheckException );
+	TEST_CHECK( result.Size() == 1 && result[0] == 42 );
+}
+
+// Data size of a corrupted header that the compressed blocks can't hold is rejected before the result is allocated.
+RELIB_TEST( ZipConverterOversizedHeaderThrows )
+{
+	const auto data = createTestData( 1000 );
+	CZipConverter converter;
+	CArray<BYTE> container;
+	converter.ZipBlocks( data, container );
+	writeHeaderValue( container, containerBlockSizePos, 1 << 30 );
+	writeHeaderValue( container, containerDataSizePos, 1 << 30 );
+	CArray<BYTE> result;
+	TEST_CHECK_THROWS( converter.UnzipData( container, result ), CCheckException );
+	TEST_CHECK( result.Capacity() < 1 << 30 );
+}
+
+//////////////////////////////////////////////////////////////////////////
+